@@ -29,4 +29,27 @@ function(prepend var_name prefix)
         list(APPEND lst "${prefix}/${filename}")
     endforeach()
     set(${var_name} "${lst}" PARENT_SCOPE)
-endfunction()
\ No newline at end of file
+endfunction()
+
+# Compiles the sources for an instruction set above the baseline (AVX2 or AVX512), for kernels that are selected at
+# runtime with tools/cpu.hpp, which describes what these translation units may contain.  Floating point contraction is
+# disabled so that the kernels give the same results on every instruction set.
+function(isa_sources isa)
+    if(isa STREQUAL "AVX2")
+        set(msvc_flags "/arch:AVX2")
+        set(gcc_flags "-mavx2 -ffp-contract=off")
+    elseif(isa STREQUAL "AVX512")
+        set(msvc_flags "/arch:AVX512")
+        set(gcc_flags "-mavx512f -ffp-contract=off")
+    else()
+        message(FATAL_ERROR "isa_sources: unknown instruction set ${isa}")
+    endif()
+
+    foreach(filename ${ARGN})
+        if(MSVC)
+            set_source_files_properties(${filename} PROPERTIES COMPILE_FLAGS "${msvc_flags}")
+        else()
+            set_source_files_properties(${filename} PROPERTIES COMPILE_FLAGS "${gcc_flags}")
+        endif()
+    endforeach()
+endfunction()
@@ -5,6 +5,8 @@
 using namespace zap::engine;
 using namespace zap::engine::gl;
 
+GLbitfield gl_access(range_access::code access);
+
 buffer::~buffer() {
     if(is_allocated()) deallocate();
 }
@@ -49,6 +51,19 @@ bool buffer::initialise(buffer_type type, buffer_usage usage, size_t size, const
     return true;
 }
 
+bool buffer::initialise_storage(buffer_type type, size_t size, range_access::code flags, const char* data) {
+    assert(is_allocated() && ZERR_UNALLOCATED_BUFFER);
+    if(!storage_supported()) { LOG_ERR("glBufferStorage is not supported"); return false; }
+    glBufferStorage(gl_type(type), size, data, gl_access(flags));
+    if(gl_error_check()) return false;
+    size_ = size;
+    return true;
+}
+
+bool buffer::storage_supported() {
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
 bool buffer::orphan(buffer_type type, buffer_usage usage) {
     assert(is_allocated() && ZERR_UNALLOCATED_BUFFER);
     //assert(is_bound() && "Attempt to orphan unbound buffer");
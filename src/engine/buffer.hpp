@@ -45,6 +45,11 @@ namespace zap { namespace engine {
             return initialise(type, usage, data.size(), data.data());
         }
 
+        // Immutable storage (glBufferStorage), required to map the buffer with BA_MAP_PERSISTENT.  Flags may only
+        // combine BA_MAP_READ, BA_MAP_WRITE, BA_MAP_PERSISTENT and BA_MAP_COHERENT.
+        bool initialise_storage(buffer_type type, size_t size, range_access::code flags, const char* data=nullptr);
+        static bool storage_supported();
+
         bool orphan(buffer_type type, buffer_usage usage);
 
         bool copy(buffer_type type, size_t offset, size_t size, const char* data); // glBufferSubData
@@ -0,0 +1,26 @@
+/* Created by Darren Otgaar on 2018/06/18. http://www.github.com/otgaard/zap */
+#include "fence.hpp"
+#include "gl_api.hpp"
+
+using namespace zap::engine;
+using namespace zap::engine::gl;
+
+void fence::insert() {
+    reset();
+    sync_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gl_error_check();
+}
+
+bool fence::wait(uint64_t timeout) {
+    if(!sync_) return true;
+    auto result = glClientWaitSync(reinterpret_cast<GLsync>(sync_), GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if(result == GL_TIMEOUT_EXPIRED) return false;
+    if(result == GL_WAIT_FAILED) gl_error_check();
+    reset();
+    return true;
+}
+
+void fence::reset() {
+    if(sync_) glDeleteSync(reinterpret_cast<GLsync>(sync_));
+    sync_ = nullptr;
+}
@@ -0,0 +1,34 @@
+/* Created by Darren Otgaar on 2018/06/18. http://www.github.com/otgaard/zap */
+#ifndef ZAP_FENCE_HPP
+#define ZAP_FENCE_HPP
+
+// A GPU fence (glFenceSync) for synchronising the client with commands already submitted, e.g. before overwriting a
+// persistently mapped buffer that may still be read by the GPU.
+
+#include <cstdint>
+#include "engine.hpp"
+
+namespace zap { namespace engine {
+    class ZAPENGINE_EXPORT fence {
+    public:
+        fence() = default;
+        fence(const fence&) = delete;
+        ~fence() { reset(); }
+
+        fence& operator=(const fence&) = delete;
+
+        bool is_pending() const { return sync_ != nullptr; }
+
+        // Inserts the fence after the commands submitted so far, replacing any pending fence
+        void insert();
+        // Waits up to timeout nanoseconds for the fence, returns false on timeout.  A fence that is not pending is
+        // signalled.
+        bool wait(uint64_t timeout=1000000000);
+        void reset();
+
+    protected:
+        void* sync_ = nullptr;
+    };
+}}
+
+#endif //ZAP_FENCE_HPP
@@ -57,6 +57,15 @@ namespace zap { namespace engine {
             return false;
         }
 
+        // Immutable storage for persistent mapping (see buffer::initialise_storage)
+        bool initialise_storage(size_t width, size_t height, range_access::code flags, const pixel_t* data=nullptr) {
+            if(buffer::initialise_storage(write_type, width*height*pixel_t::bytesize, flags, reinterpret_cast<const char*>(data))) {
+                pixel_count_ = width*height; width_ = width; height_ = height; depth_ = 1;
+                return true;
+            }
+            return false;
+        }
+
         bool resize(size_t width, size_t height) {
             if(buffer::initialise(write_type, usage_, width*height*pixel_t::bytesize)) {
                 pixel_count_ = width*height; width_ = width; height_ = height; depth_ = 1;
@@ -75,13 +84,14 @@ namespace zap { namespace engine {
         }
         bool unmap(bool write) { return buffer::unmap(write ? write_type: read_type); }
 
-        size_t copy(const typename pixmap_t::buffer_t& buffer, size_t src_off, size_t trg_off, size_t pixel_count) {
+        // Copies the pixmap storage (see pixmap) from src_off
+        size_t copy(const pixmap_t& pmap, size_t src_off, size_t trg_off, size_t pixel_count) {
             const size_t length = pixel_count * pixel_t::bytesize;
             const size_t src_offset = src_off * pixel_t::bytesize;
             const size_t trg_offset = trg_off * pixel_t::bytesize;
-            if(src_offset + length <= buffer.size()*pixel_t::bytesize && trg_offset + length <= size_) {
+            if(src_offset + length <= pmap.bytesize() && trg_offset + length <= size_) {
                 bind();
-                buffer::copy(write_type, trg_offset, length, reinterpret_cast<const char*>(buffer.data())+src_offset);
+                buffer::copy(write_type, trg_offset, length, reinterpret_cast<const char*>(pmap.data())+src_offset);
                 release();
                 return pixel_count;
             }
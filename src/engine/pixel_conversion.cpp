@@ -3,18 +3,178 @@
 //
 
 #include "pixel_conversion.hpp"
+#include "pixel_kernels.hpp"
 #include "engine/pixmap.hpp"
+#include <cmath>
+#include <vector>
+#include <tools/cpu.hpp>
+
+using namespace zap::engine::pixel_kernels;
+
+namespace {
+    struct sse2_tag { };
+
+    const kernel_table& kernels() {
+        static const kernel_table& table = zap::host_supports_avx2() ? avx2_kernels() : sse2_kernels();
+        return table;
+    }
+
+    // Resolves the map of each target channel from src_channels (see convert_pixels)
+    void resolve_map(int src_channels, const zap::engine::channel_map* map, int8_t* out) {
+        for(int c = 0; c != 4; ++c) {
+            if(map) out[c] = map->channel[c] < src_channels ? map->channel[c] : map_zero;
+            else if(c < src_channels) out[c] = int8_t(c);
+            else if(c == 3) out[c] = map_one;
+            else if(src_channels == 1) out[c] = 0;
+            else out[c] = map_zero;
+        }
+    }
+
+    // Conversions that change the depth are done in blocks of pixels through the stack
+    constexpr size_t block = 1024;
+}
+
+const kernel_table& zap::engine::pixel_kernels::sse2_kernels() {
+    static const kernel_table table = make_kernel_table<sse2_tag>();
+    return table;
+}
+
+const float* zap::engine::pixel_kernels::srgb_decode_table() {
+    static const std::vector<float> table = []() {
+        std::vector<float> tbl(256);
+        for(size_t i = 0; i != tbl.size(); ++i) {
+            const double v = i/255.;
+            tbl[i] = float(v <= .04045 ? v/12.92 : std::pow((v + .055)/1.055, 2.4));
+        }
+        return tbl;
+    }();
+    return table.data();
+}
+
+const uint8_t* zap::engine::pixel_kernels::srgb_encode_table() {
+    static const std::vector<uint8_t> table = []() {
+        std::vector<uint8_t> tbl(srgb_encode_size);
+        for(size_t i = 0; i != tbl.size(); ++i) {
+            const double v = double(i)/(srgb_encode_size - 1);
+            const double s = v <= .0031308 ? 12.92*v : 1.055*std::pow(v, 1./2.4) - .055;
+            tbl[i] = uint8_t(std::floor(255.*s + .5));
+        }
+        return tbl;
+    }();
+    return table.data();
+}
 
 namespace zap { namespace engine {
 
-template<>
-bool convert(const engine::pixmap<float>& input, engine::pixmap<engine::rgb888_t>& output) {
-    assert(input.size() >= output.size() && "Output size must be >= to Input size");
-    if(input.size() < output.size()) return false;
+bool convert_pixels(const void* src, const pixel_layout& src_layout, void* dst, const pixel_layout& dst_layout,
+                    size_t count, const channel_map* map) {
+    const int sc = src_layout.channels, dc = dst_layout.channels;
+    if(sc < 1 || sc > 4 || dc < 1 || dc > 4) {
+        LOG_ERR("Invalid pixel layout for conversion:", sc, "to", dc, "channels");
+        return false;
+    }
+
+    const auto& K = kernels();
+    int8_t m[4];
+    resolve_map(sc, map, m);
+    bool identity = sc == dc;
+    for(int c = 0; c != dc; ++c) identity = identity && m[c] == c;
 
-    const float scale = 128.f, bias = 127.f;
-    for(auto px = 0; px != input.size(); ++px) output[px].set((byte)(scale*input[px] + bias));
+    // Only the 8-bit formats are encoded
+    const bool src_srgb = !src_layout.is_float && src_layout.space == colour_space::CS_SRGB;
+    const bool dst_srgb = !dst_layout.is_float && dst_layout.space == colour_space::CS_SRGB;
+
+    auto to_float = [&K, src_srgb](const uint8_t* s, float* d, size_t n, int channels) {
+        if(src_srgb) K.srgb_to_float(s, d, n, channels);
+        else         K.unorm_to_float(s, d, n*channels);
+    };
+    auto to_unorm = [&K, dst_srgb](const float* s, uint8_t* d, size_t n, int channels) {
+        if(dst_srgb) K.float_to_srgb(s, d, n, channels);
+        else         K.float_to_unorm(s, d, n*channels);
+    };
+
+    if(src_layout.is_float && dst_layout.is_float) {
+        K.remap_float(static_cast<const float*>(src), sc, static_cast<float*>(dst), dc, m, count);
+    } else if(!src_layout.is_float && !dst_layout.is_float && src_srgb == dst_srgb) {
+        K.remap_unorm(static_cast<const uint8_t*>(src), sc, static_cast<uint8_t*>(dst), dc, m, count);
+    } else if(!src_layout.is_float && dst_layout.is_float) {
+        auto s = static_cast<const uint8_t*>(src);
+        auto d = static_cast<float*>(dst);
+        if(identity) {
+            to_float(s, d, count, sc);
+        } else {
+            // Remap the bytes before expanding them
+            uint8_t buffer[4*block];
+            for(size_t i = 0; i < count; i += block, s += block*sc, d += block*dc) {
+                const size_t n = count - i < block ? count - i : block;
+                K.remap_unorm(s, sc, buffer, dc, m, n);
+                to_float(buffer, d, n, dc);
+            }
+        }
+    } else if(src_layout.is_float && !dst_layout.is_float) {
+        auto s = static_cast<const float*>(src);
+        auto d = static_cast<uint8_t*>(dst);
+        if(identity) {
+            to_unorm(s, d, count, sc);
+        } else {
+            // Pack the floats before remapping them
+            uint8_t buffer[4*block];
+            for(size_t i = 0; i < count; i += block, s += block*sc, d += block*dc) {
+                const size_t n = count - i < block ? count - i : block;
+                to_unorm(s, buffer, n, sc);
+                K.remap_unorm(buffer, sc, d, dc, m, n);
+            }
+        }
+    } else {
+        // Between linear and sRGB bytes through floats
+        auto s = static_cast<const uint8_t*>(src);
+        auto d = static_cast<uint8_t*>(dst);
+        float buffer[4*block];
+        uint8_t bytes[4*block];
+        for(size_t i = 0; i < count; i += block, s += block*sc, d += block*dc) {
+            const size_t n = count - i < block ? count - i : block;
+            to_float(s, buffer, n, sc);
+            to_unorm(buffer, bytes, n, sc);
+            K.remap_unorm(bytes, sc, d, dc, m, n);
+        }
+    }
     return true;
 }
 
-}}
\ No newline at end of file
+void premultiply(rgba8888_t* pixels, size_t count) {
+    kernels().premultiply_unorm(reinterpret_cast<uint8_t*>(pixels), count);
+}
+
+void premultiply(rgba32f_t* pixels, size_t count) {
+    kernels().premultiply_float(reinterpret_cast<float*>(pixels), count);
+}
+
+void unpremultiply(rgba8888_t* pixels, size_t count) {
+    kernels().unpremultiply_unorm(reinterpret_cast<uint8_t*>(pixels), count);
+}
+
+void unpremultiply(rgba32f_t* pixels, size_t count) {
+    kernels().unpremultiply_float(reinterpret_cast<float*>(pixels), count);
+}
+
+template<>
+bool convert(const engine::pixmap<float>& input, engine::pixmap<engine::rgb888_t>& output) {
+    return convert_rows(input, output, [](const float* src, rgb888_t* output_row, size_t count) {
+        const float scale = 128.f, bias = 127.f;
+        const int8_t grey[4] = { 0, 0, 0, map_one };
+        auto trg = reinterpret_cast<uint8_t*>(output_row);
+        uint8_t buffer[block];
+        for(size_t i = 0; i < count; i += block, src += block, trg += 3*block) {
+            const size_t n = count - i < block ? count - i : block;
+            for(size_t px = 0; px != n; ++px) {
+                float v = scale*src[px] + bias;
+                v = v > 0.f ? v : 0.f;
+                v = v < 255.f ? v : 255.f;
+                buffer[px] = uint8_t(int32_t(v));
+            }
+            kernels().remap_unorm(buffer, 1, trg, 3, grey, n);
+        }
+    });
+}
+
+}}
@@ -5,6 +5,17 @@
 #ifndef ZAP_PIXEL_CONVERSION_HPP
 #define ZAP_PIXEL_CONVERSION_HPP
 
+/* Pixel conversion.  The common formats (r8, rgb888, rgba8888, r32f, rgb32f and rgba32f) are converted by the vectorised
+ * kernels behind convert_pixels, which convert() and pixmap::copy select automatically; any other pair of formats is
+ * converted one pixel at a time by convert<PixelA, PixelB>.
+ *
+ * 8-bit channels are normalised to [0, 1] as floats, and floats are clamped and rounded to the nearest 8-bit value.  The
+ * 8-bit formats may be sRGB encoded, in which case the colour channels are decoded on conversion to floats (and encoded
+ * from them), the fourth channel is alpha and is always linear.
+ */
+
+#include <cstddef>
+#include <type_traits>
 #include <engine/engine.hpp>
 #include <engine/pixel_format.hpp>
 
@@ -12,19 +23,138 @@ namespace zap { namespace engine {
 
 template <typename PixelT> class pixmap;
 
-template <typename PixelA, typename PixelB> PixelB convert(const PixelA& A);
+enum class colour_space : byte {
+    CS_LINEAR = 0,
+    CS_SRGB = 1
+};
 
-template<typename Input, typename Output>
-bool convert(const engine::pixmap<Input>& input, engine::pixmap<Output>& output);
+// The layout of a format handled by convert_pixels, channels (1 to 4) of normalised bytes or floats
+struct pixel_layout {
+    int channels;
+    bool is_float;
+    colour_space space;
+};
 
-template<> ZAPENGINE_EXPORT
-bool convert<float, engine::rgb888_t>(const engine::pixmap<float>& input, engine::pixmap<engine::rgb888_t>& output);
+template <typename PixelT> struct pixel_layout_of {
+    constexpr static bool supported = false;
+};
+
+#define DEF_PIXEL_LAYOUT(pix_type, channels, is_float) template <> struct pixel_layout_of<pix_type> { \
+        constexpr static bool supported = true; \
+        static pixel_layout layout(colour_space space=colour_space::CS_LINEAR) { return {channels, is_float, space}; } \
+    };
+
+DEF_PIXEL_LAYOUT(r8_t, 1, false)
+DEF_PIXEL_LAYOUT(rgb888_t, 3, false)
+DEF_PIXEL_LAYOUT(rgba8888_t, 4, false)
+DEF_PIXEL_LAYOUT(r32f_t, 1, true)
+DEF_PIXEL_LAYOUT(rgb32f_t, 3, true)
+DEF_PIXEL_LAYOUT(rgba32f_t, 4, true)
+
+#undef DEF_PIXEL_LAYOUT
+
+// Selects the source channel of each target channel, or one of the constants CM_ZERO and CM_ONE (opaque for 8 bits)
+struct channel_map {
+    enum : int8_t { CM_ZERO = -1, CM_ONE = -2 };
+    int8_t channel[4];
+};
+
+constexpr channel_map rgba_map = {{0, 1, 2, 3}};
+constexpr channel_map bgra_map = {{2, 1, 0, 3}};
+constexpr channel_map rgb_opaque_map = {{0, 1, 2, channel_map::CM_ONE}};
+
+/* Converts count pixels from src to dst.  Without a map, channels present in both are copied, a single channel is
+ * replicated to red, green and blue, and a missing alpha is opaque (other missing channels are zero).  src and dst may
+ * only overlap if they are the same buffer with the same pixel size.  Returns false if a layout is invalid.
+ */
+ZAPENGINE_EXPORT bool convert_pixels(const void* src, const pixel_layout& src_layout, void* dst,
+                                     const pixel_layout& dst_layout, size_t count, const channel_map* map=nullptr);
+
+// Multiplies (or divides, where alpha is not zero) the colour channels by alpha
+ZAPENGINE_EXPORT void premultiply(rgba8888_t* pixels, size_t count);
+ZAPENGINE_EXPORT void premultiply(rgba32f_t* pixels, size_t count);
+ZAPENGINE_EXPORT void unpremultiply(rgba8888_t* pixels, size_t count);
+ZAPENGINE_EXPORT void unpremultiply(rgba32f_t* pixels, size_t count);
+
+template <typename PixelA, typename PixelB> PixelB convert(const PixelA& A);
 
 template <>
 inline engine::rgb888_t convert<engine::r8_t, engine::rgb888_t>(const engine::r8_t& A) {
     return engine::rgb888_t{A.get1(), A.get1(), A.get1()};
 };
 
+template <typename SrcPixelT, typename TrgPixelT>
+size_t convert_span(const SrcPixelT* src, TrgPixelT* trg, size_t count, std::true_type) {
+    convert_pixels(src, pixel_layout_of<SrcPixelT>::layout(), trg, pixel_layout_of<TrgPixelT>::layout(), count);
+    return count;
+}
+
+template <typename SrcPixelT, typename TrgPixelT>
+size_t convert_span(const SrcPixelT* src, TrgPixelT* trg, size_t count, std::false_type) {
+    for(size_t i = 0; i != count; ++i) trg[i] = convert<SrcPixelT, TrgPixelT>(src[i]);
+    return count;
+}
+
+// Converts count pixels from src to trg, with the vectorised kernels if both formats are supported
+template <typename SrcPixelT, typename TrgPixelT>
+size_t convert_span(const SrcPixelT* src, TrgPixelT* trg, size_t count) {
+    using vectorised = std::integral_constant<bool, pixel_layout_of<SrcPixelT>::supported &&
+                                                    pixel_layout_of<TrgPixelT>::supported>;
+    return convert_span(src, trg, count, vectorised());
+}
+
+// Calls fnc(input_row, output_row, count) over the pixels of output, as one span if both pixmaps are packed
+template<typename Input, typename Output, typename Fnc>
+bool convert_rows(const engine::pixmap<Input>& input, engine::pixmap<Output>& output, Fnc&& fnc) {
+    if(input.is_packed() && output.is_packed()) {
+        assert(input.size() >= output.size() && "Output size must be >= to Input size");
+        if(input.size() < output.size()) return false;
+        fnc(input.data(), output.data(), size_t(output.size()));
+        return true;
+    }
+
+    if(input.width() < output.width() || input.height() < output.height() || input.depth() < output.depth()) {
+        assert(false && "Output dimensions must be <= to Input dimensions");
+        return false;
+    }
+    for(int d = 0; d != output.depth(); ++d) {
+        for(int r = 0; r != output.height(); ++r) fnc(input.data(0, r, d), output.data(0, r, d), size_t(output.width()));
+    }
+    return true;
+}
+
+template<typename Input, typename Output>
+bool convert(const engine::pixmap<Input>& input, engine::pixmap<Output>& output) {
+    return convert_rows(input, output, [](const Input* src, Output* trg, size_t count) {
+        convert_span(src, trg, count);
+    });
+}
+
+// Converts between colour spaces as well, optionally remapping the channels
+template<typename Input, typename Output>
+bool convert(const engine::pixmap<Input>& input, colour_space input_space, engine::pixmap<Output>& output,
+             colour_space output_space, const channel_map* map=nullptr) {
+    static_assert(pixel_layout_of<Input>::supported && pixel_layout_of<Output>::supported, "Unsupported pixel format");
+    const auto input_layout = pixel_layout_of<Input>::layout(input_space);
+    const auto output_layout = pixel_layout_of<Output>::layout(output_space);
+    bool result = true;
+    return convert_rows(input, output, [&](const Input* src, Output* trg, size_t count) {
+        result = convert_pixels(src, input_layout, trg, output_layout, count, map) && result;
+    }) && result;
+}
+
+// Maps [-1, 1] to grey
+template<> ZAPENGINE_EXPORT
+bool convert<float, engine::rgb888_t>(const engine::pixmap<float>& input, engine::pixmap<engine::rgb888_t>& output);
+
+// Remaps the channels of img in place, e.g. swizzle(img, bgra_map)
+template <typename PixelT>
+void swizzle(engine::pixmap<PixelT>& img, const channel_map& map) {
+    static_assert(pixel_layout_of<PixelT>::supported, "Unsupported pixel format");
+    const auto layout = pixel_layout_of<PixelT>::layout();
+    convert_pixels(img.data(), layout, img.data(), layout, size_t(img.size()), &map);
+}
+
 }}
 
 #endif //ZAP_PIXEL_CONVERSION_HPP
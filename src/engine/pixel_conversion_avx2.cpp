@@ -0,0 +1,14 @@
+/* Created by Darren Otgaar on 2018/06/20. http://www.github.com/otgaard/zap */
+// Compiled with AVX2 enabled, only called when the host supports AVX2 (see pixel_conversion.cpp)
+#include "pixel_kernels.hpp"
+
+using namespace zap::engine::pixel_kernels;
+
+namespace {
+    struct avx2_tag { };
+}
+
+const kernel_table& zap::engine::pixel_kernels::avx2_kernels() {
+    static const kernel_table table = make_kernel_table<avx2_tag>();
+    return table;
+}
@@ -0,0 +1,318 @@
+/* Created by Darren Otgaar on 2018/06/20. http://www.github.com/otgaard/zap */
+#ifndef ZAP_PIXEL_KERNELS_HPP
+#define ZAP_PIXEL_KERNELS_HPP
+
+/* The kernels behind convert_pixels, compiled once per instruction set (pixel_conversion.cpp for SSE2 and
+ * pixel_conversion_avx2.cpp for AVX2).  They are plain loops over contiguous channels, written so that the compiler
+ * vectorises them for the instruction set of each translation unit, and instantiated on a tag type local to it (see
+ * tools/cpu.hpp for what this header may contain).
+ *
+ * The 8-bit kernels that move whole pixels treat them as little-endian 32-bit words.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace zap { namespace engine { namespace pixel_kernels {
+
+struct kernel_table {
+    // Converts n channels
+    void (*unorm_to_float)(const uint8_t* src, float* dst, size_t n);
+    void (*float_to_unorm)(const float* src, uint8_t* dst, size_t n);
+    // Converts count pixels of channels, the fourth channel is alpha and is converted linearly
+    void (*srgb_to_float)(const uint8_t* src, float* dst, size_t count, int channels);
+    void (*float_to_srgb)(const float* src, uint8_t* dst, size_t count, int channels);
+    // Remaps count pixels with the map of each dst channel (see channel_map)
+    void (*remap_unorm)(const uint8_t* src, int src_channels, uint8_t* dst, int dst_channels, const int8_t* map,
+                        size_t count);
+    void (*remap_float)(const float* src, int src_channels, float* dst, int dst_channels, const int8_t* map,
+                        size_t count);
+    void (*premultiply_unorm)(uint8_t* rgba, size_t count);
+    void (*premultiply_float)(float* rgba, size_t count);
+    void (*unpremultiply_unorm)(uint8_t* rgba, size_t count);
+    void (*unpremultiply_float)(float* rgba, size_t count);
+};
+
+const kernel_table& sse2_kernels();
+const kernel_table& avx2_kernels();
+
+// The linear value of each sRGB byte
+const float* srgb_decode_table();
+// The sRGB byte of each linear value in steps of 1/(srgb_encode_size-1), close enough that encoding is exact but for
+// values within a few hundredths of a step of the rounding boundary
+constexpr size_t srgb_encode_size = 1 << 16;
+const uint8_t* srgb_encode_table();
+
+constexpr int8_t map_zero = -1;
+constexpr int8_t map_one = -2;
+
+template <typename Tag>
+void unorm_to_float(const uint8_t* src, float* dst, size_t n) {
+    constexpr float scale = 1.f/255.f;
+    for(size_t i = 0; i != n; ++i) dst[i] = float(src[i])*scale;
+}
+
+template <typename Tag>
+void float_to_unorm(const float* src, uint8_t* dst, size_t n) {
+    for(size_t i = 0; i != n; ++i) {
+        float v = src[i]*255.f + .5f;
+        v = v > 0.f ? v : 0.f;                                  // Also maps NaN to zero
+        v = v < 255.f ? v : 255.f;
+        dst[i] = uint8_t(int32_t(v));
+    }
+}
+
+template <typename Tag, int C>
+void srgb_to_float(const uint8_t* src, float* dst, size_t count, const float* table) {
+    constexpr float scale = 1.f/255.f;
+    for(size_t i = 0; i != count; ++i, src += C, dst += C) {
+        for(int c = 0; c != (C < 4 ? C : 3); ++c) dst[c] = table[src[c]];
+        if(C == 4) dst[3] = float(src[3])*scale;
+    }
+}
+
+template <typename Tag>
+void srgb_to_float(const uint8_t* src, float* dst, size_t count, int channels) {
+    const float* table = srgb_decode_table();
+    switch(channels) {
+        case 1: srgb_to_float<Tag, 1>(src, dst, count, table); break;
+        case 2: srgb_to_float<Tag, 2>(src, dst, count, table); break;
+        case 3: srgb_to_float<Tag, 3>(src, dst, count, table); break;
+        default: srgb_to_float<Tag, 4>(src, dst, count, table); break;
+    }
+}
+
+template <typename Tag, int C>
+void float_to_srgb(const float* src, uint8_t* dst, size_t count, const uint8_t* table) {
+    constexpr size_t block = 256;
+    constexpr float scale = float(srgb_encode_size - 1);
+    int32_t index[block*C];
+    while(count != 0) {
+        const size_t n = count < block ? count : block;
+        // The table indices are computed as a vector, the lookups are scalar
+        for(size_t i = 0; i != n*C; ++i) {
+            float v = src[i]*scale + .5f;
+            v = v > 0.f ? v : 0.f;
+            v = v < scale ? v : scale;
+            index[i] = int32_t(v);
+        }
+        for(size_t i = 0; i != n; ++i) {
+            for(int c = 0; c != (C < 4 ? C : 3); ++c) dst[i*C+c] = table[index[i*C+c]];
+        }
+        if(C == 4) {
+            for(size_t i = 0; i != n; ++i) {
+                float v = src[i*C+3]*255.f + .5f;
+                v = v > 0.f ? v : 0.f;
+                v = v < 255.f ? v : 255.f;
+                dst[i*C+3] = uint8_t(int32_t(v));
+            }
+        }
+        src += n*C; dst += n*C; count -= n;
+    }
+}
+
+template <typename Tag>
+void float_to_srgb(const float* src, uint8_t* dst, size_t count, int channels) {
+    const uint8_t* table = srgb_encode_table();
+    switch(channels) {
+        case 1: float_to_srgb<Tag, 1>(src, dst, count, table); break;
+        case 2: float_to_srgb<Tag, 2>(src, dst, count, table); break;
+        case 3: float_to_srgb<Tag, 3>(src, dst, count, table); break;
+        default: float_to_srgb<Tag, 4>(src, dst, count, table); break;
+    }
+}
+
+// Any remapping, each pixel is read before it is written so that src may be dst
+template <typename Tag, typename T, int SC, int DC>
+void remap_pixels(const T* src, T* dst, const int8_t* map, T one, size_t count) {
+    int sel[DC];
+    for(int c = 0; c != DC; ++c) sel[c] = map[c] >= 0 ? map[c] : (map[c] == map_zero ? SC : SC+1);
+    T px[SC+2];
+    px[SC] = T(0); px[SC+1] = one;
+    for(size_t i = 0; i != count; ++i, src += SC, dst += DC) {
+        for(int c = 0; c != SC; ++c) px[c] = src[c];
+        for(int c = 0; c != DC; ++c) dst[c] = px[sel[c]];
+    }
+}
+
+template <typename Tag, typename T, int SC>
+void remap_pixels(const T* src, T* dst, int dst_channels, const int8_t* map, T one, size_t count) {
+    switch(dst_channels) {
+        case 1: remap_pixels<Tag, T, SC, 1>(src, dst, map, one, count); break;
+        case 2: remap_pixels<Tag, T, SC, 2>(src, dst, map, one, count); break;
+        case 3: remap_pixels<Tag, T, SC, 3>(src, dst, map, one, count); break;
+        default: remap_pixels<Tag, T, SC, 4>(src, dst, map, one, count); break;
+    }
+}
+
+template <typename Tag, typename T>
+void remap_pixels(const T* src, int src_channels, T* dst, int dst_channels, const int8_t* map, T one, size_t count) {
+    switch(src_channels) {
+        case 1: remap_pixels<Tag, T, 1>(src, dst, dst_channels, map, one, count); break;
+        case 2: remap_pixels<Tag, T, 2>(src, dst, dst_channels, map, one, count); break;
+        case 3: remap_pixels<Tag, T, 3>(src, dst, dst_channels, map, one, count); break;
+        default: remap_pixels<Tag, T, 4>(src, dst, dst_channels, map, one, count); break;
+    }
+}
+
+// RGBA to RGBA with any map, as shifts of the 32-bit pixel
+template <typename Tag>
+void remap_words(const uint8_t* src, uint8_t* dst, const int8_t* map, size_t count) {
+    uint32_t shift[4], mask[4], fill = 0;
+    for(int c = 0; c != 4; ++c) {
+        shift[c] = map[c] >= 0 ? 8*uint32_t(map[c]) : 0;
+        mask[c] = map[c] >= 0 ? 0xFFu : 0u;
+        if(map[c] == map_one) fill |= 0xFFu << 8*c;
+    }
+    constexpr size_t block = 256;
+    uint32_t buffer[block];
+    while(count != 0) {
+        const size_t n = count < block ? count : block;
+        std::memcpy(buffer, src, 4*n);
+        for(size_t i = 0; i != n; ++i) {
+            const uint32_t p = buffer[i];
+            buffer[i] = ((p >> shift[0]) & mask[0]) | (((p >> shift[1]) & mask[1]) << 8) |
+                        (((p >> shift[2]) & mask[2]) << 16) | (((p >> shift[3]) & mask[3]) << 24) | fill;
+        }
+        std::memcpy(dst, buffer, 4*n);
+        src += 4*n; dst += 4*n; count -= n;
+    }
+}
+
+// RGB to opaque RGBA, src and dst may not overlap
+template <typename Tag>
+void rgb_to_rgba(const uint8_t* src, uint8_t* dst, size_t count) {
+    if(count == 0) return;
+    for(size_t i = 0; i != count-1; ++i, src += 3, dst += 4) {          // Reads one byte past the pixel
+        uint32_t p;
+        std::memcpy(&p, src, 4);
+        p |= 0xFF000000u;
+        std::memcpy(dst, &p, 4);
+    }
+    dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 0xFF;
+}
+
+// RGBA to RGB, dst may be src
+template <typename Tag>
+void rgba_to_rgb(const uint8_t* src, uint8_t* dst, size_t count) {
+    if(count == 0) return;
+    for(size_t i = 0; i != count-1; ++i, src += 4, dst += 3) {          // Writes one byte past the pixel
+        uint32_t p;
+        std::memcpy(&p, src, 4);
+        std::memcpy(dst, &p, 4);
+    }
+    dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2];
+}
+
+// A grey to opaque RGBA
+template <typename Tag>
+void grey_to_rgba(const uint8_t* src, uint8_t* dst, size_t count) {
+    constexpr size_t block = 256;
+    uint32_t buffer[block];
+    while(count != 0) {
+        const size_t n = count < block ? count : block;
+        for(size_t i = 0; i != n; ++i) buffer[i] = uint32_t(src[i])*0x010101u | 0xFF000000u;
+        std::memcpy(dst, buffer, 4*n);
+        src += n; dst += 4*n; count -= n;
+    }
+}
+
+template <typename Tag>
+void remap_unorm(const uint8_t* src, int src_channels, uint8_t* dst, int dst_channels, const int8_t* map,
+                 size_t count) {
+    bool identity = src_channels == dst_channels;
+    for(int c = 0; c != dst_channels; ++c) identity = identity && map[c] == c;
+    const bool rgb = map[0] == 0 && map[1] == 1 && map[2] == 2;
+
+    if(identity) {
+        if(src != dst) std::memmove(dst, src, count*src_channels);
+    } else if(src_channels == 4 && dst_channels == 4) {
+        remap_words<Tag>(src, dst, map, count);
+    } else if(src_channels == 3 && dst_channels == 4 && rgb && map[3] == map_one) {
+        rgb_to_rgba<Tag>(src, dst, count);
+    } else if(src_channels == 4 && dst_channels == 3 && rgb) {
+        rgba_to_rgb<Tag>(src, dst, count);
+    } else if(src_channels == 1 && dst_channels == 4 && map[0] == 0 && map[1] == 0 && map[2] == 0 && map[3] == map_one) {
+        grey_to_rgba<Tag>(src, dst, count);
+    } else {
+        remap_pixels<Tag, uint8_t>(src, src_channels, dst, dst_channels, map, uint8_t(0xFF), count);
+    }
+}
+
+template <typename Tag>
+void remap_float(const float* src, int src_channels, float* dst, int dst_channels, const int8_t* map, size_t count) {
+    bool identity = src_channels == dst_channels;
+    for(int c = 0; c != dst_channels; ++c) identity = identity && map[c] == c;
+
+    if(identity) {
+        if(src != dst) std::memmove(dst, src, count*src_channels*sizeof(float));
+    } else {
+        remap_pixels<Tag, float>(src, src_channels, dst, dst_channels, map, 1.f, count);
+    }
+}
+
+// The nearest byte to x/255 for x in [0, 255*255]
+template <typename Tag>
+uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+template <typename Tag>
+void premultiply_unorm(uint8_t* rgba, size_t count) {
+    for(size_t i = 0; i != count; ++i, rgba += 4) {
+        const uint32_t a = rgba[3];
+        rgba[0] = uint8_t(div255<Tag>(rgba[0]*a));
+        rgba[1] = uint8_t(div255<Tag>(rgba[1]*a));
+        rgba[2] = uint8_t(div255<Tag>(rgba[2]*a));
+    }
+}
+
+template <typename Tag>
+void premultiply_float(float* rgba, size_t count) {
+    for(size_t i = 0; i != count; ++i, rgba += 4) {
+        const float a = rgba[3];
+        rgba[0] *= a; rgba[1] *= a; rgba[2] *= a;
+    }
+}
+
+template <typename Tag>
+void unpremultiply_unorm(uint8_t* rgba, size_t count) {
+    for(size_t i = 0; i != count; ++i, rgba += 4) {
+        const uint32_t a = rgba[3];
+        if(a == 0 || a == 255) continue;
+        for(int c = 0; c != 3; ++c) {
+            const uint32_t v = (rgba[c]*255u + a/2)/a;
+            rgba[c] = uint8_t(v < 255u ? v : 255u);
+        }
+    }
+}
+
+template <typename Tag>
+void unpremultiply_float(float* rgba, size_t count) {
+    for(size_t i = 0; i != count; ++i, rgba += 4) {
+        const float inv = rgba[3] != 0.f ? 1.f/rgba[3] : 1.f;
+        rgba[0] *= inv; rgba[1] *= inv; rgba[2] *= inv;
+    }
+}
+
+template <typename Tag>
+kernel_table make_kernel_table() {
+    kernel_table table;
+    table.unorm_to_float = &unorm_to_float<Tag>;
+    table.float_to_unorm = &float_to_unorm<Tag>;
+    table.srgb_to_float = &srgb_to_float<Tag>;
+    table.float_to_srgb = &float_to_srgb<Tag>;
+    table.remap_unorm = &remap_unorm<Tag>;
+    table.remap_float = &remap_float<Tag>;
+    table.premultiply_unorm = &premultiply_unorm<Tag>;
+    table.premultiply_float = &premultiply_float<Tag>;
+    table.unpremultiply_unorm = &unpremultiply_unorm<Tag>;
+    table.unpremultiply_float = &unpremultiply_float<Tag>;
+    return table;
+}
+
+}}}
+
+#endif //ZAP_PIXEL_KERNELS_HPP
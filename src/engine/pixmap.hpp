@@ -4,61 +4,124 @@
 
 #include <maths/geometry/rect.hpp>
 #include <vector>
+#include <cstring>
 #include <algorithm>
 #include <engine/pixel_format.hpp>
 #include <engine/pixel_conversion.hpp>
+#include <engine/pixmap_pool.hpp>
+#include <engine/pixmap_view.hpp>
 
 namespace zap { namespace engine {
+    /* A 1D, 2D or 3D image.  The storage is aligned to the cache line and rows may be padded to a row alignment (so that
+     * each row starts on a vector boundary), in which case the rows are pitch() pixels apart.  The linear accessors
+     * (operator[], data(offset), size(), begin() and end()) address the storage, padding included, so only walk the
+     * pixels of a packed pixmap.  Transient pixmaps may be allocated from a pixmap_pool.
+     */
     template <typename PixelT>
     class pixmap {
     public:
         using pixel_t = PixelT;
         using vec2i = maths::vec2i;
         using recti = maths::geometry::recti;
-        using buffer_t = std::vector<PixelT>;
-        pixmap() : width_(0), height_(0), depth_(0) { }
+        using view_t = pixmap_view<PixelT>;
+        using const_view_t = pixmap_view<const PixelT>;
+
+        constexpr static size_t base_alignment = pixmap_pool::block_alignment;
+
+        pixmap() = default;
         pixmap(int width, int height=1, int depth=1) { resize(width, height, depth); }
-        pixmap(int width, int height, int depth, const std::vector<PixelT>& buffer) :
-            width_(width), height_(height), depth_(depth), buffer_(buffer) { }
-        pixmap(const pixmap&) = default;
-        ~pixmap() = default;
+        // Pads each row to a multiple of row_alignment bytes (a power of two, or zero for packed rows), allocating from
+        // the pool if given
+        pixmap(int width, int height, int depth, size_t row_alignment, pixmap_pool* pool=nullptr) :
+            row_alignment_(row_alignment), pool_(pool) { resize(width, height, depth); }
+        pixmap(int width, int height, int depth, const std::vector<PixelT>& buffer) {
+            resize(width, height, depth);
+            if(data_) std::memcpy(data_, buffer.data(), std::min(size_t(size()), buffer.size())*sizeof(PixelT));
+        }
+        pixmap(const pixmap& rhs) : row_alignment_(rhs.row_alignment_), pool_(rhs.pool_) {
+            resize(rhs.width_, rhs.height_, rhs.depth_);
+            if(data_) std::memcpy(data_, rhs.data_, bytesize());
+        }
+        pixmap(pixmap&& rhs) noexcept { swap(rhs); }
+        ~pixmap() { deallocate(); }
+
+        pixmap& operator=(const pixmap& rhs) {
+            if(this != &rhs) { pixmap tmp(rhs); swap(tmp); }
+            return *this;
+        }
+        pixmap& operator=(pixmap&& rhs) noexcept {
+            if(this != &rhs) { pixmap tmp(std::move(rhs)); swap(tmp); }
+            return *this;
+        }
 
-        pixmap& operator=(const pixmap&) = default;
+        void swap(pixmap& rhs) noexcept {
+            std::swap(width_, rhs.width_); std::swap(height_, rhs.height_); std::swap(depth_, rhs.depth_);
+            std::swap(pitch_, rhs.pitch_); std::swap(row_alignment_, rhs.row_alignment_);
+            std::swap(data_, rhs.data_); std::swap(capacity_, rhs.capacity_); std::swap(pool_, rhs.pool_);
+        }
 
+        // The storage is kept if large enough, as with std::vector the old storage is preserved and new pixels are zero
         void resize(int width, int height=1, int depth=1) {
             if(width < 1 || height < 1 || depth < 1) return;
+            const size_t old_bytes = bytesize();
             width_ = width; height_ = height; depth_ = depth;
-            buffer_.resize(size_t(width*height*depth));
+            pitch_ = aligned_pitch(width, row_alignment_);
+            const size_t bytes = bytesize();
+
+            if(bytes > capacity_) {
+                size_t capacity = bytes;
+                auto ptr = static_cast<PixelT*>(pool_ ? pool_->acquire(capacity, alignment())
+                                                      : pixmap_pool::allocate(capacity, alignment()));
+                if(data_) std::memcpy(ptr, data_, old_bytes);
+                std::memset(reinterpret_cast<char*>(ptr) + old_bytes, 0, bytes - old_bytes);
+                deallocate();
+                data_ = ptr;
+                capacity_ = capacity;
+            } else if(bytes > old_bytes) {
+                std::memset(reinterpret_cast<char*>(data_) + old_bytes, 0, bytes - old_bytes);
+            }
         }
 
         void clear(const pixel_t& value) {
-            std::fill(buffer_.begin(), buffer_.end(), value);
+            std::fill(data_, data_ + size(), value);
         }
 
         int width() const { return width_; }
         int height() const { return height_; }
         int depth() const { return depth_; }
-        int size() const { return int(buffer_.size()); }
-        size_t bytesize() const { return buffer_.size()*sizeof(PixelT); }
+        int pitch() const { return pitch_; }
+        size_t row_alignment() const { return row_alignment_; }
+        pixmap_pool* pool() const { return pool_; }
+        int size() const { return pitch_*height_*depth_; }
+        size_t bytesize() const { return size_t(size())*sizeof(PixelT); }
         recti bound() const { return recti{0, width(), 0, height()}; }
 
         bool is_initialised() const { return width_ != 0; }
+        bool is_packed() const { return pitch_ == width_; }
         bool is_1D() const { return height_ == 1 && depth_ == 1; }
         bool is_2D() const { return height_ > 1 && depth_ == 1; }
         bool is_3D() const { return height_ > 1 && depth_ > 1; }
 
-        PixelT& operator[](int idx) { return buffer_[idx]; }
-        const PixelT& operator[](int idx) const { return buffer_[idx]; }
-        PixelT& operator()(int c) { return buffer_[c]; }
-        const PixelT& operator()(int c) const { return buffer_[c]; }
-        PixelT& operator()(int c, int r) { return buffer_[r*width_ + c]; }
-        const PixelT& operator()(int c, int r) const { return buffer_[r*width_ + c]; }
-        PixelT& operator()(int c, int r, int d) { return buffer_[width_*(d*height_ + r) + c]; }
-        const PixelT& operator()(int c, int r, int d) const { return buffer_[width_*(d*height_ + r) + c]; }
-
-        int offset(int c, int r) const { return width_*r + c; }
-        int offset(int c, int r, int d) const { return width_*(d*height_ + r) + c; }
-        vec2i coord2(int idx) const { return vec2i(idx % width_, idx / width_); }
+        PixelT& operator[](int idx) { return data_[idx]; }
+        const PixelT& operator[](int idx) const { return data_[idx]; }
+        PixelT& operator()(int c) { return data_[c]; }
+        const PixelT& operator()(int c) const { return data_[c]; }
+        PixelT& operator()(int c, int r) { return data_[r*pitch_ + c]; }
+        const PixelT& operator()(int c, int r) const { return data_[r*pitch_ + c]; }
+        PixelT& operator()(int c, int r, int d) { return data_[pitch_*(d*height_ + r) + c]; }
+        const PixelT& operator()(int c, int r, int d) const { return data_[pitch_*(d*height_ + r) + c]; }
+
+        int offset(int c, int r) const { return pitch_*r + c; }
+        int offset(int c, int r, int d) const { return pitch_*(d*height_ + r) + c; }
+        vec2i coord2(int idx) const { return vec2i(idx % pitch_, idx / pitch_); }
+
+        view_t view() { return view_t{data_, width_, height_, pitch_, depth_}; }
+        const_view_t view() const { return const_view_t{data_, width_, height_, pitch_, depth_}; }
+        // The view of the bound (left, bottom, width and height) clipped to the pixmap
+        view_t view(const recti& bound) { return view().sub(bound); }
+        const_view_t view(const recti& bound) const { return view().sub(bound); }
+        view_t layer(int d) { return view().layer(d); }
+        const_view_t layer(int d) const { return view().layer(d); }
 
         template <typename Fnc>
         void blend(int origin_x, int origin_y, const pixmap& src, Fnc&& fnc) {
@@ -90,42 +153,34 @@ namespace zap { namespace engine {
         void flip_y() {
             assert(is_2D() && "pixmap::flip_y 2D only");
             if(!is_2D()) return;
-
-            auto& ref = *this;
-            auto hm1 = height_ - 1;
-            for(int r = 0, r_end = height_/2; r != r_end; ++r) {
-                for(int c = 0; c != width_; ++c) {
-                    std::swap(ref(c, hm1 - r), ref(c, r));
-                }
-            }
+            view().flip_y();
         }
 
-        const PixelT* begin() const { return buffer_.data(); }
-        const PixelT* end() const { return buffer_.data()+(width_*height_*depth_); }
+        const PixelT* begin() const { return data_; }
+        const PixelT* end() const { return data_ + size(); }
 
         bool copy(const byte* data, size_t len) {
-            assert(size()*sizeof(PixelT) >= len && "pixmap::copy out-of-bounds");
-            if(size()*sizeof(PixelT) < len) return false;
-            std::copy(data, data+len, reinterpret_cast<byte*>(buffer_.data()));
+            assert(bytesize() >= len && "pixmap::copy out-of-bounds");
+            if(bytesize() < len) return false;
+            std::memcpy(data_, data, len);
             return true;
         }
 
         size_t copy(size_t src_off, size_t trg_off, size_t length) {
-            std::copy(data()+src_off, data()+src_off+length, data()+trg_off);
+            std::memmove(data()+trg_off, data()+src_off, length*sizeof(PixelT));
             return length;
         }
 
         size_t copy(const pixmap& src, size_t src_off, size_t trg_off, size_t length) {
-            assert(trg_off + length <= size() && "canvas::copy out-of-bounds");
-            std::copy(src.data(src_off), src.data(src_off+length), data()+trg_off);
+            assert(trg_off + length <= size_t(size()) && "canvas::copy out-of-bounds");
+            std::memmove(data()+trg_off, src.data(src_off), length*sizeof(PixelT));
             return length;
         }
 
         template <typename SrcPixelT>
         size_t copy(const pixmap<SrcPixelT>& src, size_t src_off, size_t trg_off, size_t length) {
             assert(trg_off + length <= size() && "canvas::copy out-of-bounds");
-            for(int x = 0; x != length; ++x) *data(trg_off+x) = convert<SrcPixelT, PixelT>(src[src_off+x]);
-            return length;
+            return convert_span(src.data(src_off), data(trg_off), length);
         }
 
         template <typename SrcPixelT, typename Fnc>
@@ -139,10 +194,7 @@ namespace zap { namespace engine {
             assert(width() - trg_x >= bound.width() && height() - trg_y >= bound.height() && "canvas::copy out-of-bounds");
 
             recti bnd = bound.width() == 0 && bound.height() == 0 ? src.bound() : bound;
-
-            for(int r = 0; r != bnd.height(); ++r) {
-                copy(src, src.offset(bnd.left, bnd.bottom+r), offset(trg_x, trg_y + r), bnd.width());
-            }
+            blit(src.view(bnd), view(recti{trg_x, trg_x + bnd.width(), trg_y, trg_y + bnd.height()}));
             return bnd.height() * bnd.width();
         }
 
@@ -168,20 +220,37 @@ namespace zap { namespace engine {
             return bnd.height() * bnd.width();
         };
 
-        const PixelT* data(size_t offset=0) const { return buffer_.data()+offset; }
-        PixelT* data(size_t offset=0) { return buffer_.data()+offset; }
-        const PixelT* data(int c, int r) const { return buffer_.data()+offset(c,r); }
-        PixelT* data(int c, int r) { return buffer_.data()+offset(c,r); }
-        const PixelT* data(int c, int r, int d) const { return buffer_.data()+offset(c,r,d); }
-        PixelT* data(int c, int r, int d) { return buffer_.data()+offset(c,r,d); }
-
-        const buffer_t& buffer() const { return buffer_; }
+        const PixelT* data(size_t offset=0) const { return data_+offset; }
+        PixelT* data(size_t offset=0) { return data_+offset; }
+        const PixelT* data(int c, int r) const { return data_+offset(c,r); }
+        PixelT* data(int c, int r) { return data_+offset(c,r); }
+        const PixelT* data(int c, int r, int d) const { return data_+offset(c,r,d); }
+        PixelT* data(int c, int r, int d) { return data_+offset(c,r,d); }
+
+        // The smallest pitch of at least width pixels that is a multiple of row_alignment bytes
+        static int aligned_pitch(int width, size_t row_alignment) {
+            int pitch = width;
+            if(row_alignment > 1) while((pitch*sizeof(PixelT)) % row_alignment != 0) ++pitch;
+            return pitch;
+        }
 
     protected:
+        size_t alignment() const { return row_alignment_ > base_alignment ? row_alignment_ : base_alignment; }
+        void deallocate() {
+            if(!data_) return;
+            if(pool_) pool_->release(data_, capacity_, alignment());
+            else      pixmap_pool::deallocate(data_);
+            data_ = nullptr;
+            capacity_ = 0;
+        }
 
     private:
         int width_ = 0, height_ = 0, depth_ = 0;
-        buffer_t buffer_;
+        int pitch_ = 0;
+        size_t row_alignment_ = 0;
+        PixelT* data_ = nullptr;
+        size_t capacity_ = 0;                           // The size of the storage in bytes
+        pixmap_pool* pool_ = nullptr;
     };
 }}
 
@@ -0,0 +1,69 @@
+/* Created by Darren Otgaar on 2018/06/21. http://www.github.com/otgaard/zap */
+#include "pixmap_pool.hpp"
+#include <cstdlib>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+using namespace zap::engine;
+
+void* pixmap_pool::acquire(size_t& bytes, size_t alignment) {
+    if(alignment > block_alignment) return allocate(bytes, alignment);
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = free_.lower_bound(bytes);
+        if(it != free_.end() && it->first/2 <= bytes) {
+            void* ptr = it->second;
+            bytes = it->first;
+            retained_ -= it->first;
+            free_.erase(it);
+            return ptr;
+        }
+    }
+
+    return allocate(bytes, block_alignment);
+}
+
+void pixmap_pool::release(void* ptr, size_t bytes, size_t alignment) {
+    if(!ptr) return;
+    if(alignment <= block_alignment) {
+        std::lock_guard<std::mutex> lock(lock_);
+        if(retained_ + bytes <= max_retained_) {
+            free_.emplace(bytes, ptr);
+            retained_ += bytes;
+            return;
+        }
+    }
+    deallocate(ptr);
+}
+
+void pixmap_pool::trim() {
+    std::lock_guard<std::mutex> lock(lock_);
+    for(auto& block : free_) deallocate(block.second);
+    free_.clear();
+    retained_ = 0;
+}
+
+size_t pixmap_pool::retained_bytes() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return retained_;
+}
+
+void* pixmap_pool::allocate(size_t bytes, size_t alignment) {
+    if(bytes == 0) bytes = alignment;
+#if defined(_WIN32)
+    return _aligned_malloc(bytes, alignment);
+#else
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, alignment < sizeof(void*) ? sizeof(void*) : alignment, bytes) == 0 ? ptr : nullptr;
+#endif
+}
+
+void pixmap_pool::deallocate(void* ptr) {
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
@@ -0,0 +1,47 @@
+/* Created by Darren Otgaar on 2018/06/21. http://www.github.com/otgaard/zap */
+#ifndef ZAP_PIXMAP_POOL_HPP
+#define ZAP_PIXMAP_POOL_HPP
+
+// A pool of aligned blocks for transient pixmaps.  Released blocks are retained (up to max_retained bytes) and handed out
+// again, best fit, to requests of at least half their size, so that images of a similar size allocated every frame stop
+// reaching the heap.  The pool must outlive the pixmaps allocated from it, and may be shared between threads.
+
+#include <map>
+#include <mutex>
+#include <cstddef>
+#include "engine.hpp"
+
+namespace zap { namespace engine {
+    class ZAPENGINE_EXPORT pixmap_pool {
+    public:
+        // Blocks are aligned to the cache line, larger alignments bypass the pool
+        constexpr static size_t block_alignment = 64;
+
+        explicit pixmap_pool(size_t max_retained=size_t(256) << 20) : max_retained_(max_retained) { }
+        pixmap_pool(const pixmap_pool&) = delete;
+        ~pixmap_pool() { trim(); }
+
+        pixmap_pool& operator=(const pixmap_pool&) = delete;
+
+        // Returns a block of at least bytes, with bytes updated to the size of the block
+        void* acquire(size_t& bytes, size_t alignment=block_alignment);
+        // Returns the block (and its size as returned by acquire) to the pool
+        void release(void* ptr, size_t bytes, size_t alignment=block_alignment);
+        // Frees the retained blocks
+        void trim();
+
+        size_t retained_bytes() const;
+
+        // Aligned heap allocation, alignment must be a power of two
+        static void* allocate(size_t bytes, size_t alignment);
+        static void deallocate(void* ptr);
+
+    protected:
+        mutable std::mutex lock_;
+        std::multimap<size_t, void*> free_;
+        size_t retained_ = 0;
+        size_t max_retained_;
+    };
+}}
+
+#endif //ZAP_PIXMAP_POOL_HPP
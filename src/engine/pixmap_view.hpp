@@ -0,0 +1,107 @@
+/* Created by Darren Otgaar on 2018/06/21. http://www.github.com/otgaard/zap */
+#ifndef ZAP_PIXMAP_VIEW_HPP
+#define ZAP_PIXMAP_VIEW_HPP
+
+// A non-owning view of the pixels of a pixmap (or any strided image), for working on sub-rectangles and layers without
+// copying.  Rows are pitch pixels apart and layers layer_pitch pixels apart.  PixelT is const for a read-only view.
+
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <maths/geometry/rect.hpp>
+
+namespace zap { namespace engine {
+    template <typename PixelT>
+    class pixmap_view {
+    public:
+        using pixel_t = PixelT;
+        using recti = maths::geometry::recti;
+
+        pixmap_view() = default;
+        pixmap_view(PixelT* data, int width, int height=1, int pitch=0, int depth=1, size_t layer_pitch=0) :
+            data_(data), width_(width), height_(height), depth_(depth), pitch_(pitch ? pitch : width),
+            layer_pitch_(layer_pitch ? layer_pitch : size_t(pitch ? pitch : width)*height) { }
+        // A read-only view of a writable view
+        template <typename T, typename = typename std::enable_if<std::is_same<const T, PixelT>::value>::type>
+        pixmap_view(const pixmap_view<T>& rhs) : data_(rhs.data()), width_(rhs.width()), height_(rhs.height()),
+            depth_(rhs.depth()), pitch_(rhs.pitch()), layer_pitch_(rhs.layer_pitch()) { }
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+        int depth() const { return depth_; }
+        int pitch() const { return pitch_; }
+        size_t layer_pitch() const { return layer_pitch_; }
+        recti bound() const { return recti{0, width_, 0, height_}; }
+
+        bool empty() const { return data_ == nullptr || width_ < 1 || height_ < 1 || depth_ < 1; }
+        // True if the pixels are contiguous
+        bool is_packed() const { return pitch_ == width_ && (depth_ == 1 || layer_pitch_ == size_t(pitch_)*height_); }
+        size_t row_bytes() const { return size_t(width_)*sizeof(PixelT); }
+
+        PixelT* data() const { return data_; }
+        PixelT* data(int c, int r, int d=0) const { return data_ + (d*layer_pitch_ + size_t(r)*pitch_ + c); }
+        PixelT* row(int r, int d=0) const { return data(0, r, d); }
+        PixelT& operator()(int c, int r) const { return *data(c, r); }
+        PixelT& operator()(int c, int r, int d) const { return *data(c, r, d); }
+
+        // The view of the bound (left, bottom, width and height) clipped to this view
+        pixmap_view sub(const recti& bound) const {
+            const int left = std::max(bound.left, 0), bottom = std::max(bound.bottom, 0);
+            const int right = std::min(bound.left + bound.width(), width_);
+            const int top = std::min(bound.bottom + bound.height(), height_);
+            if(left >= right || bottom >= top) return pixmap_view{};
+            return pixmap_view{data(left, bottom), right - left, top - bottom, pitch_, depth_, layer_pitch_};
+        }
+
+        pixmap_view layer(int d) const { return pixmap_view{row(0, d), width_, height_, pitch_, 1, layer_pitch_}; }
+
+        // Reverses the order of the rows of each layer
+        void flip_y() const {
+            static_assert(!std::is_const<PixelT>::value, "pixmap_view::flip_y requires a writable view");
+            constexpr size_t block = 1024;
+            unsigned char tmp[block];
+            const size_t bytes = row_bytes();
+            for(int d = 0; d != depth_; ++d) {
+                for(int r = 0, r_end = height_/2; r != r_end; ++r) {
+                    auto A = reinterpret_cast<unsigned char*>(row(r, d));
+                    auto B = reinterpret_cast<unsigned char*>(row(height_ - 1 - r, d));
+                    for(size_t i = 0; i < bytes; i += block) {
+                        const size_t n = std::min(block, bytes - i);
+                        std::memcpy(tmp, A + i, n);
+                        std::memcpy(A + i, B + i, n);
+                        std::memcpy(B + i, tmp, n);
+                    }
+                }
+            }
+        }
+
+    protected:
+        PixelT* data_ = nullptr;
+        int width_ = 0, height_ = 0, depth_ = 0;
+        int pitch_ = 0;
+        size_t layer_pitch_ = 0;
+    };
+
+    // Copies the overlap of src and trg (from their origins), as a single copy if both are packed or a row at a time.  src and
+    // trg may only overlap row for row (e.g. a shift along x).
+    template <typename SrcPixelT, typename TrgPixelT>
+    void blit(const pixmap_view<SrcPixelT>& src, const pixmap_view<TrgPixelT>& trg) {
+        static_assert(std::is_same<typename std::remove_const<SrcPixelT>::type, TrgPixelT>::value,
+                      "blit requires the same, writable pixel type");
+        const int width = std::min(src.width(), trg.width()), height = std::min(src.height(), trg.height());
+        const int depth = std::min(src.depth(), trg.depth());
+        if(width < 1 || height < 1 || depth < 1) return;
+
+        if(src.is_packed() && trg.is_packed() && src.width() == trg.width() && src.height() == trg.height()) {
+            std::memmove(trg.data(), src.data(), size_t(width)*height*depth*sizeof(TrgPixelT));
+            return;
+        }
+
+        const size_t bytes = size_t(width)*sizeof(TrgPixelT);
+        for(int d = 0; d != depth; ++d) {
+            for(int r = 0; r != height; ++r) std::memmove(trg.row(r, d), src.row(r, d), bytes);
+        }
+    }
+}}
+
+#endif //ZAP_PIXMAP_VIEW_HPP
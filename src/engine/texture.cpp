@@ -76,6 +76,18 @@ zap::engine::gl::GLenum gl_internal_format(zap::engine::pixel_format format, zap
     return GL_NONE;
 }
 
+// glTexStorage requires a sized internal format
+zap::engine::gl::GLenum gl_sized_format(zap::engine::pixel_format format, zap::engine::pixel_datatype datatype) {
+    using namespace zap::engine; using namespace gl;
+    if(datatype == pixel_datatype::PD_UNSIGNED_BYTE) {
+        if(format == pixel_format::PF_RED)  return GL_R8;
+        if(format == pixel_format::PF_RG)   return GL_RG8;
+        if(format == pixel_format::PF_RGB)  return GL_RGB8;
+        if(format == pixel_format::PF_RGBA) return GL_RGBA8;
+    }
+    return gl_internal_format(format, datatype);
+}
+
 bool texture::allocate() {
     glGenTextures(1, &id_);
     LOG("Texture Allocated:", id_);
@@ -164,8 +176,36 @@ bool texture::initialise(texture_type type, int width, int height, int depth, pi
     return !gl_error_check();
 }
 
+bool texture::initialise_storage(int width, int height, int levels, pixel_format format, pixel_datatype datatype) {
+    using namespace gl;
+    type_ = texture_type::TT_TEX2D;
+
+    glBindTexture(GL_TEXTURE_2D, id_);
+    initialise_default();
+
+    if(storage_supported()) {
+        glTexStorage2D(GL_TEXTURE_2D, levels, gl_sized_format(format, datatype), width, height);
+    } else {
+        const auto internal_fmt = gl_internal_format(format, datatype);
+        for(int l = 0; l != levels; ++l) {
+            glTexImage2D(GL_TEXTURE_2D, l, internal_fmt, std::max(width >> l, 1), std::max(height >> l, 1), 0,
+                         gl_type(format), gl_type(datatype), nullptr);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    w_ = width; h_ = height; d_ = 1;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return !gl_error_check();
+}
+
+bool texture::storage_supported() {
+    return GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+}
+
 bool texture::copy(size_t col, size_t row, size_t width, size_t height, int level, bool update_mipmaps, pixel_format format,
-        pixel_datatype datatype, const char* data) {
+        pixel_datatype datatype, const char* data, size_t row_length) {
     using namespace gl;
     auto gltype = gl_type(type_);
 
@@ -176,13 +216,16 @@ bool texture::copy(size_t col, size_t row, size_t width, size_t height, int leve
         glGetIntegerv(GL_UNPACK_ALIGNMENT, &pixel_alignment);
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     }
+    if(row_length) glPixelStorei(GL_UNPACK_ROW_LENGTH, int(row_length));
     if(type_ == texture_type::TT_TEX2D) {
         glTexSubImage2D(gltype, level, uint32_t(col), uint32_t(row), uint32_t(width), uint32_t(height), gl_type(format), gl_type(datatype), data);
     } else {
         LOG_ERR("This function is incomplete and the texture you've just initialised isn't gonna work.");
     }
+    if(update_mipmaps) glGenerateMipmap(gltype);
 
     release();
+    if(row_length) glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     if(pixel_alignment) glPixelStorei(GL_UNPACK_ALIGNMENT, pixel_alignment);
     return !gl_error_check();
 }
@@ -55,12 +55,18 @@ public:
     void release() const;
     bool is_bound() const;
 
+    // row_length is the distance between rows of data in pixels (GL_UNPACK_ROW_LENGTH), zero if the rows are packed
     bool copy(size_t col, size_t row, size_t width, size_t height, int level, bool update_mipmaps, pixel_format format,
-        pixel_datatype datatype, const char* data=nullptr);
+        pixel_datatype datatype, const char* data=nullptr, size_t row_length=0);
 
     bool initialise(texture_type type, int width, int height, int depth, pixel_format format,
                     pixel_datatype datatype, bool mipmaps, const char* data=nullptr);
 
+    // Storage for levels mip levels of a width x height 2D texture, filled level by level with copy().  The storage is
+    // immutable where glTexStorage2D is supported.
+    bool initialise_storage(int width, int height, int levels, pixel_format format, pixel_datatype datatype);
+    static bool storage_supported();
+
 
     template <typename PixelT>
     bool initialise(size_t width, size_t height, const std::vector<PixelT>& buffer, bool generate_mipmaps=false) {
@@ -90,6 +96,21 @@ public:
         else if(pmap.depth() > 1)  type = texture_type::TT_TEX3D;
         else if(pmap.height() > 1) type = texture_type::TT_TEX2D;
         else                       type = texture_type::TT_TEX1D;
+
+        if(!pmap.is_packed()) {
+            // Padded 2D rows are uploaded with GL_UNPACK_ROW_LENGTH, anything else from a packed copy
+            if(type == texture_type::TT_TEX2D) {
+                return initialise(type, int32_t(pmap.width()), int32_t(pmap.height()), 1, pixel_type<PixelT>::format,
+                                  pixel_type<PixelT>::datatype, false, nullptr) &&
+                       copy(0, 0, size_t(pmap.width()), size_t(pmap.height()), 0, generate_mipmaps,
+                            pixel_type<PixelT>::format, pixel_type<PixelT>::datatype,
+                            reinterpret_cast<const char*>(pmap.data()), size_t(pmap.pitch()));
+            }
+            pixmap<PixelT> packed{pmap.width(), pmap.height(), pmap.depth()};
+            blit(pmap.view(), packed.view());
+            return initialise(packed, generate_mipmaps);
+        }
+
         return initialise(type, int32_t(pmap.width()), int32_t(pmap.height()), int32_t(pmap.depth()),
                           pixel_type<PixelT>::format, pixel_type<PixelT>::datatype, generate_mipmaps,
                           reinterpret_cast<const char*>(pmap.data()));
@@ -104,6 +125,17 @@ public:
         return err;
     };
 
+    // Copies the width x height block starting at pixel offset of pixbuf, with rows row_length pixels apart
+    template <typename PixelT>
+    bool copy_region(const pixel_buffer<PixelT>& pixbuf, size_t offset, size_t row_length, size_t col, size_t row,
+                     size_t width, size_t height, int level=0, bool update_mipmaps=false) {
+        pixbuf.bind();
+        auto err = copy(col, row, width, height, level, update_mipmaps, pixel_type<PixelT>::format, pixel_type<PixelT>::datatype,
+                        reinterpret_cast<const char*>(offset*sizeof(PixelT)), row_length);
+        pixbuf.release();
+        return err;
+    }
+
     static size_t query_max_units();
 
 protected:
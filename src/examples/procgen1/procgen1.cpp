@@ -146,7 +146,7 @@ void procgen1::on_resize(int width, int height) {
     auto pixbuf = generate(width, height);
     texture tex;
     tex.allocate();
-    tex.initialise(width, height, pixbuf.buffer(), false);
+    tex.initialise(pixbuf, false);
     quad_.resize(width, height);
     quad_.set_texture(std::move(tex));
 }
@@ -5,6 +5,7 @@
 #include "host/GLFW/application.hpp"
 #include "graphics2/quad.hpp"
 #include "raytracer/raytracer.hpp"
+#include "raytracer/progressive.hpp"
 
 using namespace zap;
 using namespace zap::maths;
@@ -14,7 +15,7 @@ using namespace zap::graphics;
 
 class tracer : public application {
 public:
-    tracer() : application{"tracer", 1280, 768} { }
+    tracer() : application{"tracer", 1280, 768}, prog{rndr} { }
     virtual ~tracer() { }
 
     bool initialise() override final;
@@ -25,24 +26,38 @@ public:
     void on_resize(int width, int height) override final;
 
 protected:
+    void restart(int width, int height);
+
+    // Rendering is spread across frames, each frame spends at most this long tracing
+    constexpr static float frame_budget = 12.f;
+
     quad image;
+    raytracer rndr;
+    scene scn;
+    progressive prog;
 };
 
 bool tracer::initialise() {
     image.initialise();
 
-    auto tex = texture();
-    tex.allocate();
-
-    raytracer rndr;
-    auto pixels = rndr.render(1280, 768);
-    tex.initialise(1280, 768, pixels, false);
-    image.set_texture(std::move(tex));
+    rndr.initialise();
+    raytracer::make_test_scene(scn);
+    restart(1280, 768);
     return true;
 }
 
 void tracer::update(double t, float dt) {
-    //on_resize(sc_width_, sc_height_);
+    if(prog.is_converged()) return;
+
+    prog.step(scn, frame_budget);
+
+    auto& tex = image.get_texture();
+    for(auto tile : prog.dirty_tiles()) {
+        const auto rect = prog.tile_rect(tile);
+        tex.copy(size_t(rect.left), size_t(rect.bottom), size_t(rect.width()), size_t(rect.height()), 0, false,
+                 pixel_format::PF_RGB, pixel_datatype::PD_UNSIGNED_BYTE,
+                 reinterpret_cast<const char*>(prog.tile_pixels(tile)));
+    }
 }
 
 void tracer::draw() {
@@ -56,12 +71,15 @@ void tracer::shutdown() {
 void tracer::on_resize(int width, int height) {
     application::on_resize(width,height);
     image.resize(width, height);
+    restart(width, height);
+}
+
+void tracer::restart(int width, int height) {
+    prog.reset(width, height);
 
     auto tex = texture();
     tex.allocate();
-    raytracer rndr;
-    auto pixels = rndr.render(width, height);
-    tex.initialise(width, height, pixels, false);
+    tex.initialise(width, height, std::vector<rgb888_t>(size_t(width*height), rgb888_t(0, 0, 0)), false);
     image.set_texture(std::move(tex));
 }
 
@@ -1,7 +1,8 @@
 /* Created by Darren Otgaar on 2017/06/11. http://www.github.com/otgaard/zap */
 #include <maths/rand_lcg.hpp>
-#include <tools/threadpool.hpp>
+#include <tools/scheduler.hpp>
 #include "generator.hpp"
+#include "noise_kernels.hpp"
 #include <maths/simd.hpp>
 #include <graphics/graphics2/quad.hpp>
 #include <maths/io.hpp>
@@ -77,6 +78,19 @@ struct generator::state_t {
 
         prn.shuffle(prn_table, prn_table+RND_TBL);
 
+        // The SIMD kernels gather from 32-bit, SoA copies of the tables
+        for(int i = 0; i != RND_TBL; ++i) {
+            simd_tables.perm[i] = prn_table[i];
+            simd_tables.grad1[i] = grad1_table[i];
+            simd_tables.grad2[0][i] = grad2_table[i].x; simd_tables.grad2[1][i] = grad2_table[i].y;
+            simd_tables.grad3[0][i] = grad3_table[i].x; simd_tables.grad3[1][i] = grad3_table[i].y;
+            simd_tables.grad3[2][i] = grad3_table[i].z;
+        }
+        for(int i = 0; i != 64; ++i) {
+            for(int j = 0; j != 4; ++j) simd_tables.simplex[j][i] = simplex[i][j];
+        }
+        row_kernel = noise_kernels::select_kernel();
+
         initialised = true;
         return true;
     }
@@ -92,6 +106,9 @@ struct generator::state_t {
     maths::vec3f __attribute__((aligned(16))) grad3_table[RND_TBL] = {};
 #endif
 
+    noise_kernels::tables simd_tables = {};
+    noise_kernels::row_kernel row_kernel = nullptr;
+
     // OpenGL Resources
     graphics::quad quad;
     texture prn_tex;
@@ -147,11 +164,11 @@ generator::generator() : state_(new state_t()), s(*state_.get()) {
 
 zap::generator::~generator() = default;
 
-bool zap::generator::initialise(threadpool* pool_ptr, int pool_size, ulonglong seed) {
+bool zap::generator::initialise(scheduler* pool_ptr, int pool_size, ulonglong seed) {
     if(!pool_ptr) {
-        pool_ptr_ = new threadpool{};
+        pool_ptr_ = new scheduler{};
         if(!pool_ptr_->initialise(pool_size)) {
-            LOG_ERR("Failed to initialise threadpool.  Aborting.");
+            LOG_ERR("Failed to initialise scheduler.  Aborting.");
             return false;
         }
     } else {
@@ -206,179 +223,178 @@ std::future<generator::pixmap<float>> generator::render(const render_task& req,
     }
 }
 
+namespace {
+    // Rows are rendered in bands, several per thread so that uneven bands still balance
+    int band_grain(int rows, size_t threads) {
+        return std::max(1, rows / int(4*(threads + 1)));
+    }
+
+    // Maps the face coordinates in [-1, 1] to the cube map face direction
+    vec3f cube_face(int face, float x, float y) {
+        switch(face) {
+            case 0: return vec3f{1.f, y, -x};       // X+
+            case 1: return vec3f{-1.f, y, x};       // X-
+            case 2: return vec3f{x, -1.f, y};       // Y+
+            case 3: return vec3f{x, 1.f, -y};       // Y-
+            case 4: return vec3f{x, y, 1.f};        // Z+
+            default: return vec3f{-x, y, -1.f};     // Z-
+        }
+    }
+}
+
+void generator::render_rows(int rows, const std::function<void(int, int)>& fnc) {
+    if(pool_ptr_) pool_ptr_->parallel_for(0, rows, band_grain(rows, pool_ptr_->size()), fnc);
+    else          fnc(0, rows);
+}
+
 pixmap<float> generator::render_cpu(const render_task& req) {
-    pixmap<float> image{req.width, req.height, (req.project == render_task::projection::CUBE_MAP ? 6 : 1)};
+    const int faces = req.project == render_task::projection::CUBE_MAP ? 6 : 1;
+    pixmap<float> image{req.width, req.height, faces};
     LOG("Generating Image:", image.width(), image.height(), image.depth(), image.size());
 
     if(req.project == render_task::projection::PLANAR) {
         const float inv_x = req.scale.x/req.width;
         const float inv_y = req.scale.y/req.height;
 
-        for(int r = 0; r != req.height; ++r) {
-            float y = inv_y * r;
-            int iy = maths::floor(y);
-            float dy = y - float(iy);
-            for(int c = 0; c != req.width; ++c) {
-                float x = inv_x * c;
-                int ix = maths::floor(x);
-                float dx = x - float(ix);
-                image(c,r) = pnoise(dx, dy, ix, iy);
+        render_rows(req.height, [this, &req, &image, inv_x, inv_y](int first, int last) {
+            for(int r = first; r != last; ++r) {
+                float y = inv_y * r;
+                int iy = maths::floor(y);
+                float dy = y - float(iy);
+                for(int c = 0; c != req.width; ++c) {
+                    float x = inv_x * c;
+                    int ix = maths::floor(x);
+                    float dx = x - float(ix);
+                    image(c,r) = pnoise(dx, dy, ix, iy);
+                }
             }
-        }
+        });
     } else if(req.project == render_task::projection::SPHERICAL) {
         const float inv_x = TWO_PI<float>/req.width;
         const float inv_y = PI<float>/req.height;
         const float radius = req.scale.x;
 
-        for(int r = 0; r != req.height; ++r) {
-            float theta = inv_y * r, ctheta = cosf(theta), stheta = sinf(theta);
-            for(int c = 0; c != req.width; ++c) {
-                float phi = inv_x * c, cphi = cosf(phi), sphi = sinf(phi);
-                float x = radius * stheta * cphi, y = radius * ctheta, z = radius * stheta * sphi;
-                int ix = maths::floor(x), iy = maths::floor(y), iz = maths::floor(z);
-                float dx = x - float(ix), dy = y - float(iy), dz = z - float(iz);
-                image(c,r) = pnoise(dx, dy, dz, ix, iy, iz);
+        render_rows(req.height, [this, &req, &image, inv_x, inv_y, radius](int first, int last) {
+            for(int r = first; r != last; ++r) {
+                float theta = inv_y * r, ctheta = cosf(theta), stheta = sinf(theta);
+                for(int c = 0; c != req.width; ++c) {
+                    float phi = inv_x * c, cphi = cosf(phi), sphi = sinf(phi);
+                    float x = radius * stheta * cphi, y = radius * ctheta, z = radius * stheta * sphi;
+                    int ix = maths::floor(x), iy = maths::floor(y), iz = maths::floor(z);
+                    float dx = x - float(ix), dy = y - float(iy), dz = z - float(iz);
+                    image(c,r) = pnoise(dx, dy, dz, ix, iy, iz);
+                }
             }
-        }
+        });
     } else if(req.project == render_task::projection::CUBE_MAP) {
         assert(req.width == req.height && "Cube Map requires width == height");
         const float inv_dim = 1.f/req.width;
         const int h_dim = req.width/2;
 
-        // X+ Plane
-        for(int r = 0; r != req.height; ++r) {
-            float y = 2.f * (r - h_dim) * inv_dim;
-            for(int c = 0; c != req.width; ++c) {
-                float x = 2.f * (h_dim - c) * inv_dim;
-                vec3f sP = req.scale.x * cube_to_sphere(vec3f{1.f, y, x});
-                int ix = maths::floor(sP.x), iy = maths::floor(sP.y), iz = maths::floor(sP.z);
-                float dx = sP.x - float(ix), dy = sP.y - float(iy), dz = sP.z - float(iz);
-                image(c,r,0) = pnoise(dx, dy, dz, ix, iy, iz);
-            }
-        }
-
-        // X- Plane
-        for(int r = 0; r != req.height; ++r) {
-            float y = 2.f * (r - h_dim) * inv_dim;
-            for(int c = 0; c != req.width; ++c) {
-                float x = 2.f * (c - h_dim) * inv_dim;
-                vec3f sP = req.scale.x * cube_to_sphere(vec3f{-1.f, y, x});
-                int ix = maths::floor(sP.x), iy = maths::floor(sP.y), iz = maths::floor(sP.z);
-                float dx = sP.x - float(ix), dy = sP.y - float(iy), dz = sP.z - float(iz);
-                image(c,r,1) = pnoise(dx, dy, dz, ix, iy, iz);
-            }
-        }
-
-        // Y+ Plane
-        for(int r = 0; r != req.height; ++r) {
-            float y = 2.f * (r - h_dim) * inv_dim;
-            for(int c = 0; c != req.width; ++c) {
-                float x = 2.f * (c - h_dim) * inv_dim;
-                vec3f sP = req.scale.x * cube_to_sphere(vec3f{x, -1.f, y});
-                int ix = maths::floor(sP.x), iy = maths::floor(sP.y), iz = maths::floor(sP.z);
-                float dx = sP.x - float(ix), dy = sP.y - float(iy), dz = sP.z - float(iz);
-                image(c,r,2) = pnoise(dx, dy, dz, ix, iy, iz);
-            }
-        }
-
-        // Y- Plane
-        for(int r = 0; r != req.height; ++r) {
-            float y = 2.f * (h_dim - r) * inv_dim;
-            for(int c = 0; c != req.width; ++c) {
-                float x = 2.f * (c - h_dim) * inv_dim;
-                vec3f sP = req.scale.x * cube_to_sphere(vec3f{x, 1.f, y});
-                int ix = maths::floor(sP.x), iy = maths::floor(sP.y), iz = maths::floor(sP.z);
-                float dx = sP.x - float(ix), dy = sP.y - float(iy), dz = sP.z - float(iz);
-                image(c,r,3) = pnoise(dx, dy, dz, ix, iy, iz);
+        // The bands run over the rows of all six faces
+        render_rows(faces*req.height, [this, &req, &image, inv_dim, h_dim](int first, int last) {
+            for(int row = first; row != last; ++row) {
+                const int face = row / req.height, r = row % req.height;
+                float y = 2.f * (r - h_dim) * inv_dim;
+                for(int c = 0; c != req.width; ++c) {
+                    float x = 2.f * (c - h_dim) * inv_dim;
+                    vec3f sP = req.scale.x * cube_to_sphere(cube_face(face, x, y));
+                    int ix = maths::floor(sP.x), iy = maths::floor(sP.y), iz = maths::floor(sP.z);
+                    float dx = sP.x - float(ix), dy = sP.y - float(iy), dz = sP.z - float(iz);
+                    image(c,r,face) = pnoise(dx, dy, dz, ix, iy, iz);
+                }
             }
-        }
-
-        // Z+ Plane
-        for(int r = 0; r != req.height; ++r) {
-            float y = 2.f * (r - h_dim) * inv_dim;
-            for(int c = 0; c != req.width; ++c) {
-                float x = 2.f * (c - h_dim) * inv_dim;
-                vec3f sP = req.scale.x * cube_to_sphere(vec3f{x, y, 1.f});
-                int ix = maths::floor(sP.x), iy = maths::floor(sP.y), iz = maths::floor(sP.z);
-                float dx = sP.x - float(ix), dy = sP.y - float(iy), dz = sP.z - float(iz);
-                image(c,r,4) = pnoise(dx, dy, dz, ix, iy, iz);
-            }
-        }
-
-        // Z- Plane
-        for(int r = 0; r != req.height; ++r) {
-            float y = 2.f * (r - h_dim) * inv_dim;
-            for(int c = 0; c != req.width; ++c) {
-                float x = 2.f * (h_dim - c) * inv_dim;
-                vec3f sP = req.scale.x * cube_to_sphere(vec3f{x, y, -1.f});
-                int ix = maths::floor(sP.x), iy = maths::floor(sP.y), iz = maths::floor(sP.z);
-                float dx = sP.x - float(ix), dy = sP.y - float(iy), dz = sP.z - float(iz);
-                image(c,r,5) = pnoise(dx, dy, dz, ix, iy, iz);
-            }
-        }
+        });
     }
 
     return image;
 }
 
 pixmap<float> generator::render_simd(const render_task& req) {
-    using namespace zap::maths::simd;
-
-    pixmap<float> img{req.width, req.height};
+    using noise_kernels::row_params;
+    using noise_kernels::mapping;
+
+    // The rows are padded to whole vectors of the widest kernel, so the kernels only store whole vectors
+    const int faces = req.project == render_task::projection::CUBE_MAP ? 6 : 1;
+    pixmap<float> img{req.width, req.height, faces, noise_kernels::max_width*sizeof(float)};
+
+    row_params prm;
+    switch(req.basis_fnc) {
+        case render_task::basis_function::VALUE: prm.fnc = noise_kernels::basis::VALUE; break;
+        case render_task::basis_function::PERLIN: prm.fnc = noise_kernels::basis::PERLIN; break;
+        case render_task::basis_function::SIMPLEX: prm.fnc = noise_kernels::basis::SIMPLEX; break;
+        default:
+            LOG_ERR("generator::render_simd only supports the value, perlin, and simplex basis functions");
+            return img;
+    }
 
-    // Don't support non-aligned sizes for now (need to refactor pixelmap to support row alignment)
-    if(req.width % 4 != 0) {
-        LOG_ERR("generator::render_simd cannot be used with unaligned memory, width % 4 != 0");
+    if(!s.row_kernel) {
+        LOG_ERR("generator::render_simd requires an initialised generator");
         return img;
     }
 
-    const float inv_x = req.scale.x/req.width;
-    const float inv_y = req.scale.y/req.height;
-
-    const int stream_size = 4;
-    const int blocks = req.width/stream_size;
-
-    const vecm32f vseq = { 0.f, 1.f, 2.f, 3.f };
-    const vecm32f vinc = { inv_x, inv_x, inv_x, inv_x };
-    const vecm vsteps = _mm_mul_ps(vseq, vinc);
-
-    set_round_down();
-
-    for(int r = 0; r != req.height; ++r) {
-        float vy = r * inv_y;
-        int iy0 = zap::maths::floor(vy), iy1 = iy0+1;
-        float dy = vy - float(iy0);
-        vecm vdy = load(dy);
-        int col_offset = r * req.width;
-        for(int c = 0, offset = 0; c != blocks; ++c, col_offset += 4, offset += 4) {
-            vecm vx = _mm_add_ps(load(offset * inv_x), vsteps);
-            vecm fx = ffloor_v(vx);
-            veci ix0 = convert_v(fx);
-            veci ix1 = _mm_add_epi32(ix0, veci_one);
-            vecm vdx = _mm_sub_ps(vx, fx);
-
-            VALIGN int xi0[4], xi1[4];
-            _mm_store_si128((veci*)xi0, ix0);
-            _mm_store_si128((veci*)xi1, ix1);
-
-            VALIGN float values[16];
-            for(int i = 0; i != 4; ++i) {
-                values[i]    = s.grad1(xi0[i], iy0);
-                values[4+i]  = s.grad1(xi1[i], iy0);
-                values[8+i]  = s.grad1(xi0[i], iy1);
-                values[12+i] = s.grad1(xi1[i], iy1);
+    prm.width = img.pitch();
+    const auto kernel = s.row_kernel;
+    const auto& tbl = s.simd_tables;
+
+    if(req.project == render_task::projection::PLANAR) {
+        const float inv_y = req.scale.y/req.height;
+        prm.map = mapping::PLANAR;
+        prm.inv_x = req.scale.x/req.width;
+
+        render_rows(req.height, [&img, &tbl, &prm, kernel, inv_y](int first, int last) {
+            row_params row = prm;
+            for(int r = first; r != last; ++r) {
+                row.y = inv_y * r;
+                kernel(tbl, row, img.data(0, r));
             }
+        });
+    } else if(req.project == render_task::projection::SPHERICAL) {
+        const float inv_x = TWO_PI<float>/req.width;
+        const float inv_y = PI<float>/req.height;
+        const float radius = req.scale.x;
 
-            vecm res = bilinear_v(vdx, vdy,
-                                  _mm_load_ps(values),
-                                  _mm_load_ps(values+4),
-                                  _mm_load_ps(values+8),
-                                  _mm_load_ps(values+12));
-            _mm_store_ps(img.data(size_t(col_offset)), res);
+        // The longitude terms are shared by every row, and computed for the padding too
+        const int padded = img.pitch();
+        std::vector<float> trig(size_t(2*padded), 0.f);
+        for(int c = 0; c != padded; ++c) {
+            const float phi = inv_x * c;
+            trig[c] = cosf(phi);
+            trig[padded + c] = sinf(phi);
         }
-    }
 
-    set_round_default();
+        prm.map = mapping::SPHERICAL;
+        prm.cphi = trig.data();
+        prm.sphi = trig.data() + padded;
+
+        render_rows(req.height, [&img, &tbl, &prm, kernel, inv_y, radius](int first, int last) {
+            row_params row = prm;
+            for(int r = first; r != last; ++r) {
+                const float theta = inv_y * r;
+                row.rs = radius * sinf(theta);
+                row.rc = radius * cosf(theta);
+                kernel(tbl, row, img.data(0, r));
+            }
+        });
+    } else if(req.project == render_task::projection::CUBE_MAP) {
+        assert(req.width == req.height && "Cube Map requires width == height");
+        prm.map = mapping::CUBE_MAP;
+        prm.inv_dim = 1.f/req.width;
+        prm.h_dim = req.width/2;
+        prm.scale = req.scale.x;
+
+        render_rows(faces*req.height, [&img, &tbl, &prm, &req, kernel](int first, int last) {
+            row_params row = prm;
+            for(int idx = first; idx != last; ++idx) {
+                const int r = idx % req.height;
+                row.face = idx / req.height;
+                row.cy = 2.f * (r - row.h_dim) * row.inv_dim;
+                kernel(tbl, row, img.data(0, r, row.face));
+            }
+        });
+    } else {
+        LOG_ERR("generator::render_simd only supports planar, spherical, and cube map projections");
+    }
 
     return img;
 }
@@ -10,11 +10,12 @@
 
 #include <memory>
 #include <future>
+#include <functional>
 #include <maths/vec2.hpp>
 #include <maths/mat2.hpp>
 #include <engine/pixmap.hpp>
 #include <engine/texture.hpp>
-#include <tools/threadpool.hpp>
+#include <tools/scheduler.hpp>
 #include <graphics/graphics.hpp>
 #include <engine/pixel_conversion.hpp>
 
@@ -97,7 +98,7 @@ public:
     generator& operator=(const generator&) = delete;
     generator& operator=(generator&&) = delete;
 
-    bool initialise(threadpool* pool_ptr=nullptr, int pool_size=2, ulonglong seed=1);
+    bool initialise(scheduler* pool_ptr=nullptr, int pool_size=2, ulonglong seed=1);
 
     // This is a temporary interface for sharing the PRN tables with other shaders via the loaded textures
     const texture* prn_table() const;
@@ -120,7 +121,7 @@ public:
 
     template <typename PixelT>
     pixmap_future<PixelT> render_image(const render_task& req, gen_method method=gen_method::CPU);
-    // Render the resource for usage on the client
+    // Render the resource for usage on the client, the rows of the SIMD image are padded to whole vectors (see pixmap)
     pixmap_future<float> render(const render_task& req, gen_method method=gen_method::CPU);
 
     pixmap<float> render_cpu(const render_task& req);
@@ -169,7 +170,10 @@ public:
     inline float easing_curve2(float v) const { return v * v * v * (10.f + v * (6.f * v - 15.f)); }
 
 private:
-    threadpool* pool_ptr_ = nullptr;
+    // Splits [0, rows) into bands rendered in parallel on the scheduler, fnc(first, last) renders a band
+    void render_rows(int rows, const std::function<void(int, int)>& fnc);
+
+    scheduler* pool_ptr_ = nullptr;
 
     struct state_t;
     std::unique_ptr<state_t> state_;
@@ -179,7 +183,8 @@ private:
 template <typename PixelT>
 generator::pixmap_future<PixelT> generator::render_image(const render_task& req, generator::gen_method method) {
     auto fnc = [this, method](render_task r)->generator::pixmap<PixelT> {
-        auto input = render(r, method).get();
+        auto fut = render(r, method);
+        auto input = pool_ptr_->wait(fut);
         pixmap<PixelT> img{r.width, r.height, (r.project == render_task::projection::CUBE_MAP ? 6 : 1)};
         convert(input, img);
         return img;
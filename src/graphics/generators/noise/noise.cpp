@@ -3,11 +3,13 @@
 //
 
 #include "noise.hpp"
+#include "../noise_kernels.hpp"
 #include <random>
 #include <algorithm>
 
 namespace zap { namespace generators {
     bool noise::initialised = false;
+    uint32_t noise::hash_seed = 0;
 
     byte noise::prn_tbl[noise::prn_tbl_size];
     float noise::grad1[noise::prn_tbl_size];
@@ -28,6 +30,66 @@ namespace zap { namespace generators {
         std::mt19937 g(rd());
 
         std::shuffle(prn_tbl, prn_tbl+noise::prn_tbl_size, g);
+        hash_seed = uint32_t(seed) ^ uint32_t(seed >> 32);
         initialised = true;
     }
+
+    void noise::evaluate_batch(basis_function fnc, bool turbulence, byte octaves, float persistence, float lacunarity,
+                               const float* x, const float* y, const float* z, float* out, size_t n) {
+        static const noise_kernels::batch_kernel kernel = noise_kernels::select_batch_kernel();
+
+        if(n == 0) return;
+        if(octaves == 0) {
+            std::fill(out, out+n, 0.f);
+            return;
+        }
+
+        noise_kernels::batch_params prm;
+        prm.fnc = fnc == basis_function::SIMPLEX ? noise_kernels::basis::SIMPLEX : noise_kernels::basis::PERLIN;
+        prm.dims = z ? 3 : 2;
+        prm.seed = hash_seed;
+        prm.octaves = octaves;
+        prm.persistence = persistence;
+        prm.lacunarity = lacunarity;
+        prm.turbulence = turbulence;
+        prm.x = x; prm.y = y; prm.z = z;
+        prm.n = n;
+        kernel(prm, out);
+    }
+
+    void noise::perlin2(const float* x, const float* y, float* out, size_t n) {
+        evaluate_batch(basis_function::PERLIN, false, 1, 1.f, 1.f, x, y, nullptr, out, n);
+    }
+
+    void noise::perlin3(const float* x, const float* y, const float* z, float* out, size_t n) {
+        evaluate_batch(basis_function::PERLIN, false, 1, 1.f, 1.f, x, y, z, out, n);
+    }
+
+    void noise::simplex2(const float* x, const float* y, float* out, size_t n) {
+        evaluate_batch(basis_function::SIMPLEX, false, 1, 1.f, 1.f, x, y, nullptr, out, n);
+    }
+
+    void noise::simplex3(const float* x, const float* y, const float* z, float* out, size_t n) {
+        evaluate_batch(basis_function::SIMPLEX, false, 1, 1.f, 1.f, x, y, z, out, n);
+    }
+
+    void noise::fractal2(basis_function fnc, byte octaves, float persistence, float lacunarity,
+                         const float* x, const float* y, float* out, size_t n) {
+        evaluate_batch(fnc, false, octaves, persistence, lacunarity, x, y, nullptr, out, n);
+    }
+
+    void noise::fractal3(basis_function fnc, byte octaves, float persistence, float lacunarity,
+                         const float* x, const float* y, const float* z, float* out, size_t n) {
+        evaluate_batch(fnc, false, octaves, persistence, lacunarity, x, y, z, out, n);
+    }
+
+    void noise::turbulence2(basis_function fnc, byte octaves, float persistence, float lacunarity,
+                            const float* x, const float* y, float* out, size_t n) {
+        evaluate_batch(fnc, true, octaves, persistence, lacunarity, x, y, nullptr, out, n);
+    }
+
+    void noise::turbulence3(basis_function fnc, byte octaves, float persistence, float lacunarity,
+                            const float* x, const float* y, const float* z, float* out, size_t n) {
+        evaluate_batch(fnc, true, octaves, persistence, lacunarity, x, y, z, out, n);
+    }
 }}
\ No newline at end of file
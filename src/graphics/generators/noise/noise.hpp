@@ -88,13 +88,40 @@ namespace zap { namespace generators {
         static float grad_i(int x, int y) { return grad1[perm(x,y)]; }
         static float grad_i(int x, int y, int z) { return grad1[perm(x,y,z)]; }
 
+        // Batch evaluation of n points given as separate coordinate arrays.  The batch functions hash the lattice in SIMD
+        // registers instead of gathering from the permutation tables and use the widest vector unit on the host.  They
+        // produce a different noise to perlin<T> for the same seed, in approximately [-1, 1].
+        enum class basis_function {
+            PERLIN,
+            SIMPLEX
+        };
+
+        static void perlin2(const float* x, const float* y, float* out, size_t n);
+        static void perlin3(const float* x, const float* y, const float* z, float* out, size_t n);
+        static void simplex2(const float* x, const float* y, float* out, size_t n);
+        static void simplex3(const float* x, const float* y, const float* z, float* out, size_t n);
+
+        // As fractal and turbulence, but every octave is evaluated while the sample is in registers
+        static void fractal2(basis_function fnc, byte octaves, float persistence, float lacunarity,
+                             const float* x, const float* y, float* out, size_t n);
+        static void fractal3(basis_function fnc, byte octaves, float persistence, float lacunarity,
+                             const float* x, const float* y, const float* z, float* out, size_t n);
+        static void turbulence2(basis_function fnc, byte octaves, float persistence, float lacunarity,
+                                const float* x, const float* y, float* out, size_t n);
+        static void turbulence3(basis_function fnc, byte octaves, float persistence, float lacunarity,
+                                const float* x, const float* y, const float* z, float* out, size_t n);
+
         static const byte* prn_tbl_ptr() { return prn_tbl; }
         static const vec3f* grad3_tbl_ptr() { return grad3; }
         static const vec2f* grad2_tbl_ptr() { return grad2; }
         static const float* grad1_tbl_ptr() { return grad1; }
 
     protected:
+        static void evaluate_batch(basis_function fnc, bool turbulence, byte octaves, float persistence, float lacunarity,
+                                   const float* x, const float* y, const float* z, float* out, size_t n);
+
         static bool initialised;
+        static uint32_t hash_seed;
         static byte prn_tbl[prn_tbl_size];
         static vec3f grad3[prn_tbl_size];
         static vec2f grad2[prn_tbl_size];
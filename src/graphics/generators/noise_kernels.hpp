@@ -0,0 +1,96 @@
+/* Created by Darren Otgaar on 2018/06/14. http://www.github.com/otgaard/zap */
+#ifndef ZAP_NOISE_KERNELS_HPP
+#define ZAP_NOISE_KERNELS_HPP
+
+/* Vectorised noise kernels used by generator::render_simd and the batch functions of generators::noise.  The same kernels
+ * (noise_kernels_impl.hpp) are compiled once per instruction set in its own translation unit (SSE2, AVX2 and AVX-512F)
+ * and the widest kernel supported by the host is selected at runtime, so the same binary uses the widest vector unit
+ * available.
+ *
+ * This header is included by the AVX translation units, see tools/cpu.hpp for what it may contain.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace zap { namespace noise_kernels {
+
+enum class basis {
+    VALUE,
+    PERLIN,
+    SIMPLEX                     // 4D simplex noise with the unused coordinates set to zero
+};
+
+enum class mapping {
+    PLANAR,
+    SPHERICAL,
+    CUBE_MAP
+};
+
+// The permutation and gradient tables of the generator, widened to 32 bits and stored SoA for gathers
+struct tables {
+    constexpr static int size = 256;
+    constexpr static int mask = size - 1;
+
+    int32_t perm[size];
+    float grad1[size];
+    float grad2[2][size];
+    float grad3[3][size];
+    int32_t simplex[4][64];     // The simplex traversal rank of each axis, indexed by the simplex corner ordering
+};
+
+// Describes the row of samples to evaluate (see generator::render_cpu for the projections)
+struct row_params {
+    basis fnc = basis::VALUE;
+    mapping map = mapping::PLANAR;
+    int width = 0;
+
+    float inv_x = 0.f, y = 0.f;                 // PLANAR: sample (inv_x * c, y)
+    const float* cphi = nullptr;                // SPHERICAL: cos(phi) and sin(phi) per column, padded to a multiple of
+    const float* sphi = nullptr;                // max_width
+    float rs = 0.f, rc = 0.f;                   // SPHERICAL: radius * sin(theta), radius * cos(theta)
+    int face = 0, h_dim = 0;                    // CUBE_MAP: face [x+, x-, y+, y-, z+, z-] and half the face dimension
+    float inv_dim = 0.f, cy = 0.f, scale = 1.f; // CUBE_MAP: face row coordinate in [-1, 1] and sphere scale
+};
+
+// Writes params.width samples to out, out need not be aligned
+using row_kernel = void (*)(const tables& tbl, const row_params& params, float* out);
+
+constexpr int max_width = 16;
+
+// Describes a batch of points for the gather-free noise (see noise::perlin3).  The octaves are summed as in noise::fractal
+// (or noise::turbulence), with the lattice hash offset per octave.
+struct batch_params {
+    basis fnc = basis::PERLIN;                  // PERLIN or SIMPLEX
+    int dims = 3;                               // 2 or 3, z is ignored for 2
+    uint32_t seed = 0;
+    int octaves = 1;
+    float persistence = .5f, lacunarity = 2.f;
+    bool turbulence = false;
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* z = nullptr;
+    size_t n = 0;
+};
+
+// Writes params.n samples to out, neither the inputs nor out need be aligned
+using batch_kernel = void (*)(const batch_params& params, float* out);
+
+// The widest kernel width supported by the host (4, 8 or 16)
+int host_width();
+// Returns the kernel for the width, or the widest supported kernel if the host cannot run it
+row_kernel select_kernel(int width=max_width);
+
+row_kernel sse2_kernel();
+row_kernel avx2_kernel();
+row_kernel avx512_kernel();
+
+batch_kernel select_batch_kernel(int width=max_width);
+
+batch_kernel sse2_batch_kernel();
+batch_kernel avx2_batch_kernel();
+batch_kernel avx512_batch_kernel();
+
+}}
+
+#endif //ZAP_NOISE_KERNELS_HPP
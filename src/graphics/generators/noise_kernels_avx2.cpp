@@ -0,0 +1,78 @@
+/* Created by Darren Otgaar on 2018/06/14. http://www.github.com/otgaard/zap */
+// Compiled with AVX2 enabled, only called when the host supports AVX2 (see noise_kernels::select_kernel)
+#include <immintrin.h>
+#include "noise_kernels_impl.hpp"
+
+using namespace zap::noise_kernels;
+
+namespace {
+    struct avx2_pack {
+        using vf = __m256;
+        using vi = __m256i;
+        using vm = __m256;
+        constexpr static int width = 8;
+
+        static vf set(float v) { return _mm256_set1_ps(v); }
+        static vi iset(int v) { return _mm256_set1_epi32(v); }
+        static vi seq() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+
+        static vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+        static vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+        static vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+        static vf sqrt(vf a) { return _mm256_sqrt_ps(a); }
+        static vf neg(vf a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.f)); }
+        static vf abs(vf a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+        static vf floor(vf a) { return _mm256_floor_ps(a); }
+        static vi to_int(vf a) { return _mm256_cvttps_epi32(a); }
+        static vf to_float(vi a) { return _mm256_cvtepi32_ps(a); }
+
+        static vi iadd(vi a, vi b) { return _mm256_add_epi32(a, b); }
+        static vi isub(vi a, vi b) { return _mm256_sub_epi32(a, b); }
+        static vi iand(vi a, vi b) { return _mm256_and_si256(a, b); }
+        static vi ixor(vi a, vi b) { return _mm256_xor_si256(a, b); }
+        static vi ishr(vi a, int n) { return _mm256_srli_epi32(a, n); }
+        static vi imul(vi a, vi b) { return _mm256_mullo_epi32(a, b); }
+
+        static vm lt(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static vm gt(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static vm ilt(vi a, vi b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)); }
+        static vm igt(vi a, vi b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)); }
+        static vm itest(vi a, int bit) {
+            const vi b = _mm256_set1_epi32(bit);
+            return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a, b), b));
+        }
+
+        static vf select(vm m, vf a, vf b) { return _mm256_blendv_ps(b, a, m); }
+        static vi iselect(vm m, vi a, vi b) {
+            return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), m));
+        }
+
+        static vi gather(const int32_t* base, vi idx) { return _mm256_i32gather_epi32((const int*)base, idx, 4); }
+        static vf gatherf(const float* base, vi idx) { return _mm256_i32gather_ps(base, idx, 4); }
+
+        static vf loadu(const float* ptr) { return _mm256_loadu_ps(ptr); }
+        static vf loadu_n(const float* ptr, int n) {
+            return _mm256_maskload_ps(ptr, _mm256_cmpgt_epi32(_mm256_set1_epi32(n), seq()));
+        }
+        static void storeu(float* ptr, vf v) { _mm256_storeu_ps(ptr, v); }
+        static void store_n(float* ptr, vf v, int n) {
+            _mm256_maskstore_ps(ptr, _mm256_cmpgt_epi32(_mm256_set1_epi32(n), seq()), v);
+        }
+    };
+
+    void render_row(const tables& tbl, const row_params& params, float* out) {
+        row_renderer<avx2_pack>::render(tbl, params, out);
+    }
+
+    void evaluate_batch(const batch_params& params, float* out) {
+        batch_evaluator<avx2_pack>::run(params, out);
+    }
+}
+
+row_kernel zap::noise_kernels::avx2_kernel() {
+    return &render_row;
+}
+
+batch_kernel zap::noise_kernels::avx2_batch_kernel() {
+    return &evaluate_batch;
+}
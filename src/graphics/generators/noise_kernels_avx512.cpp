@@ -0,0 +1,79 @@
+/* Created by Darren Otgaar on 2018/06/14. http://www.github.com/otgaard/zap */
+// Compiled with AVX-512F enabled, only called when the host supports AVX-512F (see noise_kernels::select_kernel)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"        // The AVX-512 intrinsics in GCC's headers use undefined registers
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+#include "noise_kernels_impl.hpp"
+
+using namespace zap::noise_kernels;
+
+namespace {
+    struct avx512_pack {
+        using vf = __m512;
+        using vi = __m512i;
+        using vm = __mmask16;
+        constexpr static int width = 16;
+
+        static vf set(float v) { return _mm512_set1_ps(v); }
+        static vi iset(int v) { return _mm512_set1_epi32(v); }
+        static vi seq() { return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); }
+
+        static vf add(vf a, vf b) { return _mm512_add_ps(a, b); }
+        static vf sub(vf a, vf b) { return _mm512_sub_ps(a, b); }
+        static vf mul(vf a, vf b) { return _mm512_mul_ps(a, b); }
+        static vf sqrt(vf a) { return _mm512_sqrt_ps(a); }
+        // AVX-512F has no float logic ops (those are AVX-512DQ), use the integer forms
+        static vf neg(vf a) {
+            return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32(int(0x80000000))));
+        }
+        static vf abs(vf a) {
+            return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7FFFFFFF)));
+        }
+        static vf floor(vf a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+        static vi to_int(vf a) { return _mm512_cvttps_epi32(a); }
+        static vf to_float(vi a) { return _mm512_cvtepi32_ps(a); }
+
+        static vi iadd(vi a, vi b) { return _mm512_add_epi32(a, b); }
+        static vi isub(vi a, vi b) { return _mm512_sub_epi32(a, b); }
+        static vi iand(vi a, vi b) { return _mm512_and_si512(a, b); }
+        static vi ixor(vi a, vi b) { return _mm512_xor_si512(a, b); }
+        static vi ishr(vi a, int n) { return _mm512_srli_epi32(a, unsigned(n)); }
+        static vi imul(vi a, vi b) { return _mm512_mullo_epi32(a, b); }
+
+        static vm lt(vf a, vf b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static vm gt(vf a, vf b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+        static vm ilt(vi a, vi b) { return _mm512_cmplt_epi32_mask(a, b); }
+        static vm igt(vi a, vi b) { return _mm512_cmpgt_epi32_mask(a, b); }
+        static vm itest(vi a, int bit) { return _mm512_test_epi32_mask(a, _mm512_set1_epi32(bit)); }
+
+        static vf select(vm m, vf a, vf b) { return _mm512_mask_blend_ps(m, b, a); }
+        static vi iselect(vm m, vi a, vi b) { return _mm512_mask_blend_epi32(m, b, a); }
+
+        static vi gather(const int32_t* base, vi idx) { return _mm512_i32gather_epi32(idx, base, 4); }
+        static vf gatherf(const float* base, vi idx) { return _mm512_i32gather_ps(idx, base, 4); }
+
+        static vf loadu(const float* ptr) { return _mm512_loadu_ps(ptr); }
+        static vf loadu_n(const float* ptr, int n) { return _mm512_maskz_loadu_ps(__mmask16((1u << n) - 1), ptr); }
+        static void storeu(float* ptr, vf v) { _mm512_storeu_ps(ptr, v); }
+        static void store_n(float* ptr, vf v, int n) { _mm512_mask_storeu_ps(ptr, __mmask16((1u << n) - 1), v); }
+    };
+
+    void render_row(const tables& tbl, const row_params& params, float* out) {
+        row_renderer<avx512_pack>::render(tbl, params, out);
+    }
+
+    void evaluate_batch(const batch_params& params, float* out) {
+        batch_evaluator<avx512_pack>::run(params, out);
+    }
+}
+
+row_kernel zap::noise_kernels::avx512_kernel() {
+    return &render_row;
+}
+
+batch_kernel zap::noise_kernels::avx512_batch_kernel() {
+    return &evaluate_batch;
+}
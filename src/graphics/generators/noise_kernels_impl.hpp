@@ -0,0 +1,445 @@
+/* Created by Darren Otgaar on 2018/06/14. http://www.github.com/otgaard/zap */
+#ifndef ZAP_NOISE_KERNELS_IMPL_HPP
+#define ZAP_NOISE_KERNELS_IMPL_HPP
+
+/* The noise row kernel, written once against a vector pack P and included by each instruction set translation unit.
+ * P must be defined in an anonymous namespace so that every instantiation is local to its translation unit.
+ *
+ * P provides vf (float lanes), vi (int32 lanes), vm (lane mask) and:
+ *   width, set, iset, seq, add, sub, mul, sqrt, neg, abs, floor, to_int, to_float, iadd, isub, iand, ixor, ishr, imul,
+ *   lt, gt, ilt, igt, itest, select, iselect, gather, gatherf, loadu, loadu_n, storeu, store_n
+ *
+ * The operations are ordered as in the scalar generator functions (vnoise, pnoise, snoise and cube_to_sphere) so that
+ * the kernels match the scalar results.
+ */
+
+#include "noise_kernels.hpp"
+
+namespace zap { namespace noise_kernels {
+
+template <typename P>
+struct row_renderer {
+    using vf = typename P::vf;
+    using vi = typename P::vi;
+    using vm = typename P::vm;
+
+    static vi perm(const tables& tbl, const vi& x) { return P::gather(tbl.perm, P::iand(x, P::iset(tables::mask))); }
+    static vi perm(const tables& tbl, const vi& x, const vi& y) { return perm(tbl, P::iadd(x, perm(tbl, y))); }
+    static vi perm(const tables& tbl, const vi& x, const vi& y, const vi& z) {
+        return perm(tbl, P::iadd(x, perm(tbl, P::iadd(y, perm(tbl, z)))));
+    }
+
+    static vf lerp(const vf& u, const vf& a, const vf& b) {
+        return P::add(P::mul(P::sub(P::set(1.f), u), a), P::mul(u, b));
+    }
+
+    static vf easing_curve(const vf& v) {
+        return P::mul(P::mul(v, v), P::sub(P::set(3.f), P::mul(P::set(2.f), v)));
+    }
+
+    static vf dot(const vf& gx, const vf& gy, const vf& x, const vf& y) {
+        return P::add(P::mul(gx, x), P::mul(gy, y));
+    }
+
+    static vf dot(const vf& gx, const vf& gy, const vf& gz, const vf& x, const vf& y, const vf& z) {
+        return P::add(P::add(P::mul(gx, x), P::mul(gy, y)), P::mul(gz, z));
+    }
+
+    static vf value2(const tables& tbl, const vf& x, const vf& y) {
+        const vf fx = P::floor(x), fy = P::floor(y);
+        const vi ix = P::to_int(fx), iy = P::to_int(fy);
+        const vi ix1 = P::iadd(ix, P::iset(1)), iy1 = P::iadd(iy, P::iset(1));
+        const vf dx = P::sub(x, fx), dy = P::sub(y, fy);
+
+        const vf P00 = P::gatherf(tbl.grad1, perm(tbl, ix, iy)), P01 = P::gatherf(tbl.grad1, perm(tbl, ix1, iy));
+        const vf P10 = P::gatherf(tbl.grad1, perm(tbl, ix, iy1)), P11 = P::gatherf(tbl.grad1, perm(tbl, ix1, iy1));
+        return lerp(dy, lerp(dx, P00, P01), lerp(dx, P10, P11));
+    }
+
+    static vf value3(const tables& tbl, const vf& x, const vf& y, const vf& z) {
+        const vf fx = P::floor(x), fy = P::floor(y), fz = P::floor(z);
+        const vi ix = P::to_int(fx), iy = P::to_int(fy), iz = P::to_int(fz);
+        const vi ix1 = P::iadd(ix, P::iset(1)), iy1 = P::iadd(iy, P::iset(1)), iz1 = P::iadd(iz, P::iset(1));
+        const vf dx = P::sub(x, fx), dy = P::sub(y, fy), dz = P::sub(z, fz);
+
+        auto g = [&tbl](const vi& a, const vi& b, const vi& c) { return P::gatherf(tbl.grad1, perm(tbl, a, b, c)); };
+        return lerp(dz, lerp(dy, lerp(dx, g(ix, iy, iz), g(ix1, iy, iz)), lerp(dx, g(ix, iy1, iz), g(ix1, iy1, iz))),
+                        lerp(dy, lerp(dx, g(ix, iy, iz1), g(ix1, iy, iz1)), lerp(dx, g(ix, iy1, iz1), g(ix1, iy1, iz1))));
+    }
+
+    static vf perlin2(const tables& tbl, const vf& x, const vf& y) {
+        const vf fx = P::floor(x), fy = P::floor(y);
+        const vi bx0 = P::to_int(fx), by0 = P::to_int(fy);
+        const vi bx1 = P::iadd(bx0, P::iset(1)), by1 = P::iadd(by0, P::iset(1));
+        const vf rx0 = P::sub(x, fx), ry0 = P::sub(y, fy);
+        const vf rx1 = P::sub(rx0, P::set(1.f)), ry1 = P::sub(ry0, P::set(1.f));
+
+        const vf sx = easing_curve(rx0), sy = easing_curve(ry0);
+
+        auto g = [&tbl](const vi& a, const vi& b, const vf& u, const vf& v) {
+            const vi h = perm(tbl, a, b);
+            return dot(P::gatherf(tbl.grad2[0], h), P::gatherf(tbl.grad2[1], h), u, v);
+        };
+
+        const vf a = lerp(sx, g(bx0, by0, rx0, ry0), g(bx1, by0, rx1, ry0));
+        const vf b = lerp(sx, g(bx0, by1, rx0, ry1), g(bx1, by1, rx1, ry1));
+        return lerp(sy, a, b);
+    }
+
+    static vf perlin3(const tables& tbl, const vf& x, const vf& y, const vf& z) {
+        const vf fx = P::floor(x), fy = P::floor(y), fz = P::floor(z);
+        const vi bx0 = P::to_int(fx), by0 = P::to_int(fy), bz0 = P::to_int(fz);
+        const vi bx1 = P::iadd(bx0, P::iset(1)), by1 = P::iadd(by0, P::iset(1)), bz1 = P::iadd(bz0, P::iset(1));
+        const vf rx0 = P::sub(x, fx), ry0 = P::sub(y, fy), rz0 = P::sub(z, fz);
+        const vf rx1 = P::sub(rx0, P::set(1.f)), ry1 = P::sub(ry0, P::set(1.f)), rz1 = P::sub(rz0, P::set(1.f));
+
+        const vf sx = easing_curve(rx0), sy = easing_curve(ry0), sz = easing_curve(rz0);
+
+        auto g = [&tbl](const vi& a, const vi& b, const vi& c, const vf& u, const vf& v, const vf& w) {
+            const vi h = perm(tbl, a, b, c);
+            return dot(P::gatherf(tbl.grad3[0], h), P::gatherf(tbl.grad3[1], h), P::gatherf(tbl.grad3[2], h), u, v, w);
+        };
+
+        vf a = lerp(sx, g(bx0, by0, bz0, rx0, ry0, rz0), g(bx1, by0, bz0, rx1, ry0, rz0));
+        vf b = lerp(sx, g(bx0, by1, bz0, rx0, ry1, rz0), g(bx1, by1, bz0, rx1, ry1, rz0));
+        const vf c = lerp(sy, a, b);
+
+        a = lerp(sx, g(bx0, by0, bz1, rx0, ry0, rz1), g(bx1, by0, bz1, rx1, ry0, rz1));
+        b = lerp(sx, g(bx0, by1, bz1, rx0, ry1, rz1), g(bx1, by1, bz1, rx1, ry1, rz1));
+        const vf d = lerp(sy, a, b);
+        return lerp(sz, c, d);
+    }
+
+    // Contribution of one simplex corner
+    static vf simplex_corner(const tables& tbl, const vi& ii, const vi& jj, const vi& kk, const vi& ll,
+                             const vf& x, const vf& y, const vf& z, const vf& w) {
+        vf t = P::sub(P::sub(P::sub(P::sub(P::set(.6f), P::mul(x, x)), P::mul(y, y)), P::mul(z, z)), P::mul(w, w));
+        const vm outside = P::lt(t, P::set(0.f));
+
+        const vi h = P::iand(P::gather(tbl.perm, P::iand(P::iadd(ii, perm(tbl, P::iadd(jj, perm(tbl, P::iadd(kk,
+                     perm(tbl, ll)))))), P::iset(tables::mask))), P::iset(31));
+
+        const vf u = P::select(P::ilt(h, P::iset(24)), x, y);
+        const vf v = P::select(P::ilt(h, P::iset(16)), y, z);
+        const vf s = P::select(P::ilt(h, P::iset(8)), z, w);
+        const vf grad = P::add(P::add(P::select(P::itest(h, 1), P::neg(u), u), P::select(P::itest(h, 2), P::neg(v), v)),
+                               P::select(P::itest(h, 4), P::neg(s), s));
+
+        t = P::mul(t, t);
+        const vf n = P::mul(P::mul(t, t), grad);
+        return P::select(outside, P::set(0.f), n);
+    }
+
+    static vf simplex4(const tables& tbl, const vf& x, const vf& y, const vf& z, const vf& w) {
+        const float F4 = .309016994f;
+        const float G4 = .138196601f;
+
+        const vf scale = P::mul(P::add(P::add(P::add(x, y), z), w), P::set(F4));
+        const vf fi = P::floor(P::add(x, scale)), fj = P::floor(P::add(y, scale));
+        const vf fk = P::floor(P::add(z, scale)), fl = P::floor(P::add(w, scale));
+        const vi i = P::to_int(fi), j = P::to_int(fj), k = P::to_int(fk), l = P::to_int(fl);
+
+        const vf t = P::mul(P::to_float(P::iadd(P::iadd(P::iadd(i, j), k), l)), P::set(G4));
+        const vf x0 = P::sub(x, P::sub(fi, t)), y0 = P::sub(y, P::sub(fj, t));
+        const vf z0 = P::sub(z, P::sub(fk, t)), w0 = P::sub(w, P::sub(fl, t));
+
+        vi c = P::iselect(P::gt(x0, y0), P::iset(32), P::iset(0));
+        c = P::iadd(c, P::iselect(P::gt(x0, z0), P::iset(16), P::iset(0)));
+        c = P::iadd(c, P::iselect(P::gt(y0, z0), P::iset(8), P::iset(0)));
+        c = P::iadd(c, P::iselect(P::gt(x0, w0), P::iset(4), P::iset(0)));
+        c = P::iadd(c, P::iselect(P::gt(y0, w0), P::iset(2), P::iset(0)));
+        c = P::iadd(c, P::iselect(P::gt(z0, w0), P::iset(1), P::iset(0)));
+
+        const vi ri = P::gather(tbl.simplex[0], c), rj = P::gather(tbl.simplex[1], c);
+        const vi rk = P::gather(tbl.simplex[2], c), rl = P::gather(tbl.simplex[3], c);
+
+        const vi ii = P::iand(i, P::iset(tables::mask)), jj = P::iand(j, P::iset(tables::mask));
+        const vi kk = P::iand(k, P::iset(tables::mask)), ll = P::iand(l, P::iset(tables::mask));
+        const vi one = P::iset(1), zero = P::iset(0);
+
+        vf n = simplex_corner(tbl, ii, jj, kk, ll, x0, y0, z0, w0);
+
+        const float F[4] = { G4, 2.f*G4, 3.f*G4, 4.f*G4 };
+        for(int corner = 3; corner != 0; --corner) {
+            const vi i1 = P::iselect(P::igt(ri, P::iset(corner-1)), one, zero);
+            const vi j1 = P::iselect(P::igt(rj, P::iset(corner-1)), one, zero);
+            const vi k1 = P::iselect(P::igt(rk, P::iset(corner-1)), one, zero);
+            const vi l1 = P::iselect(P::igt(rl, P::iset(corner-1)), one, zero);
+            const vf off = P::set(F[3-corner]);
+            n = P::add(n, simplex_corner(tbl, P::iadd(ii, i1), P::iadd(jj, j1), P::iadd(kk, k1), P::iadd(ll, l1),
+                                         P::add(P::sub(x0, P::to_float(i1)), off), P::add(P::sub(y0, P::to_float(j1)), off),
+                                         P::add(P::sub(z0, P::to_float(k1)), off), P::add(P::sub(w0, P::to_float(l1)), off)));
+        }
+
+        const vf off = P::set(F[3]), unit = P::set(1.f);
+        n = P::add(n, simplex_corner(tbl, P::iadd(ii, one), P::iadd(jj, one), P::iadd(kk, one), P::iadd(ll, one),
+                                     P::add(P::sub(x0, unit), off), P::add(P::sub(y0, unit), off),
+                                     P::add(P::sub(z0, unit), off), P::add(P::sub(w0, unit), off)));
+
+        return P::mul(P::set(27.f), n);
+    }
+
+    static vf evaluate(const tables& tbl, basis fnc, const vf& x, const vf& y) {
+        switch(fnc) {
+            case basis::PERLIN: return perlin2(tbl, x, y);
+            case basis::SIMPLEX: return simplex4(tbl, x, y, P::set(0.f), P::set(0.f));
+            default: return value2(tbl, x, y);
+        }
+    }
+
+    static vf evaluate(const tables& tbl, basis fnc, const vf& x, const vf& y, const vf& z) {
+        switch(fnc) {
+            case basis::PERLIN: return perlin3(tbl, x, y, z);
+            case basis::SIMPLEX: return simplex4(tbl, x, y, z, P::set(0.f));
+            default: return value3(tbl, x, y, z);
+        }
+    }
+
+    // Maps the face coordinates to the cube map face direction and projects onto the sphere (cube_to_sphere)
+    static void cube_point(int face, const vf& fx, const vf& fy, const vf& scale, vf& x, vf& y, vf& z) {
+        vf px, py, pz;
+        switch(face) {
+            case 0: px = P::set(1.f); py = fy; pz = P::neg(fx); break;
+            case 1: px = P::set(-1.f); py = fy; pz = fx; break;
+            case 2: px = fx; py = P::set(-1.f); pz = fy; break;
+            case 3: px = fx; py = P::set(1.f); pz = P::neg(fy); break;
+            case 4: px = fx; py = fy; pz = P::set(1.f); break;
+            default: px = P::neg(fx); py = fy; pz = P::set(-1.f); break;
+        }
+
+        const vf inv3 = P::set(1.f/3.f), half = P::set(.5f), one = P::set(1.f);
+        const vf x2 = P::mul(px, px), y2 = P::mul(py, py), z2 = P::mul(pz, pz);
+        const vf y2z2inv3 = P::mul(P::mul(y2, z2), inv3);
+        const vf z2x2inv3 = P::mul(P::mul(z2, x2), inv3);
+        const vf x2y2inv3 = P::mul(P::mul(x2, y2), inv3);
+        x = P::mul(scale, P::mul(px, P::sqrt(P::add(P::sub(P::sub(one, P::mul(half, y2)), P::mul(half, z2)), y2z2inv3))));
+        y = P::mul(scale, P::mul(py, P::sqrt(P::add(P::sub(P::sub(one, P::mul(half, z2)), P::mul(half, x2)), z2x2inv3))));
+        z = P::mul(scale, P::mul(pz, P::sqrt(P::add(P::sub(P::sub(one, P::mul(half, x2)), P::mul(half, y2)), x2y2inv3))));
+    }
+
+    static void render(const tables& tbl, const row_params& prm, float* out) {
+        const int W = P::width;
+        for(int c = 0; c < prm.width; c += W) {
+            const vi col = P::iadd(P::iset(c), P::seq());
+            vf n;
+            if(prm.map == mapping::PLANAR) {
+                n = evaluate(tbl, prm.fnc, P::mul(P::set(prm.inv_x), P::to_float(col)), P::set(prm.y));
+            } else if(prm.map == mapping::SPHERICAL) {
+                const vf rs = P::set(prm.rs);
+                n = evaluate(tbl, prm.fnc, P::mul(rs, P::loadu(prm.cphi + c)), P::set(prm.rc), P::mul(rs, P::loadu(prm.sphi + c)));
+            } else {
+                const vf fx = P::mul(P::mul(P::set(2.f), P::to_float(P::isub(col, P::iset(prm.h_dim)))), P::set(prm.inv_dim));
+                vf x, y, z;
+                cube_point(prm.face, fx, P::set(prm.cy), P::set(prm.scale), x, y, z);
+                n = evaluate(tbl, prm.fnc, x, y, z);
+            }
+
+            if(c + W <= prm.width) P::storeu(out + c, n);
+            else                   P::store_n(out + c, n, prm.width - c);
+        }
+    }
+};
+
+/* The batch noise behind noise::perlin2/3 and noise::simplex2/3.  Instead of chaining gathers through the permutation
+ * table, the lattice coordinates are hashed in registers (multiply by odd constants and avalanche) and the gradient is
+ * chosen from the hash bits as in Perlin's improved noise, so a sample costs no memory accesses beyond its coordinates.
+ * The octave loop runs with the sample in registers.
+ *
+ * The hash and gradient sets differ from the table based noise, so the results do not match perlin<T> for the same seed.
+ * Both bases are scaled to approximately [-1, 1].
+ */
+template <typename P>
+struct batch_evaluator {
+    using vf = typename P::vf;
+    using vi = typename P::vi;
+    using vm = typename P::vm;
+
+    static vi kx() { return P::iset(int32_t(0x8DA6B343)); }
+    static vi ky() { return P::iset(int32_t(0xD8163841)); }
+    static vi kz() { return P::iset(int32_t(0xCB1AB31F)); }
+
+    // Avalanches the combined lattice hash (lowbias32)
+    static vi mix(vi h) {
+        h = P::ixor(h, P::ishr(h, 16));
+        h = P::imul(h, P::iset(int32_t(0x7FEB352D)));
+        h = P::ixor(h, P::ishr(h, 15));
+        h = P::imul(h, P::iset(int32_t(0x846CA68B)));
+        return P::ixor(h, P::ishr(h, 16));
+    }
+
+    // 6t^5 - 15t^4 + 10t^3
+    static vf fade(const vf& t) {
+        const vf t3 = P::mul(P::mul(t, t), t);
+        return P::mul(t3, P::add(P::mul(t, P::sub(P::mul(t, P::set(6.f)), P::set(15.f))), P::set(10.f)));
+    }
+
+    static vf lerp(const vf& t, const vf& a, const vf& b) { return P::add(a, P::mul(t, P::sub(b, a))); }
+
+    // Eight gradients (+-1, +-2) and (+-2, +-1)
+    static vf grad(const vi& h, const vf& x, const vf& y) {
+        const vm lo = P::ilt(P::iand(h, P::iset(7)), P::iset(4));
+        const vf u = P::select(lo, x, y);
+        const vf v = P::add(P::select(lo, y, x), P::select(lo, y, x));
+        return P::add(P::select(P::itest(h, 1), P::neg(u), u), P::select(P::itest(h, 2), P::neg(v), v));
+    }
+
+    // The twelve cube edge gradients, with four repeated to make sixteen
+    static vf grad(const vi& h, const vf& x, const vf& y, const vf& z) {
+        const vi h15 = P::iand(h, P::iset(15));
+        const vf u = P::select(P::ilt(h15, P::iset(8)), x, y);
+        const vf v = P::select(P::ilt(h15, P::iset(4)), y, P::select(P::igt(h15, P::iset(11)), P::select(P::itest(h, 1), z, x), z));
+        return P::add(P::select(P::itest(h, 1), P::neg(u), u), P::select(P::itest(h, 2), P::neg(v), v));
+    }
+
+    static vf perlin2(const vf& x, const vf& y, const vi& seed) {
+        const vf fx = P::floor(x), fy = P::floor(y);
+        const vi hx0 = P::imul(P::to_int(fx), kx()), hx1 = P::iadd(hx0, kx());
+        const vi py = P::imul(P::to_int(fy), ky());
+        const vi hy0 = P::iadd(py, seed), hy1 = P::iadd(hy0, ky());
+        const vf rx0 = P::sub(x, fx), ry0 = P::sub(y, fy);
+        const vf rx1 = P::sub(rx0, P::set(1.f)), ry1 = P::sub(ry0, P::set(1.f));
+        const vf sx = fade(rx0), sy = fade(ry0);
+
+        const vf a = lerp(sx, grad(mix(P::iadd(hx0, hy0)), rx0, ry0), grad(mix(P::iadd(hx1, hy0)), rx1, ry0));
+        const vf b = lerp(sx, grad(mix(P::iadd(hx0, hy1)), rx0, ry1), grad(mix(P::iadd(hx1, hy1)), rx1, ry1));
+        return P::mul(P::set(.507f), lerp(sy, a, b));
+    }
+
+    static vf perlin3(const vf& x, const vf& y, const vf& z, const vi& seed) {
+        const vf fx = P::floor(x), fy = P::floor(y), fz = P::floor(z);
+        const vi hx0 = P::imul(P::to_int(fx), kx()), hx1 = P::iadd(hx0, kx());
+        const vi hy0 = P::imul(P::to_int(fy), ky()), hy1 = P::iadd(hy0, ky());
+        const vi hz0 = P::iadd(P::imul(P::to_int(fz), kz()), seed), hz1 = P::iadd(hz0, kz());
+        const vf rx0 = P::sub(x, fx), ry0 = P::sub(y, fy), rz0 = P::sub(z, fz);
+        const vf rx1 = P::sub(rx0, P::set(1.f)), ry1 = P::sub(ry0, P::set(1.f)), rz1 = P::sub(rz0, P::set(1.f));
+        const vf sx = fade(rx0), sy = fade(ry0), sz = fade(rz0);
+
+        auto g = [](const vi& a, const vi& b, const vi& c, const vf& u, const vf& v, const vf& w) {
+            return grad(mix(P::iadd(P::iadd(a, b), c)), u, v, w);
+        };
+
+        const vf c = lerp(sy, lerp(sx, g(hx0, hy0, hz0, rx0, ry0, rz0), g(hx1, hy0, hz0, rx1, ry0, rz0)),
+                              lerp(sx, g(hx0, hy1, hz0, rx0, ry1, rz0), g(hx1, hy1, hz0, rx1, ry1, rz0)));
+        const vf d = lerp(sy, lerp(sx, g(hx0, hy0, hz1, rx0, ry0, rz1), g(hx1, hy0, hz1, rx1, ry0, rz1)),
+                              lerp(sx, g(hx0, hy1, hz1, rx0, ry1, rz1), g(hx1, hy1, hz1, rx1, ry1, rz1)));
+        return P::mul(P::set(.936f), lerp(sz, c, d));
+    }
+
+    static vf simplex_corner(const vi& h, const vf& x, const vf& y) {
+        const vf t = P::sub(P::sub(P::set(.5f), P::mul(x, x)), P::mul(y, y));
+        const vf t2 = P::mul(t, t);
+        return P::select(P::lt(t, P::set(0.f)), P::set(0.f), P::mul(P::mul(t2, t2), grad(mix(h), x, y)));
+    }
+
+    static vf simplex_corner(const vi& h, const vf& x, const vf& y, const vf& z) {
+        const vf t = P::sub(P::sub(P::sub(P::set(.6f), P::mul(x, x)), P::mul(y, y)), P::mul(z, z));
+        const vf t2 = P::mul(t, t);
+        return P::select(P::lt(t, P::set(0.f)), P::set(0.f), P::mul(P::mul(t2, t2), grad(mix(h), x, y, z)));
+    }
+
+    static vf simplex2(const vf& x, const vf& y, const vi& seed) {
+        const float F2 = .366025403f;
+        const float G2 = .211324865f;
+
+        const vf s = P::mul(P::add(x, y), P::set(F2));
+        const vf fi = P::floor(P::add(x, s)), fj = P::floor(P::add(y, s));
+        const vf t = P::mul(P::add(fi, fj), P::set(G2));
+        const vf x0 = P::sub(x, P::sub(fi, t)), y0 = P::sub(y, P::sub(fj, t));
+
+        // The middle corner steps along x in the lower triangle and along y in the upper
+        const vm lower = P::gt(x0, y0);
+        const vf i1 = P::select(lower, P::set(1.f), P::set(0.f)), j1 = P::sub(P::set(1.f), i1);
+        const vf x1 = P::add(P::sub(x0, i1), P::set(G2)), y1 = P::add(P::sub(y0, j1), P::set(G2));
+        const vf x2 = P::add(x0, P::set(2.f*G2 - 1.f)), y2 = P::add(y0, P::set(2.f*G2 - 1.f));
+
+        const vi h0 = P::iadd(P::iadd(P::imul(P::to_int(fi), kx()), P::imul(P::to_int(fj), ky())), seed);
+        const vi h1 = P::iadd(h0, P::iselect(lower, kx(), ky()));
+        const vi h2 = P::iadd(h0, P::iadd(kx(), ky()));
+
+        const vf n = P::add(P::add(simplex_corner(h0, x0, y0), simplex_corner(h1, x1, y1)), simplex_corner(h2, x2, y2));
+        return P::mul(P::set(40.f), n);
+    }
+
+    static vf simplex3(const vf& x, const vf& y, const vf& z, const vi& seed) {
+        const float F3 = 1.f/3.f;
+        const float G3 = 1.f/6.f;
+
+        const vf s = P::mul(P::add(P::add(x, y), z), P::set(F3));
+        const vf fi = P::floor(P::add(x, s)), fj = P::floor(P::add(y, s)), fk = P::floor(P::add(z, s));
+        const vf t = P::mul(P::add(P::add(fi, fj), fk), P::set(G3));
+        const vf x0 = P::sub(x, P::sub(fi, t)), y0 = P::sub(y, P::sub(fj, t)), z0 = P::sub(z, P::sub(fk, t));
+
+        // Rank the offsets to find the traversal order of the simplex, branch free (products of 0/1 lanes)
+        const vf one = P::set(1.f), zero = P::set(0.f);
+        const vf gx = P::select(P::lt(x0, y0), zero, one), gy = P::select(P::lt(y0, z0), zero, one);
+        const vf gz = P::select(P::lt(z0, x0), zero, one);
+        const vf lx = P::sub(one, gx), ly = P::sub(one, gy), lz = P::sub(one, gz);
+        const vf i1 = P::mul(gx, lz), j1 = P::mul(gy, lx), k1 = P::mul(gz, ly);
+        const vf i2 = P::sub(P::add(gx, lz), i1), j2 = P::sub(P::add(gy, lx), j1), k2 = P::sub(P::add(gz, ly), k1);
+
+        const vf x1 = P::add(P::sub(x0, i1), P::set(G3)), y1 = P::add(P::sub(y0, j1), P::set(G3));
+        const vf z1 = P::add(P::sub(z0, k1), P::set(G3));
+        const vf x2 = P::add(P::sub(x0, i2), P::set(2.f*G3)), y2 = P::add(P::sub(y0, j2), P::set(2.f*G3));
+        const vf z2 = P::add(P::sub(z0, k2), P::set(2.f*G3));
+        const vf x3 = P::add(x0, P::set(3.f*G3 - 1.f)), y3 = P::add(y0, P::set(3.f*G3 - 1.f));
+        const vf z3 = P::add(z0, P::set(3.f*G3 - 1.f));
+
+        // 0/1 lanes to all-bits masks on the hash multipliers
+        auto step = [](const vf& o, const vi& k) { return P::iand(P::isub(P::iset(0), P::to_int(o)), k); };
+
+        const vi h0 = P::iadd(P::iadd(P::iadd(P::imul(P::to_int(fi), kx()), P::imul(P::to_int(fj), ky())),
+                                      P::imul(P::to_int(fk), kz())), seed);
+        const vi h1 = P::iadd(h0, P::iadd(P::iadd(step(i1, kx()), step(j1, ky())), step(k1, kz())));
+        const vi h2 = P::iadd(h0, P::iadd(P::iadd(step(i2, kx()), step(j2, ky())), step(k2, kz())));
+        const vi h3 = P::iadd(h0, P::iadd(P::iadd(kx(), ky()), kz()));
+
+        const vf n = P::add(P::add(simplex_corner(h0, x0, y0, z0), simplex_corner(h1, x1, y1, z1)),
+                            P::add(simplex_corner(h2, x2, y2, z2), simplex_corner(h3, x3, y3, z3)));
+        return P::mul(P::set(32.f), n);
+    }
+
+    static vf evaluate(const batch_params& prm, const vf& x, const vf& y, const vf& z, const vi& seed) {
+        if(prm.dims == 2) return prm.fnc == basis::SIMPLEX ? simplex2(x, y, seed) : perlin2(x, y, seed);
+        return prm.fnc == basis::SIMPLEX ? simplex3(x, y, z, seed) : perlin3(x, y, z, seed);
+    }
+
+    static void run(const batch_params& prm, float* out) {
+        const int W = P::width;
+
+        float ampl = 1.f, mag = 0.f;
+        for(int o = 0; o != prm.octaves; ++o) {
+            mag += ampl;
+            ampl *= prm.persistence;
+        }
+        const vf inv_mag = P::set(1.f/mag);
+
+        for(size_t i = 0; i < prm.n; i += W) {
+            const int count = prm.n - i < size_t(W) ? int(prm.n - i) : W;
+            auto load = [i, count](const float* ptr) {
+                return count == P::width ? P::loadu(ptr + i) : P::loadu_n(ptr + i, count);
+            };
+            const vf x = load(prm.x), y = load(prm.y), z = prm.dims == 2 ? P::set(0.f) : load(prm.z);
+
+            vf accum = P::set(0.f);
+            float freq = 1.f;
+            ampl = 1.f;
+            for(int o = 0; o != prm.octaves; ++o) {
+                const vf f = P::set(freq);
+                const vi seed = P::iset(int32_t(prm.seed + uint32_t(o)*0x9E3779B9u));
+                vf n = evaluate(prm, P::mul(f, x), P::mul(f, y), P::mul(f, z), seed);
+                if(prm.turbulence) n = P::abs(n);
+                accum = P::add(accum, P::mul(P::set(ampl), n));
+                ampl *= prm.persistence;
+                freq *= prm.lacunarity;
+            }
+
+            const vf result = P::mul(accum, inv_mag);
+            if(count == W) P::storeu(out + i, result);
+            else           P::store_n(out + i, result, count);
+        }
+    }
+};
+
+}}
+
+#endif //ZAP_NOISE_KERNELS_IMPL_HPP
@@ -0,0 +1,114 @@
+/* Created by Darren Otgaar on 2018/06/14. http://www.github.com/otgaard/zap */
+#include <emmintrin.h>
+#include "noise_kernels_impl.hpp"
+#include <tools/cpu.hpp>
+
+using namespace zap::noise_kernels;
+
+namespace {
+    struct sse2_pack {
+        using vf = __m128;
+        using vi = __m128i;
+        using vm = __m128;
+        constexpr static int width = 4;
+
+        static vf set(float v) { return _mm_set1_ps(v); }
+        static vi iset(int v) { return _mm_set1_epi32(v); }
+        static vi seq() { return _mm_setr_epi32(0, 1, 2, 3); }
+
+        static vf add(vf a, vf b) { return _mm_add_ps(a, b); }
+        static vf sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+        static vf mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+        static vf sqrt(vf a) { return _mm_sqrt_ps(a); }
+        static vf neg(vf a) { return _mm_xor_ps(a, _mm_set1_ps(-0.f)); }
+        static vf abs(vf a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+        static vf floor(vf a) {
+            const vf t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+            return _mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(a, t), _mm_set1_ps(1.f)));
+        }
+        static vi to_int(vf a) { return _mm_cvttps_epi32(a); }
+        static vf to_float(vi a) { return _mm_cvtepi32_ps(a); }
+
+        static vi iadd(vi a, vi b) { return _mm_add_epi32(a, b); }
+        static vi isub(vi a, vi b) { return _mm_sub_epi32(a, b); }
+        static vi iand(vi a, vi b) { return _mm_and_si128(a, b); }
+        static vi ixor(vi a, vi b) { return _mm_xor_si128(a, b); }
+        static vi ishr(vi a, int n) { return _mm_srli_epi32(a, n); }
+        // SSE2 has no 32-bit low multiply, multiply the even and odd lanes separately and interleave the low halves
+        static vi imul(vi a, vi b) {
+            const vi even = _mm_mul_epu32(a, b);
+            const vi odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+
+        static vm lt(vf a, vf b) { return _mm_cmplt_ps(a, b); }
+        static vm gt(vf a, vf b) { return _mm_cmpgt_ps(a, b); }
+        static vm ilt(vi a, vi b) { return _mm_castsi128_ps(_mm_cmplt_epi32(a, b)); }
+        static vm igt(vi a, vi b) { return _mm_castsi128_ps(_mm_cmpgt_epi32(a, b)); }
+        static vm itest(vi a, int bit) {
+            const vi b = _mm_set1_epi32(bit);
+            return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a, b), b));
+        }
+
+        static vf select(vm m, vf a, vf b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        static vi iselect(vm m, vi a, vi b) {
+            const vi mi = _mm_castps_si128(m);
+            return _mm_or_si128(_mm_and_si128(mi, a), _mm_andnot_si128(mi, b));
+        }
+
+        // No gathers before AVX2
+        static vi gather(const int32_t* base, vi idx) {
+            alignas(16) int32_t i[4];
+            _mm_store_si128((vi*)i, idx);
+            return _mm_setr_epi32(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+        }
+        static vf gatherf(const float* base, vi idx) {
+            alignas(16) int32_t i[4];
+            _mm_store_si128((vi*)i, idx);
+            return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+        }
+
+        static vf loadu(const float* ptr) { return _mm_loadu_ps(ptr); }
+        static vf loadu_n(const float* ptr, int n) {
+            alignas(16) float arr[4] = { 0.f, 0.f, 0.f, 0.f };
+            for(int i = 0; i != n; ++i) arr[i] = ptr[i];
+            return _mm_load_ps(arr);
+        }
+        static void storeu(float* ptr, vf v) { _mm_storeu_ps(ptr, v); }
+        static void store_n(float* ptr, vf v, int n) {
+            alignas(16) float arr[4];
+            _mm_store_ps(arr, v);
+            for(int i = 0; i != n; ++i) ptr[i] = arr[i];
+        }
+    };
+
+    void render_row(const tables& tbl, const row_params& params, float* out) {
+        row_renderer<sse2_pack>::render(tbl, params, out);
+    }
+
+    void evaluate_batch(const batch_params& params, float* out) {
+        batch_evaluator<sse2_pack>::run(params, out);
+    }
+}
+
+row_kernel zap::noise_kernels::sse2_kernel() {
+    return &render_row;
+}
+
+batch_kernel zap::noise_kernels::sse2_batch_kernel() {
+    return &evaluate_batch;
+}
+
+int zap::noise_kernels::host_width() {
+    return zap::host_simd_width();
+}
+
+row_kernel zap::noise_kernels::select_kernel(int width) {
+    const int w = width < host_width() ? width : host_width();
+    return w >= 16 ? avx512_kernel() : w >= 8 ? avx2_kernel() : sse2_kernel();
+}
+
+batch_kernel zap::noise_kernels::select_batch_kernel(int width) {
+    const int w = width < host_width() ? width : host_width();
+    return w >= 16 ? avx512_batch_kernel() : w >= 8 ? avx2_batch_kernel() : sse2_batch_kernel();
+}
@@ -9,6 +9,7 @@
 #include <maths/maths.hpp>
 
 namespace zap { namespace generators {
+    // See convolution_engine.hpp for in-place, cache-blocked and parallel filtering of pixmaps
     template <typename PixelT>
     struct convolution {
         static std::vector<PixelT> boxblur_vert(size_t width, size_t height, size_t radius, std::vector<PixelT>& image) {
@@ -0,0 +1,274 @@
+/* Created by Darren Otgaar on 2018/06/19. http://www.github.com/otgaard/zap */
+#include "convolution_engine.hpp"
+#include <tools/log.hpp>
+
+using namespace zap;
+using namespace zap::generators;
+
+constexpr int convolution_engine::block_rows;
+
+namespace {
+    inline int clamp_idx(int i, int n) { return i < 0 ? 0 : (i >= n ? n - 1 : i); }
+
+    // The filters run along x over a block of width columns, each a vector of len floats (the rows of the block)
+
+    void box_pass(const float* in, float* out, int width, int len, int radius, float* acc) {
+        const float inv = 1.f/float(2*radius + 1);
+        for(int v = 0; v != len; ++v) acc[v] = float(radius + 1)*in[v];
+        for(int j = 1; j <= radius; ++j) {
+            const float* s = in + size_t(clamp_idx(j, width))*len;
+            for(int v = 0; v != len; ++v) acc[v] += s[v];
+        }
+
+        for(int x = 0; x != width; ++x) {
+            float* o = out + size_t(x)*len;
+            const float* add = in + size_t(clamp_idx(x + radius + 1, width))*len;
+            const float* sub = in + size_t(clamp_idx(x - radius, width))*len;
+            for(int v = 0; v != len; ++v) {
+                o[v] = acc[v]*inv;
+                acc[v] += add[v] - sub[v];
+            }
+        }
+    }
+
+    void kernel_pass(const float* in, float* out, int width, int len, const float* weights, int size) {
+        const int k = size/2;
+        for(int x = 0; x != width; ++x) {
+            float* o = out + size_t(x)*len;
+            for(int v = 0; v != len; ++v) o[v] = 0.f;
+            for(int j = 0; j != size; ++j) {
+                const float w = weights[j];
+                const float* s = in + size_t(clamp_idx(x + j - k, width))*len;
+                for(int v = 0; v != len; ++v) o[v] += w*s[v];
+            }
+        }
+    }
+
+    // Transposes rows [y, y + rows) of the image into the block, column-major, or back to the image if !to_block
+    template <int C>
+    void transpose_block(float* image, float* block, int width, int channels, int y, int rows, bool to_block) {
+        const int ch_count = C ? C : channels, len = rows*ch_count;
+        for(int r = 0; r != rows; ++r) {
+            float* p = image + size_t(y + r)*width*ch_count;
+            float* b = block + r*ch_count;
+            for(int x = 0; x != width; ++x, p += ch_count, b += len) {
+                if(to_block) for(int ch = 0; ch != ch_count; ++ch) b[ch] = p[ch];
+                else         for(int ch = 0; ch != ch_count; ++ch) p[ch] = b[ch];
+            }
+        }
+    }
+
+    void transpose_block(float* image, float* block, int width, int channels, int y, int rows, bool to_block) {
+        switch(channels) {
+            case 1: transpose_block<1>(image, block, width, channels, y, rows, to_block); break;
+            case 2: transpose_block<2>(image, block, width, channels, y, rows, to_block); break;
+            case 3: transpose_block<3>(image, block, width, channels, y, rows, to_block); break;
+            case 4: transpose_block<4>(image, block, width, channels, y, rows, to_block); break;
+            default: transpose_block<0>(image, block, width, channels, y, rows, to_block); break;
+        }
+    }
+
+    // The column filters run down a strip of len floats per row, with stride floats between rows.  Rows that have been
+    // overwritten but are still needed are read from ring, which holds the last ring_rows original rows.
+
+    void box_columns(float* strip, size_t stride, int height, int len, int radius, float* ring, float* acc) {
+        const float inv = 1.f/float(2*radius + 1);
+        const int ring_rows = radius + 1;
+        auto row = [=](int y) { return strip + stride*size_t(y); };
+
+        for(int v = 0; v != len; ++v) acc[v] = float(radius + 1)*strip[v];
+        for(int j = 1; j <= radius; ++j) {
+            const float* s = row(clamp_idx(j, height));
+            for(int v = 0; v != len; ++v) acc[v] += s[v];
+        }
+
+        for(int y = 0; y != height; ++y) {
+            float* o = row(y);
+            std::copy(o, o + len, ring + size_t(y % ring_rows)*len);
+            const int a = clamp_idx(y + radius + 1, height);
+            const float* add = a > y ? row(a) : ring + size_t(a % ring_rows)*len;
+            const float* sub = ring + size_t(std::max(y - radius, 0) % ring_rows)*len;
+            for(int v = 0; v != len; ++v) {
+                o[v] = acc[v]*inv;
+                acc[v] += add[v] - sub[v];
+            }
+        }
+    }
+
+    void kernel_columns(float* strip, size_t stride, int height, int len, const float* weights, int size, float* ring,
+                        float* acc) {
+        const int k = size/2, ring_rows = k + 1;
+        for(int y = 0; y != height; ++y) {
+            float* o = strip + stride*size_t(y);
+            std::copy(o, o + len, ring + size_t(y % ring_rows)*len);
+            for(int v = 0; v != len; ++v) acc[v] = 0.f;
+            for(int j = 0; j != size; ++j) {
+                const int sy = clamp_idx(y + j - k, height);
+                const float* s = sy > y ? strip + stride*size_t(sy) : ring + size_t(sy % ring_rows)*len;
+                const float w = weights[j];
+                for(int v = 0; v != len; ++v) acc[v] += w*s[v];
+            }
+            std::copy(acc, acc + len, o);
+        }
+    }
+}
+
+void convolution_engine::release() {
+    image_ = std::vector<float>();
+    output_ = std::vector<float>();
+    arena_ = std::vector<float>();
+    slot_stride_ = 0;
+}
+
+void convolution_engine::box_blur(float* image, int width, int height, int channels, int radius, int passes) {
+    if(radius < 1 || passes < 1) return;
+    std::vector<filter> filters(size_t(passes), filter{radius, nullptr, 0});
+    run_separable(image, width, height, channels, filters, filters);
+}
+
+void convolution_engine::gaussian_blur(float* image, int width, int height, int channels, float sigma, int passes) {
+    if(sigma <= 0.f || passes < 1) return;
+    std::vector<filter> filters;
+    for(auto box : gaussian_boxes(sigma, passes)) {
+        if(box > 1) filters.push_back(filter{(box - 1)/2, nullptr, 0});
+    }
+    if(!filters.empty()) run_separable(image, width, height, channels, filters, filters);
+}
+
+void convolution_engine::separable(float* image, int width, int height, int channels, const std::vector<float>& kernel_x,
+                                   const std::vector<float>& kernel_y) {
+    std::vector<filter> horz, vert;
+    if(!kernel_x.empty()) horz.push_back(filter{0, kernel_x.data(), int(kernel_x.size())});
+    if(!kernel_y.empty()) vert.push_back(filter{0, kernel_y.data(), int(kernel_y.size())});
+    if(!horz.empty() || !vert.empty()) run_separable(image, width, height, channels, horz, vert);
+}
+
+void convolution_engine::convolve(float* image, int width, int height, int channels, const std::vector<float>& kernel,
+                                  int kernel_width, int kernel_height) {
+    if(kernel_width < 1 || kernel_height < 1 || kernel.size() < size_t(kernel_width)*size_t(kernel_height)) {
+        LOG_ERR("convolution_engine::convolve: the kernel must have kernel_width * kernel_height weights");
+        return;
+    }
+    if(width < 1 || height < 1 || channels < 1) return;
+
+    const size_t row_length = size_t(width)*channels;
+    output_.resize(row_length*height);
+    float* out = output_.data();
+    const int cx = kernel_width/2, cy = kernel_height/2;
+
+    // Each kernel column adds a shifted source row, clamped at the ends, to the output row
+    parallel_for(height, 8, [=, &kernel](int first, int last) {
+        for(int y = first; y != last; ++y) {
+            float* o = out + row_length*y;
+            std::fill(o, o + row_length, 0.f);
+            for(int ky = 0; ky != kernel_height; ++ky) {
+                const float* s = image + row_length*clamp_idx(y + ky - cy, height);
+                for(int kx = 0; kx != kernel_width; ++kx) {
+                    const float w = kernel[ky*kernel_width + kx];
+                    if(w == 0.f) continue;
+
+                    const int dx = kx - cx;
+                    const int x0 = std::min(std::max(-dx, 0), width), x1 = std::max(std::min(width - dx, width), x0);
+                    auto edge = [=](int x) {
+                        const float* p = s + size_t(clamp_idx(x + dx, width))*channels;
+                        for(int ch = 0; ch != channels; ++ch) o[x*channels + ch] += w*p[ch];
+                    };
+                    for(int x = 0; x != x0; ++x) edge(x);
+                    const int shift = dx*channels;
+                    for(int i = x0*channels, end = x1*channels; i != end; ++i) o[i] += w*s[i + shift];
+                    for(int x = x1; x != width; ++x) edge(x);
+                }
+            }
+        }
+    });
+
+    parallel_for(height, 64, [=](int first, int last) {
+        std::copy(out + row_length*first, out + row_length*last, image + row_length*first);
+    });
+}
+
+std::vector<int> convolution_engine::gaussian_boxes(float sigma, int passes) {
+    std::vector<int> boxes(size_t(std::max(passes, 1)));
+    const float n = float(boxes.size()), var12 = 12.f*sigma*sigma;
+
+    // The widths wl and wu = wl + 2 are mixed so that the variance of the passes sums to sigma^2
+    int wl = int(std::floor(std::sqrt(var12/n + 1.f)));
+    if(wl % 2 == 0) --wl;
+    wl = std::max(wl, 1);
+    const int wu = wl + 2;
+    const int m = int(std::round((var12 - n*wl*wl - 4.f*n*wl - 3.f*n)/(-4.f*wl - 4.f)));
+    for(size_t i = 0; i != boxes.size(); ++i) boxes[i] = int(i) < m ? wl : wu;
+    return boxes;
+}
+
+void convolution_engine::run_separable(float* image, int width, int height, int channels,
+                                       const std::vector<filter>& horz, const std::vector<filter>& vert) {
+    if(width < 1 || height < 1 || channels < 1) return;
+
+    // The row pass needs two blocks (the filters ping-pong between them) and the running sums of the box filter, the
+    // column pass needs the ring of original rows and the running sums (or kernel sums) of the strip
+    int ring_rows = 1;
+    for(const auto& f : vert) ring_rows = std::max(ring_rows, (f.weights ? f.size/2 : f.radius) + 1);
+    const size_t row_scratch = 2*size_t(width)*block_rows*channels + size_t(block_rows)*channels;
+    const size_t column_scratch = size_t(ring_rows + 1)*strip_width*channels;
+    slot_stride_ = std::max(row_scratch, column_scratch);
+    arena_.resize(slot_stride_*slot_count());
+
+    if(!horz.empty()) filter_rows(image, width, height, channels, horz);
+    if(!vert.empty()) filter_columns(image, width, height, channels, vert);
+}
+
+void convolution_engine::filter_rows(float* image, int width, int height, int channels,
+                                     const std::vector<filter>& filters) {
+    const int slots = slot_count();
+    const size_t block = size_t(width)*block_rows*channels;
+
+    // Each slot filters a contiguous band of rows, block_rows at a time
+    parallel_for(slots, 1, [=, &filters](int first, int last) {
+        for(int slot = first; slot != last; ++slot) {
+            float* A = arena_.data() + slot_stride_*slot;
+            float* B = A + block;
+            float* acc = B + block;
+            const int r0 = int(int64_t(height)*slot/slots), r1 = int(int64_t(height)*(slot + 1)/slots);
+
+            for(int y = r0; y < r1; y += block_rows) {
+                const int rows = std::min(int(block_rows), r1 - y), len = rows*channels;
+                transpose_block(image, A, width, channels, y, rows, true);
+
+                float* in = A;
+                float* out = B;
+                for(const auto& f : filters) {
+                    if(f.weights) kernel_pass(in, out, width, len, f.weights, f.size);
+                    else          box_pass(in, out, width, len, f.radius, acc);
+                    std::swap(in, out);
+                }
+
+                transpose_block(image, in, width, channels, y, rows, false);
+            }
+        }
+    });
+}
+
+void convolution_engine::filter_columns(float* image, int width, int height, int channels,
+                                        const std::vector<filter>& filters) {
+    const int slots = slot_count(), strips = (width + strip_width - 1)/strip_width;
+    const size_t stride = size_t(width)*channels;
+
+    // Each slot filters a contiguous range of strips, top to bottom, once per filter
+    parallel_for(slots, 1, [=, &filters](int first, int last) {
+        for(int slot = first; slot != last; ++slot) {
+            float* acc = arena_.data() + slot_stride_*slot;
+            float* ring = acc + size_t(strip_width)*channels;
+            const int s0 = int(int64_t(strips)*slot/slots), s1 = int(int64_t(strips)*(slot + 1)/slots);
+
+            for(int s = s0; s != s1; ++s) {
+                const int x = s*strip_width, len = (std::min(x + strip_width, width) - x)*channels;
+                float* strip = image + size_t(x)*channels;
+                for(const auto& f : filters) {
+                    if(f.weights) kernel_columns(strip, stride, height, len, f.weights, f.size, ring, acc);
+                    else          box_columns(strip, stride, height, len, f.radius, ring, acc);
+                }
+            }
+        }
+    });
+}
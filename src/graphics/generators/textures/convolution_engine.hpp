@@ -0,0 +1,157 @@
+/* Created by Darren Otgaar on 2018/06/19. http://www.github.com/otgaard/zap */
+#ifndef ZAP_CONVOLUTION_ENGINE_HPP
+#define ZAP_CONVOLUTION_ENGINE_HPP
+
+/* A cache-blocked convolution engine for pixmaps.  The image is filtered as interleaved floats (float pixmaps in place,
+ * others through a retained float copy) and the result is written back to the pixmap.
+ *
+ * Separable filters run as a row pass and a column pass, each applying any number of box or kernel filters (the Gaussian
+ * is approximated by repeated box filters).  The row pass transposes blocks of block_rows rows into column-major scratch,
+ * so the filters run along x over contiguous vectors of block_rows*channels floats, and transposes them back in place.
+ * The column pass sweeps down strips of strip_width columns, with the filters running across the strip and the rows
+ * still needed by the filter kept in a ring in the scratch.  Every inner loop is over contiguous floats, which the
+ * compiler vectorises.
+ *
+ * Pixels outside the image are clamped to the edge.  The row blocks and column strips are distributed over the scheduler,
+ * if given, and the scratch buffers are retained between calls.
+ */
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <type_traits>
+#include <engine/pixmap.hpp>
+#include <tools/scheduler.hpp>
+
+namespace zap { namespace generators {
+
+class convolution_engine {
+public:
+    constexpr static int block_rows = 8;
+    constexpr static int strip_width = 256;
+
+    explicit convolution_engine(scheduler* pool=nullptr) : pool_(pool) { }
+
+    void set_scheduler(scheduler* pool) { pool_ = pool; }
+    // Frees the scratch buffers
+    void release();
+
+    template <typename PixelT>
+    void box_blur(engine::pixmap<PixelT>& img, int radius, int passes=1) {
+        apply(img, [this, radius, passes](float* image, int width, int height, int channels) {
+            box_blur(image, width, height, channels, radius, passes);
+        });
+    }
+
+    // Approximates the Gaussian of standard deviation sigma with passes box filters
+    template <typename PixelT>
+    void gaussian_blur(engine::pixmap<PixelT>& img, float sigma, int passes=3) {
+        apply(img, [this, sigma, passes](float* image, int width, int height, int channels) {
+            gaussian_blur(image, width, height, channels, sigma, passes);
+        });
+    }
+
+    // Applies kernel_x along the rows and kernel_y along the columns, centred on size/2, an empty kernel is skipped
+    template <typename PixelT>
+    void separable(engine::pixmap<PixelT>& img, const std::vector<float>& kernel_x, const std::vector<float>& kernel_y) {
+        apply(img, [this, &kernel_x, &kernel_y](float* image, int width, int height, int channels) {
+            separable(image, width, height, channels, kernel_x, kernel_y);
+        });
+    }
+
+    // Applies the kernel_width x kernel_height kernel (row-major, centred on the size/2 element in each dimension)
+    template <typename PixelT>
+    void convolve(engine::pixmap<PixelT>& img, const std::vector<float>& kernel, int kernel_width, int kernel_height) {
+        apply(img, [this, &kernel, kernel_width, kernel_height](float* image, int width, int height, int channels) {
+            convolve(image, width, height, channels, kernel, kernel_width, kernel_height);
+        });
+    }
+
+    // The above on width x height pixels of channels interleaved floats, filtered in place
+    void box_blur(float* image, int width, int height, int channels, int radius, int passes=1);
+    void gaussian_blur(float* image, int width, int height, int channels, float sigma, int passes=3);
+    void separable(float* image, int width, int height, int channels, const std::vector<float>& kernel_x,
+                   const std::vector<float>& kernel_y);
+    void convolve(float* image, int width, int height, int channels, const std::vector<float>& kernel,
+                  int kernel_width, int kernel_height);
+
+    // The (odd) widths of passes box filters approximating a Gaussian of standard deviation sigma
+    static std::vector<int> gaussian_boxes(float sigma, int passes);
+
+protected:
+    // A box filter of radius if weights is null, otherwise the kernel of size weights centred on size/2
+    struct filter {
+        int radius;
+        const float* weights;
+        int size;
+    };
+
+    void run_separable(float* image, int width, int height, int channels, const std::vector<filter>& horz,
+                       const std::vector<filter>& vert);
+    void filter_rows(float* image, int width, int height, int channels, const std::vector<filter>& filters);
+    void filter_columns(float* image, int width, int height, int channels, const std::vector<filter>& filters);
+    int slot_count() const { return pool_ ? int(pool_->size()) + 1 : 1; }
+
+    template <typename Fnc>
+    void parallel_for(int count, int grain, Fnc&& fnc) {
+        if(pool_) pool_->parallel_for(0, count, grain, std::forward<Fnc>(fnc));
+        else      fnc(0, count);
+    }
+
+    template <typename PixelT, typename Fnc>
+    void apply(engine::pixmap<PixelT>& img, Fnc&& fnc);
+
+    scheduler* pool_;
+    std::vector<float> image_;                  // The float copy of non-float pixmaps
+    std::vector<float> output_;                 // The output of convolve(), copied back once complete
+    std::vector<float> arena_;                  // The scratch of each slot (a thread's share of a pass)
+    size_t slot_stride_ = 0;
+};
+
+template <typename PixelT, typename Fnc>
+void convolution_engine::apply(engine::pixmap<PixelT>& img, Fnc&& fnc) {
+    using type = typename PixelT::type;
+    constexpr int channels = int(PixelT::size);
+    static_assert(std::is_arithmetic<type>::value, "convolution_engine requires arithmetic channels");
+
+    const int width = img.width(), height = img.height();
+    if(width < 1 || height < 1) return;
+
+    // Packed float pixmaps are filtered in place, padded rows are copied out like any other format
+    if(std::is_same<type, float>::value && sizeof(PixelT) == channels*sizeof(float) && img.is_packed()) {
+        fnc(reinterpret_cast<float*>(img.data()), width, height, channels);
+        return;
+    }
+
+    const size_t row_length = size_t(width)*channels;
+    image_.resize(row_length*height);
+    parallel_for(height, 32, [this, &img, width, row_length](int first, int last) {
+        for(int r = first; r != last; ++r) {
+            const PixelT* src = img.data(0, r);
+            float* trg = image_.data() + row_length*r;
+            for(int c = 0; c != width; ++c) {
+                for(int ch = 0; ch != channels; ++ch) *trg++ = float(src[c].get(ch));
+            }
+        }
+    });
+
+    fnc(image_.data(), width, height, channels);
+
+    parallel_for(height, 32, [this, &img, width, row_length](int first, int last) {
+        const float lo = float(std::numeric_limits<type>::lowest()), hi = float(std::numeric_limits<type>::max());
+        for(int r = first; r != last; ++r) {
+            PixelT* trg = img.data(0, r);
+            const float* src = image_.data() + row_length*r;
+            for(int c = 0; c != width; ++c) {
+                for(int ch = 0; ch != channels; ++ch, ++src) {
+                    const float v = std::is_integral<type>::value ? std::floor(*src + .5f) : *src;
+                    trg[c].set(ch, type(v < lo ? lo : (v > hi ? hi : v)));
+                }
+            }
+        }
+    });
+}
+
+}}
+
+#endif //ZAP_CONVOLUTION_ENGINE_HPP
@@ -5,68 +5,116 @@
 #ifndef ZAP_SPECTRAL_HPP
 #define ZAP_SPECTRAL_HPP
 
+#include <cmath>
+#include <limits>
 #include <vector>
 #include <maths/maths.hpp>
+#include <engine/pixmap.hpp>
+#include <tools/scheduler.hpp>
 
 // Provides spectral synthesis tools for generating textures on the CPU.
 
 namespace zap { namespace generators {
     template <typename Pixel>
     struct spectral {
-        static std::vector<Pixel> make_clouds(int terms, float scale, size_t width, size_t height) {
-            float i, amplitude, f;
-            float x, fx, xfreq, xphase;
-            float y, fy, yfreq, yphase;
+        /* Gardner's clouds: each term adds a wave along x, with a phase that depends on y, and a wave along y, with a
+         * phase that depends on x.  A wave of the form cos(a + b), with a depending on the column and b on the row, is
+         * expanded to cos(a)cos(b) - sin(a)sin(b), so the cosines are evaluated once per column and once per row into
+         * tables and each pixel is a sum of products over the terms, vectorised along the row.  The rows are spread over
+         * the scheduler if given.
+         */
+        static void make_clouds(engine::pixmap<Pixel>& image, int terms, float scale, scheduler* pool=nullptr) {
+            const int width = image.width(), height = image.height();
+            if(width < 1 || height < 1) return;
+
             const float offset = 0.5;
             const float xoffset = 13;
             const float yoffset = 96;
 
-            std::vector<float> sample(width*height);
-            std::vector<Pixel> image(width*height);
-
             const float dx = scale/width;
             const float dy = scale/height;
 
-            constexpr float TWO_PI = 2.f*float(zap::maths::PI);
-            constexpr float HALF_PI = .5f*float(zap::maths::PI);
-            constexpr float xfreq_origin = TWO_PI * .023f;
-            constexpr float yfreq_origin = TWO_PI * .021f;
-
-            for(size_t row = 0; row != height; ++row) {
-                y = scale * (row * dy + yoffset);
-                for(size_t col = 0; col != width; ++col) {
-                    x = scale * (col * dx + xoffset);
-
-                    xphase = .9f; yphase = .7f;
-                    xfreq = xfreq_origin; yfreq = yfreq_origin;
-                    amplitude = .3f;
-                    f = 0;
-
-                    for(i = 0; i < terms; ++i) {
-                        fx = wave_fnc<float, decltype(std::cosf)>(std::cosf, x, xfreq, amplitude, xphase, offset);
-                        fy = wave_fnc<float, decltype(std::cosf)>(std::cosf, y, yfreq, amplitude, yphase, offset);
-                        f += fx + fy;
-                        xphase = HALF_PI*.9f * std::cos(yfreq * y);
-                        yphase = HALF_PI*1.1f * std::cos(xfreq * x);
-
-                        xfreq *= 1.9f + .1f*i;
-                        yfreq *= 2.2f - .08f*i;
-                        amplitude *= .707f;
-                    }
-
-                    sample[row*width + col] = zap::maths::clamp(f);
+            const float TWO_PI = zap::maths::TWO_PI<float>;
+            const double HALF_PI = zap::maths::HALF_PI<double>;
+
+            // The frequencies and amplitude of each term, the constant part of the sum is accumulated in bias
+            std::vector<float> xfreq(terms), yfreq(terms), amplitude(terms);
+            float bias = 0.f;
+            {
+                float xf = TWO_PI * .023f, yf = TWO_PI * .021f, amp = .3f;
+                for(int i = 0; i < terms; ++i) {
+                    xfreq[i] = xf; yfreq[i] = yf; amplitude[i] = amp;
+                    bias += 2.f*amp*offset;
+                    xf *= 1.9f + .1f*i;
+                    yf *= 2.2f - .08f*i;
+                    amp *= .707f;
                 }
             }
 
-            // Convert to target pixel
-            const typename Pixel::type type_max = std::numeric_limits<typename Pixel::type>::max();
-            //const float type_scale = 1.f / type_max;
-            for(size_t idx = 0; idx != image.size(); ++idx) {
-                auto val = typename Pixel::type(type_max*sample[idx]);
-                for(int j = 0; j < Pixel::data_t::size; ++j) image[idx].set(j, val);
+            // Per term, the columns hold amplitude*[cos(a), sin(a), cos(d), sin(d)] for the x wave cos(a + b) and the
+            // y wave cos(c + d), and the rows [cos(b), sin(b), cos(c), sin(c)]
+            std::vector<float> columns(size_t(terms)*4*width), rows(size_t(terms)*4*height);
+            for(int col = 0; col != width; ++col) {
+                const double x = scale * (col * dx + xoffset);
+                for(int i = 0; i < terms; ++i) {
+                    const double yphase = i == 0 ? .7 : HALF_PI*1.1*std::cos(double(xfreq[i-1])*x);
+                    const double a = xfreq[i]*x, d = yfreq[i]*yphase;
+                    float* table = columns.data() + size_t(i)*4*width;
+                    table[col]           = float(amplitude[i]*std::cos(a));
+                    table[width + col]   = float(amplitude[i]*std::sin(a));
+                    table[2*width + col] = float(amplitude[i]*std::cos(d));
+                    table[3*width + col] = float(amplitude[i]*std::sin(d));
+                }
+            }
+            for(int row = 0; row != height; ++row) {
+                const double y = scale * (row * dy + yoffset);
+                for(int i = 0; i < terms; ++i) {
+                    const double xphase = i == 0 ? .9 : HALF_PI*.9*std::cos(double(yfreq[i-1])*y);
+                    const double b = xfreq[i]*xphase, c = yfreq[i]*y;
+                    float* table = rows.data() + (size_t(row)*terms + i)*4;
+                    table[0] = float(std::cos(b));
+                    table[1] = float(std::sin(b));
+                    table[2] = float(std::cos(c));
+                    table[3] = float(std::sin(c));
+                }
             }
 
-            return image;
+            auto fnc = [&image, &columns, &rows, terms, width, bias](int first, int last) {
+                using type = typename Pixel::type;
+                const type type_max = std::numeric_limits<type>::max();
+                std::vector<float> sample(width);
+                for(int row = first; row != last; ++row) {
+                    float* s = sample.data();
+                    for(int col = 0; col != width; ++col) s[col] = bias;
+
+                    const float* row_table = rows.data() + size_t(row)*terms*4;
+                    for(int i = 0; i < terms; ++i, row_table += 4) {
+                        const float* cos_a = columns.data() + size_t(i)*4*width, * sin_a = cos_a + width;
+                        const float* cos_d = sin_a + width, * sin_d = cos_d + width;
+                        const float cos_b = row_table[0], sin_b = row_table[1], cos_c = row_table[2], sin_c = row_table[3];
+                        for(int col = 0; col != width; ++col) {
+                            s[col] += cos_a[col]*cos_b - sin_a[col]*sin_b + cos_c*cos_d[col] - sin_c*sin_d[col];
+                        }
+                    }
+
+                    // Convert to target pixel
+                    Pixel* trg = image.data(0, row);
+                    for(int col = 0; col != width; ++col) {
+                        auto val = type(type_max*zap::maths::clamp(s[col]));
+                        for(size_t j = 0; j != Pixel::data_t::size; ++j) trg[col].set(j, val);
+                    }
+                }
+            };
+
+            if(pool) pool->parallel_for(0, height, 16, fnc);
+            else     fnc(0, height);
+        }
+
+        static std::vector<Pixel> make_clouds(int terms, float scale, size_t width, size_t height,
+                                              scheduler* pool=nullptr) {
+            engine::pixmap<Pixel> image{int(width), int(height)};
+            make_clouds(image, terms, scale, pool);
+            return std::vector<Pixel>(image.begin(), image.end());
         }
 
         template <typename T, typename FNC>
@@ -0,0 +1,86 @@
+/* Created by Darren Otgaar on 2018/06/15. http://www.github.com/otgaard/zap */
+#include "mesh_cache.hpp"
+#include <cstring>
+#include <ostream>
+
+using namespace zap;
+using namespace zap::maths;
+using namespace zap::graphics;
+
+static_assert(sizeof(mesh_cache::header) <= mesh_cache::data_offset, "mesh_cache::header exceeds the data offset");
+
+bool mesh_cache::write(const std::string& source, const std::vector<vtx_p3n3t2_t>& vertices,
+                       const std::vector<uint32_t>& indices) {
+    file_info info;
+    if(!get_file_info(source, info)) {
+        LOG_ERR("mesh_cache: source file not found:", source);
+        return false;
+    }
+
+    char block[data_offset];
+    std::memset(block, 0, sizeof(block));
+    header hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = magic;
+    hdr.version = version;
+    hdr.vertex_size = uint32_t(sizeof(vtx_p3n3t2_t));
+    hdr.vertex_count = vertices.size();
+    hdr.index_count = indices.size();
+    hdr.source_size = info.size;
+    hdr.source_mtime = info.mtime;
+
+    if(!vertices.empty()) {
+        vec3f min = vertices[0].position, max = vertices[0].position;
+        for(const auto& vtx : vertices) {
+            for(int i = 0; i != 3; ++i) {
+                min[i] = std::min(min[i], vtx.position[i]);
+                max[i] = std::max(max[i], vtx.position[i]);
+            }
+        }
+        for(int i = 0; i != 3; ++i) {
+            hdr.bounds_min[i] = min[i];
+            hdr.bounds_max[i] = max[i];
+        }
+    }
+    std::memcpy(block, &hdr, sizeof(hdr));
+
+    const std::string path = cache_path(source);
+    const bool written = write_file_atomic(path, [&block, &vertices, &indices](std::ostream& file) {
+        file.write(block, sizeof(block));
+        file.write(reinterpret_cast<const char*>(vertices.data()), std::streamsize(vertices.size()*sizeof(vtx_p3n3t2_t)));
+        file.write(reinterpret_cast<const char*>(indices.data()), std::streamsize(indices.size()*sizeof(uint32_t)));
+    });
+    if(!written) {
+        LOG_ERR("mesh_cache: failed to write", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool mesh_cache::open(const std::string& source) {
+    close();
+
+    file_info info;
+    if(!get_file_info(source, info) || !file_.open(cache_path(source))) return false;
+
+    const auto* hdr = reinterpret_cast<const header*>(file_.data());
+    const bool valid = file_.size() >= data_offset && hdr->magic == magic && hdr->version == version &&
+                       hdr->vertex_size == sizeof(vtx_p3n3t2_t) && hdr->source_size == info.size &&
+                       hdr->source_mtime == info.mtime &&
+                       file_.size() == data_offset + hdr->vertex_count*sizeof(vtx_p3n3t2_t) +
+                                       hdr->index_count*sizeof(uint32_t);
+    if(!valid) {
+        file_.close();
+        return false;
+    }
+
+    hdr_ = hdr;
+    return true;
+}
+
+geometry::AABB3f mesh_cache::bounds() const {
+    const vec3f min{hdr_->bounds_min[0], hdr_->bounds_min[1], hdr_->bounds_min[2]};
+    const vec3f max{hdr_->bounds_max[0], hdr_->bounds_max[1], hdr_->bounds_max[2]};
+    return geometry::AABB3f{.5f*(min + max), .5f*(max - min)};
+}
@@ -0,0 +1,69 @@
+/* Created by Darren Otgaar on 2018/06/15. http://www.github.com/otgaard/zap */
+#ifndef ZAP_MESH_CACHE_HPP
+#define ZAP_MESH_CACHE_HPP
+
+/* A binary cache for meshes loaded from text formats.  The file is a fixed header followed by the interleaved
+ * vtx_p3n3t2_t vertices and the uint32_t indices, so that a cached mesh is memory mapped and uploaded straight from the
+ * mapping.  The header records the size and modification time of the source file; a cache that is stale, truncated or
+ * written by another version (or vertex layout) fails to open and is rebuilt by the loader.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <tools/os.hpp>
+#include <maths/geometry/AABB.hpp>
+#include "graphics/graphics3/g3_types.hpp"
+
+namespace zap { namespace graphics {
+
+class mesh_cache {
+public:
+    constexpr static uint32_t magic = 0x4D42415A;       // "ZABM"
+    constexpr static uint32_t version = 1;
+
+    struct header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertex_size;                           // sizeof(vtx_p3n3t2_t), guards against layout changes
+        uint32_t reserved;
+        uint64_t vertex_count;
+        uint64_t index_count;
+        uint64_t source_size;
+        int64_t source_mtime;
+        float bounds_min[3];
+        float bounds_max[3];
+    };
+
+    // The vertex block starts here (leaving room for the header to grow), the index block follows it
+    constexpr static size_t data_offset = 128;
+
+    mesh_cache() = default;
+
+    static std::string cache_path(const std::string& source) { return source + ".zbm"; }
+
+    // Writes the cache for source to cache_path(source)
+    static bool write(const std::string& source, const std::vector<vtx_p3n3t2_t>& vertices,
+                      const std::vector<uint32_t>& indices);
+
+    // Maps the cache of source, fails if there is no valid, current cache
+    bool open(const std::string& source);
+    void close() { file_.close(); hdr_ = nullptr; }
+    bool is_open() const { return hdr_ != nullptr; }
+
+    size_t vertex_count() const { return size_t(hdr_->vertex_count); }
+    size_t index_count() const { return size_t(hdr_->index_count); }
+    const vtx_p3n3t2_t* vertices() const { return reinterpret_cast<const vtx_p3n3t2_t*>(file_.data() + data_offset); }
+    const uint32_t* indices() const {
+        return reinterpret_cast<const uint32_t*>(file_.data() + data_offset + vertex_count()*sizeof(vtx_p3n3t2_t));
+    }
+    maths::geometry::AABB3f bounds() const;
+
+private:
+    mapped_file file_;
+    const header* hdr_ = nullptr;
+};
+
+}}
+
+#endif //ZAP_MESH_CACHE_HPP
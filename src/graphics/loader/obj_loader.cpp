@@ -3,12 +3,395 @@
 //
 
 #include "obj_loader.hpp"
+#include "mesh_cache.hpp"
 #include <string>
 #include <fstream>
 #include <streambuf>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <tools/scheduler.hpp>
 
 namespace zap { namespace graphics {
 
+namespace {
+    // A face corner, indices are 0-based and -1 if absent
+    struct corner_t {
+        int32_t v, vt, vn;
+    };
+
+    // A parsed polygon and the number of elements declared before it in its chunk, so that its indices can be resolved
+    // once the chunks preceding it are known
+    struct polygon_t {
+        uint32_t count;
+        uint32_t positions, texcoords, normals;
+    };
+
+    struct obj_data {
+        std::vector<vec3f> positions;
+        std::vector<vec2f> texcoords;
+        std::vector<vec3f> normals;
+        std::vector<polygon_t> polygons;
+        std::vector<corner_t> raw;                      // The polygon corners as written, absent indices are 0
+        size_t skipped = 0;                             // Malformed lines
+    };
+
+    // The elements declared in the chunks before a chunk
+    struct chunk_base {
+        size_t positions, texcoords, normals;
+    };
+
+    const size_t chunk_size = 1 << 20;                  // Minimum bytes per chunk when parsing in parallel
+
+    inline bool is_space(char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; }
+    inline bool is_digit(char ch) { return unsigned(ch - '0') < 10u; }
+
+    inline const char* skip_space(const char* ptr, const char* end) {
+        while(ptr != end && is_space(*ptr)) ++ptr;
+        return ptr;
+    }
+
+    inline const char* next_line(const char* ptr, const char* end) {
+        while(ptr != end && *ptr != '\n') ++ptr;
+        return ptr != end ? ptr + 1 : end;
+    }
+
+    // Parses [+-]digits[.digits][(e|E)[+-]digits] without locale or allocation (std::from_chars is C++17)
+    bool parse_float(const char*& ptr, const char* end, float& value) {
+        static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                        1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+        const char* p = ptr;
+        bool neg = false;
+        if(p != end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+
+        uint64_t mantissa = 0;
+        int exponent = 0, digits = 0, significant = 0;
+        for(; p != end && is_digit(*p); ++p, ++digits) {
+            if(significant < 19) {
+                mantissa = mantissa*10 + uint64_t(*p - '0');
+                if(mantissa != 0) ++significant;
+            } else {
+                ++exponent;
+            }
+        }
+        if(p != end && *p == '.') {
+            for(++p; p != end && is_digit(*p); ++p, ++digits) {
+                if(significant < 19) {
+                    mantissa = mantissa*10 + uint64_t(*p - '0');
+                    if(mantissa != 0) ++significant;
+                    --exponent;
+                }
+            }
+        }
+        if(digits == 0) return false;
+
+        if(p != end && (*p == 'e' || *p == 'E')) {
+            const char* e = p + 1;
+            bool eneg = false;
+            if(e != end && (*e == '-' || *e == '+')) eneg = *e++ == '-';
+            if(e != end && is_digit(*e)) {
+                int exp = 0;
+                for(; e != end && is_digit(*e); ++e) exp = exp < 10000 ? exp*10 + (*e - '0') : exp;
+                exponent += eneg ? -exp : exp;
+                p = e;
+            }
+        }
+
+        double result = double(mantissa);
+        if(mantissa != 0) {
+            if(exponent >= -22 && exponent <= 22) result = exponent < 0 ? result/pow10[-exponent] : result*pow10[exponent];
+            else                                  result *= std::pow(10., exponent);
+        }
+
+        value = float(neg ? -result : result);
+        ptr = p;
+        return true;
+    }
+
+    bool parse_int(const char*& ptr, const char* end, int32_t& value) {
+        const char* p = ptr;
+        bool neg = false;
+        if(p != end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+        if(p == end || !is_digit(*p)) return false;
+
+        int64_t result = 0;
+        for(; p != end && is_digit(*p); ++p) result = result < INT32_MAX ? result*10 + (*p - '0') : result;
+        if(result > INT32_MAX) return false;
+
+        value = int32_t(neg ? -result : result);
+        ptr = p;
+        return true;
+    }
+
+    // Parses v, v/vt, v//vn or v/vt/vn, the indices are resolved later (see triangulate)
+    bool parse_corner(const char*& ptr, const char* end, corner_t& crn) {
+        crn.vt = crn.vn = 0;
+        if(!parse_int(ptr, end, crn.v) || crn.v == 0) return false;
+        if(ptr == end || *ptr != '/') return true;
+
+        ++ptr;
+        if(ptr != end && *ptr != '/') {
+            if(!parse_int(ptr, end, crn.vt) || crn.vt == 0) return false;
+        }
+        if(ptr == end || *ptr != '/') return true;
+
+        ++ptr;
+        return parse_int(ptr, end, crn.vn) && crn.vn != 0;
+    }
+
+    template <size_t N>
+    bool parse_floats(const char* ptr, const char* end, float (&arr)[N], size_t required) {
+        for(size_t i = 0; i != N; ++i) {
+            ptr = skip_space(ptr, end);
+            if(!parse_float(ptr, end, arr[i])) return i >= required;
+        }
+        return true;
+    }
+
+    void parse_obj(const char* begin, const char* end, obj_data& data) {
+        for(const char* line = begin; line != end; line = next_line(line, end)) {
+            const char* ptr = skip_space(line, end);
+            if(ptr == end || *ptr == '\n' || *ptr == '#') continue;
+
+            const char* eol = ptr;
+            while(eol != end && *eol != '\n') ++eol;
+
+            if(ptr[0] == 'v' && ptr + 1 != eol && is_space(ptr[1])) {
+                float arr[3];
+                if(parse_floats(ptr + 2, eol, arr, 3)) data.positions.emplace_back(arr[0], arr[1], arr[2]);
+                else                                   ++data.skipped;
+            } else if(ptr[0] == 'v' && ptr + 2 < eol && ptr[1] == 't' && is_space(ptr[2])) {
+                float arr[2] = { 0.f, 0.f };
+                if(parse_floats(ptr + 3, eol, arr, 1)) data.texcoords.emplace_back(arr[0], arr[1]);
+                else                                   ++data.skipped;
+            } else if(ptr[0] == 'v' && ptr + 2 < eol && ptr[1] == 'n' && is_space(ptr[2])) {
+                float arr[3];
+                if(parse_floats(ptr + 3, eol, arr, 3)) data.normals.emplace_back(arr[0], arr[1], arr[2]);
+                else                                   ++data.skipped;
+            } else if(ptr[0] == 'f' && ptr + 1 != eol && is_space(ptr[1])) {
+                const size_t first = data.raw.size();
+                bool valid = true;
+                for(ptr = skip_space(ptr + 1, eol); ptr != eol; ptr = skip_space(ptr, eol)) {
+                    corner_t crn;
+                    if(!parse_corner(ptr, eol, crn) || (ptr != eol && !is_space(*ptr))) {
+                        valid = false;
+                        break;
+                    }
+                    data.raw.push_back(crn);
+                }
+
+                const size_t count = data.raw.size() - first;
+                if(valid && count >= 3) {
+                    data.polygons.push_back(polygon_t{uint32_t(count), uint32_t(data.positions.size()),
+                                                      uint32_t(data.texcoords.size()), uint32_t(data.normals.size())});
+                } else {
+                    data.raw.resize(first);
+                    ++data.skipped;
+                }
+            }
+        }
+    }
+
+    // Resolves a 1-based (or negative, relative) OBJ index against the element count, returns -1 if out of range
+    inline int32_t resolve(int32_t idx, size_t count) {
+        const int64_t r = idx > 0 ? int64_t(idx) - 1 : int64_t(count) + idx;
+        return r >= 0 && r < int64_t(count) ? int32_t(r) : -1;
+    }
+
+    // Resolves the polygons of a chunk against the elements declared before it and fans them into triangles.  Polygons
+    // with an index out of range are skipped.
+    void triangulate(const obj_data& data, const chunk_base& base, std::vector<corner_t>& corners, size_t& skipped) {
+        std::vector<corner_t> poly;
+        const corner_t* raw = data.raw.data();
+        for(const auto& P : data.polygons) {
+            poly.resize(P.count);
+            bool valid = true;
+            for(uint32_t i = 0; i != P.count; ++i, ++raw) {
+                auto& crn = poly[i];
+                crn.v = resolve(raw->v, base.positions + P.positions);
+                crn.vt = raw->vt != 0 ? resolve(raw->vt, base.texcoords + P.texcoords) : -1;
+                crn.vn = raw->vn != 0 ? resolve(raw->vn, base.normals + P.normals) : -1;
+                valid &= crn.v != -1 && (raw->vt == 0 || crn.vt != -1) && (raw->vn == 0 || crn.vn != -1);
+            }
+
+            if(!valid) {
+                ++skipped;
+                continue;
+            }
+
+            // Fan the polygon around its first corner
+            for(uint32_t i = 2; i != P.count; ++i) {
+                corners.push_back(poly[0]);
+                corners.push_back(poly[i-1]);
+                corners.push_back(poly[i]);
+            }
+        }
+    }
+
+    // Maps each distinct (v, vt, vn) corner to one output vertex, in order of first use.  The table is sized from an
+    // estimate and doubles whenever it is more than half full, as there may be several corners per position.
+    class corner_map {
+    public:
+        explicit corner_map(size_t expected) {
+            size_t capacity = 16;
+            while(capacity < 2*expected) capacity *= 2;
+            slots_.assign(capacity, slot{{-1, -1, -1}, 0});
+            mask_ = capacity - 1;
+        }
+
+        // Returns the index of the corner and true if it was inserted
+        std::pair<uint32_t, bool> insert(const corner_t& crn, uint32_t next) {
+            auto& s = find(crn);
+            if(s.key.v != -1) return std::make_pair(s.value, false);
+
+            s.key = crn;
+            s.value = next;
+            if(2*++size_ > slots_.size()) grow();
+            return std::make_pair(next, true);
+        }
+
+    private:
+        struct slot {
+            corner_t key;
+            uint32_t value;
+        };
+
+        // The slot holding crn or the empty slot where it belongs
+        slot& find(const corner_t& crn) {
+            uint32_t h = uint32_t(crn.v)*0x8DA6B343u + uint32_t(crn.vt)*0xD8163841u + uint32_t(crn.vn)*0xCB1AB31Fu;
+            h ^= h >> 16;
+            for(size_t idx = h & mask_; ; idx = (idx + 1) & mask_) {
+                auto& s = slots_[idx];
+                if(s.key.v == -1 || (s.key.v == crn.v && s.key.vt == crn.vt && s.key.vn == crn.vn)) return s;
+            }
+        }
+
+        void grow() {
+            std::vector<slot> old(2*slots_.size(), slot{{-1, -1, -1}, 0});
+            old.swap(slots_);
+            mask_ = slots_.size() - 1;
+            for(const auto& s : old) {
+                if(s.key.v != -1) find(s.key) = s;
+            }
+        }
+
+        std::vector<slot> slots_;
+        size_t mask_ = 0;
+        size_t size_ = 0;
+    };
+
+    void build_model(const obj_data& data, const std::vector<corner_t>& corners, obj_loader::model_t& model) {
+        auto& vertices = model.first;
+        auto& indices = model.second;
+
+        bool has_tex = false, has_nor = true;
+        for(const auto& crn : corners) {
+            has_tex |= crn.vt != -1;
+            has_nor &= crn.vn != -1;
+        }
+        has_nor &= !corners.empty();
+
+        vtx_p3n3t2_t vtx;
+        vtx.normal.set(0.f, 0.f, 0.f);
+        vtx.texcoord1.set(0.f, 0.f);
+
+        indices.reserve(corners.size());
+        if(!has_tex && !has_nor) {
+            // Position only, the vertices are the positions and need no de-duplication
+            vertices.reserve(data.positions.size());
+            for(const auto& P : data.positions) {
+                vtx.position = P;
+                vertices.push_back(vtx);
+            }
+            for(const auto& crn : corners) indices.push_back(uint32_t(crn.v));
+        } else {
+            corner_map map(data.positions.size());
+            vertices.reserve(data.positions.size());
+            for(const auto& crn : corners) {
+                const auto r = map.insert(crn, uint32_t(vertices.size()));
+                if(r.second) {
+                    vtx.position = data.positions[crn.v];
+                    vtx.normal = crn.vn != -1 ? data.normals[crn.vn] : vec3f{0.f, 0.f, 0.f};
+                    vtx.texcoord1 = crn.vt != -1 ? data.texcoords[crn.vt] : vec2f{0.f, 0.f};
+                    vertices.push_back(vtx);
+                }
+                indices.push_back(r.first);
+            }
+        }
+
+        // Normals are only taken from the file if every corner specifies one
+        if(!has_nor) obj_loader::compute_normals(vertices, indices, true);
+    }
+
+    void reserve(obj_data& data, size_t bytes) {
+        // Estimate from the size to avoid most of the regrowth on large files
+        data.positions.reserve(bytes/64);
+        data.polygons.reserve(bytes/32);
+        data.raw.reserve(3*bytes/32);
+    }
+
+    template <typename T>
+    void append(std::vector<T>& trg, const std::vector<T>& src) { trg.insert(trg.end(), src.begin(), src.end()); }
+
+    // Splits [begin, end) into chunks at line boundaries, parses them in parallel and merges them in file order, so that
+    // the result is identical to parsing the text as one chunk
+    void parse_parallel(const char* begin, const char* end, scheduler* pool, obj_data& data,
+                        std::vector<corner_t>& corners) {
+        const size_t bytes = size_t(end - begin);
+        const size_t count = std::max<size_t>(std::min(bytes/chunk_size, 4*(pool->size() + 1)), 1);
+
+        std::vector<const char*> bounds(count + 1, end);
+        bounds[0] = begin;
+        for(size_t i = 1; i != count; ++i) {
+            const char* ptr = std::max(bounds[i-1], begin + i*(bytes/count));
+            bounds[i] = ptr != begin && ptr[-1] == '\n' ? ptr : next_line(ptr, end);
+        }
+
+        std::vector<obj_data> chunks(count);
+        pool->parallel_for(0, int(count), 1, [&chunks, &bounds](int first, int last) {
+            for(int i = first; i != last; ++i) {
+                reserve(chunks[i], size_t(bounds[i+1] - bounds[i]));
+                parse_obj(bounds[i], bounds[i+1], chunks[i]);
+            }
+        });
+
+        std::vector<chunk_base> bases(count);
+        chunk_base base = { 0, 0, 0 };
+        for(size_t i = 0; i != count; ++i) {
+            bases[i] = base;
+            base.positions += chunks[i].positions.size();
+            base.texcoords += chunks[i].texcoords.size();
+            base.normals += chunks[i].normals.size();
+        }
+
+        std::vector<std::vector<corner_t>> tris(count);
+        std::vector<size_t> skipped(count, 0);
+        pool->parallel_for(0, int(count), 1, [&chunks, &bases, &tris, &skipped](int first, int last) {
+            for(int i = first; i != last; ++i) {
+                tris[i].reserve(3*chunks[i].polygons.size());
+                triangulate(chunks[i], bases[i], tris[i], skipped[i]);
+            }
+        });
+
+        size_t total = 0;
+        for(const auto& t : tris) total += t.size();
+        data.positions.reserve(base.positions);
+        data.texcoords.reserve(base.texcoords);
+        data.normals.reserve(base.normals);
+        corners.reserve(total);
+        for(size_t i = 0; i != count; ++i) {
+            append(data.positions, chunks[i].positions);
+            append(data.texcoords, chunks[i].texcoords);
+            append(data.normals, chunks[i].normals);
+            append(corners, tris[i]);
+            data.skipped += chunks[i].skipped + skipped[i];
+            chunks[i] = obj_data{};                     // Release each chunk once merged
+            std::vector<corner_t>().swap(tris[i]);
+        }
+    }
+}
+
 std::string obj_loader::read_textfile(const std::string& path) {
     std::string str;
     std::ifstream file(path);
@@ -20,7 +403,7 @@ std::string obj_loader::read_textfile(const std::string& path) {
     return str;
 }
 
-obj_loader::mesh_p3n3t2_u32_t obj_loader::load_mesh(const std::string& path) {
+obj_loader::mesh_p3n3t2_u32_t obj_loader::load_mesh(const std::string& path, scheduler* pool, bool use_cache) {
     mesh_p3n3t2_u32_t mesh;
     auto vbuf = std::make_unique<vbuf_p3n3t2_t>();
     auto ibuf = std::make_unique<ibuf_u32_t>();
@@ -30,18 +413,26 @@ obj_loader::mesh_p3n3t2_u32_t obj_loader::load_mesh(const std::string& path) {
         return mesh;
     }
 
-    auto model = load_model(path);
+    // Upload a cached mesh straight from the mapping
+    mesh_cache cache;
+    model_t model;
+    if(!use_cache || !cache.open(path)) model = load_model(path, pool, use_cache);
+
+    const size_t vertex_count = cache.is_open() ? cache.vertex_count() : model.first.size();
+    const size_t index_count = cache.is_open() ? cache.index_count() : model.second.size();
+    const vtx_p3n3t2_t* vertices = cache.is_open() ? cache.vertices() : model.first.data();
+    const uint32_t* indices = cache.is_open() ? cache.indices() : model.second.data();
 
     mesh.bind();
 
     vbuf->bind();
-    if (!vbuf->initialise(model.first)) {
+    if (!vbuf->initialise(vertex_count, vertices)) {
         LOG_ERR("Failed to initialise vertices");
         return mesh;
     }
 
     ibuf->bind();
-    if (!ibuf->initialise(model.second)) {
+    if (!ibuf->initialise(index_count, reinterpret_cast<const char*>(indices))) {
         LOG_ERR("Failed to initialise faces");
         return mesh;
     }
@@ -52,46 +443,47 @@ obj_loader::mesh_p3n3t2_u32_t obj_loader::load_mesh(const std::string& path) {
     return mesh;
 }
 
-obj_loader::model_t obj_loader::load_model(const std::string& path) {
-    std::string file = read_textfile(path);
-    if(file.empty()) {
+obj_loader::model_t obj_loader::load_model(const std::string& path, scheduler* pool, bool use_cache) {
+    model_t model;
+
+    mesh_cache cache;
+    if(use_cache && cache.open(path)) {
+        model.first.assign(cache.vertices(), cache.vertices() + cache.vertex_count());
+        model.second.assign(cache.indices(), cache.indices() + cache.index_count());
+        return model;
+    }
+
+    mapped_file file(path);
+    if(!file.is_open()) {
         LOG_ERR("Failed to load file:", path);
-        return std::make_pair(std::vector<vtx_p3n3t2_t>(), std::vector<uint32_t>());
-    }
-
-    std::vector<vtx_p3n3t2_t> positions;
-    std::vector<uint32_t> faces;
-    positions.reserve(100000); faces.reserve(100000);
-
-    std::istringstream sstr(file);
-    std::string line;
-    while(std::getline(sstr, line)) {
-        if (line[0] == '#') continue;
-        else if (line[0] == 'v') {
-            // process vertex
-            std::istringstream parser(line);
-            char op;
-            float x, y, z;
-            parser >> op >> x >> y >> z;
-            vtx_p3n3t2_t vtx;
-            vtx.position.set(x, y, z);
-            vtx.normal.set(0.f, 0.f, 0.f);
-            positions.push_back(vtx);
-        } else if (line[0] == 'f') {
-            // process face
-            std::istringstream parser(line);
-            char op;
-            uint32_t i, j, k;
-            parser >> op >> i >> j >> k;
-            faces.push_back(i-1); faces.push_back(j-1); faces.push_back(k-1);
-        }
-    }
-
-    LOG("Vertices:", positions.size(), "Faces:", faces.size());
-
-    compute_normals(positions, faces, false);
-
-    return std::make_pair(positions, faces);
+        return model;
+    }
+
+    model = parse_model(file.begin(), file.end(), pool);
+    if(use_cache && !model.second.empty()) mesh_cache::write(path, model.first, model.second);
+    return model;
+}
+
+obj_loader::model_t obj_loader::parse_model(const char* begin, const char* end, scheduler* pool) {
+    model_t model;
+
+    obj_data data;
+    std::vector<corner_t> corners;
+    if(pool && pool->size() != 0 && size_t(end - begin) >= 2*chunk_size) {
+        parse_parallel(begin, end, pool, data, corners);
+    } else {
+        reserve(data, size_t(end - begin));
+        parse_obj(begin, end, data);
+        corners.reserve(3*data.polygons.size());
+        triangulate(data, chunk_base{0, 0, 0}, corners, data.skipped);
+    }
+    if(data.skipped != 0) LOG_ERR("Skipped malformed lines:", data.skipped);
+
+    build_model(data, corners, model);
+
+    LOG("Vertices:", model.first.size(), "Faces:", model.second.size());
+
+    return model;
 }
 
-}}
\ No newline at end of file
+}}
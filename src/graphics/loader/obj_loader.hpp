@@ -13,7 +13,12 @@
 
 #include "graphics/graphics3/g3_types.hpp"
 
-// Loader for simple OBJ models for now, e.g. Stanford models, etc.
+namespace zap { class scheduler; }
+
+// Loader for OBJ models (v, vt, vn and f with v, v/vt, v//vn or v/vt/vn corners).  Polygons are triangulated as fans and
+// each distinct corner becomes one vertex.  Normals are computed unless every corner specifies one.  Given a scheduler,
+// large files are split at line boundaries and parsed in parallel, with the same result as the serial parse.  Loaded
+// models are cached next to the source (see mesh_cache) and later loads map the cache instead of parsing.
 namespace zap { namespace graphics {
 
 class obj_loader {
@@ -26,7 +31,7 @@ public:
         // Computing Normals
         if(clear) for(auto& vtx : vbuf) vtx.normal.set(0.f, 0.f, 0.f);
 
-        for(auto tri = 0; tri != ibuf.size(); tri += 3) {
+        for(size_t tri = 0; tri != ibuf.size(); tri += 3) {
             const auto A = ibuf[tri], B = ibuf[tri + 1], C = ibuf[tri + 2];
             const auto& pA = vbuf[A].position, &pB = vbuf[B].position, &pC = vbuf[C].position;
             const auto U = pB - pA, V = pC - pA, N = zap::maths::cross(U, V);
@@ -40,8 +45,11 @@ public:
 
     static std::string read_textfile(const std::string& path);
 
-    static mesh_p3n3t2_u32_t load_mesh(const std::string& path);
-    static model_t load_model(const std::string& path);
+    static mesh_p3n3t2_u32_t load_mesh(const std::string& path, scheduler* pool=nullptr, bool use_cache=true);
+    // Loads the mesh cache if it is current, otherwise memory maps and parses the file and writes the cache
+    static model_t load_model(const std::string& path, scheduler* pool=nullptr, bool use_cache=true);
+    // Parses OBJ text in [begin, end)
+    static model_t parse_model(const char* begin, const char* end, scheduler* pool=nullptr);
 
 protected:
 
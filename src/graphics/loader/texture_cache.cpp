@@ -0,0 +1,310 @@
+/* Created by Darren Otgaar on 2018/06/23. http://www.github.com/otgaard/zap */
+#include "texture_cache.hpp"
+#include <cmath>
+#include <cstring>
+#include <ostream>
+#include <algorithm>
+#include <tools/scheduler.hpp>
+#include "stb_image.h"
+
+using namespace zap;
+using namespace zap::engine;
+using namespace zap::graphics;
+
+static_assert(sizeof(texture_cache::header) <= texture_cache::data_offset, "texture_cache::header exceeds the data offset");
+
+namespace {
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL, prime2 = 0xC2B2AE3D27D4EB4FULL, prime3 = 0x165667B19E3779F9ULL;
+
+    inline uint64_t rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+    inline uint64_t mix(uint64_t acc, uint64_t v) { return rotl(acc + v*prime2, 31)*prime1; }
+
+    inline uint64_t load64(const char* ptr) {
+        uint64_t v;
+        std::memcpy(&v, ptr, sizeof(v));
+        return v;
+    }
+
+    // Four independent lanes over 32 byte blocks (after xxHash64)
+    uint64_t hash_bytes(const char* data, size_t size) {
+        uint64_t lane[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+        const char* ptr = data, * end = data + size;
+        for(; end - ptr >= 32; ptr += 32) {
+            for(int i = 0; i != 4; ++i) lane[i] = mix(lane[i], load64(ptr + 8*i));
+        }
+
+        uint64_t h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18) + uint64_t(size);
+        for(; end - ptr >= 8; ptr += 8) h = rotl(h ^ mix(0, load64(ptr)), 27)*prime1 + prime3;
+        for(; ptr != end; ++ptr) h = rotl(h ^ (uint64_t(uint8_t(*ptr))*prime3), 11)*prime1;
+
+        h ^= h >> 33; h *= prime2;
+        h ^= h >> 29; h *= prime3;
+        return h ^ (h >> 32);
+    }
+
+    template <typename Fnc>
+    void parallel_rows(scheduler* pool, int rows, Fnc&& fnc) {
+        if(pool) pool->parallel_for(0, rows, 16, std::forward<Fnc>(fnc));
+        else     fnc(0, rows);
+    }
+
+    constexpr int kaiser_taps = 8;
+
+    // The weights of the 2:1 Kaiser windowed sinc, tap k samples (2x - 3 + k) for target x
+    const float* kaiser_weights() {
+        static const std::vector<float> weights = []() {
+            const double pi = 3.14159265358979323846, alpha = 4.;
+            auto bessel_i0 = [](double x) {
+                double sum = 1., term = 1.;
+                for(int k = 1; k != 32; ++k) {
+                    term *= (x/(2.*k))*(x/(2.*k));
+                    sum += term;
+                }
+                return sum;
+            };
+
+            std::vector<float> w(kaiser_taps);
+            double total = 0.;
+            for(int k = 0; k != kaiser_taps; ++k) {
+                const double d = k - 3.5, t = d/2., r = d/4.;
+                const double sinc = std::sin(pi*t)/(pi*t);
+                const double window = bessel_i0(alpha*std::sqrt(std::max(1. - r*r, 0.)))/bessel_i0(alpha);
+                w[k] = float(sinc*window);
+                total += w[k];
+            }
+            for(auto& v : w) v = float(v/total);
+            return w;
+        }();
+        return weights.data();
+    }
+
+    inline byte to_byte(float v) {
+        v = std::floor(v + .5f);
+        return byte(v < 0.f ? 0.f : (v > 255.f ? 255.f : v));
+    }
+
+    // Each target texel averages a window of 2x2 source texels, the last row and column of an odd level are folded into
+    // the windows on the edge (which then span 3) and an axis of one pixel is not reduced.
+    void box_level(const texture_cache::pixmap_t& src, texture_cache::pixmap_t& trg, scheduler* pool) {
+        const int sw = src.width(), sh = src.height(), tw = trg.width(), th = trg.height();
+        parallel_rows(pool, th, [&src, &trg, sw, sh, tw, th](int first, int last) {
+            for(int y = first; y != last; ++y) {
+                const int y0 = y*sh/th, y1 = (y + 1)*sh/th;
+                auto out = trg.data(0, y);
+                for(int x = 0; x != tw; ++x) {
+                    const int x0 = x*sw/tw, x1 = (x + 1)*sw/tw, count = (x1 - x0)*(y1 - y0);
+                    int sum[4] = { 0, 0, 0, 0 };
+                    for(int r = y0; r != y1; ++r) {
+                        const auto row = src.data(0, r);
+                        for(int c = x0; c != x1; ++c) {
+                            for(int ch = 0; ch != 4; ++ch) sum[ch] += row[c].get(ch);
+                        }
+                    }
+                    for(int ch = 0; ch != 4; ++ch) out[x].set(ch, byte((sum[ch] + count/2)/count));
+                }
+            }
+        });
+    }
+
+    void kaiser_level(const texture_cache::pixmap_t& src, texture_cache::pixmap_t& trg, scheduler* pool) {
+        const int sw = src.width(), sh = src.height(), tw = trg.width(), th = trg.height();
+        const float* w = kaiser_weights();
+
+        // Filter the rows into floats, then the columns into the target.  An axis of one pixel is not reduced.
+        std::vector<float> tmp(size_t(tw)*sh*4);
+        parallel_rows(pool, sh, [&src, &tmp, w, sw, tw](int first, int last) {
+            for(int y = first; y != last; ++y) {
+                const auto row = src.data(0, y);
+                float* out = tmp.data() + size_t(y)*tw*4;
+                for(int x = 0; x != tw; ++x, out += 4) {
+                    if(sw == 1) {
+                        for(int ch = 0; ch != 4; ++ch) out[ch] = row[0].get(ch);
+                        continue;
+                    }
+                    float acc[4] = { 0.f, 0.f, 0.f, 0.f };
+                    for(int k = 0; k != kaiser_taps; ++k) {
+                        const auto& px = row[std::min(std::max(2*x - 3 + k, 0), sw-1)];
+                        for(int ch = 0; ch != 4; ++ch) acc[ch] += w[k]*px.get(ch);
+                    }
+                    for(int ch = 0; ch != 4; ++ch) out[ch] = acc[ch];
+                }
+            }
+        });
+
+        const size_t row_length = size_t(tw)*4;
+        parallel_rows(pool, th, [&tmp, &trg, w, sh, th, row_length](int first, int last) {
+            std::vector<float> acc(row_length);
+            for(int y = first; y != last; ++y) {
+                if(sh == 1) {
+                    std::copy(tmp.begin(), tmp.begin() + row_length, acc.begin());
+                } else {
+                    std::fill(acc.begin(), acc.end(), 0.f);
+                    for(int k = 0; k != kaiser_taps; ++k) {
+                        const float* row = tmp.data() + size_t(std::min(std::max(2*y - 3 + k, 0), sh-1))*row_length;
+                        for(size_t i = 0; i != row_length; ++i) acc[i] += w[k]*row[i];
+                    }
+                }
+                auto out = reinterpret_cast<byte*>(trg.data(0, y));
+                for(size_t i = 0; i != row_length; ++i) out[i] = to_byte(acc[i]);
+            }
+        });
+    }
+}
+
+bool texture_cache::hash_file(const std::string& path, uint64_t& hash, uint64_t& size) {
+    mapped_file file;
+    if(!file.open(path)) return false;
+    hash = hash_bytes(file.data(), file.size());
+    size = file.size();
+    return true;
+}
+
+std::string texture_cache::cache_path(uint64_t hash, mip_filter filter) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx%s.ztc", (unsigned long long)hash, filter == mip_filter::MF_BOX ? "b" : "k");
+    return directory_.empty() ? std::string(name) : directory_ + "/" + name;
+}
+
+int texture_cache::level_count(int width, int height) {
+    int levels = 1;
+    for(int dim = std::max(width, height); dim > 1; dim >>= 1) ++levels;
+    return levels;
+}
+
+std::vector<texture_cache::pixmap_t> texture_cache::build_chain(pixmap_t image, mip_filter filter, scheduler* pool) {
+    std::vector<pixmap_t> chain;
+    const int levels = level_count(image.width(), image.height());
+    chain.reserve(size_t(levels));
+    chain.emplace_back(std::move(image));
+    for(int l = 1; l != levels; ++l) {
+        const auto& src = chain.back();
+        pixmap_t trg{std::max(src.width() >> 1, 1), std::max(src.height() >> 1, 1)};
+        if(filter == mip_filter::MF_KAISER) kaiser_level(src, trg, pool);
+        else                                box_level(src, trg, pool);
+        chain.emplace_back(std::move(trg));
+    }
+    return chain;
+}
+
+bool texture_cache::write(const std::string& source, mip_filter filter, scheduler* pool) {
+    uint64_t hash, size;
+    if(!hash_file(source, hash, size)) {
+        LOG_ERR("texture_cache: source file not found:", source);
+        return false;
+    }
+    return write_cache(cache_path(hash, filter), hash, size, source, filter, pool);
+}
+
+bool texture_cache::write_cache(const std::string& path, uint64_t hash, uint64_t size, const std::string& source,
+                                mip_filter filter, scheduler* pool) {
+    int width, height, components;
+    byte* data = stbi_load(source.c_str(), &width, &height, &components, int(pixel_t::size));
+    if(!data) {
+        LOG_ERR("texture_cache: failed to decode", source);
+        return false;
+    }
+
+    pixmap_t image{width, height};
+    image.copy(data, size_t(width)*height*sizeof(pixel_t));
+    stbi_image_free(data);
+
+    const auto chain = build_chain(std::move(image), filter, pool);
+
+    char block[data_offset];
+    std::memset(block, 0, sizeof(block));
+    header hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = magic;
+    hdr.version = version;
+    hdr.pixel_size = uint32_t(sizeof(pixel_t));
+    hdr.filter = uint32_t(filter);
+    hdr.level_count = uint32_t(chain.size());
+    hdr.source_hash = hash;
+    hdr.source_size = size;
+
+    uint64_t offset = data_offset;
+    for(size_t l = 0; l != chain.size(); ++l) {
+        hdr.levels[l].width = uint32_t(chain[l].width());
+        hdr.levels[l].height = uint32_t(chain[l].height());
+        hdr.levels[l].offset = offset;
+        offset += (chain[l].size()*sizeof(pixel_t) + data_alignment - 1) & ~uint64_t(data_alignment - 1);
+    }
+    std::memcpy(block, &hdr, sizeof(hdr));
+
+    const bool written = write_file_atomic(path, [&block, &chain](std::ostream& file) {
+        const char padding[data_alignment] = { };
+        file.write(block, sizeof(block));
+        for(const auto& level : chain) {
+            const size_t bytes = level.size()*sizeof(pixel_t);
+            file.write(reinterpret_cast<const char*>(level.data()), std::streamsize(bytes));
+            if(bytes % data_alignment) file.write(padding, std::streamsize(data_alignment - bytes % data_alignment));
+        }
+    });
+    if(!written) {
+        LOG_ERR("texture_cache: failed to write", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool texture_cache::open(const std::string& source, mip_filter filter) {
+    close();
+
+    uint64_t hash, size;
+    return hash_file(source, hash, size) && open_cache(cache_path(hash, filter), hash, size, filter);
+}
+
+bool texture_cache::open_cache(const std::string& path, uint64_t hash, uint64_t size, mip_filter filter) {
+    close();
+    if(!file_.open(path)) return false;
+
+    const auto* hdr = reinterpret_cast<const header*>(file_.data());
+    bool valid = file_.size() >= data_offset && hdr->magic == magic && hdr->version == version &&
+                 hdr->pixel_size == sizeof(pixel_t) && hdr->filter == uint32_t(filter) && hdr->source_hash == hash &&
+                 hdr->source_size == size && hdr->level_count > 0 && hdr->level_count <= uint32_t(max_levels);
+    for(uint32_t l = 0; valid && l != hdr->level_count; ++l) {
+        const auto& lvl = hdr->levels[l];
+        valid = lvl.width > 0 && lvl.height > 0 && lvl.offset >= data_offset &&
+                lvl.offset + uint64_t(lvl.width)*lvl.height*sizeof(pixel_t) <= file_.size();
+    }
+    if(!valid) {
+        file_.close();
+        return false;
+    }
+
+    hdr_ = hdr;
+    return true;
+}
+
+bool texture_cache::load(const std::string& source, texture& tex, mip_filter filter, scheduler* pool) {
+    close();
+
+    uint64_t hash, size;
+    if(!hash_file(source, hash, size)) {
+        LOG_ERR("texture_cache: source file not found:", source);
+        return false;
+    }
+
+    const auto path = cache_path(hash, filter);
+    if(!open_cache(path, hash, size, filter) &&
+       !(write_cache(path, hash, size, source, filter, pool) && open_cache(path, hash, size, filter))) {
+        return false;
+    }
+    return upload(tex);
+}
+
+bool texture_cache::upload(texture& tex) const {
+    if(!is_open()) return false;
+    if(!tex.is_allocated() && !tex.allocate()) return false;
+    if(!tex.initialise_storage(width(), height(), levels(), pixel_format::PF_RGBA, pixel_datatype::PD_UNSIGNED_BYTE)) {
+        return false;
+    }
+
+    bool result = true;
+    for(int l = 0; l != levels(); ++l) {
+        result = tex.copy(0, 0, size_t(level_width(l)), size_t(level_height(l)), l, false, pixel_format::PF_RGBA,
+                          pixel_datatype::PD_UNSIGNED_BYTE, reinterpret_cast<const char*>(level_data(l))) && result;
+    }
+    return result;
+}
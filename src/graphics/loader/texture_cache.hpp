@@ -0,0 +1,109 @@
+/* Created by Darren Otgaar on 2018/06/23. http://www.github.com/otgaard/zap */
+#ifndef ZAP_TEXTURE_CACHE_HPP
+#define ZAP_TEXTURE_CACHE_HPP
+
+/* An on-disk cache of decoded 2D textures with their mip chains.  A cache file is named for the hash of the source
+ * image's contents (and the mip filter) and holds a fixed header, the level table and every level as packed RGBA8 rows,
+ * so that an open cache is memory mapped and uploaded level by level straight from the mapping.  A cache that is
+ * truncated, written by another version or built from other contents fails to open and is rebuilt by load().
+ *
+ * The mip chain is built on the CPU, each level filtered from the one above (by a 2x2 box or an 8-tap Kaiser windowed
+ * sinc, edges clamped), with the rows of each level spread over the scheduler if given.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <tools/os.hpp>
+#include <engine/pixmap.hpp>
+#include <engine/texture.hpp>
+
+namespace zap { class scheduler; }
+
+namespace zap { namespace graphics {
+
+class texture_cache {
+public:
+    using pixel_t = engine::rgba8888_t;
+    using pixmap_t = engine::pixmap<pixel_t>;
+
+    constexpr static uint32_t magic = 0x4354415A;       // "ZATC"
+    constexpr static uint32_t version = 1;
+    constexpr static int max_levels = 32;
+
+    enum class mip_filter : uint32_t {
+        MF_BOX = 0,
+        MF_KAISER = 1
+    };
+
+    struct level {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;                                // From the start of the file
+    };
+
+    struct header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t pixel_size;                            // sizeof(pixel_t), guards against layout changes
+        uint32_t filter;
+        uint32_t level_count;
+        uint32_t reserved;
+        uint64_t source_hash;
+        uint64_t source_size;
+        level levels[max_levels];
+    };
+
+    // The first level starts here (leaving room for the header to grow), levels are aligned to data_alignment bytes
+    constexpr static size_t data_offset = 1024;
+    constexpr static size_t data_alignment = 64;
+
+    // Cache files are kept in directory, which must exist
+    explicit texture_cache(const std::string& directory) : directory_(directory) { }
+
+    // Hashes the contents of path (64-bit, not cryptographic)
+    static bool hash_file(const std::string& path, uint64_t& hash, uint64_t& size);
+    std::string cache_path(uint64_t hash, mip_filter filter) const;
+
+    // The number of levels in the full mip chain of a width x height image
+    static int level_count(int width, int height);
+    // Builds the mip chain of image, image is the first level
+    static std::vector<pixmap_t> build_chain(pixmap_t image, mip_filter filter, scheduler* pool=nullptr);
+
+    // Decodes source and writes its cache, fails if source cannot be decoded
+    bool write(const std::string& source, mip_filter filter=mip_filter::MF_BOX, scheduler* pool=nullptr);
+
+    // Maps the cache of source, fails if there is no valid cache
+    bool open(const std::string& source, mip_filter filter=mip_filter::MF_BOX);
+    void close() { file_.close(); hdr_ = nullptr; }
+    bool is_open() const { return hdr_ != nullptr; }
+
+    // Opens the cache of source (writing it first if required) and uploads it to tex
+    bool load(const std::string& source, engine::texture& tex, mip_filter filter=mip_filter::MF_BOX,
+              scheduler* pool=nullptr);
+    // Uploads the open cache to tex, allocating tex if required
+    bool upload(engine::texture& tex) const;
+
+    int width() const { return int(hdr_->levels[0].width); }
+    int height() const { return int(hdr_->levels[0].height); }
+    int levels() const { return int(hdr_->level_count); }
+    int level_width(int l) const { return int(hdr_->levels[l].width); }
+    int level_height(int l) const { return int(hdr_->levels[l].height); }
+    const pixel_t* level_data(int l) const {
+        return reinterpret_cast<const pixel_t*>(file_.data() + hdr_->levels[l].offset);
+    }
+
+protected:
+    bool write_cache(const std::string& path, uint64_t hash, uint64_t size, const std::string& source,
+                     mip_filter filter, scheduler* pool);
+    bool open_cache(const std::string& path, uint64_t hash, uint64_t size, mip_filter filter);
+
+private:
+    std::string directory_;
+    mapped_file file_;
+    const header* hdr_ = nullptr;
+};
+
+}}
+
+#endif //ZAP_TEXTURE_CACHE_HPP
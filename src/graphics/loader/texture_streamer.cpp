@@ -0,0 +1,253 @@
+/* Created by Darren Otgaar on 2018/06/22. http://www.github.com/otgaard/zap */
+#include "texture_streamer.hpp"
+#include <thread>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <tools/scheduler.hpp>
+#include "stb_image.h"
+
+using namespace zap;
+using namespace zap::engine;
+using namespace zap::loader;
+
+texture_streamer::~texture_streamer() {
+    // The decoding tasks reference the entries
+    while(decoding_.load() != 0) {
+        if(!pool_ || !pool_->run_one()) std::this_thread::yield();
+    }
+
+    for(auto& s : ring_) {
+        if(s.pbuf.is_mapped()) { s.pbuf.bind(); s.pbuf.unmap(true); s.pbuf.release(); }
+    }
+}
+
+bool texture_streamer::initialise(size_t frame_budget, size_t slot_bytes) {
+    frame_budget_ = frame_budget;
+    slot_pixels_ = std::max(slot_bytes/sizeof(pixel_t), size_t(1));
+
+    persistent_ = buffer::storage_supported();
+    if(persistent_) {
+        const auto flags = range_access::code(range_access::BA_MAP_WRITE | range_access::BA_MAP_PERSISTENT |
+                                              range_access::BA_MAP_COHERENT);
+        for(auto& s : ring_) {
+            s.pbuf.allocate();
+            s.pbuf.bind();
+            if(!s.pbuf.initialise_storage(slot_pixels_, 1, flags) || !s.pbuf.map(flags, true, 0, slot_pixels_)) {
+                LOG_ERR("Failed to map the texture_streamer ring persistently");
+                s.pbuf.release();
+                persistent_ = false;
+                break;
+            }
+            s.pbuf.release();
+        }
+    }
+
+    if(!persistent_) {
+        // Each band orphans the slot's storage instead
+        for(auto& s : ring_) {
+            if(s.pbuf.is_allocated()) {
+                if(s.pbuf.is_mapped()) { s.pbuf.bind(); s.pbuf.unmap(true); s.pbuf.release(); }
+                s.pbuf.deallocate();
+            }
+            s.pbuf.allocate();
+            s.pbuf.bind();
+            const bool result = s.pbuf.initialise(slot_pixels_, 1);
+            s.pbuf.release();
+            if(!result) {
+                LOG_ERR("Failed to initialise the texture_streamer ring");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const texture* texture_streamer::request(const std::string& path, bool generate_mipmaps, bool flip_y) {
+    auto it = entries_.find(path);
+    if(it != entries_.end()) return &it->second->tex;
+
+    std::unique_ptr<entry> ent{new entry{}};
+    ent->path = path;
+    ent->generate_mipmaps = generate_mipmaps;
+    ent->flip_y = flip_y;
+
+    const pixel_t grey{128, 128, 128, 255};
+    if(!ent->tex.allocate() || !ent->tex.initialise(texture_type::TT_TEX2D, 1, 1, 1, pixel_format::PF_RGBA,
+                                                    pixel_datatype::PD_UNSIGNED_BYTE, false,
+                                                    reinterpret_cast<const char*>(&grey))) {
+        LOG_ERR("Failed to initialise the placeholder texture:", path);
+    }
+
+    auto ptr = ent.get();
+    entries_.emplace(path, std::move(ent));
+
+    decoding_.fetch_add(1);
+    if(pool_) pool_->run_task([this, ptr]() { decode(ptr); });
+    else      decode(ptr);
+    return &ptr->tex;
+}
+
+void texture_streamer::decode(entry* ent) {
+    int width, height, components;
+    byte* data = stbi_load(ent->path.c_str(), &width, &height, &components, int(pixel_t::size));
+    if(data) {
+        ent->image = pixmap<pixel_t>{width, height, 1, pixmap<pixel_t>::base_alignment, &pixmaps_};
+        const size_t row_bytes = size_t(width)*sizeof(pixel_t);
+        for(int r = 0; r != height; ++r) std::memcpy(ent->image.data(0, r), data + row_bytes*r, row_bytes);
+        stbi_image_free(data);
+        if(ent->flip_y) ent->image.flip_y();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        decoded_.push_back(ent);
+    }
+    decoding_.fetch_sub(1);                             // Last, the destructor may run as soon as this reaches zero
+}
+
+void texture_streamer::begin_upload(entry* ent) {
+    if(ent->image.size() == 0) {
+        LOG_ERR("Failed to decode texture:", ent->path);
+        ent->status = state::ST_FAILED;
+        return;
+    }
+
+    auto& img = ent->image;
+    if(!ent->staging.allocate() || !ent->staging.initialise(texture_type::TT_TEX2D, img.width(), img.height(), 1,
+                                                            pixel_format::PF_RGBA, pixel_datatype::PD_UNSIGNED_BYTE,
+                                                            false, nullptr)) {
+        LOG_ERR("Failed to initialise texture:", ent->path);
+        ent->status = state::ST_FAILED;
+        ent->image = pixmap<pixel_t>{};
+        return;
+    }
+
+    ent->status = state::ST_UPLOADING;
+    uploads_.push_back(ent);
+}
+
+size_t texture_streamer::update() {
+    return upload(frame_budget_, false);
+}
+
+void texture_streamer::finish() {
+    while(pending() != 0) {
+        if(upload(std::numeric_limits<size_t>::max(), true) == 0 && uploads_.empty()) {
+            if(!pool_ || !pool_->run_one()) std::this_thread::yield();
+        }
+    }
+}
+
+size_t texture_streamer::upload(size_t budget, bool block) {
+    {
+        std::vector<entry*> decoded;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            decoded.swap(decoded_);
+        }
+        for(auto ent : decoded) begin_upload(ent);
+    }
+
+    if(slot_pixels_ == 0) {
+        LOG_ERR("texture_streamer::initialise must be called before update");
+        return 0;
+    }
+
+    size_t uploaded = 0;
+    bool stalled = false;
+    while(!uploads_.empty() && !stalled) {
+        if(uploaded >= budget) break;                       // Including a forced row over the budget
+
+        auto ent = uploads_.front();
+        const size_t row_bytes = size_t(ent->image.width())*sizeof(pixel_t);
+        // At least one row is uploaded a frame, so a budget smaller than a row still makes progress
+        const size_t max_rows = uploaded == 0 ? std::max((budget - uploaded)/row_bytes, size_t(1))
+                                              : (budget - uploaded)/row_bytes;
+        if(max_rows == 0) break;
+
+        uploaded += upload_band(ent, max_rows, block, stalled);
+        if(ent->next_row == ent->image.height()) {
+            ent->tex = std::move(ent->staging);             // The placeholder is released with the staging texture
+            ent->staging.deallocate();
+            ent->image = pixmap<pixel_t>{};                 // Returned to the pool
+            ent->status = state::ST_RESIDENT;
+            uploads_.pop_front();
+        }
+    }
+    return uploaded;
+}
+
+size_t texture_streamer::upload_band(entry* ent, size_t max_rows, bool block, bool& stalled) {
+    auto& img = ent->image;
+    const size_t width = size_t(img.width()), row_bytes = width*sizeof(pixel_t);
+    const size_t remaining = size_t(img.height() - ent->next_row);
+    size_t rows = std::min(std::min(max_rows, remaining), slot_pixels_/width);
+
+    if(rows == 0) {
+        // A row larger than a slot is copied straight from the pixmap
+        rows = std::min(max_rows, remaining);
+        const bool last = rows == remaining;
+        ent->staging.copy(0, size_t(ent->next_row), width, rows, 0, last && ent->generate_mipmaps, pixel_format::PF_RGBA,
+                          pixel_datatype::PD_UNSIGNED_BYTE, reinterpret_cast<const char*>(img.data(0, ent->next_row)),
+                          size_t(img.pitch()));
+        ent->next_row += int(rows);
+        return rows*row_bytes;
+    }
+
+    auto& s = ring_[slot_];
+    if(!s.fence.wait(block ? 1000000000 : 0)) {
+        stalled = true;                                     // The GPU is behind, try again next frame
+        return 0;
+    }
+
+    const size_t count = rows*width;
+    char* ptr = nullptr;
+    if(persistent_) {
+        ptr = reinterpret_cast<char*>(s.pbuf.data());
+    } else {
+        s.pbuf.bind();
+        ptr = s.pbuf.map(range_access::code(range_access::BA_MAP_WRITE | range_access::BA_MAP_INVALIDATE_BUFFER),
+                         true, 0, count);
+        if(!ptr) {
+            s.pbuf.release();
+            LOG_ERR("Failed to map the texture_streamer ring");
+            stalled = true;
+            return 0;
+        }
+    }
+
+    if(img.is_packed()) {
+        std::memcpy(ptr, img.data(0, ent->next_row), count*sizeof(pixel_t));
+    } else {
+        for(size_t r = 0; r != rows; ++r) std::memcpy(ptr + r*row_bytes, img.data(0, ent->next_row + int(r)), row_bytes);
+    }
+
+    if(!persistent_) {
+        s.pbuf.unmap(true);
+        s.pbuf.release();
+    }
+
+    const bool last = size_t(ent->next_row) + rows == size_t(img.height());
+    ent->staging.copy_region(s.pbuf, 0, width, 0, size_t(ent->next_row), width, rows, 0,
+                             last && ent->generate_mipmaps);
+    s.fence.insert();
+    slot_ = (slot_ + 1) % ring_size;
+    ent->next_row += int(rows);
+    return count*sizeof(pixel_t);
+}
+
+size_t texture_streamer::pending() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return size_t(decoding_.load()) + decoded_.size() + uploads_.size();
+}
+
+bool texture_streamer::is_resident(const std::string& path) const {
+    auto it = entries_.find(path);
+    return it != entries_.end() && it->second->status == state::ST_RESIDENT;
+}
+
+bool texture_streamer::has_failed(const std::string& path) const {
+    auto it = entries_.find(path);
+    return it != entries_.end() && it->second->status == state::ST_FAILED;
+}
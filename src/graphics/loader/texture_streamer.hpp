@@ -0,0 +1,103 @@
+/* Created by Darren Otgaar on 2018/06/22. http://www.github.com/otgaard/zap */
+#ifndef ZAP_TEXTURE_STREAMER_HPP
+#define ZAP_TEXTURE_STREAMER_HPP
+
+/* Streams 2D RGBA textures from image files without stalling the render loop.  request() returns a texture at once,
+ * a 1x1 placeholder that is replaced in place once the image is resident, so it may be bound straight away.  Images are
+ * decoded on the scheduler (or by request() without one) into pooled pixmaps, and update(), called once a frame, uploads
+ * up to frame_budget bytes of them in bands of rows through a ring of pixel buffers.  The ring is persistently mapped
+ * where buffer storage is supported, each slot guarded by a fence, and a slot the GPU is still reading ends the frame's
+ * uploads rather than waiting on it.
+ *
+ * All members except the decoding run on the thread owning the GL context, and the textures are owned by the streamer.
+ */
+
+#include <map>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <engine/fence.hpp>
+#include <engine/pixmap.hpp>
+#include <engine/texture.hpp>
+#include <engine/pixel_buffer.hpp>
+#include <engine/pixmap_pool.hpp>
+
+namespace zap { class scheduler; }
+
+namespace zap { namespace loader {
+
+class texture_streamer {
+public:
+    using pixel_t = engine::rgba8888_t;
+    constexpr static int ring_size = 3;
+
+    explicit texture_streamer(scheduler* pool=nullptr) : pool_(pool) { }
+    texture_streamer(const texture_streamer&) = delete;
+    ~texture_streamer();
+
+    texture_streamer& operator=(const texture_streamer&) = delete;
+
+    // Allocates the ring of slot_bytes pixel buffers and sets the bytes uploaded by each update()
+    bool initialise(size_t frame_budget=size_t(8) << 20, size_t slot_bytes=size_t(4) << 20);
+
+    // Returns the texture of path, streamed on first request (repeated requests share the texture)
+    const engine::texture* request(const std::string& path, bool generate_mipmaps=false, bool flip_y=false);
+    // Uploads the decoded images within the frame budget and returns the number of bytes uploaded
+    size_t update();
+    // Blocks until every requested texture is resident or has failed
+    void finish();
+
+    // The textures requested but not yet resident or failed
+    size_t pending() const;
+    bool is_resident(const std::string& path) const;
+    bool has_failed(const std::string& path) const;
+
+    void set_frame_budget(size_t bytes) { frame_budget_ = bytes; }
+    size_t frame_budget() const { return frame_budget_; }
+
+protected:
+    enum class state { ST_DECODING, ST_UPLOADING, ST_RESIDENT, ST_FAILED };
+
+    struct entry {
+        std::string path;
+        bool generate_mipmaps;
+        bool flip_y;
+        state status = state::ST_DECODING;
+        engine::texture tex;                    // The placeholder until the upload completes
+        engine::texture staging;                // The texture being uploaded, swapped into tex when complete
+        engine::pixmap<pixel_t> image;
+        int next_row = 0;
+    };
+
+    struct slot {
+        engine::pixel_buffer<pixel_t> pbuf{engine::buffer_usage::BU_STREAM_DRAW};
+        engine::fence fence;                    // Signalled once the GPU has read the slot
+    };
+
+    void decode(entry* ent);
+    void begin_upload(entry* ent);
+    size_t upload(size_t budget, bool block);
+    size_t upload_band(entry* ent, size_t max_rows, bool block, bool& stalled);
+
+    scheduler* pool_;
+    engine::pixmap_pool pixmaps_;
+    std::map<std::string, std::unique_ptr<entry>> entries_;
+    std::deque<entry*> uploads_;                // Decoded images in upload order
+
+    mutable std::mutex lock_;
+    std::vector<entry*> decoded_;               // Handed over by the decoding tasks
+    std::atomic<int> decoding_{0};
+
+    slot ring_[ring_size];
+    int slot_ = 0;
+    size_t slot_pixels_ = 0;
+    bool persistent_ = false;
+    size_t frame_budget_ = size_t(8) << 20;
+};
+
+}}
+
+#endif //ZAP_TEXTURE_STREAMER_HPP
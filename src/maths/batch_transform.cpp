@@ -0,0 +1,83 @@
+/* Created by Darren Otgaar on 2018/06/26. http://www.github.com/otgaard/zap */
+#include "batch_transform.hpp"
+#include "transform_kernels.hpp"
+#include <cstdint>
+#include <algorithm>
+#include <tools/cpu.hpp>
+
+using namespace zap::maths;
+using namespace zap::maths::transform_kernels;
+
+namespace {
+    struct sse2_tag { };
+
+    static_assert(sizeof(vec3f) == 3*sizeof(float) && sizeof(vec4f) == 4*sizeof(float),
+                  "The batch transforms require tightly packed vectors");
+
+    using kernel_fnc = void (*)(const float* M, const float* src, float* dst, size_t count);
+
+    const kernel_table& kernels() {
+        static const kernel_table& table = zap::host_supports_avx2() ? avx2_kernels() : sse2_kernels();
+        return table;
+    }
+
+    // The kernels require distinct arrays, overlapping arrays are copied through the stack in blocks
+    constexpr size_t block = 256;
+
+    template <typename VecT>
+    void run_kernel(kernel_fnc kernel, const mat4f& M, const VecT* src, VecT* dst, size_t count) {
+        constexpr size_t N = sizeof(VecT)/sizeof(float);
+        const auto src_ptr = reinterpret_cast<const float*>(src);
+        const auto dst_ptr = reinterpret_cast<float*>(dst);
+        const auto s = uintptr_t(src_ptr), d = uintptr_t(dst_ptr), bytes = uintptr_t(count*sizeof(VecT));
+        if(s + bytes <= d || d + bytes <= s) {
+            kernel(M.arr, src_ptr, dst_ptr, count);
+            return;
+        }
+
+        // The blocks are done in the order that reads each source block before it is overwritten
+        float scratch[block*N];
+        const size_t blocks = (count + block - 1)/block;
+        for(size_t b = 0; b != blocks; ++b) {
+            const size_t i = (d > s ? blocks - 1 - b : b)*block, n = count - i < block ? count - i : block;
+            std::copy(src_ptr + i*N, src_ptr + (i + n)*N, scratch);
+            kernel(M.arr, scratch, dst_ptr + i*N, n);
+        }
+    }
+}
+
+const kernel_table& zap::maths::transform_kernels::sse2_kernels() {
+    static const kernel_table table = make_kernel_table<sse2_tag>();
+    return table;
+}
+
+namespace zap { namespace maths {
+
+void transform_points(const mat4f& M, const vec3f* src, vec3f* dst, size_t count) {
+    run_kernel(kernels().transform_points, M, src, dst, count);
+}
+
+void transform_vectors(const mat4f& M, const vec3f* src, vec3f* dst, size_t count) {
+    run_kernel(kernels().transform_vectors, M, src, dst, count);
+}
+
+void transform_normals(const mat4f& M, const vec3f* src, vec3f* dst, size_t count, bool normalise) {
+    // The columns of the inverse transpose are the rows of the inverse, the cofactors of the 3x3 part over the
+    // determinant.  A singular matrix keeps the cofactors, which still give the direction of the normals.
+    const vec3f c0 = M.col3(0), c1 = M.col3(1), c2 = M.col3(2);
+    vec3f r0 = cross(c1, c2), r1 = cross(c2, c0), r2 = cross(c0, c1);
+    const float det = dot(c0, r0);
+    if(std::abs(det) > std::numeric_limits<float>::epsilon()) {
+        const float inv_det = 1.f/det;
+        r0 *= inv_det; r1 *= inv_det; r2 *= inv_det;
+    }
+
+    const mat4f N(r0, r1, r2, vec3f(0.f, 0.f, 0.f));
+    run_kernel(normalise ? kernels().transform_normalise : kernels().transform_vectors, N, src, dst, count);
+}
+
+void transform_homogeneous(const mat4f& M, const vec4f* src, vec4f* dst, size_t count) {
+    run_kernel(kernels().transform_homogeneous, M, src, dst, count);
+}
+
+}}
@@ -0,0 +1,28 @@
+/* Created by Darren Otgaar on 2018/06/26. http://www.github.com/otgaard/zap */
+#ifndef ZAP_BATCH_TRANSFORM_HPP
+#define ZAP_BATCH_TRANSFORM_HPP
+
+/* Transforms arrays of vectors by an affine mat4f, eight (AVX2) or four (SSE2) at a time, with the instruction set
+ * chosen at runtime.  The source and destination may be the same array.
+ */
+
+#include <cstddef>
+#include <maths/maths.hpp>
+#include <maths/vec3.hpp>
+#include <maths/vec4.hpp>
+#include <maths/mat3.hpp>
+#include <maths/mat4.hpp>
+
+namespace zap { namespace maths {
+    // dst[i] = M.transform(src[i])
+    ZAPMATHS_EXPORT void transform_points(const mat4f& M, const vec3f* src, vec3f* dst, size_t count);
+    // dst[i] = M*src[i], the translation is ignored
+    ZAPMATHS_EXPORT void transform_vectors(const mat4f& M, const vec3f* src, vec3f* dst, size_t count);
+    // Transforms normals by the inverse transpose of the 3x3 part of M, normalising the results if normalise is set
+    ZAPMATHS_EXPORT void transform_normals(const mat4f& M, const vec3f* src, vec3f* dst, size_t count,
+                                           bool normalise=true);
+    // The full 4x4 product, e.g. to clip space, the w of dst is not copied from src as in M*src[i]
+    ZAPMATHS_EXPORT void transform_homogeneous(const mat4f& M, const vec4f* src, vec4f* dst, size_t count);
+}}
+
+#endif //ZAP_BATCH_TRANSFORM_HPP
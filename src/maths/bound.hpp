@@ -253,6 +253,32 @@ inline bound<geometry::disc2f, transform3f>& bound<geometry::disc2f, transform3f
     return *this;
 }
 
+template <>
+inline bound<geometry::spheref, transform4f>& bound<geometry::spheref, transform4f>::grow(const bound& rhs) {
+    if (rhs.geometry.radius == 0) return *this;
+
+    auto delta = rhs.geometry.centre - geometry.centre;
+    auto len_sq = delta.length_sqr();
+    auto rad_diff = rhs.geometry.radius - geometry.radius;
+    auto rd_sq = rad_diff * rad_diff;
+
+    if (rd_sq >= len_sq) {	// Containment
+        if (rad_diff >= 0.f) {
+            geometry.centre = rhs.geometry.centre;
+            geometry.radius = rhs.geometry.radius;
+        }
+    } else {
+        auto len = sqrtf(len_sq);
+        if (len > FLT_EPSILON) {
+            auto coeff = (len + rad_diff) / (2.f * len);
+            geometry.centre += coeff * delta;
+        }
+        geometry.radius = (len + geometry.radius + rhs.geometry.radius) / 2;
+    }
+
+    return *this;
+}
+
 template <>
 inline bound<geometry::AABB2f, transform3f>& bound<geometry::AABB2f, transform3f>::grow(const bound& rhs) {
     auto x_min = std::numeric_limits<float>::max(), x_max = -x_min,
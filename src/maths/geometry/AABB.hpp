@@ -127,35 +127,14 @@ struct AABB<T, vec3> {
         return *this;
     }
 
+    // Arvo's method: the centre is transformed and each half-extent is the extent of the box along that axis, the rows
+    // of the absolute 3x3 part dotted with the old half-extents, giving the same box as transforming the eight corners
     AABB& transform(const affine_t& trans) {
-        vector_t arr[8] = {
-            centre + -hextent,
-            centre + vector_t{+1, -1, -1} * hextent,
-            centre + vector_t{+1, +1, -1} * hextent,
-            centre + vector_t{-1, +1, -1} * hextent,
-            centre + hextent,
-            centre + vector_t{-1, -1, +1} * hextent,
-            centre + vector_t{+1, -1, +1} * hextent,
-            centre + vector_t{-1, +1, +1} * hextent
-        };
-
-        for(auto& P : arr) P = trans.transform(P);
-
-        type x_min = std::numeric_limits<type>::max(), x_max = -x_min;
-        type y_min = x_min, y_max = x_max;
-        type z_min = x_min, z_max = x_max;
-
-        for(auto& p : arr) {
-            if(p.x < x_min) x_min = p.x;
-            if(p.x > x_max) x_max = p.x;
-            if(p.y < y_min) y_min = p.y;
-            if(p.y > y_max) y_max = p.y;
-            if(p.z < z_min) z_min = p.z;
-            if(p.z > z_max) z_max = p.z;
+        const vector_t e = hextent;
+        centre = trans.transform(centre);
+        for(size_t r = 0; r != 3; ++r) {
+            hextent[r] = std::abs(trans(r,0))*e.x + std::abs(trans(r,1))*e.y + std::abs(trans(r,2))*e.z;
         }
-
-        hextent.set((x_max - x_min)/2, (y_max - y_min)/2, (z_max - z_min)/2);
-        centre.set(x_min + hextent.x, y_min + hextent.y, z_min + hextent.z);
         return *this;
     }
 
@@ -208,9 +187,25 @@ bool intersection(const AABB<T, vec3>& A, const AABB<T, vec3>& B) {
     return true;
 }
 
+// Slab test, inv_d is the reciprocal of the ray direction (precomputed when testing many boxes against the same ray).
+// On success [t_min, t_max] is clipped to the interval of the ray inside the box.
+template <typename T>
+bool intersection(const AABB<T, vec3>& A, const geometry::ray<vec3<T>>& r, const vec3<T>& inv_d, T& t_min, T& t_max) {
+    for(size_t i = 0; i != 3; ++i) {
+        T t0 = (A.centre[i] - A.hextent[i] - r.O[i]) * inv_d[i];
+        T t1 = (A.centre[i] + A.hextent[i] - r.O[i]) * inv_d[i];
+        if(inv_d[i] < T(0)) std::swap(t0, t1);
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+        if(t_max < t_min) return false;
+    }
+    return true;
+}
+
 template <typename T>
 bool intersection(const AABB<T, vec3>& A, const geometry::ray<vec3<T>>& r) {
-    return false;
+    T t_min = T(0), t_max = std::numeric_limits<T>::max();
+    return intersection(A, r, vec3<T>(T(1)/r.d.x, T(1)/r.d.y, T(1)/r.d.z), t_min, t_max);
 }
 
 using AABB3i = AABB<int, vec3>;
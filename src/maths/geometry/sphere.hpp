@@ -5,7 +5,9 @@
 #ifndef ZAP_SPHERE_HPP
 #define ZAP_SPHERE_HPP
 
+#include <cmath>
 #include <limits>
+#include <algorithm>
 #include <maths/geometry/ray.hpp>
 
 namespace zap { namespace maths { namespace geometry {
@@ -29,6 +31,9 @@ struct sphere {
 
     sphere& transform(const affine_t& trans) {
         centre = trans.transform(centre);
+        // Scale by the longest axis so the sphere still bounds under non-uniform scale
+        auto scale_sq = std::max(std::max(trans.col3(0).length_sqr(), trans.col3(1).length_sqr()), trans.col3(2).length_sqr());
+        radius *= std::sqrt(scale_sq);
         return *this;
     }
 
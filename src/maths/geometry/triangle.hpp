@@ -0,0 +1,68 @@
+//
+// Created by Darren Otgaar on 2018/06/11.
+//
+
+#ifndef ZAP_TRIANGLE_HPP
+#define ZAP_TRIANGLE_HPP
+
+#include <limits>
+#include <maths/geometry/ray.hpp>
+
+namespace zap { namespace maths { namespace geometry {
+
+template <typename T>
+struct triangle {
+    using type = T;
+    using vector_t = vec3<type>;
+    using affine_t = mat4<type>;
+
+    triangle() = default;
+    triangle(const triangle& rhs) = default;
+    triangle(const vector_t& P0, const vector_t& P1, const vector_t& P2) : P0(P0), P1(P1), P2(P2) { }
+
+    triangle& operator=(const triangle& rhs) = default;
+
+    triangle& translate(const vector_t& trans) {
+        P0 += trans; P1 += trans; P2 += trans;
+        return *this;
+    }
+
+    triangle& transform(const affine_t& trans) {
+        P0 = trans.transform(P0); P1 = trans.transform(P1); P2 = trans.transform(P2);
+        return *this;
+    }
+
+    vector_t normal() const { return normalise(cross(P1 - P0, P2 - P0)); }
+    vector_t centroid() const { return (P0 + P1 + P2) / type(3); }
+
+    vector_t P0, P1, P2;
+};
+
+using trianglef = triangle<float>;
+using triangled = triangle<double>;
+
+// Moller-Trumbore, returns the ray parameter t and the barycentric coordinates (u, v) of the intersection
+template <typename T>
+bool intersection(const triangle<T>& tri, const ray<typename triangle<T>::vector_t>& R, T& t, T& u, T& v, const T& epsilon=std::numeric_limits<T>::epsilon()) {
+    using vector = typename triangle<T>::vector_t;
+    const vector e1 = tri.P1 - tri.P0, e2 = tri.P2 - tri.P0;
+    const vector pvec = cross(R.d, e2);
+    const T det = dot(e1, pvec);
+    if(std::abs(det) < std::numeric_limits<T>::epsilon()) return false;
+
+    const T inv_det = T(1)/det;
+    const vector tvec = R.O - tri.P0;
+    u = dot(tvec, pvec) * inv_det;
+    if(u < T(0) || u > T(1)) return false;
+
+    const vector qvec = cross(tvec, e1);
+    v = dot(R.d, qvec) * inv_det;
+    if(v < T(0) || u + v > T(1)) return false;
+
+    t = dot(e2, qvec) * inv_det;
+    return t >= epsilon;
+}
+
+}}}
+
+#endif //ZAP_TRIANGLE_HPP
@@ -8,6 +8,9 @@
 #include <maths/maths.hpp>
 #include <maths/vec3.hpp>
 #include <maths/vec4.hpp>
+#if defined(ZAP_MATHS_SIMD)
+#include <maths/simd.hpp>
+#endif
 
 /* Note:
  * Matrices are represented in standard mathematical notation:
@@ -494,6 +497,119 @@ namespace zap { namespace maths {
         return inv;
     }
 
+    // The inverse of an affine matrix (the last row is [0 0 0 1]), the 3x3 part is inverted by its adjugate
+    template <typename T>
+    mat4<T> affine_inverse(const mat4<T>& M, T epsilon=std::numeric_limits<T>::epsilon()) {
+        const vec3<T> c0 = M.col3(0), c1 = M.col3(1), c2 = M.col3(2), t = M.col3(3);
+        const vec3<T> r0 = cross(c1, c2), r1 = cross(c2, c0), r2 = cross(c0, c1);
+        const T det = dot(c0, r0);
+        if(std::abs(det) <= epsilon) return mat4<T>((T)0);
+
+        const T inv_det = (T)1/det;
+        mat4<T> inv;
+        inv.row(0, vec4<T>(r0*inv_det, -dot(r0, t)*inv_det));
+        inv.row(1, vec4<T>(r1*inv_det, -dot(r1, t)*inv_det));
+        inv.row(2, vec4<T>(r2*inv_det, -dot(r2, t)*inv_det));
+        inv.row(3, vec4<T>((T)0, (T)0, (T)0, (T)1));
+        return inv;
+    }
+
+#if defined(ZAP_MATHS_SIMD)
+    /* SSE versions of the mat4f products, the columns are loaded unaligned because mat4 carries no alignment.  The sums
+     * are accumulated in the same order as the scalar code above, so the results are identical.
+     */
+
+    inline mat4<float> operator*(const mat4<float>& lhs, const mat4<float>& rhs) {
+        using namespace simd;
+        const vecm a0 = loadu(lhs.arr), a1 = loadu(lhs.arr + 4), a2 = loadu(lhs.arr + 8), a3 = loadu(lhs.arr + 12);
+        mat4<float> r;
+        for(int c = 0; c != 4; ++c) {
+            const vecm b = loadu(rhs.arr + 4*c);
+            storeu(r.arr + 4*c, madd(a3, splat<3>(b), madd(a2, splat<2>(b), _mm_add_ps(_mm_mul_ps(a0, splat<0>(b)),
+                                                                                     _mm_mul_ps(a1, splat<1>(b))))));
+        }
+        return r;
+    }
+
+    template <>
+    inline mat4<float>& mat4<float>::operator*=(const mat4<float>& rhs) {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    inline vec4<float> operator*(const mat4<float>& lhs, const vec4<float>& v) {
+        using namespace simd;
+        const vecm b = loadu(v.arr);
+        vecm32f r = madd(loadu(lhs.arr + 12), splat<3>(b), madd(loadu(lhs.arr + 8), splat<2>(b),
+                         _mm_add_ps(_mm_mul_ps(loadu(lhs.arr), splat<0>(b)), _mm_mul_ps(loadu(lhs.arr + 4), splat<1>(b)))));
+        return vec4<float>(r.arr[0], r.arr[1], r.arr[2], v.w);
+    }
+
+    template <>
+    inline vec4<float> mat4<float>::operator*(const vec4<float>& v) {
+        using namespace simd;
+        const vecm b = loadu(v.arr);
+        vecm32f r = madd(loadu(arr + 12), splat<3>(b), madd(loadu(arr + 8), splat<2>(b),
+                         _mm_add_ps(_mm_mul_ps(loadu(arr), splat<0>(b)), _mm_mul_ps(loadu(arr + 4), splat<1>(b)))));
+        return vec4<float>(r.arr[0], r.arr[1], r.arr[2], r.arr[3]);
+    }
+
+    inline vec3<float> operator*(const mat4<float>& lhs, const vec3<float>& v) {
+        using namespace simd;
+        vecm32f r = madd(loadu(lhs.arr + 8), load(v.z), _mm_add_ps(_mm_mul_ps(loadu(lhs.arr), load(v.x)),
+                                                                   _mm_mul_ps(loadu(lhs.arr + 4), load(v.y))));
+        return vec3<float>(r.arr[0], r.arr[1], r.arr[2]);
+    }
+
+    inline vec3<float> transform4(const mat4<float>& lhs, const vec3<float>& v) {
+        using namespace simd;
+        vecm32f r = _mm_add_ps(madd(loadu(lhs.arr + 8), load(v.z), _mm_add_ps(_mm_mul_ps(loadu(lhs.arr), load(v.x)),
+                               _mm_mul_ps(loadu(lhs.arr + 4), load(v.y)))), loadu(lhs.arr + 12));
+        return vec3<float>(r.arr[0], r.arr[1], r.arr[2]);
+    }
+
+    template <>
+    inline vec3<float> mat4<float>::transform(const vec3<float>& P) const {
+        return transform4(*this, P);
+    }
+
+    inline mat4<float> transpose(const mat4<float>& M) {
+        using namespace simd;
+        vecm c0 = loadu(M.arr), c1 = loadu(M.arr + 4), c2 = loadu(M.arr + 8), c3 = loadu(M.arr + 12);
+        simd::transpose(c0, c1, c2, c3);
+        mat4<float> r;
+        storeu(r.arr, c0); storeu(r.arr + 4, c1); storeu(r.arr + 8, c2); storeu(r.arr + 12, c3);
+        return r;
+    }
+
+    template <>
+    inline mat4<float>& mat4<float>::transpose() {
+        *this = maths::transpose(*this);
+        return *this;
+    }
+
+    inline mat4<float> affine_inverse(const mat4<float>& M, float epsilon=std::numeric_limits<float>::epsilon()) {
+        using namespace simd;
+        // The w lanes of the first three columns are zero, so the w lanes of the cross products are too
+        const vecm c0 = loadu(M.arr), c1 = loadu(M.arr + 4), c2 = loadu(M.arr + 8);
+        vecm r0 = cross_v(c1, c2), r1 = cross_v(c2, c0), r2 = cross_v(c0, c1);
+        const float det = _mm_cvtss_f32(dot3_v(c0, r0));
+        if(std::abs(det) <= epsilon) return mat4<float>(0.f);
+
+        const vecm inv_det = load(1.f/det);
+        r0 = _mm_mul_ps(r0, inv_det); r1 = _mm_mul_ps(r1, inv_det); r2 = _mm_mul_ps(r2, inv_det);
+        vecm r3 = _mm_setzero_ps();
+        simd::transpose(r0, r1, r2, r3);            // r0..r2 are now the columns of the inverse of the 3x3 part
+
+        const vecm t = loadu(M.arr + 12);
+        const vecm tr = madd(r2, splat<2>(t), _mm_add_ps(_mm_mul_ps(r0, splat<0>(t)), _mm_mul_ps(r1, splat<1>(t))));
+        mat4<float> inv;
+        storeu(inv.arr, r0); storeu(inv.arr + 4, r1); storeu(inv.arr + 8, r2);
+        storeu(inv.arr + 12, _mm_sub_ps(_mm_set_ps(1.f, 0.f, 0.f, 0.f), tr));
+        return inv;
+    }
+#endif //ZAP_MATHS_SIMD
+
     using mat4b = mat4<uint8_t>;
     using mat4s = mat4<int16_t>;
     using mat4i = mat4<int32_t>;
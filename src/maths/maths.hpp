@@ -28,6 +28,12 @@
 #define ALIGN_ATTR(w) __attribute__((aligned(w)))
 #endif //_WIN32
 
+// The mat4f kernels use SSE2 (the x86-64 baseline) unless ZAP_NO_SIMD is defined.  Unlike ZAP_MATHS_SSE2, this does not
+// change the layout or alignment of the vector and matrix types.
+#if !defined(ZAP_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define ZAP_MATHS_SIMD
+#endif
+
 namespace zap { namespace maths {
 #if defined(_WIN32)
     template <typename T> const T PI = T(3.14159265358979323846);
@@ -34,6 +34,31 @@ namespace zap { namespace maths { namespace simd {
     inline vecm VCALL load(const float* arr) { return _mm_load_ps(arr); }
     inline vecm VCALL load(float value) { return _mm_set1_ps(value); }
     inline veci VCALL load(int value) { return _mm_set1_epi32(value); }
+    inline vecm VCALL loadu(const float* arr) { return _mm_loadu_ps(arr); }
+    inline void VCALL storeu(float* arr, const vecm& v) { _mm_storeu_ps(arr, v); }
+
+    // Broadcasts lane I
+    template <int I>
+    inline vecm VCALL splat(const vecm& v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(I, I, I, I)); }
+
+    // a*b + c (not fused, so results match the scalar code)
+    inline vecm VCALL madd(const vecm& a, const vecm& b, const vecm& c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+    // The cross product of the xyz lanes, w is a.w*b.w - a.w*b.w
+    inline vecm VCALL cross_v(const vecm& a, const vecm& b) {
+        const vecm a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        const vecm b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        const vecm c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+        return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+
+    // The dot product of the xyz lanes in every lane
+    inline vecm VCALL dot3_v(const vecm& a, const vecm& b) {
+        const vecm p = _mm_mul_ps(a, b);
+        return _mm_add_ps(_mm_add_ps(splat<0>(p), splat<1>(p)), splat<2>(p));
+    }
+
+    inline void transpose(vecm& r0, vecm& r1, vecm& r2, vecm& r3) { _MM_TRANSPOSE4_PS(r0, r1, r2, r3); }
 
 #if defined(_WIN32)
     __declspec(align(16)) struct vecm32f {
@@ -100,6 +125,8 @@ namespace zap { namespace maths { namespace simd {
     const vecm32f vecm_one = { 1.f, 1.f, 1.f, 1.f };
     const veci veci_one = _mm_cvtps_epi32(vecm_one.v);
 
+    inline vecm VCALL abs_v(const vecm& v) { return _mm_and_ps(v, vecm_abs_mask); }
+
     inline void set_round_down() {
         _MM_SET_ROUNDING_MODE(_MM_ROUND_DOWN);
     }
@@ -131,6 +158,15 @@ namespace zap { namespace maths { namespace simd {
         return _mm_cvtps_epi32(v);
     }
 
+    // Per-lane mask ? a : b (SSE2 replacement for _mm_blendv_ps)
+    inline vecm VCALL select_v(const vecm& mask, const vecm& a, const vecm& b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    inline veci VCALL select_v(const veci& mask, const veci& a, const veci& b) {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
     inline vecm VCALL lerp_v(const vecm& u, const vecm& v0, const vecm& v1) {
         return _mm_add_ps(
                 _mm_mul_ps(_mm_sub_ps(vecm_one, u), v0),
@@ -60,6 +60,7 @@ namespace zap { namespace maths {
     protected:
         void update_transform() const;
         void invert_affine() const;
+        void compose(const transform& lhs, const transform& rhs);    // The general product, lhs and rhs are synced
 
         rot_t rotation_;
         vec_t scale_;
@@ -219,6 +220,8 @@ namespace zap { namespace maths {
                 inv_matrix_(r,col) = -dot(inv_matrix_.row(r), translation_);
             }
         }
+
+        transform_state_.set(transform_state::TS_SYNCEDINV);
     }
 
     template <typename AFFINE_MAT_T>
@@ -230,7 +233,7 @@ namespace zap { namespace maths {
         if(rhs.transform_state_.is_set(transform_state::TS_IDENTITY)) return *this;
 
         transform P;
-        if(transform_state_.is_set(transform_state::TS_ROTSCALE) && transform_state_.is_set(transform_state::TS_ROTSCALE)) {
+        if(transform_state_.is_set(transform_state::TS_ROTSCALE) && rhs.transform_state_.is_set(transform_state::TS_ROTSCALE)) {
             if(transform_state_.is_set(transform_state::TS_UNISCALE)) {
                 P.rotate(rotation_ * rhs.rotation_);
                 P.translate(uniform_scale()*(rotation_*rhs.translation_) + translation_);
@@ -240,16 +243,33 @@ namespace zap { namespace maths {
             }
         }
 
-        rot_t M_scale(scale_);
+        P.compose(*this, rhs);
+        return P;
+    }
+
+    template <typename AFFINE_MAT_T>
+    void transform<AFFINE_MAT_T>::compose(const transform& lhs, const transform& rhs) {
+        rot_t M_scale(lhs.scale_);
         rot_t N_scale(rhs.scale_);
 
-        rot_t A = transform_state_.is_set(transform_state::TS_ROTSCALE)     ? rotation_     * M_scale : rotation_;
+        rot_t A = lhs.transform_state_.is_set(transform_state::TS_ROTSCALE) ? lhs.rotation_ * M_scale : lhs.rotation_;
         rot_t B = rhs.transform_state_.is_set(transform_state::TS_ROTSCALE) ? rhs.rotation_ * N_scale : rhs.rotation_;
 
-        P.matrix(A*B);
-        P.translate(A*rhs.translation_ + translation_);
-        return P;
+        matrix(A*B);
+        translate(A*rhs.translation_ + lhs.translation_);
+    }
+
+#if defined(ZAP_MATHS_SIMD)
+    // The upper 3x3 of the synced matrices is A and B above, so the product is one mat4f product, which is kept as the
+    // synced matrix of the result
+    template <>
+    inline void transform<mat4f>::compose(const transform& lhs, const transform& rhs) {
+        matrix_ = lhs.matrix_ * rhs.matrix_;
+        matrix(matrix_.rotation());
+        translate(matrix_.col3(3));
+        transform_state_.set(transform_state::TS_SYNCED);
     }
+#endif //ZAP_MATHS_SIMD
 
     template <typename AFFINE_MAT_T>
     typename transform<AFFINE_MAT_T>::vec_t transform<AFFINE_MAT_T>::vtransform(const typename transform<AFFINE_MAT_T>::vec_t& vec) const {
@@ -0,0 +1,97 @@
+/* Created by Darren Otgaar on 2018/06/26. http://www.github.com/otgaard/zap */
+#ifndef ZAP_TRANSFORM_KERNELS_HPP
+#define ZAP_TRANSFORM_KERNELS_HPP
+
+/* The kernels behind the batch transforms (batch_transform.hpp), compiled once per instruction set (batch_transform.cpp
+ * for SSE2 and batch_transform_avx2.cpp for AVX2) in the same way as the pixel kernels.  Each is a plain loop over the
+ * interleaved components that the compiler vectorises for the instruction set of its translation unit, instantiated on
+ * a tag type local to it.  It includes none of the maths headers (see tools/cpu.hpp).
+ *
+ * The matrix is 16 floats in column major order (mat4f::arr) and the source and destination must not overlap.
+ */
+
+#include <cstddef>
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
+namespace zap { namespace maths { namespace transform_kernels {
+
+struct kernel_table {
+    // count xyz triples, M*(P, 1) for points and M*(V, 0) for vectors
+    void (*transform_points)(const float* M, const float* src, float* dst, size_t count);
+    void (*transform_vectors)(const float* M, const float* src, float* dst, size_t count);
+    // As transform_vectors, scaling each result to unit length (zero vectors are left as they are)
+    void (*transform_normalise)(const float* M, const float* src, float* dst, size_t count);
+    // count xyzw quadruples, M*V
+    void (*transform_homogeneous)(const float* M, const float* src, float* dst, size_t count);
+};
+
+const kernel_table& sse2_kernels();
+const kernel_table& avx2_kernels();
+
+// The square root without <cmath>
+template <typename Tag>
+inline float sqrt_f(float x) {
+#if defined(_MSC_VER)
+    return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(x)));
+#else
+    return __builtin_sqrtf(x);
+#endif
+}
+
+template <typename Tag>
+void transform_points(const float* M, const float* src, float* dst, size_t count) {
+    const float m00 = M[0], m10 = M[1], m20 = M[2], m01 = M[4], m11 = M[5], m21 = M[6];
+    const float m02 = M[8], m12 = M[9], m22 = M[10], m03 = M[12], m13 = M[13], m23 = M[14];
+    for(size_t i = 0; i != count; ++i, src += 3, dst += 3) {
+        const float x = src[0], y = src[1], z = src[2];
+        dst[0] = m00*x + m01*y + m02*z + m03;
+        dst[1] = m10*x + m11*y + m12*z + m13;
+        dst[2] = m20*x + m21*y + m22*z + m23;
+    }
+}
+
+template <typename Tag>
+void transform_vectors(const float* M, const float* src, float* dst, size_t count) {
+    const float m00 = M[0], m10 = M[1], m20 = M[2], m01 = M[4], m11 = M[5], m21 = M[6];
+    const float m02 = M[8], m12 = M[9], m22 = M[10];
+    for(size_t i = 0; i != count; ++i, src += 3, dst += 3) {
+        const float x = src[0], y = src[1], z = src[2];
+        dst[0] = m00*x + m01*y + m02*z;
+        dst[1] = m10*x + m11*y + m12*z;
+        dst[2] = m20*x + m21*y + m22*z;
+    }
+}
+
+template <typename Tag>
+void transform_normalise(const float* M, const float* src, float* dst, size_t count) {
+    transform_vectors<Tag>(M, src, dst, count);
+    for(size_t i = 0; i != count; ++i, dst += 3) {
+        const float len_sq = dst[0]*dst[0] + dst[1]*dst[1] + dst[2]*dst[2];
+        const float scale = len_sq > 0.f ? 1.f/sqrt_f<Tag>(len_sq) : 1.f;
+        dst[0] *= scale; dst[1] *= scale; dst[2] *= scale;
+    }
+}
+
+template <typename Tag>
+void transform_homogeneous(const float* M, const float* src, float* dst, size_t count) {
+    for(size_t i = 0; i != count; ++i, src += 4, dst += 4) {
+        const float x = src[0], y = src[1], z = src[2], w = src[3];
+        for(int r = 0; r != 4; ++r) dst[r] = M[r]*x + M[4 + r]*y + M[8 + r]*z + M[12 + r]*w;
+    }
+}
+
+template <typename Tag>
+kernel_table make_kernel_table() {
+    kernel_table table;
+    table.transform_points = &transform_points<Tag>;
+    table.transform_vectors = &transform_vectors<Tag>;
+    table.transform_normalise = &transform_normalise<Tag>;
+    table.transform_homogeneous = &transform_homogeneous<Tag>;
+    return table;
+}
+
+}}}
+
+#endif //ZAP_TRANSFORM_KERNELS_HPP
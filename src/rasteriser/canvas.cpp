@@ -2,9 +2,13 @@
 
 #include <graphics/colour.hpp>
 #include "canvas.hpp"
+#include "span.hpp"
 
+#include <numeric>
+#include <cmath>
 #include <algorithm>
 #include <maths/io.hpp>
+#include <tools/scheduler.hpp>
 
 using namespace zap::engine;
 using namespace zap::rasteriser;
@@ -12,36 +16,83 @@ using namespace zap::rasteriser;
 using colour = zap::graphics::colour;
 
 template <typename PixelT>
-canvas<PixelT, pixel_buffer>::canvas() : mapped_ptr_(nullptr) {
+canvas<PixelT, pixel_buffer>::canvas() : mapped_ptr_(nullptr), raster_(&ring_[0]) {
 }
 
 template <typename PixelT>
-canvas<PixelT, pixel_buffer>::canvas(int width, int height) : mapped_ptr_(nullptr), clip_region_(0, width-1, 0, height-1) {
+canvas<PixelT, pixel_buffer>::canvas(int width, int height) : mapped_ptr_(nullptr), clip_region_(0, width-1, 0, height-1),
+    raster_(&ring_[0]) {
     initialise();
 }
 
 template <typename PixelT>
 canvas<PixelT, pixel_buffer>::~canvas() {
+    if(persistent_) {
+        for(auto& slot : ring_) {
+            if(slot.is_mapped()) { slot.bind(); slot.unmap(true); slot.release(); }
+        }
+    }
 }
 
+// Without persistent mapping, the raster is a single buffer mapped between map() and unmap().  Otherwise, the raster is
+// a ring of persistently mapped slots and each map() advances to the next slot, so that drawing never waits on the GPU
+// reading the slot uploaded last.  The regions drawn into the other slots since the new slot was last current are copied
+// forward from the previous slot before the first draw (see sync_slot()).
 template <typename PixelT>
 bool canvas<PixelT, pixel_buffer>::map() {
     if(mapped_ptr_) return true;
 
-    min_.x = width(); min_.y = height();
-    max_.x = 0;       max_.y = 0;
-    raster_.bind();
-    mapped_ptr_ = reinterpret_cast<pixel_t*>(raster_.map(buffer_access::BA_WRITE_ONLY, true));
-    return mapped_ptr_ != nullptr;
+    if(!persistent_) {
+        raster_->bind();
+        mapped_ptr_ = reinterpret_cast<pixel_t*>(raster_->map(buffer_access::BA_WRITE_ONLY, true));
+        return mapped_ptr_ != nullptr;
+    }
+
+    const int next = (slot_ + 1) % ring_size;
+    if(!fences_[next].wait()) { LOG_ERR("Timed out waiting for the canvas raster"); return false; }
+
+    stale_.clear();
+    for(int i = 0; i != ring_size; ++i) {
+        if(i != next) stale_.add(history_[i]);
+    }
+    history_[next].clear();
+
+    source_ = raster_;
+    slot_ = next;
+    raster_ = &ring_[slot_];
+    mapped_ptr_ = raster_->data();
+    return true;
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::unmap() {
-    raster_.unmap(true);
-    raster_.release();
+    if(!mapped_ptr_) return;
+
+    if(persistent_) {
+        if(!stale_.empty()) sync_slot();
+    } else {
+        raster_->unmap(true);
+        raster_->release();
+    }
     mapped_ptr_ = nullptr;
-    min_.x = maths::clamp(min_.x, 0, width()); max_.x = maths::clamp(max_.x, 0, width());
-    min_.y = maths::clamp(min_.y, 0, height()); max_.y = maths::clamp(max_.y, 0, height());
+}
+
+template <typename PixelT>
+void canvas<PixelT, pixel_buffer>::sync_slot() {
+    const size_t row_length = size_t(width());
+    for(const auto& r : stale_.rects()) {
+        const size_t w = size_t(r.right - r.left + 1);
+        if(w == row_length) {
+            const auto offset = raster_->idx(0, r.bottom), count = row_length*size_t(r.top - r.bottom + 1);
+            std::copy(source_->data() + offset, source_->data() + offset + count, raster_->data() + offset);
+        } else {
+            for(int y = r.bottom; y <= r.top; ++y) {
+                const auto offset = raster_->idx(r.left, y);
+                std::copy(source_->data() + offset, source_->data() + offset + w, raster_->data() + offset);
+            }
+        }
+    }
+    stale_.clear();
 }
 
 template <typename PixelT>
@@ -51,116 +102,109 @@ void canvas<PixelT, pixel_buffer>::initialise() {
     clear_colour_ = colour::white8;
 }
 
+// Each dirty rectangle is uploaded with a single call, directly from the raster (GL_UNPACK_ROW_LENGTH skips the pixels
+// outside the rectangle)
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::update(texture& tex) {
     if(mapped_ptr_) { LOG("Error, unmap canvas to update texture"); return; }
+    if(dirty_.empty()) return;
 
-    max_.x += 1; max_.y += 1;
-    auto w = max_.x - min_.x, h = max_.y - min_.y;
-    if(w > 0 && h > 0) {
-        if(tex.width() != width() || tex.height() != height()) {
-            tex.initialise(texture_type::TT_TEX2D,width(),height(),1,pixel_format::PF_RGB, pixel_datatype::PD_UNSIGNED_BYTE,false);
-        }
+    if(tex.width() != width() || tex.height() != height()) {
+        tex.initialise(texture_type::TT_TEX2D,width(),height(),1,pixel_format::PF_RGB, pixel_datatype::PD_UNSIGNED_BYTE,false);
+        dirty_.clear();
+        dirty_.add(clip_region_);
+    }
 
-        if(w == width() && h == height()) {
-            raster_.bind();
-            tex.copy(raster_, 0, 0, w, h, 0);
-            raster_.release();
-        } else if(w > block_width_) { // Perhaps calculate some percentage width of the scan line over which we just copy the block
-            if(!pbo_.is_allocated()) pbo_.allocate();
-            pbo_.bind();
-            pbo_.initialise(width(), h);
-            raster_.bind(buffer_type::BT_COPY_READ);
-            pbo_.copy_buffer(buffer_type::BT_COPY_READ, buffer_type::BT_PIXEL_UNPACK,
-                             raster_.idx(0, min_.y) * raster_.pixel_size(),
-                             0,
-                             h * width() * raster_.pixel_size());
-            raster_.release(buffer_type::BT_COPY_READ);
-            pbo_.bind();
-            tex.copy(pbo_, 0, min_.y, width(), h, 0);
-            pbo_.release();
-        } else {
-            if(!pbo_.is_allocated()) pbo_.allocate();
-            pbo_.bind();
-            pbo_.initialise(w, h);
-            raster_.bind(buffer_type::BT_COPY_READ);
-            for(int r = 0; r != h; ++r) {
-                pbo_.copy_buffer(buffer_type::BT_COPY_READ, buffer_type::BT_PIXEL_UNPACK,
-                                 raster_.idx(min_.x, min_.y + r) * raster_.pixel_size(),
-                                 r * w * raster_.pixel_size(),
-                                 w * raster_.pixel_size());
-            }
-            raster_.release(buffer_type::BT_COPY_READ);
-            pbo_.bind();
-            tex.copy(pbo_, min_.x, min_.y, w, h, 0);
-            pbo_.release();
-        }
+    for(const auto& r : dirty_.rects()) {
+        const size_t w = size_t(r.right - r.left + 1), h = size_t(r.top - r.bottom + 1);
+        tex.copy_region(*raster_, raster_->idx(r.left, r.bottom), size_t(width()), r.left, r.bottom, w, h);
+        bytes_uploaded_ += w*h*sizeof(pixel_t);
+        ++upload_count_;
     }
+    dirty_.clear();
+
+    if(persistent_) fences_[slot_].insert();
 }
 
 template <typename PixelT>
-inline void canvas<PixelT, pixel_buffer>::update_region(int x, int y) {
-    if(x < min_.x)  min_.x = x;
-    if(x > max_.x)  max_.x = x;
-    if(y < min_.y)  min_.y = y;
-    if(y > max_.y)  max_.y = y;
+inline void canvas<PixelT, pixel_buffer>::update_region(int x1, int y1, int x2, int y2) {
+    if(!stale_.empty()) sync_slot();
+    dirty_.add(x1, y1, x2, y2, clip_region_);
+    if(persistent_) history_[slot_].add(x1, y1, x2, y2, clip_region_);
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::resize(int width, int height) {
-    if(raster_.is_mapped()) { LOG_ERR("Cannot resize canvas while raster is mapped"); return; }
+    if(mapped_ptr_) { LOG_ERR("Cannot resize canvas while raster is mapped"); return; }
+
+    for(auto& f : fences_) f.reset();
+    for(auto& h : history_) h.clear();
+    stale_.clear();
+    dirty_.clear();
+    slot_ = 0;
+    raster_ = source_ = &ring_[0];
+    clip_region_.set(0, width-1, 0, height-1);
 
-    if(!raster_.is_allocated()) {
-        raster_.allocate();
-        raster_.bind();
-        raster_.initialise(width, height);
-        raster_.release();
-    } else {
-        raster_.bind();
-        raster_.resize(width, height);
-        if(map()) {
-            clear(clear_colour_);
-            unmap();
+    // Immutable storage cannot be resized, so the slots are reallocated
+    persistent_ = buffer::storage_supported();
+    if(persistent_) {
+        const auto flags = range_access::code(range_access::BA_MAP_READ | range_access::BA_MAP_WRITE |
+                                              range_access::BA_MAP_PERSISTENT | range_access::BA_MAP_COHERENT);
+        for(auto& slot : ring_) {
+            if(slot.is_allocated()) {
+                if(slot.is_mapped()) { slot.bind(); slot.unmap(true); slot.release(); }
+                slot.deallocate();
+            }
+            slot.allocate();
+            slot.bind();
+            if(!slot.initialise_storage(width, height, flags) || !slot.map(flags, true, 0, size_t(width)*size_t(height))) {
+                LOG_ERR("Failed to map the canvas raster persistently");
+                slot.release();
+                persistent_ = false;
+                break;
+            }
+            slot.release();
         }
     }
 
-    block_width_ = int(.8f*width);      // Update width over which we copy an entire block of memory
-    clip_region_.set(0, width-1, 0, height-1);
+    if(!persistent_) {
+        for(auto& slot : ring_) {
+            if(!slot.is_allocated()) continue;
+            if(slot.is_mapped()) { slot.bind(); slot.unmap(true); slot.release(); }
+            slot.deallocate();
+        }
+        raster_->allocate();
+        raster_->bind();
+        raster_->initialise(width, height);
+        raster_->release();
+    }
+
+    if(map()) {
+        clear(clear_colour_);
+        unmap();
+    }
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::clear(byte r, byte g, byte b) {
-    for(int y = 0, yend = height()-1; y <= yend; ++y) {
-        for(int x = 0, xend = width()-1; x <= xend; ++x) {
-            raster_(x,y).set3(r,g,b);
-        }
-    }
-    min_.set(0,0), max_.set(width()-1,height()-1);
+    clear(vec3b{r,g,b});
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::clear(const vec3b& rgb) {
-    for(int y = 0, yend = height()-1; y <= yend; ++y) {
-        for(int x = 0, xend = width()-1; x <= xend; ++x) {
-            raster_(x,y).set3(rgb);
-        }
-    }
-    min_.set(0,0), max_.set(width()-1,height()-1);
+    stale_.clear();                     // Overwritten, no need to bring the slot up to date
+    update_region(0, 0, width()-1, height()-1);
+    fill_span(raster_->data(), size_t(width())*size_t(height()), rgb);
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::clear() {
-    for(int y = 0, yend = height()-1; y <= yend; ++y) {
-        for(int x = 0, xend = width()-1; x <= xend; ++x) {
-            raster_(x,y).set3(clear_colour_);
-        }
-    }
-    min_.set(0,0), max_.set(width()-1,height()-1);
+    clear(clear_colour_);
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::line_impl(int x1, int y1, int x2, int y2) {
-    update_region(x1,y1); update_region(x2,y2);
+    update_region(x1,y1,x2,y2);
 
     int dx = x2 - x1, dy = y2 - y1;
 
@@ -182,43 +226,43 @@ void canvas<PixelT, pixel_buffer>::line_impl(int x1, int y1, int x2, int y2) {
             int d = 2*dy - dx;
             int incE = 2*dy, incNE = 2*(dy - dx);
             int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
+            (*raster_)(x,y).set3(pen_colour_);
             while(x < x2) {
                 if(d <= 0) { d += incE;  ++x; }
                 else       { d += incNE; ++x; ++y; }
-                raster_(x,y).set3(pen_colour_);
+                (*raster_)(x,y).set3(pen_colour_);
             }
         } else if(-1.f < m && m < 0) {                  // Octant 7 - (-1 .. 0)
             int d = 2*dy + dx;
             int incE = 2*dy, incSE = 2*(dy + dx);
             int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
+            (*raster_)(x,y).set3(pen_colour_);
             while(x < x2) {
                 if(d >= 0) { d += incE;  ++x; }
                 else       { d += incSE; ++x; --y; }
-                raster_(x,y).set3(pen_colour_);
+                (*raster_)(x,y).set3(pen_colour_);
             }
         } else if(1.f < m) {                            // Octant 1 - (1 .. inf)
             std::swap(dx, dy);
             int d = 2*dy - dx;
             int incN = 2*dy, incNE = 2*(dy - dx);
             int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
+            (*raster_)(x,y).set3(pen_colour_);
             while(y < y2) {
                 if(d <= 0) { d += incN;  ++y; }
                 else       { d += incNE; ++y; ++x; }
-                raster_(x,y).set3(pen_colour_);
+                (*raster_)(x,y).set3(pen_colour_);
             }
         } else if(m < -1.f) {                           // Octant 6 - (-inf .. -1)
             std::swap(dx, dy);
             int d = 2*dy + dx;
             int incS = 2*dy, incSE = 2*(dy + dx);
             int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
+            (*raster_)(x,y).set3(pen_colour_);
             while(y > y2) {
                 if(d <= 0) { d += incS;  --y; }
                 else       { d += incSE; --y; ++x; }
-                raster_(x,y).set3(pen_colour_);
+                (*raster_)(x,y).set3(pen_colour_);
             }
         }
     } else { // x2 < x1
@@ -226,43 +270,43 @@ void canvas<PixelT, pixel_buffer>::line_impl(int x1, int y1, int x2, int y2) {
             int d = 2*dy - dx;
             int incW = 2*dy, incSW = 2*(dy - dx);
             int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
+            (*raster_)(x,y).set3(pen_colour_);
             while(x > x2) {
                 if(d > 0) { d += incW;  --x; }
                 else      { d += incSW; --x; --y; }
-                raster_(x,y).set3(pen_colour_);
+                (*raster_)(x,y).set3(pen_colour_);
             }
         } else if(-1.f < m && m < 0) {                  // Octant 3 - (-1 .. 0)
             int d = 2*dy + dx;
             int incW = 2*dy, incNW = 2*(dy + dx);
             int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
+            (*raster_)(x,y).set3(pen_colour_);
             while(x > x2) {
                 if(d < 0) { d += incW;  --x; }
                 else      { d += incNW; --x; ++y; }
-                raster_(x,y).set3(pen_colour_);
+                (*raster_)(x,y).set3(pen_colour_);
             }
         } else if(1.f < m) {                            // Octant 5 - (1 .. inf)
             std::swap(dx, dy);
             int d = 2*dy - dx;
             int incS = 2*dy, incSW = 2*(dy - dx);
             int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
+            (*raster_)(x,y).set3(pen_colour_);
             while(y > y2) {
                 if(d > 0) { d += incS;  --y; }
                 else      { d += incSW; --y; --x; }
-                raster_(x,y).set3(pen_colour_);
+                (*raster_)(x,y).set3(pen_colour_);
             }
         } else if(m < -1.f) {                           // Octant 2 - (-inf .. -1)
             std::swap(dx, dy);
             int d = 2*dy + dx;
             int incN = 2*dy, incNW = 2*(dy + dx);
             int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
+            (*raster_)(x,y).set3(pen_colour_);
             while(y < y2) {
                 if(d > 0) { d += incN;  ++y; }
                 else      { d += incNW; ++y; --x; }
-                raster_(x,y).set3(pen_colour_);
+                (*raster_)(x,y).set3(pen_colour_);
             }
         }
     }
@@ -270,7 +314,7 @@ void canvas<PixelT, pixel_buffer>::line_impl(int x1, int y1, int x2, int y2) {
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::circle(int cx, int cy, int r) {
-    update_region(cx-r,cy-r); update_region(cx+r,cy+r);
+    update_region(cx-r,cy-r,cx+r,cy+r);
 
     int x = 0, y = r, d = 1 - r;
     int incE = 3, incSE = -2 * r + 5;
@@ -289,7 +333,7 @@ void canvas<PixelT, pixel_buffer>::circle(int cx, int cy, int r) {
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::ellipse(int cx, int cy, int major, int minor) {
-    update_region(cx-major,cy-minor); update_region(cx+major,cy+minor);
+    update_region(cx-major,cy-minor,cx+major,cy+minor);
 
     const int major2 = 2*major*major, minor2 = 2*minor*minor;
     int x = -major, y = 0;
@@ -307,7 +351,7 @@ void canvas<PixelT, pixel_buffer>::ellipse(int cx, int cy, int major, int minor)
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::rect(int x1, int y1, int x2, int y2) {
-    update_region(x1,y1); update_region(x2,y2);
+    update_region(x1,y1,x2,y2);
     int left, bottom, right, top;
     if(x1 < x2) { left = x1; right = x2; }
     else        { left = x2; right = x1; }
@@ -323,7 +367,7 @@ void canvas<PixelT, pixel_buffer>::rect(int x1, int y1, int x2, int y2) {
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::filled_rect(int x1, int y1, int x2, int y2) {
-    update_region(x1,y1); update_region(x2,y2);
+    update_region(x1,y1,x2,y2);
     int left, bottom, right, top;
     if(x1 < x2) { left = x1; right = x2; }
     else        { left = x2; right = x1; }
@@ -333,26 +377,22 @@ void canvas<PixelT, pixel_buffer>::filled_rect(int x1, int y1, int x2, int y2) {
     if(right-left <= 0) return;
 
     // Use principle of bottom and left being part of primitive, top and right, not.
-    for(int c = left; c < right; ++c) raster_(c,bottom).set3(fill_colour_);
-
-    const auto diff = right - left;
-    for(int r = bottom+1; r < top; ++r) {
-        raster_.copy(raster_.idx(left,bottom), raster_.idx(left,r), diff);
-    }
+    const auto diff = size_t(right - left);
+    fill_span(raster_->data() + raster_->idx(left,bottom), diff, fill_colour_);
+    for(int r = bottom+1; r < top; ++r) fill_span(raster_->data() + raster_->idx(left,r), diff, fill_colour_);
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::vertical_line(int x1, int y1, int y2) {
     if(y1 > y2) std::swap(y1, y2); //assert(y1 < y2 && "vertical_line requires y1 < y2");
     int y = y1;
-    while(y <= y2) raster_(x1,y++).set3(pen_colour_);
+    while(y <= y2) (*raster_)(x1,y++).set3(pen_colour_);
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::horizontal_line(int x1, int x2, int y1) {
     assert(x1 < x2 && "horizontal_line requires x1 < x2");
-    int x = x1;
-    while(x <= x2) raster_(x++,y1).set3(pen_colour_);
+    fill_span(raster_->data() + raster_->idx(x1,y1), size_t(x2 - x1 + 1), pen_colour_);
 }
 
 template <typename PixelT>
@@ -361,13 +401,13 @@ void canvas<PixelT, pixel_buffer>::diagonal_line(int x1, int y1, int x2, int y2)
     int x = x1, y = y1;
     if(xd > 0) {
         while(x <= x2) {
-            raster_(x, y).set3(pen_colour_);
+            (*raster_)(x, y).set3(pen_colour_);
             x += xd;
             y += yd;
         }
     } else {
         while(x >= x2) {
-            raster_(x, y).set3(pen_colour_);
+            (*raster_)(x, y).set3(pen_colour_);
             x += xd;
             y += yd;
         }
@@ -376,16 +416,16 @@ void canvas<PixelT, pixel_buffer>::diagonal_line(int x1, int y1, int x2, int y2)
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::circle_points(int cx, int cy, int x, int y) {
-    raster_(cx + x, cy + y).set3(pen_colour_); raster_(cx + x, cy - y).set3(pen_colour_);
-    raster_(cx - x, cy + y).set3(pen_colour_); raster_(cx - x, cy - y).set3(pen_colour_);
-    raster_(cx + y, cy + x).set3(pen_colour_); raster_(cx + y, cy - x).set3(pen_colour_);
-    raster_(cx - y, cy + x).set3(pen_colour_); raster_(cx - y, cy - x).set3(pen_colour_);
+    (*raster_)(cx + x, cy + y).set3(pen_colour_); (*raster_)(cx + x, cy - y).set3(pen_colour_);
+    (*raster_)(cx - x, cy + y).set3(pen_colour_); (*raster_)(cx - x, cy - y).set3(pen_colour_);
+    (*raster_)(cx + y, cy + x).set3(pen_colour_); (*raster_)(cx + y, cy - x).set3(pen_colour_);
+    (*raster_)(cx - y, cy + x).set3(pen_colour_); (*raster_)(cx - y, cy - x).set3(pen_colour_);
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixel_buffer>::ellipse_points(int cx, int cy, int x, int y) {
-    raster_(cx + x, cy + y).set3(pen_colour_); raster_(cx - x, cy + y).set3(pen_colour_);
-    raster_(cx + x, cy - y).set3(pen_colour_); raster_(cx - x, cy - y).set3(pen_colour_);
+    (*raster_)(cx + x, cy + y).set3(pen_colour_); (*raster_)(cx - x, cy + y).set3(pen_colour_);
+    (*raster_)(cx + x, cy - y).set3(pen_colour_); (*raster_)(cx - x, cy - y).set3(pen_colour_);
 }
 
 enum clip_plane {
@@ -539,15 +579,116 @@ struct edge_table {
     }
 };
 
-template <typename PixelT>
-void canvas<PixelT, pixel_buffer>::polygon(const std::vector<vec2i>& polygon) {
-    if(polygon.size() < 3) { LOG_ERR("Polygon must consist of at least three vertices"); return; }
-    edge_table global_et(polygon);
-    if(global_et.buckets.size() == 0) { LOG_ERR("Edge Table empty"); return; }
+// The scan conversion of the canvases, shared by immediate drawing and the tile rasteriser of the deferred mode.
+// plot(x, y) is called for each pixel of the primitive and span(x1, x2, y) for each [x1, x2] run of pixels.
+
+namespace {
+
+inline int64_t floor_div(int64_t n, int64_t d) { return n >= 0 ? n/d : -((d - n - 1)/d); }
+inline int64_t ceil_div(int64_t n, int64_t d) { return -floor_div(-n, d); }
+
+// Plots the pixels of the line inside the clip region, only the steps of the line inside the region are taken.  The eight
+// octants are reduced to stepping along the major axis with the decision variable d = 2a - b, where b and a are the major
+// and minor extents of the line.  The minor step is taken on d > 0, or on d >= 0 for lines drawn right to left.  As the
+// decision variable after k steps is bounded, the number of minor steps after k steps has the closed form
+// m(k) = floor((2ka + b - tie)/2b), which gives the range of steps inside the clip region and the state at its start.
+template <typename PlotFnc, typename SpanFnc>
+void scan_line(int x1, int y1, int x2, int y2, const recti& clip, PlotFnc&& plot, SpanFnc&& span) {
+    // Horizontal or Vertical Case
+    if(x1 == x2 || y1 == y2) {
+        const int left = std::max(std::min(x1, x2), clip.left), right = std::min(std::max(x1, x2), clip.right);
+        const int bottom = std::max(std::min(y1, y2), clip.bottom), top = std::min(std::max(y1, y2), clip.top);
+        if(left > right) return;
+        for(int y = bottom; y <= top; ++y) span(left, right, y);
+        return;
+    }
+
+    const bool x_major = std::abs(x2 - x1) >= std::abs(y2 - y1);
+    const int M1 = x_major ? x1 : y1, m1 = x_major ? y1 : x1;
+    const int dM = x_major ? x2 - x1 : y2 - y1, dm = x_major ? y2 - y1 : x2 - x1;
+    const int sM = dM > 0 ? 1 : -1, sm = dm > 0 ? 1 : -1;
+    const int64_t b = std::abs(dM), a = std::abs(dm);
+    const int cM0 = x_major ? clip.left : clip.bottom, cM1 = x_major ? clip.right : clip.top;
+    const int cm0 = x_major ? clip.bottom : clip.left, cm1 = x_major ? clip.top : clip.right;
+
+    // The steps [k0, k1] along the major axis and the minor steps [mlo, mhi] inside the clip region
+    int64_t k0 = sM > 0 ? cM0 - M1 : M1 - cM1, k1 = sM > 0 ? cM1 - M1 : M1 - cM0;
+    const int64_t mlo = sm > 0 ? cm0 - m1 : m1 - cm1, mhi = sm > 0 ? cm1 - m1 : m1 - cm0;
+    k0 = std::max(k0, int64_t(0)); k1 = std::min(k1, b);
+
+    auto point = [&](int64_t k, int64_t m) {
+        const int M = M1 + sM*int(k), m_ = m1 + sm*int(m);
+        x_major ? plot(M, m_) : plot(m_, M);
+    };
+
+    if(a == b) {                                                // Diagonal Case
+        k0 = std::max(k0, mlo); k1 = std::min(k1, mhi);
+        for(int64_t k = k0; k <= k1; ++k) point(k, k);
+        return;
+    }
+
+    const int64_t tie = x1 < x2 ? 1 : 0, offset = b - tie;
+    k0 = std::max(k0, ceil_div(2*b*mlo - offset, 2*a));
+    k1 = std::min(k1, floor_div(2*b*(mhi + 1) - offset - 1, 2*a));
+    if(k0 > k1) return;
+
+    int64_t m = (2*k0*a + offset)/(2*b);
+    int64_t d = 2*a - b + 2*k0*a - 2*m*b;
+    const int64_t incA = 2*a, incB = 2*(a - b);
+    for(int64_t k = k0; k <= k1; ++k) {
+        point(k, m);
+        if(d > 0 || (d == 0 && !tie)) { d += incB; ++m; }
+        else                            d += incA;
+    }
+}
+
+template <typename PlotFnc>
+void scan_circle(int cx, int cy, int r, PlotFnc&& plot) {
+    auto circle_points = [&plot](int cx, int cy, int x, int y) {
+        plot(cx + x, cy + y); plot(cx + x, cy - y); plot(cx - x, cy + y); plot(cx - x, cy - y);
+        plot(cx + y, cy + x); plot(cx + y, cy - x); plot(cx - y, cy + x); plot(cx - y, cy - x);
+    };
+
+    int x = 0, y = r, d = 1 - r;
+    int incE = 3, incSE = -2 * r + 5;
+    circle_points(cx, cy, x, y);
+
+    while(y > x) {
+        if(d < 0) {
+            d += incE; incE += 2; incSE += 2;
+        } else {
+            d += incSE; incE += 2; incSE += 4; y--;
+        }
+        ++x;
+        circle_points(cx, cy, x, y);
+    }
+}
 
+template <typename PlotFnc>
+void scan_ellipse(int cx, int cy, int major, int minor, PlotFnc&& plot) {
+    auto ellipse_points = [&plot](int cx, int cy, int x, int y) {
+        plot(cx + x, cy + y); plot(cx - x, cy + y); plot(cx + x, cy - y); plot(cx - x, cy - y);
+    };
+
+    const int major2 = 2*major*major, minor2 = 2*minor*minor;
+    int x = -major, y = 0;
+    int e2 = minor, dx = (1+2*x)*e2*e2;
+    int dy = x*x, err = dx+dy;
+    do {
+        ellipse_points(cx, cy, x, y);
+        e2 = 2*err;
+        if(e2 >= dx) { x++; dx += minor2; err += dx; }
+        if(e2 <= dy) { y++; dy += major2; err += dy; }
+    } while(x <= 0);
+
+    while(y++ < minor) ellipse_points(cx, cy, x, y);
+}
+
+template <typename SpanFnc>
+void scan_polygon(const edge_table& global_et, SpanFnc&& span) {
     std::vector<edge_table::edge> AET;
 
-    int curr_bucket = 0;
+    size_t curr_bucket = 0;
     int curr_y = global_et.min_y;
     while(curr_y != global_et.max_y) {
         while(global_et.buckets.size() != curr_bucket && global_et.buckets[curr_bucket].y == curr_y) {
@@ -566,11 +707,9 @@ void canvas<PixelT, pixel_buffer>::polygon(const std::vector<vec2i>& polygon) {
             return A.xmin < B.xmin;
         });
 
-        for(int i = 0, end = (int)AET.size(); i != end; i += 2) {
-            auto& se = AET[2*i]; auto& ee = AET[2*i+1];
-            for(int x = se.xmin, xend = ee.xmin; x <= xend; ++x) {
-                raster_(x,curr_y).set3(fill_colour_);
-            }
+        for(size_t i = 0, end = AET.size(); i != end; i += 2) {
+            auto& se = AET[i]; auto& ee = AET[i+1];
+            span(se.xmin, ee.xmin, curr_y);
             if(se.denominator != 0) {
                 se.increment += se.numerator;
                 while(se.increment > se.denominator) {
@@ -589,6 +728,73 @@ void canvas<PixelT, pixel_buffer>::polygon(const std::vector<vec2i>& polygon) {
     }
 }
 
+}
+
+template <typename PixelT>
+void canvas<PixelT, pixel_buffer>::polygon(const std::vector<vec2i>& polygon) {
+    if(polygon.size() < 3) { LOG_ERR("Polygon must consist of at least three vertices"); return; }
+    edge_table global_et(polygon);
+    if(global_et.buckets.size() == 0) { LOG_ERR("Edge Table empty"); return; }
+
+    int min_x, max_x;
+    std::tie(min_x, max_x) = zap::maths::find_range(polygon, [](const vec2i& v) { return v.x; });
+    update_region(min_x, global_et.min_y, max_x, global_et.max_y);
+
+    scan_polygon(global_et, [this](int x1, int x2, int y) {
+        if(x1 <= x2) fill_span(raster_->data() + raster_->idx(x1, y), size_t(x2 - x1 + 1), fill_colour_);
+    });
+}
+
+template <typename PixelT>
+struct canvas<PixelT, pixmap>::display_list {
+    enum class op {
+        PIXEL,
+        LINE,
+        CIRCLE,
+        ELLIPSE,
+        FILLED_RECT,
+        POLYGON,
+        PATH,
+        CLEAR
+    };
+
+    struct command {
+        op type;
+        vec3b colour;
+        int p[4];                               // The parameters of the primitive, POLYGON and PATH store an index
+        recti bound;                            // The pixels the primitive may cover (inclusive), clamped when binned
+    };
+
+    // The scanline runs of a polygon, runs[rows[y - min_y], rows[y - min_y + 1]) are the [x1, x2] runs of row y
+    struct span_table {
+        int min_y;
+        std::vector<uint32_t> rows;
+        std::vector<vec2i> runs;
+    };
+
+    // The coverage spans of a path, spans[rows[y - min_y], rows[y - min_y + 1]) are the spans of row y
+    struct coverage_table {
+        int min_y;
+        std::vector<uint32_t> rows;
+        std::vector<coverage_span> spans;
+    };
+
+    explicit display_list(int tile_size) : tile_size(tile_size) { }
+
+    void record(op type, const vec3b& colour, int a, int b, int c, int d, const recti& bound) {
+        commands.push_back(command{type, colour, {a, b, c, d}, bound});
+    }
+
+    int tile_size;
+    std::vector<command> commands;
+    std::vector<edge_table> polygons;
+    std::vector<span_table> spans;              // Scan converted from polygons once per flush, shared by the tiles
+    std::vector<std::pair<path, fill_rule>> paths;
+    std::vector<coverage_table> coverage;       // Rasterised from paths once per flush
+    std::vector<uint32_t> bin_offsets;          // bins[bin_offsets[t], bin_offsets[t+1]) are the commands of tile t,
+    std::vector<uint32_t> bins;                 // in draw order
+};
+
 template <typename PixelT>
 canvas<PixelT, pixmap>::canvas() : mapped_ptr_(nullptr) {
 }
@@ -612,6 +818,7 @@ void canvas<PixelT, pixmap>::initialise() {
 template <typename PixelT>
 void canvas<PixelT, pixmap>::update(texture& tex) {
     if(mapped_ptr_) { LOG("Error, unmap canvas to update texture"); return; }
+    if(display_list_) flush();
 
     max_.x += 1; max_.y += 1;
     auto w = max_.x - min_.x, h = max_.y - min_.y;
@@ -639,31 +846,37 @@ void canvas<PixelT, pixmap>::resize(int width, int height) {
 
 template <typename PixelT>
 void canvas<PixelT, pixmap>::clear(byte r, byte g, byte b) {
-    for(int y = 0, yend = height()-1; y <= yend; ++y) {
-        for(int x = 0, xend = width()-1; x <= xend; ++x) {
-            raster_(x,y).set3(r,g,b);
-        }
+    if(display_list_) {
+        display_list_->record(display_list::op::CLEAR, vec3b{r,g,b}, 0, 0, 0, 0, recti{0, width()-1, 0, height()-1});
+        min_.set(0,0), max_.set(width()-1,height()-1);
+        return;
     }
+
+    fill_span(raster_.data(), size_t(width())*size_t(height()), vec3b{r,g,b});
     min_.set(0,0), max_.set(width()-1,height()-1);
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixmap>::clear(const vec3b& rgb) {
-    for(int y = 0, yend = height()-1; y <= yend; ++y) {
-        for(int x = 0, xend = width()-1; x <= xend; ++x) {
-            raster_(x,y).set3(rgb);
-        }
+    if(display_list_) {
+        display_list_->record(display_list::op::CLEAR, rgb, 0, 0, 0, 0, recti{0, width()-1, 0, height()-1});
+        min_.set(0,0), max_.set(width()-1,height()-1);
+        return;
     }
+
+    fill_span(raster_.data(), size_t(width())*size_t(height()), rgb);
     min_.set(0,0), max_.set(width()-1,height()-1);
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixmap>::clear() {
-    for(int y = 0, yend = height()-1; y <= yend; ++y) {
-        for(int x = 0, xend = width()-1; x <= xend; ++x) {
-            raster_(x,y).set3(clear_colour_);
-        }
+    if(display_list_) {
+        display_list_->record(display_list::op::CLEAR, clear_colour_, 0, 0, 0, 0, recti{0, width()-1, 0, height()-1});
+        min_.set(0,0), max_.set(width()-1,height()-1);
+        return;
     }
+
+    fill_span(raster_.data(), size_t(width())*size_t(height()), clear_colour_);
     min_.set(0,0), max_.set(width()-1,height()-1);
 }
 
@@ -671,147 +884,40 @@ template <typename PixelT>
 void canvas<PixelT, pixmap>::line_impl(int x1, int y1, int x2, int y2) {
     update_region(x1,y1); update_region(x2,y2);
 
-    int dx = x2 - x1, dy = y2 - y1;
-
-    // Horizontal or Vertical Case
-    if(dx == 0) {
-        y1 < y2 ? vertical_line(x1, y1, y2) : vertical_line(x1, y2, y1);
-        return;
-    } else if(dy == 0) {
-        x1 < x2 ? horizontal_line(x1, x2, y1) : horizontal_line(x2, x1, y1);
+    const recti bound{std::min(x1, x2), std::max(x1, x2), std::min(y1, y2), std::max(y1, y2)};
+    if(display_list_) {
+        display_list_->record(display_list::op::LINE, pen_colour_, x1, y1, x2, y2, bound);
         return;
     }
 
-    float m = float(dy)/dx;
-
-    if(maths::eq(maths::abs(m), 1.f)) {
-        diagonal_line(x1, y1, x2, y2);
-    } else if(x1 < x2) {
-        if(0 < m && m < 1.f) {                          // Octant 0 - (0 .. 1)
-            int d = 2*dy - dx;
-            int incE = 2*dy, incNE = 2*(dy - dx);
-            int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
-            while(x < x2) {
-                if(d <= 0) { d += incE;  ++x; }
-                else       { d += incNE; ++x; ++y; }
-                raster_(x,y).set3(pen_colour_);
-            }
-        } else if(-1.f < m && m < 0) {                  // Octant 7 - (-1 .. 0)
-            int d = 2*dy + dx;
-            int incE = 2*dy, incSE = 2*(dy + dx);
-            int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
-            while(x < x2) {
-                if(d >= 0) { d += incE;  ++x; }
-                else       { d += incSE; ++x; --y; }
-                raster_(x,y).set3(pen_colour_);
-            }
-        } else if(1.f < m) {                            // Octant 1 - (1 .. inf)
-            std::swap(dx, dy);
-            int d = 2*dy - dx;
-            int incN = 2*dy, incNE = 2*(dy - dx);
-            int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
-            while(y < y2) {
-                if(d <= 0) { d += incN;  ++y; }
-                else       { d += incNE; ++y; ++x; }
-                raster_(x,y).set3(pen_colour_);
-            }
-        } else if(m < -1.f) {                           // Octant 6 - (-inf .. -1)
-            std::swap(dx, dy);
-            int d = 2*dy + dx;
-            int incS = 2*dy, incSE = 2*(dy + dx);
-            int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
-            while(y > y2) {
-                if(d <= 0) { d += incS;  --y; }
-                else       { d += incSE; --y; ++x; }
-                raster_(x,y).set3(pen_colour_);
-            }
-        }
-    } else { // x2 < x1
-        if(0 < m && m < 1.f) {                          // Octant 4 - (0 .. 1)
-            int d = 2*dy - dx;
-            int incW = 2*dy, incSW = 2*(dy - dx);
-            int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
-            while(x > x2) {
-                if(d > 0) { d += incW;  --x; }
-                else      { d += incSW; --x; --y; }
-                raster_(x,y).set3(pen_colour_);
-            }
-        } else if(-1.f < m && m < 0) {                  // Octant 3 - (-1 .. 0)
-            int d = 2*dy + dx;
-            int incW = 2*dy, incNW = 2*(dy + dx);
-            int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
-            while(x > x2) {
-                if(d < 0) { d += incW;  --x; }
-                else      { d += incNW; --x; ++y; }
-                raster_(x,y).set3(pen_colour_);
-            }
-        } else if(1.f < m) {                            // Octant 5 - (1 .. inf)
-            std::swap(dx, dy);
-            int d = 2*dy - dx;
-            int incS = 2*dy, incSW = 2*(dy - dx);
-            int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
-            while(y > y2) {
-                if(d > 0) { d += incS;  --y; }
-                else      { d += incSW; --y; --x; }
-                raster_(x,y).set3(pen_colour_);
-            }
-        } else if(m < -1.f) {                           // Octant 2 - (-inf .. -1)
-            std::swap(dx, dy);
-            int d = 2*dy + dx;
-            int incN = 2*dy, incNW = 2*(dy + dx);
-            int x = x1, y = y1;
-            raster_(x,y).set3(pen_colour_);
-            while(y < y2) {
-                if(d > 0) { d += incN;  ++y; }
-                else      { d += incNW; ++y; --x; }
-                raster_(x,y).set3(pen_colour_);
-            }
-        }
-    }
+    scan_line(x1, y1, x2, y2, bound, [this](int x, int y) { raster_(x,y).set3(pen_colour_); },
+              [this](int x1, int x2, int y) { fill_span(raster_.data(x1,y), size_t(x2 - x1 + 1), pen_colour_); });
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixmap>::circle(int cx, int cy, int r) {
     update_region(cx-r,cy-r); update_region(cx+r,cy+r);
 
-    int x = 0, y = r, d = 1 - r;
-    int incE = 3, incSE = -2 * r + 5;
-    circle_points(cx, cy, x, y);
-
-    while(y > x) {
-        if(d < 0) {
-            d += incE; incE += 2; incSE += 2;
-        } else {
-            d += incSE; incE += 2; incSE += 4; y--;
-        }
-        ++x;
-        circle_points(cx, cy, x, y);
+    if(display_list_) {
+        display_list_->record(display_list::op::CIRCLE, pen_colour_, cx, cy, r, 0, recti{cx-r, cx+r, cy-r, cy+r});
+        return;
     }
+
+    scan_circle(cx, cy, r, [this](int x, int y) { raster_(x,y).set3(pen_colour_); });
 }
 
 template <typename PixelT>
 void canvas<PixelT, pixmap>::ellipse(int cx, int cy, int major, int minor) {
     update_region(cx-major,cy-minor); update_region(cx+major,cy+minor);
 
-    const int major2 = 2*major*major, minor2 = 2*minor*minor;
-    int x = -major, y = 0;
-    int e2 = minor, dx = (1+2*x)*e2*e2;
-    int dy = x*x, err = dx+dy;
-    do {
-        ellipse_points(cx, cy, x, y);
-        e2 = 2*err;
-        if(e2 >= dx) { x++; dx += minor2; err += dx; }
-        if(e2 <= dy) { y++; dy += major2; err += dy; }
-    } while(x <= 0);
+    if(display_list_) {
+        // Padded by a pixel, the final steps of degenerate ellipses may overshoot the axes
+        display_list_->record(display_list::op::ELLIPSE, pen_colour_, cx, cy, major, minor,
+                              recti{cx-major-1, cx+major+1, cy-minor-1, cy+minor+1});
+        return;
+    }
 
-    while(y++ < minor) ellipse_points(cx, cy, x, y);
+    scan_ellipse(cx, cy, major, minor, [this](int x, int y) { raster_(x,y).set3(pen_colour_); });
 }
 
 template <typename PixelT>
@@ -841,67 +947,24 @@ void canvas<PixelT, pixmap>::filled_rect(int x1, int y1, int x2, int y2) {
 
     if(right-left <= 0) return;
 
-    // Use principle of bottom and left being part of primitive, top and right, not.
-    for(int c = left; c < right; ++c) raster_(c,bottom).set3(fill_colour_);
-
-    const auto diff = right - left;
-    for(int r = bottom+1; r < top; ++r) {
-        raster_.copy(raster_.offset(left,bottom), raster_.offset(left,r), diff);
+    if(display_list_) {
+        display_list_->record(display_list::op::FILLED_RECT, fill_colour_, left, bottom, right, top,
+                              recti{left, right-1, bottom, std::max(bottom, top-1)});
+        return;
     }
+
+    // Use principle of bottom and left being part of primitive, top and right, not.
+    const auto diff = size_t(right - left);
+    fill_span(raster_.data(left,bottom), diff, fill_colour_);
+    for(int r = bottom+1; r < top; ++r) fill_span(raster_.data(left,r), diff, fill_colour_);
 }
 
 template <typename PixelT>
 size_t canvas<PixelT, pixmap>::copy(const typename canvas<PixelT, pixmap>::pixmap_t& src, int trg_x, int trg_y, const recti& bound) {
+    if(display_list_) flush();
     return raster_.copy(src, trg_x, trg_y, bound);
 }
 
-template <typename PixelT>
-void canvas<PixelT, pixmap>::vertical_line(int x1, int y1, int y2) {
-    if(y1 > y2) std::swap(y1, y2); //assert(y1 < y2 && "vertical_line requires y1 < y2");
-    int y = y1;
-    while(y <= y2) raster_(x1,y++).set3(pen_colour_);
-}
-
-template <typename PixelT>
-void canvas<PixelT, pixmap>::horizontal_line(int x1, int x2, int y1) {
-    assert(x1 < x2 && "horizontal_line requires x1 < x2");
-    int x = x1;
-    while(x <= x2) raster_(x++,y1).set3(pen_colour_);
-}
-
-template <typename PixelT>
-void canvas<PixelT, pixmap>::diagonal_line(int x1, int y1, int x2, int y2) {
-    int xd = maths::sign(x2 - x1), yd = maths::sign(y2 - y1);
-    int x = x1, y = y1;
-    if(xd > 0) {
-        while(x <= x2) {
-            raster_(x, y).set3(pen_colour_);
-            x += xd;
-            y += yd;
-        }
-    } else {
-        while(x >= x2) {
-            raster_(x, y).set3(pen_colour_);
-            x += xd;
-            y += yd;
-        }
-    }
-}
-
-template <typename PixelT>
-void canvas<PixelT, pixmap>::circle_points(int cx, int cy, int x, int y) {
-    raster_(cx + x, cy + y).set3(pen_colour_); raster_(cx + x, cy - y).set3(pen_colour_);
-    raster_(cx - x, cy + y).set3(pen_colour_); raster_(cx - x, cy - y).set3(pen_colour_);
-    raster_(cx + y, cy + x).set3(pen_colour_); raster_(cx + y, cy - x).set3(pen_colour_);
-    raster_(cx - y, cy + x).set3(pen_colour_); raster_(cx - y, cy - x).set3(pen_colour_);
-}
-
-template <typename PixelT>
-void canvas<PixelT, pixmap>::ellipse_points(int cx, int cy, int x, int y) {
-    raster_(cx + x, cy + y).set3(pen_colour_); raster_(cx - x, cy + y).set3(pen_colour_);
-    raster_(cx + x, cy - y).set3(pen_colour_); raster_(cx - x, cy - y).set3(pen_colour_);
-}
-
 // Cohen-Sutherland line clipper
 template <typename PixelT>
 void canvas<PixelT, pixmap>::line(int x1, int y1, int x2, int y2) {
@@ -980,47 +1043,224 @@ void canvas<PixelT, pixmap>::polygon(const std::vector<vec2i>& polygon) {
     edge_table global_et(polygon);
     if(global_et.buckets.size() == 0) { LOG_ERR("Edge Table empty"); return; }
 
-    std::vector<edge_table::edge> AET;
+    if(display_list_) {
+        if(global_et.min_y == global_et.max_y) return;
+        int min_x, max_x;
+        std::tie(min_x, max_x) = zap::maths::find_range(polygon, [](const vec2i& v) { return v.x; });
+        const recti bound{min_x, max_x, global_et.min_y, global_et.max_y-1};
+        display_list_->record(display_list::op::POLYGON, fill_colour_, int(display_list_->polygons.size()), 0, 0, 0,
+                              bound);
+        display_list_->polygons.emplace_back(std::move(global_et));
+        return;
+    }
 
-    int curr_bucket = 0;
-    int curr_y = global_et.min_y;
-    while(curr_y != global_et.max_y) {
-        while(global_et.buckets.size() != curr_bucket && global_et.buckets[curr_bucket].y == curr_y) {
-            auto& current = global_et.buckets[curr_bucket];
-            std::copy(current.edges.begin(), current.edges.end(), std::back_inserter(AET));
-            ++curr_bucket;
-        }
+    scan_polygon(global_et, [this](int x1, int x2, int y) {
+        if(x1 <= x2) fill_span(raster_.data(x1,y), size_t(x2 - x1 + 1), fill_colour_);
+    });
+}
 
-        auto it = std::remove_if(std::begin(AET), std::end(AET), [&curr_y](const edge_table::edge& ed) {
-            return ed.ymax == curr_y;
-        });
-        if(it != std::end(AET)) AET.erase(it, AET.end());
-        if(AET.size() % 2 != 0) { LOG_ERR("AET contains non-even number of edges"); return; }
+template <typename PixelT>
+void canvas<PixelT, pixmap>::fill_path(const path& P, fill_rule rule) {
+    path_impl(P, rule, fill_colour_);
+}
 
-        std::sort(std::begin(AET), std::end(AET), [](const edge_table::edge& A, const edge_table::edge& B) {
-            return A.xmin < B.xmin;
-        });
+template <typename PixelT>
+void canvas<PixelT, pixmap>::stroke(const std::vector<vec2f>& polyline, float width, bool closed) {
+    path outline;
+    outline.stroke(polyline, width, closed);
+    path_impl(outline, fill_rule::NON_ZERO, pen_colour_);
+}
+
+template <typename PixelT>
+void canvas<PixelT, pixmap>::path_impl(const path& P, fill_rule rule, const vec3b& colour) {
+    if(P.empty()) return;
+
+    const auto bnd = P.bounds();
+    const auto& clip = clip_region_;
+    if(bnd.right < clip.left || bnd.left > clip.right + 1 || bnd.top < clip.bottom || bnd.bottom > clip.top + 1) return;
 
-        for(int i = 0, end = (int)AET.size(); i != end; i += 2) {
-            auto& se = AET[2*i]; auto& ee = AET[2*i+1];
-            for(int x = se.xmin, xend = ee.xmin; x <= xend; ++x) {
-                raster_(x,curr_y).set3(fill_colour_);
+    const recti bound{
+        std::max(int(std::floor(bnd.left)), clip.left), std::min(int(std::ceil(bnd.right)), clip.right),
+        std::max(int(std::floor(bnd.bottom)), clip.bottom), std::min(int(std::ceil(bnd.top)), clip.top)
+    };
+    update_region(bound.left,bound.bottom); update_region(bound.right,bound.top);
+
+    if(display_list_) {
+        display_list_->record(display_list::op::PATH, colour, int(display_list_->paths.size()), 0, 0, 0, bound);
+        display_list_->paths.emplace_back(P, rule);
+        return;
+    }
+
+    coverage_.rasterise(P, rule, clip, coverage_spans_);
+    for(const auto& span : coverage_spans_) {
+        blend_span(raster_.data(span.x,span.y), size_t(span.count), colour, span.alpha);
+    }
+}
+
+template <typename PixelT>
+void canvas<PixelT, pixmap>::record_pixel(int x, int y, const vec3b& rgb) {
+    display_list_->record(display_list::op::PIXEL, rgb, x, y, 0, 0, recti{x, x, y, y});
+}
+
+template <typename PixelT>
+void canvas<PixelT, pixmap>::begin_deferred(int tile_size) {
+    if(tile_size < 1) { LOG_ERR("Invalid tile size", tile_size); return; }
+    if(display_list_) display_list_->tile_size = tile_size;
+    else              display_list_.reset(new display_list(tile_size));
+}
+
+template <typename PixelT>
+void canvas<PixelT, pixmap>::end_deferred(scheduler* pool) {
+    if(!display_list_) return;
+    flush(pool);
+    display_list_.reset();
+}
+
+template <typename PixelT>
+void canvas<PixelT, pixmap>::flush(scheduler* pool) {
+    if(!display_list_ || display_list_->commands.empty()) return;
+
+    auto& list = *display_list_;
+    const int w = width(), h = height(), ts = list.tile_size;
+    const int tiles_x = (w + ts - 1)/ts, tiles_y = (h + ts - 1)/ts, tile_count = tiles_x*tiles_y;
+
+    // Bin the commands by the tiles their bounds overlap, a counting sort keeps each bin in draw order
+    auto for_each_tile = [w, h, ts, tiles_x](recti& bnd, uint32_t* cursor, uint32_t* bins, uint32_t cmd) {
+        bnd.left = std::max(bnd.left, 0); bnd.right = std::min(bnd.right, w-1);
+        bnd.bottom = std::max(bnd.bottom, 0); bnd.top = std::min(bnd.top, h-1);
+        if(bnd.left > bnd.right || bnd.bottom > bnd.top) return;
+        for(int ty = bnd.bottom/ts, ty_end = bnd.top/ts; ty <= ty_end; ++ty) {
+            for(int tx = bnd.left/ts, tx_end = bnd.right/ts; tx <= tx_end; ++tx) {
+                auto& slot = cursor[ty*tiles_x + tx];
+                if(bins) bins[slot] = cmd;
+                ++slot;
             }
-            if(se.denominator != 0) {
-                se.increment += se.numerator;
-                while(se.increment > se.denominator) {
-                    se.xmin += se.sign; se.increment -= se.denominator;
+        }
+    };
+
+    list.bin_offsets.assign(size_t(tile_count+1), 0);
+    for(auto& cmd : list.commands) for_each_tile(cmd.bound, list.bin_offsets.data()+1, nullptr, 0);
+    std::partial_sum(list.bin_offsets.begin(), list.bin_offsets.end(), list.bin_offsets.begin());
+
+    list.bins.resize(list.bin_offsets.back());
+    std::vector<uint32_t> cursor(list.bin_offsets.begin(), list.bin_offsets.end()-1);
+    for(uint32_t i = 0, end = uint32_t(list.commands.size()); i != end; ++i) {
+        for_each_tile(list.commands[i].bound, cursor.data(), list.bins.data(), i);
+    }
+
+    // Scan convert each polygon once rather than in every tile it overlaps
+    list.spans.resize(list.polygons.size());
+    auto scan = [&list](int first, int last) {
+        for(int i = first; i != last; ++i) {
+            const auto& et = list.polygons[i];
+            auto& spans = list.spans[i];
+            spans.min_y = et.min_y;
+            spans.rows.assign(size_t(et.max_y - et.min_y + 1), 0);
+            spans.runs.clear();
+            scan_polygon(et, [&spans](int x1, int x2, int y) {
+                spans.runs.emplace_back(x1, x2);
+                ++spans.rows[y - spans.min_y + 1];
+            });
+            std::partial_sum(spans.rows.begin(), spans.rows.end(), spans.rows.begin());
+        }
+    };
+
+    list.coverage.resize(list.paths.size());
+    auto rasterise_paths = [this, &list](int first, int last) {
+        coverage_rasteriser rasteriser;
+        for(int i = first; i != last; ++i) {
+            auto& table = list.coverage[i];
+            rasteriser.rasterise(list.paths[i].first, list.paths[i].second, clip_region_, table.spans);
+            table.min_y = table.spans.empty() ? 0 : table.spans.front().y;
+            table.rows.assign(table.spans.empty() ? 1 : size_t(table.spans.back().y - table.min_y + 2), 0);
+            for(const auto& span : table.spans) ++table.rows[span.y - table.min_y + 1];
+            std::partial_sum(table.rows.begin(), table.rows.end(), table.rows.begin());
+        }
+    };
+
+    // The tiles are disjoint, so each is rasterised without synchronisation
+    auto rasterise = [this, &list, w, h, ts, tiles_x](int first, int last) {
+        for(int t = first; t != last; ++t) {
+            if(list.bin_offsets[t] == list.bin_offsets[t+1]) continue;
+            const int x = (t % tiles_x)*ts, y = (t / tiles_x)*ts;
+            rasterise_tile(list, recti{x, std::min(x+ts, w)-1, y, std::min(y+ts, h)-1}, list.bin_offsets[t],
+                           list.bin_offsets[t+1]);
+        }
+    };
+
+    if(pool) {
+        pool->parallel_for(0, int(list.polygons.size()), 16, scan);
+        pool->parallel_for(0, int(list.paths.size()), 4, rasterise_paths);
+        pool->parallel_for(0, tile_count, 1, rasterise);
+    } else {
+        scan(0, int(list.polygons.size()));
+        rasterise_paths(0, int(list.paths.size()));
+        rasterise(0, tile_count);
+    }
+
+    list.commands.clear();
+    list.polygons.clear();
+    list.paths.clear();
+}
+
+template <typename PixelT>
+void canvas<PixelT, pixmap>::rasterise_tile(const display_list& list, const recti& tile, size_t first, size_t last) {
+    using op = typename display_list::op;
+
+    for(size_t i = first; i != last; ++i) {
+        const auto& cmd = list.commands[list.bins[i]];
+        const auto& colour = cmd.colour;
+        auto plot = [this, &tile, &colour](int x, int y) { if(tile.intersection(x, y)) raster_(x,y).set3(colour); };
+
+        // The bounds of the primitive within the tile
+        const int left = std::max(cmd.bound.left, tile.left), right = std::min(cmd.bound.right, tile.right);
+        const int bottom = std::max(cmd.bound.bottom, tile.bottom), top = std::min(cmd.bound.top, tile.top);
+        auto fill = [this, &colour](int left, int right, int bottom, int top) {
+            if(left > right) return;
+            for(int y = bottom; y <= top; ++y) fill_span(raster_.data(left,y), size_t(right - left + 1), colour);
+        };
+
+        switch(cmd.type) {
+            case op::PIXEL:
+                raster_(cmd.p[0], cmd.p[1]).set3(colour);
+                break;
+            case op::LINE:
+                scan_line(cmd.p[0], cmd.p[1], cmd.p[2], cmd.p[3], tile,
+                          [this, &colour](int x, int y) { raster_(x,y).set3(colour); },
+                          [&fill](int x1, int x2, int y) { fill(x1, x2, y, y); });
+                break;
+            case op::CIRCLE:
+                scan_circle(cmd.p[0], cmd.p[1], cmd.p[2], plot);
+                break;
+            case op::ELLIPSE:
+                scan_ellipse(cmd.p[0], cmd.p[1], cmd.p[2], cmd.p[3], plot);
+                break;
+            case op::PATH: {
+                const auto& table = list.coverage[cmd.p[0]];
+                const int ybegin = std::max(bottom, table.min_y);
+                const int yend = std::min(top, table.min_y + int(table.rows.size()) - 2);
+                for(int y = ybegin; y <= yend; ++y) {
+                    for(auto r = table.rows[y - table.min_y], end = table.rows[y - table.min_y + 1]; r != end; ++r) {
+                        const auto& span = table.spans[r];
+                        const int x1 = std::max(span.x, left), x2 = std::min(span.x + span.count - 1, right);
+                        if(x1 <= x2) blend_span(raster_.data(x1,y), size_t(x2 - x1 + 1), colour, span.alpha);
+                    }
                 }
-            }
-            if(ee.denominator != 0) {
-                ee.increment += ee.numerator;
-                while(ee.increment > ee.denominator) {
-                    ee.xmin += ee.sign; ee.increment -= ee.denominator;
+            } break;
+            case op::FILLED_RECT:
+            case op::CLEAR:
+                fill(left, right, bottom, top);
+                break;
+            case op::POLYGON: {
+                const auto& spans = list.spans[cmd.p[0]];
+                for(int y = bottom; y <= top; ++y) {
+                    for(auto r = spans.rows[y - spans.min_y], end = spans.rows[y - spans.min_y + 1]; r != end; ++r) {
+                        const int x1 = std::max(spans.runs[r].x, left), x2 = std::min(spans.runs[r].y, right);
+                        if(x1 <= x2) fill(x1, x2, y, y);
+                    }
                 }
-            }
+            } break;
         }
-
-        ++curr_y;
     }
 }
 
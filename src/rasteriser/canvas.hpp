@@ -5,15 +5,22 @@
 // A 2D Software Rasteriser for rasterising lines, circles, ellipses, text, using clipping & ranged updates and Pixel
 // Buffer usage in OpenGL.  The basis for a small vector graphics engine.
 
+#include <memory>
 #include <maths/vec2.hpp>
 #include <maths/vec3.hpp>
 #include <engine/pixmap.hpp>
+#include <engine/fence.hpp>
 #include <engine/texture.hpp>
 #include <maths/geometry/rect.hpp>
 #include <maths/geometry/segment.hpp>
+#include <rasteriser/coverage.hpp>
+#include <rasteriser/dirty_region.hpp>
+
+namespace zap { class scheduler; }
 
 namespace zap { namespace rasteriser {
     using maths::vec2i;
+    using maths::vec2f;
     using maths::vec3b;
     using maths::geometry::recti;
     using maths::geometry::segment2i;
@@ -30,9 +37,9 @@ namespace zap { namespace rasteriser {
         bool map();
         void unmap();
 
-        int width() const { return int32_t(raster_.width()); }
-        int height() const { return int32_t(raster_.height()); }
-        vec2i centre() const { return vec2i{int32_t(raster_.width()/2), int32_t(raster_.height()/2)}; }
+        int width() const { return int32_t(raster_->width()); }
+        int height() const { return int32_t(raster_->height()); }
+        vec2i centre() const { return vec2i{int32_t(raster_->width()/2), int32_t(raster_->height()/2)}; }
 
         void resize(int width, int height);
 
@@ -64,14 +71,22 @@ namespace zap { namespace rasteriser {
         void rect(int x1, int y1, int x2, int y2);
         void filled_rect(int x1, int y1, int x2, int y2);
 
+        // Uploads the regions modified since the last update
         void update(zap::engine::texture& tex);
 
+        // Upload statistics, accumulated over all updates
+        size_t bytes_uploaded() const { return bytes_uploaded_; }
+        size_t upload_count() const { return upload_count_; }
+        void reset_upload_stats() { bytes_uploaded_ = 0; upload_count_ = 0; }
+
     protected:
         using pixel_t = PixelT;
         using pbuf_t = engine::pixel_buffer<PixelT>;
+        constexpr static int ring_size = 3;
 
         void initialise();
-        void update_region(int x, int y);
+        void update_region(int x1, int y1, int x2, int y2);
+        void sync_slot();
 
         void line_impl(int x1, int y1, int x2, int y2);
 
@@ -84,12 +99,19 @@ namespace zap { namespace rasteriser {
 
 
         pixel_t* mapped_ptr_;
-        vec2i min_, max_;
+        dirty_region dirty_;                    // Modified since the last update
         vec3b pen_colour_, clear_colour_, fill_colour_;
         recti clip_region_;
-        int block_width_;
-        pbuf_t raster_;
-        pbuf_t pbo_;
+
+        bool persistent_ = false;
+        int slot_ = 0;
+        pbuf_t ring_[ring_size];                // Only ring_[0] is used without persistent mapping
+        pbuf_t* raster_;                        // The current slot
+        pbuf_t* source_ = nullptr;              // The previous slot, which stale_ is copied from
+        dirty_region history_[ring_size];       // Modified in each slot while it was current
+        dirty_region stale_;                    // Modified in the other slots since the current slot was last current
+        engine::fence fences_[ring_size];       // Signalled once the GPU has read the slot
+        size_t bytes_uploaded_ = 0, upload_count_ = 0;
     };
 
 template <typename PixelT>
@@ -119,7 +141,8 @@ public:
     const vec3b& fill_colour() const { return fill_colour_; }
 
     void set_pixel(int x, int y, const vec3b& rgb) {
-        raster_(x,y).set3(rgb);
+        if(display_list_) record_pixel(x, y, rgb);
+        else              raster_(x,y).set3(rgb);
     }
 
     void line(int x1, int y1, int x2, int y2);
@@ -139,8 +162,21 @@ public:
     void rect(int x1, int y1, int x2, int y2);
     void filled_rect(int x1, int y1, int x2, int y2);
 
+    // Anti-aliased paths (see coverage.hpp), filled with the fill colour or stroked with the pen colour
+    void fill_path(const path& P, fill_rule rule=fill_rule::NON_ZERO);
+    void stroke(const std::vector<vec2f>& polyline, float width, bool closed=false);
+
     size_t copy(const pixmap_t& src, int trg_x, int trg_y, const recti& bound=recti{0, 0, 0, 0});
 
+    // In deferred mode the draw calls (including clear and set_pixel) are recorded into a display list instead of being
+    // rasterised.  flush() bins the commands into tile_size square screen tiles by bounding box and rasterises the tiles
+    // in parallel on the scheduler (or the calling thread), preserving the draw order within each tile, so the result is
+    // identical to immediate drawing.  copy() and update() flush pending commands on the calling thread.
+    void begin_deferred(int tile_size=64);
+    void end_deferred(scheduler* pool=nullptr);
+    bool is_deferred() const { return display_list_ != nullptr; }
+    void flush(scheduler* pool=nullptr);
+
     void update(zap::engine::texture& tex);
     const engine::pixmap<PixelT>& get_buffer() const { return raster_; }
 
@@ -153,18 +189,20 @@ protected:
 
     void line_impl(int x1, int y1, int x2, int y2);
 
-    void vertical_line(int x1, int y1, int y2);
-    void horizontal_line(int x1, int x2, int y1);
-    void diagonal_line(int x1, int y1, int x2, int y2);
+    void path_impl(const path& P, fill_rule rule, const vec3b& colour);
 
-    void circle_points(int cx, int cy, int x, int y);
-    void ellipse_points(int cx, int cy, int x, int y);
+    struct display_list;
+    void record_pixel(int x, int y, const vec3b& rgb);
+    void rasterise_tile(const display_list& list, const recti& tile, size_t first, size_t last);
 
     pixel_t* mapped_ptr_;
     vec2i min_, max_;
     vec3b pen_colour_, clear_colour_, fill_colour_;
     recti clip_region_;
     pbuf_t raster_;
+    coverage_rasteriser coverage_;
+    std::vector<coverage_span> coverage_spans_;
+    std::unique_ptr<display_list> display_list_;
 };
 
 }}
@@ -0,0 +1,201 @@
+/* Created by Darren Otgaar on 2018/06/17. http://www.github.com/otgaard/zap */
+#include "coverage.hpp"
+#include <cmath>
+#include <algorithm>
+
+using namespace zap::maths;
+using namespace zap::rasteriser;
+
+void path::move_to(const vec2f& P) {
+    close();
+    points_.push_back(P);
+}
+
+void path::line_to(const vec2f& P) {
+    points_.push_back(P);
+}
+
+// The chord error of n segments is bounded by |B''|/(8n^2), the number of segments is chosen to keep it within tolerance
+void path::quad_to(const vec2f& C, const vec2f& P) {
+    const vec2f P0 = points_.empty() ? C : points_.back();
+    const float dd = (P0 - 2.f*C + P).length();
+    const int n = std::max(1, int(std::ceil(std::sqrt(dd/(4.f*tolerance_)))));
+    for(int i = 1; i != n; ++i) {
+        const float t = float(i)/n, s = 1.f - t;
+        points_.push_back(s*s*P0 + 2.f*s*t*C + t*t*P);
+    }
+    points_.push_back(P);
+}
+
+void path::cubic_to(const vec2f& C1, const vec2f& C2, const vec2f& P) {
+    const vec2f P0 = points_.empty() ? C1 : points_.back();
+    const float dd = std::max((P0 - 2.f*C1 + C2).length(), (C1 - 2.f*C2 + P).length());
+    const int n = std::max(1, int(std::ceil(std::sqrt(.75f*dd/tolerance_))));
+    for(int i = 1; i != n; ++i) {
+        const float t = float(i)/n, s = 1.f - t;
+        points_.push_back(s*s*s*P0 + 3.f*s*s*t*C1 + 3.f*s*t*t*C2 + t*t*t*P);
+    }
+    points_.push_back(P);
+}
+
+void path::close() {
+    const auto begin = contours_.empty() ? 0 : contours_.back();
+    if(points_.size() != begin) contours_.push_back(uint32_t(points_.size()));
+}
+
+void path::stroke(const std::vector<vec2f>& polyline, float width, bool closed) {
+    const size_t count = polyline.size();
+    if(count < 2 || width <= 0.f) return;
+
+    const float hw = .5f*width;
+    auto offset = [hw](const vec2f& A, const vec2f& B) {
+        const auto len = (B - A).length();
+        return len > 0.f ? (hw/len)*perp(B - A) : vec2f{0.f, 0.f};
+    };
+
+    // Each segment is a quad and each join a triangle on the outside of the turn, all wound the same way (negative area)
+    const size_t segments = closed ? count : count - 1;
+    for(size_t i = 0; i != segments; ++i) {
+        const auto& A = polyline[i];
+        const auto& B = polyline[(i+1) % count];
+        const auto N = offset(A, B);
+        if(N.x == 0.f && N.y == 0.f) continue;
+        move_to(A + N); line_to(B + N); line_to(B - N); line_to(A - N); close();
+    }
+
+    for(size_t i = closed ? 0 : 1, end = closed ? count : count - 1; i != end; ++i) {
+        const auto& P = polyline[(i + count - 1) % count];
+        const auto& V = polyline[i];
+        const auto& Q = polyline[(i+1) % count];
+        const float turn = dotperp(V - P, Q - V);
+        if(turn == 0.f) continue;
+        const float side = turn > 0.f ? -1.f : 1.f;
+        auto P1 = V + side*offset(P, V), P2 = V + side*offset(V, Q);
+        if(dotperp(P1 - V, P2 - V) > 0.f) std::swap(P1, P2);
+        move_to(V); line_to(P1); line_to(P2); close();
+    }
+}
+
+path::rectf path::bounds() const {
+    if(points_.empty()) return rectf{0.f, 0.f, 0.f, 0.f};
+    rectf bnd{points_[0].x, points_[0].x, points_[0].y, points_[0].y};
+    for(const auto& P : points_) {
+        bnd.left = std::min(bnd.left, P.x); bnd.right = std::max(bnd.right, P.x);
+        bnd.bottom = std::min(bnd.bottom, P.y); bnd.top = std::max(bnd.top, P.y);
+    }
+    return bnd;
+}
+
+void coverage_rasteriser::rasterise(const path& P, fill_rule rule, const recti& clip, std::vector<coverage_span>& spans) {
+    spans.clear();
+    if(P.empty() || clip.left > clip.right || clip.bottom > clip.top) return;
+
+    clip_ = clip;
+    cells_.clear();
+
+    const auto& points = P.points();
+    const auto& contours = P.contours();
+    uint32_t begin = 0;
+    for(size_t c = 0, end = contours.size() + 1; c != end; ++c) {
+        const uint32_t last = c != contours.size() ? contours[c] : uint32_t(points.size());
+        if(last - begin > 1) {
+            for(uint32_t i = begin; i != last - 1; ++i) add_edge(points[i], points[i+1]);
+            add_edge(points[last-1], points[begin]);
+        }
+        begin = last;
+    }
+
+    std::sort(cells_.begin(), cells_.end(), [](const cell& A, const cell& B) { return A.key < B.key; });
+
+    // Maps the winding (accumulated cover) to coverage
+    auto alpha = [rule](float winding) {
+        float cov = std::abs(winding);
+        if(rule == fill_rule::EVEN_ODD) {
+            cov = std::fmod(cov, 2.f);
+            if(cov > 1.f) cov = 2.f - cov;
+        } else if(cov > 1.f) {
+            cov = 1.f;
+        }
+        return int(cov*255.f + .5f);
+    };
+
+    auto emit = [&spans](int x, int y, int count, int a) {
+        if(count > 0 && a > 0) spans.push_back(coverage_span{x, y, count, uint8_t(a)});
+    };
+
+    // Sweep each row, each cell covers its own pixel partially and the run up to the next cell by the accumulated cover
+    const int x_origin = clip.left - 1;
+    for(size_t i = 0, end = cells_.size(); i != end;) {
+        const uint32_t row = uint32_t(cells_[i].key >> 32);
+        const int y = clip.bottom + int(row);
+        float acc = 0.f;
+        while(i != end && uint32_t(cells_[i].key >> 32) == row) {
+            const auto key = cells_[i].key;
+            float cover = 0.f, area = 0.f;
+            for(; i != end && cells_[i].key == key; ++i) {
+                cover += cells_[i].cover;
+                area += cells_[i].area;
+            }
+
+            const int x = x_origin + int(uint32_t(key));
+            if(x >= clip.left) emit(x, y, 1, alpha(acc + cover - area));
+            acc += cover;
+
+            const int next = i != end && uint32_t(cells_[i].key >> 32) == row ? x_origin + int(uint32_t(cells_[i].key))
+                                                                               : clip.right + 1;
+            emit(x + 1, y, next - x - 1, alpha(acc));
+        }
+    }
+}
+
+void coverage_rasteriser::add_edge(vec2f A, vec2f B) {
+    if(A.y == B.y) return;
+    const float dir = A.y < B.y ? 1.f : -1.f;
+    if(A.y > B.y) std::swap(A, B);
+
+    const float ymin = float(clip_.bottom), ymax = float(clip_.top + 1);
+    if(B.y <= ymin || A.y >= ymax) return;
+
+    const float dxdy = (B.x - A.x)/(B.y - A.y);
+    const float y0 = std::max(A.y, ymin), y1 = std::min(B.y, ymax);
+    for(int row = int(std::floor(y0)); float(row) < y1; ++row) {
+        const float ya = std::max(y0, float(row)), yb = std::min(y1, float(row + 1));
+        if(ya >= yb) continue;
+        add_row(row, A.x + (ya - A.y)*dxdy, A.x + (yb - A.y)*dxdy, dir*(yb - ya));
+    }
+}
+
+void coverage_rasteriser::add_row(int row, float xa, float xb, float dy) {
+    if(xa > xb) std::swap(xa, xb);
+    const float left = float(clip_.left), right = float(clip_.right + 1);
+    if(xa >= right) return;                                     // Only affects pixels right of the clip region
+
+    if(xa == xb) {
+        const int x = int(std::floor(xa));
+        if(x < clip_.left) add_cell(clip_.left - 1, row, dy, 0.f);
+        else               add_cell(x, row, dy, dy*(xa - x));
+        return;
+    }
+
+    // The part left of the clip region only adds cover, the part to the right is dropped
+    const float dydx = dy/(xb - xa);
+    if(xa < left) {
+        const float xe = std::min(xb, left);
+        add_cell(clip_.left - 1, row, (xe - xa)*dydx, 0.f);
+        xa = xe;
+    }
+    xb = std::min(xb, right);
+
+    for(float x = xa; x < xb;) {
+        const int col = int(std::floor(x));
+        const float xe = std::min(xb, float(col + 1));
+        const float d = (xe - x)*dydx;
+        add_cell(col, row, d, d*(.5f*(x + xe) - col));
+        x = xe;
+    }
+}
+
+void coverage_rasteriser::add_cell(int x, int y, float cover, float area) {
+    const uint64_t key = uint64_t(uint32_t(y - clip_.bottom)) << 32 | uint32_t(x - (clip_.left - 1));
+    cells_.push_back(cell{key, cover, area});
+}
@@ -0,0 +1,82 @@
+/* Created by Darren Otgaar on 2018/06/17. http://www.github.com/otgaard/zap */
+#ifndef ZAP_COVERAGE_HPP
+#define ZAP_COVERAGE_HPP
+
+// An anti-aliased scanline rasteriser for paths, in the style of the signed-area cell rasterisers of FreeType and libart.
+// Each edge adds its cover (signed height) and area to the pixel cells it crosses, and the cells are sorted and swept per
+// row into runs of constant coverage, so the cost is proportional to the edge crossings rather than the area filled.
+
+#include <vector>
+#include <cstdint>
+#include <maths/vec2.hpp>
+#include <maths/geometry/rect.hpp>
+
+namespace zap { namespace rasteriser {
+
+enum class fill_rule {
+    NON_ZERO,
+    EVEN_ODD
+};
+
+// A set of contours, closed implicitly when filled.  Curves are flattened into line segments, within tolerance pixels
+// of the curve, as they are added.
+class path {
+public:
+    using vec2f = maths::vec2f;
+    using rectf = maths::geometry::rectf;
+
+    explicit path(float tolerance=.25f) : tolerance_(tolerance) { }
+
+    void move_to(const vec2f& P);
+    void line_to(const vec2f& P);
+    void quad_to(const vec2f& C, const vec2f& P);
+    void cubic_to(const vec2f& C1, const vec2f& C2, const vec2f& P);
+    void close();
+    void clear() { points_.clear(); contours_.clear(); }
+
+    // Adds the outline of a stroke of width along the polyline, with butt caps and bevelled joins.  The outline is made up
+    // of overlapping contours and must be filled NON_ZERO.
+    void stroke(const std::vector<vec2f>& polyline, float width, bool closed=false);
+
+    bool empty() const { return points_.empty(); }
+    const std::vector<vec2f>& points() const { return points_; }
+    const std::vector<uint32_t>& contours() const { return contours_; }     // The end of each contour in points()
+    rectf bounds() const;
+
+private:
+    float tolerance_;
+    std::vector<vec2f> points_;
+    std::vector<uint32_t> contours_;
+};
+
+// A run of count pixels from (x, y) with the coverage alpha (1 to 255)
+struct coverage_span {
+    int x, y, count;
+    uint8_t alpha;
+};
+
+class coverage_rasteriser {
+public:
+    using recti = maths::geometry::recti;
+
+    // Writes the spans of the path inside clip (inclusive), ordered by row and then column
+    void rasterise(const path& P, fill_rule rule, const recti& clip, std::vector<coverage_span>& spans);
+
+protected:
+    struct cell {
+        uint64_t key;                           // row << 32 | column, relative to the clip region
+        float cover;
+        float area;
+    };
+
+    void add_edge(maths::vec2f A, maths::vec2f B);
+    void add_row(int row, float xa, float xb, float dy);
+    void add_cell(int x, int y, float cover, float area);
+
+    recti clip_;
+    std::vector<cell> cells_;
+};
+
+}}
+
+#endif //ZAP_COVERAGE_HPP
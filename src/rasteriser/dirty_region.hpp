@@ -0,0 +1,89 @@
+/* Created by Darren Otgaar on 2018/06/18. http://www.github.com/otgaard/zap */
+#ifndef ZAP_DIRTY_REGION_HPP
+#define ZAP_DIRTY_REGION_HPP
+
+// Tracks the modified area of a raster as a short list of (inclusive) rectangles.  A rectangle is merged into another
+// when uploading the union costs no more than uploading both, where each upload is charged the fixed overhead (in
+// pixels) of a driver call.  When the list exceeds max_rects, the cheapest pair is merged.
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <maths/geometry/rect.hpp>
+
+namespace zap { namespace rasteriser {
+
+class dirty_region {
+public:
+    using recti = maths::geometry::recti;
+
+    explicit dirty_region(size_t max_rects=8, int64_t overhead=4096) : max_rects_(max_rects), overhead_(overhead) { }
+
+    bool empty() const { return rects_.empty(); }
+    const std::vector<recti>& rects() const { return rects_; }
+    void clear() { rects_.clear(); }
+
+    int64_t area() const {
+        int64_t total = 0;
+        for(const auto& r : rects_) total += area(r);
+        return total;
+    }
+
+    // Adds the rectangle spanned by (x1, y1) and (x2, y2), clipped to bound
+    void add(int x1, int y1, int x2, int y2, const recti& bound) {
+        recti r{std::max(std::min(x1, x2), bound.left), std::min(std::max(x1, x2), bound.right),
+                std::max(std::min(y1, y2), bound.bottom), std::min(std::max(y1, y2), bound.top)};
+        if(r.left <= r.right && r.bottom <= r.top) add(r);
+    }
+
+    void add(recti r) {
+        for(size_t i = 0; i != rects_.size();) {
+            if(rects_[i].contains(r)) return;
+            if(r.contains(rects_[i]) || cost(rects_[i], r) <= 0) {
+                r = merge(rects_[i], r);
+                rects_[i] = rects_.back();
+                rects_.pop_back();
+                i = 0;                      // The larger rectangle may now absorb one already tested
+            } else {
+                ++i;
+            }
+        }
+        rects_.push_back(r);
+
+        if(rects_.size() > max_rects_) {
+            size_t a = 0, b = 1;
+            int64_t min_cost = std::numeric_limits<int64_t>::max();
+            for(size_t i = 0; i != rects_.size(); ++i) {
+                for(size_t j = i+1; j != rects_.size(); ++j) {
+                    const auto c = cost(rects_[i], rects_[j]);
+                    if(c < min_cost) { min_cost = c; a = i; b = j; }
+                }
+            }
+            r = merge(rects_[a], rects_[b]);
+            rects_[b] = rects_.back(); rects_.pop_back();
+            rects_[a] = rects_.back(); rects_.pop_back();
+            add(r);
+        }
+    }
+
+    void add(const dirty_region& rhs) { for(const auto& r : rhs.rects_) add(r); }
+
+    static int64_t area(const recti& r) { return int64_t(r.right - r.left + 1)*int64_t(r.top - r.bottom + 1); }
+    static recti merge(const recti& A, const recti& B) {
+        return recti{std::min(A.left, B.left), std::max(A.right, B.right),
+                     std::min(A.bottom, B.bottom), std::max(A.top, B.top)};
+    }
+
+protected:
+    // The pixels wasted by uploading the union of A and B less the call saved (negative if the merge is cheaper)
+    int64_t cost(const recti& A, const recti& B) const { return area(merge(A, B)) - area(A) - area(B) - overhead_; }
+
+    size_t max_rects_;
+    int64_t overhead_;
+    std::vector<recti> rects_;
+};
+
+}}
+
+#endif //ZAP_DIRTY_REGION_HPP
@@ -0,0 +1,48 @@
+/* Created by Darren Otgaar on 2018/06/16. http://www.github.com/otgaard/zap */
+#include <emmintrin.h>
+#include "span.hpp"
+#include "span_impl.hpp"
+#include <tools/cpu.hpp>
+
+using namespace zap::rasteriser;
+using namespace zap::rasteriser::span_kernels;
+
+namespace {
+    struct sse2_pack {
+        using vi = __m128i;
+        constexpr static size_t bytes = 16;
+
+        static vi load(const unsigned char* ptr) { return _mm_load_si128(reinterpret_cast<const vi*>(ptr)); }
+        static vi set32(int32_t v) { return _mm_set1_epi32(v); }
+        static void store(unsigned char* ptr, vi v) { _mm_store_si128(reinterpret_cast<vi*>(ptr), v); }
+        static void storeu(unsigned char* ptr, vi v) { _mm_storeu_si128(reinterpret_cast<vi*>(ptr), v); }
+        static void stream(unsigned char* ptr, vi v) { _mm_stream_si128(reinterpret_cast<vi*>(ptr), v); }
+        static void fence() { _mm_sfence(); }
+    };
+
+    void sse2_rgb(unsigned char* dst, size_t count, const unsigned char* rgb) { fill_rgb<sse2_pack>(dst, count, rgb); }
+    void sse2_rgba(unsigned char* dst, size_t count, const unsigned char* rgb) { fill_rgba<sse2_pack>(dst, count, rgb); }
+
+    // The AVX2 kernels are used where the host supports them
+    fill_kernel select(fill_kernel sse2, fill_kernel avx2) {
+        return zap::host_supports_avx2() ? avx2 : sse2;
+    }
+}
+
+fill_kernel zap::rasteriser::span_kernels::sse2_fill_rgb() {
+    return &sse2_rgb;
+}
+
+fill_kernel zap::rasteriser::span_kernels::sse2_fill_rgba() {
+    return &sse2_rgba;
+}
+
+void zap::rasteriser::fill_span(engine::rgb888_t* dst, size_t count, const maths::vec3b& rgb) {
+    static const fill_kernel kernel = select(sse2_fill_rgb(), avx2_fill_rgb());
+    kernel(reinterpret_cast<unsigned char*>(dst), count, rgb.data());
+}
+
+void zap::rasteriser::fill_span(engine::rgba8888_t* dst, size_t count, const maths::vec3b& rgb) {
+    static const fill_kernel kernel = select(sse2_fill_rgba(), avx2_fill_rgba());
+    kernel(reinterpret_cast<unsigned char*>(dst), count, rgb.data());
+}
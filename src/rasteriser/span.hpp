@@ -0,0 +1,38 @@
+/* Created by Darren Otgaar on 2018/06/16. http://www.github.com/otgaard/zap */
+#ifndef ZAP_SPAN_HPP
+#define ZAP_SPAN_HPP
+
+// Span writers for the canvas.  The 24-bit RGB and 32-bit RGBA writers store whole vectors of pixels (16 bytes with
+// SSE2, 32 bytes with AVX2 where the host supports it), aligned after a short scalar head, and large spans are written
+// with non-temporal stores so that clears and large fills run at memory bandwidth.
+
+#include <cstddef>
+#include <cstdint>
+#include <maths/vec3.hpp>
+#include <engine/pixel_format.hpp>
+
+namespace zap { namespace rasteriser {
+
+// Writes count pixels of colour rgb to dst
+template <typename PixelT>
+void fill_span(PixelT* dst, size_t count, const maths::vec3b& rgb) {
+    for(size_t i = 0; i != count; ++i) dst[i].set3(rgb);
+}
+
+void fill_span(engine::rgb888_t* dst, size_t count, const maths::vec3b& rgb);
+// The alpha channel is written opaque
+void fill_span(engine::rgba8888_t* dst, size_t count, const maths::vec3b& rgb);
+
+// Blends count pixels of dst towards rgb by alpha/255
+template <typename PixelT>
+void blend_span(PixelT* dst, size_t count, const maths::vec3b& rgb, uint8_t alpha) {
+    if(alpha == 255) { fill_span(dst, count, rgb); return; }
+    const int a = alpha, ia = 255 - alpha;
+    for(size_t i = 0; i != count; ++i) {
+        for(int c = 0; c != 3; ++c) dst[i].set(c, byte((dst[i].get(c)*ia + rgb[c]*a + 127)/255));
+    }
+}
+
+}}
+
+#endif //ZAP_SPAN_HPP
@@ -0,0 +1,31 @@
+/* Created by Darren Otgaar on 2018/06/16. http://www.github.com/otgaard/zap */
+// Compiled with AVX2 enabled, only called when the host supports AVX2 (see fill_span)
+#include <immintrin.h>
+#include "span_impl.hpp"
+
+using namespace zap::rasteriser::span_kernels;
+
+namespace {
+    struct avx2_pack {
+        using vi = __m256i;
+        constexpr static size_t bytes = 32;
+
+        static vi load(const unsigned char* ptr) { return _mm256_load_si256(reinterpret_cast<const vi*>(ptr)); }
+        static vi set32(int32_t v) { return _mm256_set1_epi32(v); }
+        static void store(unsigned char* ptr, vi v) { _mm256_store_si256(reinterpret_cast<vi*>(ptr), v); }
+        static void storeu(unsigned char* ptr, vi v) { _mm256_storeu_si256(reinterpret_cast<vi*>(ptr), v); }
+        static void stream(unsigned char* ptr, vi v) { _mm256_stream_si256(reinterpret_cast<vi*>(ptr), v); }
+        static void fence() { _mm_sfence(); }
+    };
+
+    void avx2_rgb(unsigned char* dst, size_t count, const unsigned char* rgb) { fill_rgb<avx2_pack>(dst, count, rgb); }
+    void avx2_rgba(unsigned char* dst, size_t count, const unsigned char* rgb) { fill_rgba<avx2_pack>(dst, count, rgb); }
+}
+
+fill_kernel zap::rasteriser::span_kernels::avx2_fill_rgb() {
+    return &avx2_rgb;
+}
+
+fill_kernel zap::rasteriser::span_kernels::avx2_fill_rgba() {
+    return &avx2_rgba;
+}
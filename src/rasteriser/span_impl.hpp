@@ -0,0 +1,101 @@
+/* Created by Darren Otgaar on 2018/06/16. http://www.github.com/otgaard/zap */
+#ifndef ZAP_SPAN_IMPL_HPP
+#define ZAP_SPAN_IMPL_HPP
+
+/* The span kernels behind fill_span, compiled once per instruction set (span.cpp for SSE2 and span_avx2.cpp for AVX2) on
+ * a pack type P providing:
+ *
+ *      P::bytes            the vector width in bytes
+ *      P::load(ptr)        aligned load
+ *      P::set32(v)         broadcast of a 32-bit value
+ *      P::store(ptr, v)    aligned store
+ *      P::storeu(ptr, v)   unaligned store
+ *      P::stream(ptr, v)   aligned non-temporal store
+ *      P::fence()          orders the non-temporal stores
+ *
+ * This header is included by span_avx2.cpp, see tools/cpu.hpp for what it may contain.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace zap { namespace rasteriser { namespace span_kernels {
+
+// Writes count pixels of the colour rgb[0..2] to dst
+using fill_kernel = void (*)(unsigned char* dst, size_t count, const unsigned char* rgb);
+
+fill_kernel sse2_fill_rgb();
+fill_kernel sse2_fill_rgba();
+fill_kernel avx2_fill_rgb();
+fill_kernel avx2_fill_rgba();
+
+// Spans of at least this many bytes are written with non-temporal stores, which bypass the cache
+constexpr size_t stream_bytes = 256*1024;
+
+template <typename P>
+void fill_rgb(unsigned char* dst, size_t count, const unsigned char* rgb) {
+    static_assert(P::bytes == 16 || P::bytes == 32, "The head requires 11 to be the inverse of 3 modulo P::bytes");
+
+    // The pixels written before dst is aligned to the vector width, 3 is invertible modulo any power of two
+    const size_t misalign = size_t(reinterpret_cast<uintptr_t>(dst) & (P::bytes - 1));
+    size_t head = ((P::bytes - misalign)*11) & (P::bytes - 1);
+    if(head > count) head = count;
+    for(size_t i = 0; i != head; ++i, dst += 3) { dst[0] = rgb[0]; dst[1] = rgb[1]; dst[2] = rgb[2]; }
+    count -= head;
+
+    // P::bytes pixels fill three vectors exactly
+    alignas(32) unsigned char pattern[3*P::bytes];
+    for(size_t i = 0; i != 3*P::bytes; ++i) pattern[i] = rgb[i % 3];
+    const auto v0 = P::load(pattern), v1 = P::load(pattern + P::bytes), v2 = P::load(pattern + 2*P::bytes);
+
+    const size_t blocks = count/P::bytes;
+    if(3*count >= stream_bytes) {
+        for(size_t b = 0; b != blocks; ++b, dst += 3*P::bytes) {
+            P::stream(dst, v0); P::stream(dst + P::bytes, v1); P::stream(dst + 2*P::bytes, v2);
+        }
+        P::fence();
+    } else {
+        for(size_t b = 0; b != blocks; ++b, dst += 3*P::bytes) {
+            P::store(dst, v0); P::store(dst + P::bytes, v1); P::store(dst + 2*P::bytes, v2);
+        }
+    }
+
+    for(size_t i = 0, tail = count - blocks*P::bytes; i != tail; ++i, dst += 3) {
+        dst[0] = rgb[0]; dst[1] = rgb[1]; dst[2] = rgb[2];
+    }
+}
+
+template <typename P>
+void fill_rgba(unsigned char* dst, size_t count, const unsigned char* rgb) {
+    constexpr size_t width = P::bytes/4;
+    const unsigned char pixel[4] = { rgb[0], rgb[1], rgb[2], 0xFF };
+    int32_t value;
+    std::memcpy(&value, pixel, 4);
+    const auto v = P::set32(value);
+
+    const size_t misalign = size_t(reinterpret_cast<uintptr_t>(dst) & (P::bytes - 1));
+    if(misalign & 3) {                                          // Not a pixel array, never aligns
+        for(; count >= width; count -= width, dst += P::bytes) P::storeu(dst, v);
+    } else {
+        size_t head = ((P::bytes - misalign) & (P::bytes - 1))/4;
+        if(head > count) head = count;
+        for(size_t i = 0; i != head; ++i, dst += 4) std::memcpy(dst, pixel, 4);
+        count -= head;
+
+        const size_t blocks = count/width;
+        if(4*count >= stream_bytes) {
+            for(size_t b = 0; b != blocks; ++b, dst += P::bytes) P::stream(dst, v);
+            P::fence();
+        } else {
+            for(size_t b = 0; b != blocks; ++b, dst += P::bytes) P::store(dst, v);
+        }
+        count -= blocks*width;
+    }
+
+    for(size_t i = 0; i != count; ++i, dst += 4) std::memcpy(dst, pixel, 4);
+}
+
+}}}
+
+#endif //ZAP_SPAN_IMPL_HPP
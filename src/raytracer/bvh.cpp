@@ -0,0 +1,153 @@
+/* Created by Darren Otgaar on 2018/06/10. http://www.github.com/otgaard/zap */
+#include "bvh.hpp"
+#include <algorithm>
+
+using namespace zap::maths;
+using namespace zap::renderer;
+using namespace zap::maths::geometry;
+
+namespace {
+    constexpr size_t BIN_COUNT = 16;
+    constexpr float TRAVERSAL_COST = 1.f;      // Relative to the cost of a single primitive intersection
+    constexpr uint32_t MAX_LEAF_SIZE = 0xFFFF;
+
+    inline void grow(vec3f& min, vec3f& max, const vec3f& P) {
+        for(size_t i = 0; i != 3; ++i) {
+            if(P[i] < min[i]) min[i] = P[i];
+            if(P[i] > max[i]) max[i] = P[i];
+        }
+    }
+
+    inline float surface_area(const vec3f& min, const vec3f& max) {
+        const vec3f d = max - min;
+        return d.x < 0.f ? 0.f : 2.f * (d.x*d.y + d.y*d.z + d.z*d.x);
+    }
+
+    struct bin {
+        vec3f min = vec3f{std::numeric_limits<float>::max()};
+        vec3f max = vec3f{-std::numeric_limits<float>::max()};
+        uint32_t count = 0;
+    };
+}
+
+void bvh::build(const std::vector<AABB3f>& bounds, size_t leaf_size) {
+    clear();
+    depth_ = 0;
+    if(bounds.empty()) return;
+
+    std::vector<build_prim> prims(bounds.size());
+    indices_.resize(bounds.size());
+    for(size_t i = 0; i != bounds.size(); ++i) {
+        prims[i].min = bounds[i].min();
+        prims[i].max = bounds[i].max();
+        prims[i].centroid = bounds[i].centre;
+        prims[i].id = uint32_t(i);
+    }
+
+    nodes_.reserve(2*bounds.size() - 1);
+    build_node(prims, 0, uint32_t(prims.size()), std::max<size_t>(leaf_size, 1), 1);
+
+    // The leaves reference ranges of the partitioned build list
+    for(size_t i = 0; i != prims.size(); ++i) indices_[i] = prims[i].id;
+}
+
+uint32_t bvh::build_node(std::vector<build_prim>& prims, uint32_t begin, uint32_t end, size_t leaf_size, size_t depth) {
+    const uint32_t idx = uint32_t(nodes_.size());
+    nodes_.emplace_back();
+    if(depth > depth_) depth_ = depth;
+
+    vec3f bmin{std::numeric_limits<float>::max()}, bmax{-std::numeric_limits<float>::max()};
+    vec3f cmin = bmin, cmax = bmax;
+    for(uint32_t i = begin; i != end; ++i) {
+        grow(bmin, bmax, prims[i].min);
+        grow(bmin, bmax, prims[i].max);
+        grow(cmin, cmax, prims[i].centroid);
+    }
+
+    nodes_[idx].bound = AABB3f{.5f*(bmin + bmax), .5f*(bmax - bmin)};
+
+    const uint32_t count = end - begin;
+    auto make_leaf = [this, idx, begin, count]() {
+        nodes_[idx].offset = begin;
+        nodes_[idx].count = uint16_t(count);
+        nodes_[idx].axis = 0;
+        return idx;
+    };
+
+    if((count <= leaf_size && count <= MAX_LEAF_SIZE) || depth >= max_depth) return make_leaf();
+
+    // Split along the axis with the largest centroid extent
+    const vec3f extent = cmax - cmin;
+    uint16_t axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    uint32_t mid = begin;
+    if(extent[axis] > 0.f) {
+        bin bins[BIN_COUNT];
+        const float scale = BIN_COUNT * (1.f - 1e-4f) / extent[axis];
+        auto bin_index = [&](const build_prim& p) { return size_t((p.centroid[axis] - cmin[axis]) * scale); };
+
+        for(uint32_t i = begin; i != end; ++i) {
+            auto& b = bins[bin_index(prims[i])];
+            ++b.count;
+            grow(b.min, b.max, prims[i].min);
+            grow(b.min, b.max, prims[i].max);
+        }
+
+        // Sweep from the right to accumulate the area and count of the right partition for every split plane
+        float right_area[BIN_COUNT-1];
+        uint32_t right_count[BIN_COUNT-1];
+        bin acc;
+        for(size_t i = BIN_COUNT-1; i != 0; --i) {
+            if(bins[i].count != 0) {
+                acc.count += bins[i].count;
+                grow(acc.min, acc.max, bins[i].min);
+                grow(acc.min, acc.max, bins[i].max);
+            }
+            right_area[i-1] = surface_area(acc.min, acc.max);
+            right_count[i-1] = acc.count;
+        }
+
+        acc = bin{};
+        float best_cost = std::numeric_limits<float>::max();
+        size_t best_split = 0;
+        for(size_t i = 0; i != BIN_COUNT-1; ++i) {
+            if(bins[i].count != 0) {
+                acc.count += bins[i].count;
+                grow(acc.min, acc.max, bins[i].min);
+                grow(acc.min, acc.max, bins[i].max);
+            }
+            if(acc.count == 0 || right_count[i] == 0) continue;
+            const float cost = surface_area(acc.min, acc.max)*acc.count + right_area[i]*right_count[i];
+            if(cost < best_cost) {
+                best_cost = cost;
+                best_split = i;
+            }
+        }
+
+        // SAH cost of splitting relative to intersecting every primitive in this node
+        const float inv_area = 1.f / std::max(surface_area(bmin, bmax), std::numeric_limits<float>::min());
+        if(TRAVERSAL_COST + best_cost*inv_area >= float(count) && count <= leaf_size*4 && count <= MAX_LEAF_SIZE) {
+            return make_leaf();
+        }
+
+        auto first = prims.begin() + begin, last = prims.begin() + end;
+        auto pivot = std::partition(first, last, [&](const build_prim& p) { return bin_index(p) <= best_split; });
+        mid = uint32_t(pivot - prims.begin());
+    }
+
+    // Degenerate split (coincident centroids), fall back to an object median
+    if(mid == begin || mid == end) {
+        mid = begin + count/2;
+        auto first = prims.begin() + begin, last = prims.begin() + end;
+        std::nth_element(first, prims.begin() + mid, last, [axis](const build_prim& a, const build_prim& b) {
+            return a.centroid[axis] < b.centroid[axis];
+        });
+    }
+
+    nodes_[idx].count = 0;
+    nodes_[idx].axis = axis;
+    build_node(prims, begin, mid, leaf_size, depth+1);
+    const uint32_t right = build_node(prims, mid, end, leaf_size, depth+1);
+    nodes_[idx].offset = right;
+    return idx;
+}
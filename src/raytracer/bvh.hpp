@@ -0,0 +1,216 @@
+/* Created by Darren Otgaar on 2018/06/10. http://www.github.com/otgaard/zap */
+#ifndef ZAP_BVH_HPP
+#define ZAP_BVH_HPP
+
+/* A bounding volume hierarchy built with the binned surface area heuristic.  The bvh stores only the hierarchy and a
+ * permutation of primitive ids; the primitives themselves stay in the owner (see scene).  The nodes are stored depth-first
+ * so the left child of an interior node always follows its parent and only the right child index is stored.
+ */
+
+#include <vector>
+#include <maths/geometry/AABB.hpp>
+#include <maths/geometry/ray.hpp>
+#include "packet.hpp"
+
+namespace zap { namespace renderer {
+
+class bvh {
+public:
+    using vec3f = maths::vec3f;
+    using AABB3f = maths::geometry::AABB3f;
+    using ray3f = maths::geometry::ray3f;
+
+    struct node {
+        AABB3f bound;
+        uint32_t offset;        // Leaf: first index into indices(), Interior: index of the right child
+        uint16_t count;         // Leaf: number of primitives, Interior: 0
+        uint16_t axis;          // Split axis, used to visit the nearer child first
+
+        bool is_leaf() const { return count != 0; }
+    };
+
+    constexpr static size_t max_depth = 64;
+
+    bvh() = default;
+    ~bvh() = default;
+
+    // Builds the hierarchy over the bounds of the primitives, bounds[i] is the bound of primitive i
+    void build(const std::vector<AABB3f>& bounds, size_t leaf_size=4);
+    void clear() { nodes_.clear(); indices_.clear(); }
+
+    bool empty() const { return nodes_.empty(); }
+    size_t depth() const { return depth_; }
+    const std::vector<node>& nodes() const { return nodes_; }
+    const std::vector<uint32_t>& indices() const { return indices_; }
+
+    // Closest hit: fnc(prim_id, t_max) is called for each candidate primitive and returns true if the primitive was hit
+    // at t < t_max, in which case it must also shorten t_max.  Nodes beyond t_max are culled.
+    template <typename Fnc> bool closest(const ray3f& r, float& t_max, Fnc&& fnc) const;
+
+    // Any hit: returns as soon as fnc(prim_id, t_max) returns true (used for shadow rays)
+    template <typename Fnc> bool any(const ray3f& r, float t_max, Fnc&& fnc) const;
+
+    // Packet closest hit: fnc(prim_id, hits) is called for each candidate primitive of a node entered by any lane
+    template <typename Fnc> void closest(const ray_packet& p, hit_packet& hits, Fnc&& fnc) const;
+
+    // Packet any hit: fnc(prim_id, hits) returns the mask of lanes hit, returns the mask of occluded lanes.  Lanes with
+    // t_max < 0 are inactive.
+    template <typename Fnc> int any(const ray_packet& p, const maths::simd::vecm& t_max, Fnc&& fnc) const;
+
+protected:
+    struct build_prim {
+        vec3f min, max, centroid;
+        uint32_t id;
+    };
+
+    uint32_t build_node(std::vector<build_prim>& prims, uint32_t begin, uint32_t end, size_t leaf_size, size_t depth);
+
+private:
+    std::vector<node> nodes_;
+    std::vector<uint32_t> indices_;
+    size_t depth_ = 0;
+};
+
+template <typename Fnc>
+bool bvh::closest(const ray3f& r, float& t_max, Fnc&& fnc) const {
+    if(nodes_.empty()) return false;
+
+    const vec3f inv_d{1.f/r.d.x, 1.f/r.d.y, 1.f/r.d.z};
+    const bool dir_neg[3] = { inv_d.x < 0.f, inv_d.y < 0.f, inv_d.z < 0.f };
+
+    uint32_t stack[max_depth];
+    size_t sp = 0;
+    uint32_t curr = 0;
+    bool hit = false;
+
+    while(true) {
+        const auto& nd = nodes_[curr];
+        float t0 = 0.f, t1 = t_max;
+        if(intersection(nd.bound, r, inv_d, t0, t1)) {
+            if(nd.is_leaf()) {
+                for(uint32_t i = nd.offset, end = nd.offset + nd.count; i != end; ++i) {
+                    if(fnc(indices_[i], t_max)) hit = true;
+                }
+                if(sp == 0) break;
+                curr = stack[--sp];
+            } else if(dir_neg[nd.axis]) {
+                stack[sp++] = curr + 1;
+                curr = nd.offset;
+            } else {
+                stack[sp++] = nd.offset;
+                curr = curr + 1;
+            }
+        } else {
+            if(sp == 0) break;
+            curr = stack[--sp];
+        }
+    }
+
+    return hit;
+}
+
+template <typename Fnc>
+bool bvh::any(const ray3f& r, float t_max, Fnc&& fnc) const {
+    if(nodes_.empty()) return false;
+
+    const vec3f inv_d{1.f/r.d.x, 1.f/r.d.y, 1.f/r.d.z};
+
+    uint32_t stack[max_depth];
+    size_t sp = 0;
+    uint32_t curr = 0;
+
+    while(true) {
+        const auto& nd = nodes_[curr];
+        float t0 = 0.f, t1 = t_max;
+        if(intersection(nd.bound, r, inv_d, t0, t1)) {
+            if(nd.is_leaf()) {
+                for(uint32_t i = nd.offset, end = nd.offset + nd.count; i != end; ++i) {
+                    if(fnc(indices_[i], t_max)) return true;
+                }
+                if(sp == 0) break;
+                curr = stack[--sp];
+            } else {
+                stack[sp++] = nd.offset;
+                curr = curr + 1;
+            }
+        } else {
+            if(sp == 0) break;
+            curr = stack[--sp];
+        }
+    }
+
+    return false;
+}
+
+template <typename Fnc>
+void bvh::closest(const ray_packet& p, hit_packet& hits, Fnc&& fnc) const {
+    if(nodes_.empty()) return;
+
+    uint32_t stack[max_depth];
+    size_t sp = 0;
+    uint32_t curr = 0;
+
+    while(true) {
+        const auto& nd = nodes_[curr];
+        if(intersection(nd.bound, p, hits.t)) {
+            if(nd.is_leaf()) {
+                for(uint32_t i = nd.offset, end = nd.offset + nd.count; i != end; ++i) fnc(indices_[i], hits);
+                if(sp == 0) break;
+                curr = stack[--sp];
+            } else if(p.is_coherent(nd.axis) && p.is_negative(nd.axis)) {
+                stack[sp++] = curr + 1;
+                curr = nd.offset;
+            } else {
+                stack[sp++] = nd.offset;
+                curr = curr + 1;
+            }
+        } else {
+            if(sp == 0) break;
+            curr = stack[--sp];
+        }
+    }
+}
+
+template <typename Fnc>
+int bvh::any(const ray_packet& p, const maths::simd::vecm& t_max, Fnc&& fnc) const {
+    const int active = _mm_movemask_ps(_mm_cmpge_ps(t_max, _mm_setzero_ps()));
+    if(nodes_.empty() || active == 0) return 0;
+
+    // Occluded lanes are retired by setting their t to -1
+    hit_packet hits{t_max};
+    int occluded = 0;
+
+    uint32_t stack[max_depth];
+    size_t sp = 0;
+    uint32_t curr = 0;
+
+    while(true) {
+        const auto& nd = nodes_[curr];
+        if(intersection(nd.bound, p, hits.t)) {
+            if(nd.is_leaf()) {
+                for(uint32_t i = nd.offset, end = nd.offset + nd.count; i != end; ++i) {
+                    if(int mask = fnc(indices_[i], hits)) {
+                        occluded |= mask;
+                        if((occluded & active) == active) return occluded & active;
+                        const maths::simd::vecm32i lanes = { mask & 1 ? -1 : 0, mask & 2 ? -1 : 0, mask & 4 ? -1 : 0, mask & 8 ? -1 : 0 };
+                        hits.t = maths::simd::select_v(lanes.v, maths::simd::load(-1.f), hits.t);
+                    }
+                }
+                if(sp == 0) break;
+                curr = stack[--sp];
+            } else {
+                stack[sp++] = nd.offset;
+                curr = curr + 1;
+            }
+        } else {
+            if(sp == 0) break;
+            curr = stack[--sp];
+        }
+    }
+
+    return occluded & active;
+}
+
+}}
+
+#endif //ZAP_BVH_HPP
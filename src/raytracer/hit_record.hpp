@@ -5,8 +5,8 @@
 #ifndef ZAP_HIT_RECORD_HPP
 #define ZAP_HIT_RECORD_HPP
 
+#include <limits>
 #include <maths/vec3.hpp>
-#include <renderer/material.hpp>
 
 namespace zap { namespace renderer {
 
@@ -14,15 +14,16 @@ template <typename T>
 struct hit_record {
     using vec3 = maths::vec3<T>;
 
-    hit_record() : hit(false), material_ptr(nullptr) { }
+    hit_record() : hit(false), t(std::numeric_limits<T>::max()), material_id(INVALID_IDX) { }
     hit_record(const hit_record& rhs) = default;
 
     hit_record& operator=(const hit_record& rhs) = delete;
 
     bool hit;
+    T t;
     vec3 world_coord;
     vec3 normal;
-    material* material_ptr;
+    uint32_t material_id;
 };
 
 }}
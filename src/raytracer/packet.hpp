@@ -0,0 +1,204 @@
+/* Created by Darren Otgaar on 2018/06/11. http://www.github.com/otgaard/zap */
+#ifndef ZAP_PACKET_HPP
+#define ZAP_PACKET_HPP
+
+/* SSE ray packets.  A packet holds four coherent rays in SoA form so that each kernel tests all four rays against one
+ * primitive at a time.  Lanes are disabled by setting their t_max to a negative value; none of the kernels report a hit
+ * for a lane whose t_max < 0.  Kernels return the lane mask of hits (bit i set for lane i) and shorten t_max and update
+ * prim for the lanes that were hit.
+ */
+
+#include <maths/simd.hpp>
+#include <maths/geometry/AABB.hpp>
+#include <maths/geometry/plane.hpp>
+#include <maths/geometry/sphere.hpp>
+#include <maths/geometry/triangle.hpp>
+
+namespace zap { namespace renderer {
+
+struct ray_packet {
+    using vecm = maths::simd::vecm;
+    using vec3f = maths::vec3f;
+    using ray3f = maths::geometry::ray3f;
+
+    constexpr static int size = 4;
+    constexpr static int full_mask = 0xF;
+
+    ray_packet() = default;
+    explicit ray_packet(const ray3f* rays) {
+        VALIGN float arr[6][4];
+        for(int i = 0; i != size; ++i) {
+            arr[0][i] = rays[i].O.x; arr[1][i] = rays[i].O.y; arr[2][i] = rays[i].O.z;
+            arr[3][i] = rays[i].d.x; arr[4][i] = rays[i].d.y; arr[5][i] = rays[i].d.z;
+        }
+        ox = _mm_load_ps(arr[0]); oy = _mm_load_ps(arr[1]); oz = _mm_load_ps(arr[2]);
+        dx = _mm_load_ps(arr[3]); dy = _mm_load_ps(arr[4]); dz = _mm_load_ps(arr[5]);
+        finalise();
+    }
+
+    // Must be called if the directions are written directly
+    void finalise() {
+        const vecm one = maths::simd::vecm_one;
+        idx = _mm_div_ps(one, dx); idy = _mm_div_ps(one, dy); idz = _mm_div_ps(one, dz);
+        sign_mask = _mm_movemask_ps(dx) | (_mm_movemask_ps(dy) << 4) | (_mm_movemask_ps(dz) << 8);
+    }
+
+    // True if every ray in the packet has the same direction sign on the axis (required for ordered traversal)
+    bool is_coherent(int axis) const {
+        const int m = (sign_mask >> (4*axis)) & full_mask;
+        return m == 0 || m == full_mask;
+    }
+
+    bool is_negative(int axis) const { return ((sign_mask >> (4*axis)) & 1) != 0; }
+
+    ray3f ray(int lane) const {
+        VALIGN float arr[6][4];
+        _mm_store_ps(arr[0], ox); _mm_store_ps(arr[1], oy); _mm_store_ps(arr[2], oz);
+        _mm_store_ps(arr[3], dx); _mm_store_ps(arr[4], dy); _mm_store_ps(arr[5], dz);
+        return ray3f{vec3f{arr[0][lane], arr[1][lane], arr[2][lane]}, vec3f{arr[3][lane], arr[4][lane], arr[5][lane]}};
+    }
+
+    vecm ox, oy, oz;
+    vecm dx, dy, dz;
+    vecm idx, idy, idz;
+    int sign_mask = 0;
+};
+
+struct hit_packet {
+    using vecm = maths::simd::vecm;
+    using veci = maths::simd::veci;
+
+    hit_packet() = default;
+    explicit hit_packet(const vecm& t_max) : t(t_max), prim(_mm_set1_epi32(int(INVALID_IDX))) { }
+
+    vecm t;         // Closest hit per lane, t_max if missed
+    veci prim;      // Primitive id per lane, INVALID_IDX if missed
+};
+
+namespace simd_kernels {
+    using vecm = maths::simd::vecm;
+    using veci = maths::simd::veci;
+
+    inline vecm dot3(const vecm& ax, const vecm& ay, const vecm& az, const vecm& bx, const vecm& by, const vecm& bz) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+    }
+
+    // Shortens t and sets prim for the lanes in mask, returns the lane bits of mask
+    inline int commit(hit_packet& hits, const vecm& mask, const vecm& t, uint32_t prim_id) {
+        using maths::simd::select_v;
+        hits.t = select_v(mask, t, hits.t);
+        hits.prim = select_v(_mm_castps_si128(mask), _mm_set1_epi32(int(prim_id)), hits.prim);
+        return _mm_movemask_ps(mask);
+    }
+}
+
+// Packet vs AABB slab test, returns the mask of lanes entering the box in [0, t_max]
+inline int intersection(const maths::geometry::AABB3f& box, const ray_packet& p, const maths::simd::vecm& t_max) {
+    using namespace maths::simd;
+    const auto bmin = box.min(), bmax = box.max();
+
+    vecm t0 = _mm_mul_ps(_mm_sub_ps(load(bmin.x), p.ox), p.idx);
+    vecm t1 = _mm_mul_ps(_mm_sub_ps(load(bmax.x), p.ox), p.idx);
+    vecm tmin = _mm_min_ps(t0, t1), tmax = _mm_max_ps(t0, t1);
+
+    t0 = _mm_mul_ps(_mm_sub_ps(load(bmin.y), p.oy), p.idy);
+    t1 = _mm_mul_ps(_mm_sub_ps(load(bmax.y), p.oy), p.idy);
+    tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+    tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+
+    t0 = _mm_mul_ps(_mm_sub_ps(load(bmin.z), p.oz), p.idz);
+    t1 = _mm_mul_ps(_mm_sub_ps(load(bmax.z), p.oz), p.idz);
+    tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+    tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+
+    tmin = _mm_max_ps(tmin, _mm_setzero_ps());
+    tmax = _mm_min_ps(tmax, t_max);
+    return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+}
+
+// Packet vs sphere, takes the nearest root in (epsilon, hits.t)
+inline int intersection(const maths::geometry::spheref& S, const ray_packet& p, hit_packet& hits, uint32_t prim_id, float epsilon) {
+    using namespace maths::simd;
+    using namespace simd_kernels;
+
+    const vecm vx = _mm_sub_ps(p.ox, load(S.centre.x));
+    const vecm vy = _mm_sub_ps(p.oy, load(S.centre.y));
+    const vecm vz = _mm_sub_ps(p.oz, load(S.centre.z));
+
+    const vecm a = dot3(p.dx, p.dy, p.dz, p.dx, p.dy, p.dz);
+    const vecm b = _mm_mul_ps(load(2.f), dot3(p.dx, p.dy, p.dz, vx, vy, vz));
+    const vecm c = _mm_sub_ps(dot3(vx, vy, vz, vx, vy, vz), load(S.radius*S.radius));
+    const vecm discrim = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(load(4.f), _mm_mul_ps(a, c)));
+
+    vecm mask = _mm_cmpge_ps(discrim, _mm_setzero_ps());
+    if(_mm_movemask_ps(mask) == 0) return 0;
+
+    const vecm rt = _mm_sqrt_ps(_mm_max_ps(discrim, _mm_setzero_ps()));
+    const vecm inv_2a = _mm_div_ps(load(.5f), a);
+    const vecm nb = _mm_sub_ps(_mm_setzero_ps(), b);
+    const vecm t_near = _mm_mul_ps(_mm_sub_ps(nb, rt), inv_2a);
+    const vecm t_far = _mm_mul_ps(_mm_add_ps(nb, rt), inv_2a);
+
+    const vecm eps = load(epsilon);
+    const vecm t = select_v(_mm_cmpge_ps(t_near, eps), t_near, t_far);
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, eps), _mm_cmplt_ps(t, hits.t)));
+    return commit(hits, mask, t, prim_id);
+}
+
+// Packet vs triangle (Moller-Trumbore)
+inline int intersection(const maths::geometry::trianglef& tri, const ray_packet& p, hit_packet& hits, uint32_t prim_id, float epsilon) {
+    using namespace maths::simd;
+    using namespace simd_kernels;
+
+    const auto e1 = tri.P1 - tri.P0, e2 = tri.P2 - tri.P0;
+    const vecm e1x = load(e1.x), e1y = load(e1.y), e1z = load(e1.z);
+    const vecm e2x = load(e2.x), e2y = load(e2.y), e2z = load(e2.z);
+
+    // pvec = d x e2
+    const vecm px = _mm_sub_ps(_mm_mul_ps(p.dy, e2z), _mm_mul_ps(p.dz, e2y));
+    const vecm py = _mm_sub_ps(_mm_mul_ps(p.dz, e2x), _mm_mul_ps(p.dx, e2z));
+    const vecm pz = _mm_sub_ps(_mm_mul_ps(p.dx, e2y), _mm_mul_ps(p.dy, e2x));
+
+    const vecm det = dot3(e1x, e1y, e1z, px, py, pz);
+    const vecm abs_det = _mm_and_ps(det, vecm_abs_mask);
+    vecm mask = _mm_cmpge_ps(abs_det, load(std::numeric_limits<float>::epsilon()));
+    if(_mm_movemask_ps(mask) == 0) return 0;
+
+    const vecm inv_det = _mm_div_ps(vecm_one, det);
+    const vecm tx = _mm_sub_ps(p.ox, load(tri.P0.x));
+    const vecm ty = _mm_sub_ps(p.oy, load(tri.P0.y));
+    const vecm tz = _mm_sub_ps(p.oz, load(tri.P0.z));
+
+    const vecm u = _mm_mul_ps(dot3(tx, ty, tz, px, py, pz), inv_det);
+
+    // qvec = tvec x e1
+    const vecm qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    const vecm qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    const vecm qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+    const vecm v = _mm_mul_ps(dot3(p.dx, p.dy, p.dz, qx, qy, qz), inv_det);
+    const vecm t = _mm_mul_ps(dot3(e2x, e2y, e2z, qx, qy, qz), inv_det);
+
+    const vecm zero = _mm_setzero_ps();
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), vecm_one));
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, load(epsilon)), _mm_cmplt_ps(t, hits.t)));
+    return commit(hits, mask, t, prim_id);
+}
+
+// Packet vs plane
+inline int intersection(const maths::geometry::plane<float>& P, const ray_packet& p, hit_packet& hits, uint32_t prim_id, float epsilon) {
+    using namespace maths::simd;
+    using namespace simd_kernels;
+
+    const vecm nx = load(P.n.x), ny = load(P.n.y), nz = load(P.n.z);
+    const vecm num = dot3(_mm_sub_ps(load(P.O.x), p.ox), _mm_sub_ps(load(P.O.y), p.oy), _mm_sub_ps(load(P.O.z), p.oz), nx, ny, nz);
+    const vecm t = _mm_div_ps(num, dot3(p.dx, p.dy, p.dz, nx, ny, nz));
+
+    const vecm mask = _mm_and_ps(_mm_cmpgt_ps(t, load(epsilon)), _mm_cmplt_ps(t, hits.t));
+    return commit(hits, mask, t, prim_id);
+}
+
+}}
+
+#endif //ZAP_PACKET_HPP
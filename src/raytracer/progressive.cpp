@@ -0,0 +1,118 @@
+/* Created by Darren Otgaar on 2018/06/12. http://www.github.com/otgaard/zap */
+#include "progressive.hpp"
+#include <chrono>
+#include <algorithm>
+#include <tools/scheduler.hpp>
+
+using namespace zap::maths;
+using namespace zap::engine;
+using namespace zap::renderer;
+using namespace zap::maths::geometry;
+
+namespace {
+    // Low discrepancy sub-pixel offsets so that any prefix of the sample sequence covers the pixel evenly
+    inline float radical_inverse(int n, int base) {
+        const float inv_base = 1.f/base;
+        float inv = inv_base, value = 0.f;
+        for(; n > 0; n /= base, inv *= inv_base) value += (n % base) * inv;
+        return value;
+    }
+
+    inline vec2f halton(int idx) {
+        return vec2f{radical_inverse(idx+1, 2), radical_inverse(idx+1, 3)};
+    }
+}
+
+progressive::progressive(raytracer& rndr) : rndr_(rndr) {
+}
+
+progressive::~progressive() {
+}
+
+void progressive::reset(int w, int h) {
+    width_ = std::max(w, 0); height_ = std::max(h, 0);
+    tile_count_ = width_ > 0 && height_ > 0 ? rndr_.tile_count(width_, height_) : 0;
+    tile_stride_ = rndr_.tile_size()*rndr_.tile_size();
+
+    if(tile_count_ != 0) {
+        accum_.resize(width_, height_);
+        accum_.clear(rgb32f_t(0.f, 0.f, 0.f));
+    }
+    display_.assign(size_t(tile_count_*tile_stride_), rgb888_t(0, 0, 0));
+    samples_.assign(size_t(tile_count_), 0);
+    busy_.reset(new std::atomic<int>[tile_count_]);
+    for(int i = 0; i != tile_count_; ++i) busy_[i] = 0;
+    touched_.assign(size_t(tile_count_), 0);
+    dirty_.clear();
+    converged_ = 0;
+    next_job_ = 0;
+}
+
+int progressive::sample_pass() const {
+    return samples_.empty() ? 0 : *std::min_element(samples_.begin(), samples_.end());
+}
+
+size_t progressive::step(const scene& scn, float budget_ms) {
+    dirty_.clear();
+    if(tile_count_ == 0 || is_converged()) return 0;
+
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::microseconds(int64_t(budget_ms*1000.f));
+
+    // Jobs map round-robin onto tiles; a job is skipped if its tile is being refined or has converged
+    std::atomic<int> next_job{next_job_};
+    std::atomic<int> traced{0};
+    auto worker = [this, &scn, &next_job, &traced, deadline](int, int) {
+        std::vector<vec3f> samples(static_cast<size_t>(tile_stride_));
+        int count = 0;
+        while(clock::now() < deadline && converged_ < tile_count_) {
+            const int tile = next_job++ % tile_count_;
+            int expected = 0;
+            if(!busy_[tile].compare_exchange_strong(expected, 1)) continue;
+            if(samples_[tile] < max_samples_) {
+                refine(scn, tile, samples);
+                ++count;
+            }
+            busy_[tile] = 0;
+        }
+        traced += count;
+    };
+
+    // One worker loop per thread, each runs until the deadline
+    auto pool = rndr_.pool();
+    const int lanes = pool ? std::min(rndr_.thread_count() + 1, tile_count_) : 1;
+    if(pool) pool->parallel_for(0, lanes, 1, worker);
+    else     worker(0, 1);
+
+    next_job_ = next_job % tile_count_;
+    for(int t = 0; t != tile_count_; ++t) {
+        if(touched_[t]) {
+            dirty_.push_back(t);
+            touched_[t] = 0;
+        }
+    }
+
+    return size_t(traced.load());
+}
+
+void progressive::refine(const scene& scn, int tile, std::vector<vec3f>& samples) {
+    const auto rect = tile_rect(tile);
+    const int tw = rect.width(), th = rect.height();
+
+    rndr_.trace_tile(scn, width_, height_, rect, halton(samples_[tile]), samples.data());
+    const float inv_n = 1.f/++samples_[tile];
+    if(samples_[tile] == max_samples_) ++converged_;
+
+    rgb888_t* display = display_.data() + tile*tile_stride_;
+    for(int r = 0; r != th; ++r) {
+        rgb32f_t* acc = accum_.data(rect.left, rect.bottom + r);
+        for(int c = 0; c != tw; ++c) {
+            auto& px = acc[c];
+            const vec3f sum = px.get3v<float>() + samples[r*tw + c];
+            px.set3(sum);
+            display[r*tw + c].set3(sum*inv_n);
+        }
+    }
+
+    touched_[tile] = 1;
+}
@@ -0,0 +1,79 @@
+/* Created by Darren Otgaar on 2018/06/12. http://www.github.com/otgaard/zap */
+#ifndef ZAP_PROGRESSIVE_HPP
+#define ZAP_PROGRESSIVE_HPP
+
+/* Progressive, time-sliced rendering on top of the raytracer.  Each call to step() traces one jittered sample per pixel
+ * for as many tiles as fit in the time budget and accumulates the samples into a float pixmap.  Tiles are visited
+ * round-robin so the whole image converges evenly, and the tiles refined by the last step are reported as dirty so that
+ * the caller only uploads what changed.
+ *
+ * The resolved 8-bit image is stored tile by tile (each tile is packed, rect.width() pixels per row) so that a dirty tile
+ * can be uploaded to a texture directly with texture::copy.
+ */
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <engine/pixmap.hpp>
+#include "raytracer.hpp"
+
+namespace zap { namespace renderer {
+
+class progressive {
+public:
+    using recti = maths::geometry::recti;
+
+    explicit progressive(raytracer& rndr);
+    ~progressive();
+
+    // Discards the accumulated samples and restarts the image at w x h
+    void reset(int w, int h);
+    // Restarts accumulation at the current size (e.g. after the scene changes)
+    void restart() { reset(width_, height_); }
+
+    void set_max_samples(int max_samples) { max_samples_ = max_samples > 0 ? max_samples : max_samples_; }
+    int max_samples() const { return max_samples_; }
+
+    // Traces tile samples until budget_ms has elapsed or the image has converged.  Returns the number of tile samples
+    // traced.  The scene must be built.
+    size_t step(const scene& scn, float budget_ms);
+
+    bool is_converged() const { return converged_ == tile_count_; }
+    // The minimum number of samples accumulated by every pixel
+    int sample_pass() const;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int tile_count() const { return tile_count_; }
+    recti tile_rect(int tile) const { return rndr_.tile_rect(width_, height_, tile); }
+
+    // Tiles refined by the last call to step()
+    const std::vector<int>& dirty_tiles() const { return dirty_; }
+    // The resolved pixels of the tile, packed with rect.width() pixels per row
+    const engine::rgb888_t* tile_pixels(int tile) const { return display_.data() + tile*tile_stride_; }
+
+    const engine::pixmap<engine::rgb32f_t>& accumulation() const { return accum_; }
+
+protected:
+    void refine(const scene& scn, int tile, std::vector<maths::vec3f>& samples);
+
+private:
+    raytracer& rndr_;
+    int width_ = 0, height_ = 0;
+    int tile_count_ = 0;
+    int tile_stride_ = 0;
+    int max_samples_ = 64;
+
+    engine::pixmap<engine::rgb32f_t> accum_;
+    std::vector<engine::rgb888_t> display_;
+    std::vector<int> samples_;                          // Samples accumulated per tile
+    std::unique_ptr<std::atomic<int>[]> busy_;          // A tile is refined by one thread at a time
+    std::vector<char> touched_;
+    std::vector<int> dirty_;
+    std::atomic<int> converged_{0};
+    int next_job_ = 0;                                  // Resumes the round-robin where the last step stopped
+};
+
+}}
+
+#endif //ZAP_PROGRESSIVE_HPP
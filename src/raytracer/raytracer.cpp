@@ -4,6 +4,8 @@
 #include <maths/geometry/ray.hpp>
 #include <maths/geometry/plane.hpp>
 #include <maths/geometry/sphere.hpp>
+#include <tools/scheduler.hpp>
+#include <tools/log.hpp>
 #include <maths/io.hpp>
 
 using namespace zap::maths;
@@ -11,60 +13,212 @@ using namespace zap::engine;
 using namespace zap::renderer;
 using namespace zap::maths::geometry;
 
+namespace {
+    const float z_min = -.1f, z_max = 100.f, fov = HALF_PI<float>;
+
+    const vec2f offsets[4] = {
+        {.25f,.25f},
+        {.75f,.25f},
+        {.75f,.75f},
+        {.25f,.75f}
+    };
+}
+
 raytracer::raytracer() {
 }
 
 raytracer::~raytracer() {
 }
 
+bool raytracer::initialise(zap::scheduler* pool_ptr, int pool_size) {
+    if(!pool_ptr) {
+        if(pool_size <= 0) pool_size = std::max(int(std::thread::hardware_concurrency()), 1);
+        pool_.reset(new scheduler{});
+        if(!pool_->initialise(pool_size)) {
+            LOG_ERR("Failed to initialise scheduler.  Aborting.");
+            pool_.reset();
+            return false;
+        }
+        pool_ptr_ = pool_.get();
+    } else {
+        pool_ptr_ = pool_ptr;
+    }
+
+    thread_count_ = int(pool_ptr_->size());
+    return true;
+}
+
+void raytracer::make_test_scene(scene& scn) {
+    scn.clear();
+    auto red = scn.add_material(rt_material{vec3f{25.f, 0.f, 0.f}, vec3f{220.f, 0.f, 0.f}});
+    auto blue = scn.add_material(rt_material{vec3f{0.f, 0.f, 25.f}, vec3f{0.f, 0.f, 230.f}});
+    scn.add_sphere(spheref{vec3f{0.f, -1.6f, -4.f}, .2f}, red);
+    scn.add_plane(plane<float>{vec3f{0.f, -2.f, 0.f}, vec3f{0.f, 1.f, 0.f}}, blue);
+    scn.add_light(vec3f{0.f, 2.f, -4.f});
+    scn.build();
+}
+
 std::vector<zap::engine::rgb888_t> raytracer::render(int w, int h) {
-    const float inv_w = 1.f/w, inv_h = 1.f/h;
+    scene scn;
+    make_test_scene(scn);
+    return render(const_cast<const scene&>(scn), w, h);
+}
 
-    const float z_min = -.1f, z_max = 100.f, fov = HALF_PI<float>, ar = float(h)/w;
-    const float s = -2.f * std::tan(.5f*fov);
+std::vector<zap::engine::rgb888_t> raytracer::render(scene& scn, int w, int h) {
+    if(!scn.is_built()) scn.build();
+    return render(const_cast<const scene&>(scn), w, h);
+}
 
-    const vec3f light_pos = vec3f(0,2,-4.f);
-    sphere<float> sphere1(vec3f(0.f,-1.6f,-4.f), .2f);
-    plane<float> plane1(vec3f(0,-2.f,0.f), vec3f(0,1.f,0));
-    ray<vec3f> ray1(vec3f(0,0,0), vec3f(0,0,-1.f));
-    vec2f roots;
-    int row_offset;
-    float t;
+std::vector<zap::engine::rgb888_t> raytracer::render(const scene& scn, int w, int h) {
+    std::vector<zap::engine::rgb888_t> pixels(w*h, rgb888_t(0,0,0));
+    if(w <= 0 || h <= 0) return pixels;
 
-    vec2f offsets[4] = {
-        {.25f,.25f},
-        {.75f,.25f},
-        {.75f,.75f},
-        {.25f,.75f}
+    const int tiles = tile_count(w, h);
+    auto render_tiles = [this, &scn, w, h, &pixels](int first, int last) {
+        for(int tile = first; tile != last; ++tile) render_tile(scn, w, h, tile, pixels);
     };
 
-    std::vector<zap::engine::rgb888_t> pixels(w*h, rgb888_t(0,0,0));
-    for(int r = 0; r != h; ++r) {
-        row_offset = r*w;
-        for(int c = 0; c != w; ++c) {
-            vec3f pixel(0,0,0);
-            for(int sm = 0; sm != 4; ++sm) {
-                ray1.O = vec3f(((c + offsets[sm].x)*inv_w -.5f) * s, ((r + offsets[sm].y)*inv_h - .5f) * s * ar, 1.f) * z_min;
-                ray1.d = normalise(ray1.O);
-
-                if(int count = intersection(sphere1, ray1, roots.data())) {
-                    auto P = ray1.position(count == 2 ? roots.y : roots.x);
-                    auto N = normalise(P - sphere1.C);
-                    auto ld = normalise(light_pos - P);
-                    pixel += vec3f(byte(25+max(dot(ld,N),0.f)*220),0,0);
-                } else if((t = intersection(plane1, ray1)) > 0.f && t < z_max) {
-                    auto P = ray1.position(t);
-                    auto ld = normalise(light_pos - P);
-                    if(intersection(sphere1, ray<vec3f>(P, ld), roots.data())) {
-                        pixel += vec3f(0, 0, 25);
-                    } else {
-                        pixel += vec3f(0, 0, byte(max(dot(ld, plane1.n), 0.f) * 255));
-                    }
-                }
+    if(pool_ptr_) pool_ptr_->parallel_for(0, tiles, 1, render_tiles);
+    else          render_tiles(0, tiles);
+
+    return pixels;
+}
+
+recti raytracer::tile_rect(int w, int h, int tile) const {
+    const int tiles_x = (w + tile_size_ - 1)/tile_size_;
+    const int c0 = (tile % tiles_x) * tile_size_, r0 = (tile / tiles_x) * tile_size_;
+    return recti{c0, std::min(c0 + tile_size_, w), r0, std::min(r0 + tile_size_, h)};
+}
+
+void raytracer::render_tile(const scene& scn, int w, int h, int tile, std::vector<rgb888_t>& pixels) const {
+    const auto rect = tile_rect(w, h, tile);
+    const int tw = rect.width(), th = rect.height();
+
+    std::vector<vec3f> accum(size_t(tw*th), vec3f{0.f}), samples(size_t(tw*th));
+    for(int sm = 0; sm != 4; ++sm) {
+        trace_tile(scn, w, h, rect, offsets[sm], samples.data());
+        for(size_t i = 0; i != samples.size(); ++i) accum[i] += samples[i];
+    }
+
+    for(int r = 0; r != th; ++r) {
+        const int row_offset = (rect.bottom + r)*w + rect.left;
+        for(int c = 0; c != tw; ++c) pixels[row_offset+c].set3(accum[r*tw + c]*.25f);
+    }
+}
+
+void raytracer::trace_tile(const scene& scn, int w, int h, const recti& rect, const vec2f& offset, vec3f* samples) const {
+    const float inv_w = 1.f/w, inv_h = 1.f/h;
+    const float ar = float(h)/w, s = -2.f * std::tan(.5f*fov);
+    const int tw = rect.width();
+
+    auto primary = [=](int c, int r) {
+        const vec3f O = vec3f(((c + offset.x)*inv_w -.5f) * s, ((r + offset.y)*inv_h - .5f) * s * ar, 1.f) * z_min;
+        return ray3f{O, normalise(O)};
+    };
+
+    if(!use_packets_) {
+        for(int r = rect.bottom; r != rect.top; ++r) {
+            for(int c = rect.left; c != rect.right; ++c) {
+                samples[(r - rect.bottom)*tw + c - rect.left] = trace(scn, primary(c, r));
             }
-            pixels[row_offset+c].set3(pixel*.25f);
         }
+        return;
     }
 
-    return pixels;
+    // Traces 2x2 pixel quads as packets, lanes falling outside the tile are disabled
+    const int lane_c[4] = { 0, 1, 0, 1 }, lane_r[4] = { 0, 0, 1, 1 };
+    ray3f rays[ray_packet::size];
+    vec3f colours[ray_packet::size];
+    for(int r = rect.bottom; r < rect.top; r += 2) {
+        for(int c = rect.left; c < rect.right; c += 2) {
+            int active = 0;
+            for(int l = 0; l != ray_packet::size; ++l) {
+                if(c + lane_c[l] < rect.right && r + lane_r[l] < rect.top) active |= 1 << l;
+                rays[l] = primary(c + lane_c[l], r + lane_r[l]);
+            }
+
+            trace(scn, rays, active, colours);
+
+            for(int l = 0; l != ray_packet::size; ++l) {
+                if(active & (1 << l)) samples[(r + lane_r[l] - rect.bottom)*tw + c + lane_c[l] - rect.left] = colours[l];
+            }
+        }
+    }
+}
+
+void raytracer::trace(const scene& scn, const ray3f* rays, int active, vec3f* colours) const {
+    using namespace zap::maths::simd;
+    constexpr int N = ray_packet::size;
+
+    const vecm32f t_max = { active & 1 ? z_max : -1.f, active & 2 ? z_max : -1.f,
+                            active & 4 ? z_max : -1.f, active & 8 ? z_max : -1.f };
+
+    const ray_packet primary{rays};
+    hit_packet hits;
+    scn.intersect(primary, t_max.v, hits);
+
+    VALIGN float t[N];
+    VALIGN uint32_t prim[N];
+    _mm_store_ps(t, hits.t);
+    _mm_store_si128((veci*)prim, hits.prim);
+
+    hit_record<float> rec[N];
+    for(int l = 0; l != N; ++l) {
+        if(prim[l] != INVALID_IDX) {
+            scn.resolve(rays[l], t[l], prim[l], rec[l]);
+            colours[l] = scn.material(rec[l].material_id).ambient;
+        } else {
+            colours[l] = vec3f{0.f};
+        }
+    }
+
+    ray3f shadow[N];
+    VALIGN float shadow_t[N];
+    float NdotL[N];
+    for(const auto& light : scn.lights()) {
+        for(int l = 0; l != N; ++l) {
+            shadow_t[l] = -1.f;
+            shadow[l] = ray3f{vec3f{0.f}, vec3f{0.f, 1.f, 0.f}};
+            NdotL[l] = 0.f;
+            if(!rec[l].hit) continue;
+
+            vec3f ld = light - rec[l].world_coord;
+            const float dist = ld.length();
+            ld /= dist;
+            NdotL[l] = dot(ld, rec[l].normal);
+            if(NdotL[l] <= 0.f) continue;
+
+            shadow[l] = ray3f{rec[l].world_coord, ld};
+            shadow_t[l] = dist;
+        }
+
+        const vecm shadow_max = _mm_load_ps(shadow_t);
+        const int lit = _mm_movemask_ps(_mm_cmpge_ps(shadow_max, _mm_setzero_ps()));
+        if(lit == 0) continue;
+
+        const int occluded = scn.occluded(ray_packet{shadow}, shadow_max);
+        for(int l = 0; l != N; ++l) {
+            if((lit & ~occluded) & (1 << l)) colours[l] += NdotL[l] * scn.material(rec[l].material_id).diffuse;
+        }
+    }
+
+    for(int l = 0; l != N; ++l) colours[l] = clamp(colours[l], vec3f{0.f}, vec3f{255.f});
+}
+
+vec3f raytracer::trace(const scene& scn, const ray3f& r) const {
+    hit_record<float> rec;
+    if(!scn.intersect(r, z_max, rec)) return vec3f{0.f, 0.f, 0.f};
+
+    const auto& mat = scn.material(rec.material_id);
+    vec3f colour = mat.ambient;
+    for(const auto& light : scn.lights()) {
+        vec3f ld = light - rec.world_coord;
+        const float dist = ld.length();
+        ld /= dist;
+        const float NdotL = dot(ld, rec.normal);
+        if(NdotL <= 0.f || scn.occluded(ray3f{rec.world_coord, ld}, dist)) continue;
+        colour += NdotL * mat.diffuse;
+    }
+
+    return clamp(colour, vec3f{0.f}, vec3f{255.f});
 }
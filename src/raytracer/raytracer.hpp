@@ -2,25 +2,74 @@
 #ifndef ZAP_TRACER_HPP
 #define ZAP_TRACER_HPP
 
+#include <memory>
 #include <vector>
 #include <engine/pixel_format.hpp>
+#include <maths/geometry/rect.hpp>
+#include "scene.hpp"
 
 // Motivates the addition of geometric primitives, intersection tests, spatial partitioning, and PBR models.
 
+namespace zap {
+    class scheduler;
+}
+
 namespace zap { namespace renderer {
 
+/* The image is divided into square screen-space tiles which are distributed over the scheduler workers (and the calling
+ * thread) with parallel_for.  Tiles are small enough to balance uneven scenes and large enough to keep the
+ * rays of a tile coherent in the bvh.
+ *
+ * By default, primary and shadow rays are traced as 4-wide SSE packets covering 2x2 pixel quads (see packet.hpp).  The
+ * scalar path is kept for reference and comparison.
+ */
+
 class raytracer {
 public:
     raytracer();
     ~raytracer();
 
+    // Renders on the provided pool or creates a pool of pool_size threads (0 uses the hardware concurrency).  If the
+    // raytracer is not initialised, render runs on the calling thread.
+    bool initialise(scheduler* pool_ptr=nullptr, int pool_size=0);
 
+    void set_tile_size(int tile_size) { tile_size_ = tile_size > 0 ? tile_size : tile_size_; }
+    int tile_size() const { return tile_size_; }
 
+    void set_packet_tracing(bool enable) { use_packets_ = enable; }
+    bool packet_tracing() const { return use_packets_; }
 
+    // Renders the built-in test scene
     std::vector<engine::rgb888_t> render(int w, int h);
+    // Renders the scene, which is built first if required
+    std::vector<engine::rgb888_t> render(scene& scn, int w, int h);
+    std::vector<engine::rgb888_t> render(const scene& scn, int w, int h);
+
+    static void make_test_scene(scene& scn);
+
+    // Screen rectangle [left, right) x [bottom, top) of the tile in a w x h image
+    maths::geometry::recti tile_rect(int w, int h, int tile) const;
+    int tile_count(int w, int h) const { return ((w + tile_size_ - 1)/tile_size_) * ((h + tile_size_ - 1)/tile_size_); }
+
+    // Traces a single sample per pixel at the sub-pixel offset, samples are written packed row by row (rect.width() per row)
+    void trace_tile(const scene& scn, int w, int h, const maths::geometry::recti& rect, const maths::vec2f& offset,
+                    maths::vec3f* samples) const;
+
+    scheduler* pool() const { return pool_ptr_; }
+    int thread_count() const { return thread_count_; }
+
+private:
+    void render_tile(const scene& scn, int w, int h, int tile, std::vector<engine::rgb888_t>& pixels) const;
+    maths::vec3f trace(const scene& scn, const maths::geometry::ray3f& r) const;
+    void trace(const scene& scn, const maths::geometry::ray3f* rays, int active, maths::vec3f* colours) const;
+
+    scheduler* pool_ptr_ = nullptr;
+    std::unique_ptr<scheduler> pool_;
+    int thread_count_ = 0;
+    int tile_size_ = 32;
+    bool use_packets_ = true;
 };
 
 }}
 
 #endif //ZAP_TRACER_HPP
-
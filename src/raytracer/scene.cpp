@@ -0,0 +1,180 @@
+/* Created by Darren Otgaar on 2018/06/10. http://www.github.com/otgaard/zap */
+#include "scene.hpp"
+
+using namespace zap::maths;
+using namespace zap::renderer;
+using namespace zap::maths::geometry;
+
+constexpr float scene::epsilon;
+
+uint32_t scene::add_material(const rt_material& mat) {
+    materials_.push_back(mat);
+    return uint32_t(materials_.size() - 1);
+}
+
+uint32_t scene::add_sphere(const spheref& S, uint32_t material_id) {
+    assert(material_id < materials_.size() && ZERR_IDX_OUT_OF_RANGE);
+    spheres_.push_back(S);
+    sphere_mat_.push_back(material_id);
+    built_ = false;
+    return uint32_t(spheres_.size() - 1);
+}
+
+uint32_t scene::add_triangle(const trianglef& T, uint32_t material_id) {
+    assert(material_id < materials_.size() && ZERR_IDX_OUT_OF_RANGE);
+    triangles_.push_back(T);
+    triangle_mat_.push_back(material_id);
+    built_ = false;
+    return uint32_t(triangles_.size() - 1);
+}
+
+uint32_t scene::add_plane(const planef& P, uint32_t material_id) {
+    assert(material_id < materials_.size() && ZERR_IDX_OUT_OF_RANGE);
+    planes_.push_back(P);
+    plane_mat_.push_back(material_id);
+    return uint32_t(planes_.size() - 1);
+}
+
+void scene::clear() {
+    spheres_.clear();
+    sphere_mat_.clear();
+    triangles_.clear();
+    triangle_mat_.clear();
+    planes_.clear();
+    plane_mat_.clear();
+    materials_.clear();
+    lights_.clear();
+    bvh_.clear();
+    built_ = false;
+}
+
+void scene::build(size_t leaf_size) {
+    std::vector<AABB3f> bounds;
+    bounds.reserve(bounded_count());
+    for(const auto& S : spheres_) bounds.emplace_back(S.centre, vec3f{S.radius});
+    for(const auto& T : triangles_) {
+        vec3f min = T.P0, max = T.P0;
+        for(const auto& P : { T.P1, T.P2 }) {
+            for(size_t i = 0; i != 3; ++i) {
+                if(P[i] < min[i]) min[i] = P[i];
+                if(P[i] > max[i]) max[i] = P[i];
+            }
+        }
+        bounds.emplace_back(.5f*(min + max), .5f*(max - min));
+    }
+    bvh_.build(bounds, leaf_size);
+    built_ = true;
+}
+
+bool scene::intersect_prim(uint32_t prim_id, const ray3f& r, float& t) const {
+    if(prim_id < spheres_.size()) {
+        float roots[2];
+        if(int count = intersection(spheres_[prim_id], r, roots, epsilon)) {
+            t = count == 2 ? roots[1] : roots[0];
+            return true;
+        }
+        return false;
+    } else {
+        float u, v;
+        return intersection(triangles_[prim_id - spheres_.size()], r, t, u, v, epsilon);
+    }
+}
+
+int scene::intersect_prim(uint32_t prim_id, const ray_packet& p, hit_packet& hits) const {
+    return prim_id < spheres_.size()
+         ? intersection(spheres_[prim_id], p, hits, prim_id, epsilon)
+         : intersection(triangles_[prim_id - spheres_.size()], p, hits, prim_id, epsilon);
+}
+
+bool scene::intersect(const ray3f& r, float t_max, hit_record<float>& rec) const {
+    assert(built_ && "scene::build() must be called before intersecting");
+
+    uint32_t prim_id = INVALID_IDX;
+    bvh_.closest(r, t_max, [this, &r, &prim_id](uint32_t id, float& t_closest) {
+        float t;
+        if(intersect_prim(id, r, t) && t < t_closest) {
+            t_closest = t;
+            prim_id = id;
+            return true;
+        }
+        return false;
+    });
+
+    for(uint32_t i = 0, end = uint32_t(planes_.size()); i != end; ++i) {
+        const float t = intersection(planes_[i], r);
+        if(t > epsilon && t < t_max) {
+            t_max = t;
+            prim_id = bounded_count() + i;
+        }
+    }
+
+    if(prim_id != INVALID_IDX) resolve(r, t_max, prim_id, rec);
+    return rec.hit;
+}
+
+bool scene::occluded(const ray3f& r, float t_max) const {
+    assert(built_ && "scene::build() must be called before intersecting");
+
+    for(const auto& P : planes_) {
+        const float t = intersection(P, r);
+        if(t > epsilon && t < t_max) return true;
+    }
+
+    return bvh_.any(r, t_max, [this, &r](uint32_t id, float t_limit) {
+        float t;
+        return intersect_prim(id, r, t) && t < t_limit;
+    });
+}
+
+void scene::intersect(const ray_packet& p, const vecm& t_max, hit_packet& hits) const {
+    assert(built_ && "scene::build() must be called before intersecting");
+
+    hits = hit_packet{t_max};
+    bvh_.closest(p, hits, [this, &p](uint32_t id, hit_packet& h) { intersect_prim(id, p, h); });
+
+    const uint32_t offset = bounded_count();
+    for(uint32_t i = 0, end = uint32_t(planes_.size()); i != end; ++i) {
+        intersection(planes_[i], p, hits, offset + i, epsilon);
+    }
+}
+
+int scene::occluded(const ray_packet& p, const vecm& t_max) const {
+    assert(built_ && "scene::build() must be called before intersecting");
+
+    const int active = _mm_movemask_ps(_mm_cmpge_ps(t_max, _mm_setzero_ps()));
+    if(active == 0) return 0;
+
+    hit_packet hits{t_max};
+    int mask = 0;
+    for(const auto& P : planes_) mask |= intersection(P, p, hits, 0, epsilon);
+    if((mask & active) == active) return active;
+
+    // Occluded lanes are retired before traversing the bvh
+    const maths::simd::vecm32i lanes = { mask & 1 ? -1 : 0, mask & 2 ? -1 : 0, mask & 4 ? -1 : 0, mask & 8 ? -1 : 0 };
+    const vecm remaining = maths::simd::select_v(lanes.v, maths::simd::load(-1.f), t_max);
+
+    return (mask | bvh_.any(p, remaining, [this, &p](uint32_t id, hit_packet& h) {
+        return intersect_prim(id, p, h);
+    })) & active;
+}
+
+void scene::resolve(const ray3f& r, float t, uint32_t prim_id, hit_record<float>& rec) const {
+    rec.hit = true;
+    rec.t = t;
+    rec.world_coord = r.position(t);
+
+    if(prim_id < spheres_.size()) {
+        const auto& S = spheres_[prim_id];
+        rec.normal = (rec.world_coord - S.centre) / S.radius;
+        rec.material_id = sphere_mat_[prim_id];
+    } else if(prim_id < bounded_count()) {
+        const uint32_t idx = prim_id - uint32_t(spheres_.size());
+        rec.normal = triangles_[idx].normal();
+        if(dot(rec.normal, r.d) > 0.f) rec.normal = -rec.normal;      // Triangles are two-sided
+        rec.material_id = triangle_mat_[idx];
+    } else {
+        const uint32_t idx = prim_id - bounded_count();
+        rec.normal = planes_[idx].n;
+        rec.material_id = plane_mat_[idx];
+    }
+}
@@ -0,0 +1,99 @@
+/* Created by Darren Otgaar on 2018/06/10. http://www.github.com/otgaard/zap */
+#ifndef ZAP_RT_SCENE_HPP
+#define ZAP_RT_SCENE_HPP
+
+/* The raytracer scene holds the primitives, materials and lights.  Bounded primitives (spheres and triangles) are indexed
+ * by a bvh which must be rebuilt by calling build() after the scene is modified.  Planes are unbounded and tested
+ * linearly.
+ *
+ * Primitive ids are shared by the scalar and packet paths: [0, S) are spheres, [S, S+T) are triangles, and the planes
+ * follow at [S+T, S+T+P).
+ */
+
+#include <vector>
+#include <maths/geometry/AABB.hpp>
+#include <maths/geometry/plane.hpp>
+#include <maths/geometry/sphere.hpp>
+#include <maths/geometry/triangle.hpp>
+#include "hit_record.hpp"
+#include "packet.hpp"
+#include "bvh.hpp"
+
+namespace zap { namespace renderer {
+
+struct rt_material {
+    rt_material() = default;
+    rt_material(const maths::vec3f& ambient, const maths::vec3f& diffuse) : ambient(ambient), diffuse(diffuse) { }
+
+    maths::vec3f ambient;       // [0, 255]
+    maths::vec3f diffuse;       // [0, 255]
+};
+
+class scene {
+public:
+    using vec3f = maths::vec3f;
+    using ray3f = maths::geometry::ray3f;
+    using spheref = maths::geometry::spheref;
+    using planef = maths::geometry::plane<float>;
+    using trianglef = maths::geometry::trianglef;
+    using vecm = maths::simd::vecm;
+    using AABB3f = maths::geometry::AABB3f;
+
+    scene() = default;
+    ~scene() = default;
+
+    uint32_t add_material(const rt_material& mat);
+    uint32_t add_sphere(const spheref& S, uint32_t material_id);
+    uint32_t add_triangle(const trianglef& T, uint32_t material_id);
+    uint32_t add_plane(const planef& P, uint32_t material_id);
+    void add_light(const vec3f& P) { lights_.push_back(P); }
+
+    void clear();
+
+    // Rebuilds the acceleration structure, must be called after adding primitives and before rendering
+    void build(size_t leaf_size=4);
+    bool is_built() const { return built_; }
+
+    // Closest intersection in (epsilon, t_max)
+    bool intersect(const ray3f& r, float t_max, hit_record<float>& rec) const;
+    // Any intersection in (epsilon, t_max)
+    bool occluded(const ray3f& r, float t_max) const;
+
+    // Packet closest intersection, lanes with t_max < 0 are inactive
+    void intersect(const ray_packet& p, const vecm& t_max, hit_packet& hits) const;
+    // Returns the mask of occluded lanes, lanes with t_max < 0 are inactive
+    int occluded(const ray_packet& p, const vecm& t_max) const;
+
+    // Completes the hit_record for the primitive hit at t along r
+    void resolve(const ray3f& r, float t, uint32_t prim_id, hit_record<float>& rec) const;
+
+    const std::vector<spheref>& spheres() const { return spheres_; }
+    const std::vector<trianglef>& triangles() const { return triangles_; }
+    const std::vector<planef>& planes() const { return planes_; }
+    const std::vector<vec3f>& lights() const { return lights_; }
+    const rt_material& material(uint32_t id) const { return materials_[id]; }
+    const bvh& hierarchy() const { return bvh_; }
+
+    constexpr static float epsilon = 1e-4f;
+
+protected:
+    uint32_t bounded_count() const { return uint32_t(spheres_.size() + triangles_.size()); }
+    bool intersect_prim(uint32_t prim_id, const ray3f& r, float& t) const;
+    int intersect_prim(uint32_t prim_id, const ray_packet& p, hit_packet& hits) const;
+
+private:
+    std::vector<spheref> spheres_;
+    std::vector<uint32_t> sphere_mat_;
+    std::vector<trianglef> triangles_;
+    std::vector<uint32_t> triangle_mat_;
+    std::vector<planef> planes_;
+    std::vector<uint32_t> plane_mat_;
+    std::vector<rt_material> materials_;
+    std::vector<vec3f> lights_;
+    bvh bvh_;
+    bool built_ = false;
+};
+
+}}
+
+#endif //ZAP_RT_SCENE_HPP
@@ -256,6 +256,7 @@ public:
     }
     program* get_program() const { return program_; }
     const std::vector<char>& get_uniforms() const { return uniforms_; }
+    const std::vector<const texture*>& get_textures() const { return textures_; }
 
     void set_state(const render_state* rndr_state) { rndr_state_ = rndr_state; }
     const render_state* get_state() const { return rndr_state_; }
@@ -0,0 +1,128 @@
+/* Created by Darren Otgaar on 2018/06/24. http://www.github.com/otgaard/zap */
+#include "render_queue.hpp"
+#include <cstring>
+
+using namespace zap::engine;
+using namespace zap::renderer;
+
+namespace {
+    enum field { F_STATE = 0, F_PROGRAM = 1, F_TEXTURES = 2, F_CONTEXT = 3, F_MESH = 4, F_COUNT = 5 };
+
+    // The widths of the key fields (render_queue.hpp)
+    constexpr uint64_t state_mask = (1u << 7) - 1, id_mask = (1u << 10) - 1, depth_mask = (1u << 16) - 1;
+
+    // The top 16 bits of a non-negative float, which order as the float does
+    inline uint64_t quantise_depth(float depth) {
+        if(!(depth > 0.f)) return 0;
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> 15;
+    }
+
+    inline uint64_t hash_textures(const std::vector<const texture*>& textures) {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for(auto tex : textures) hash = (hash ^ uint64_t(reinterpret_cast<uintptr_t>(tex)))*0x100000001B3ULL;
+        return hash;
+    }
+}
+
+uint64_t render_queue::make_key(bool translucent, uint32_t state, uint32_t program, uint32_t textures,
+                                uint32_t context, uint32_t mesh, float depth) {
+    assert(state <= state_mask && program <= id_mask && textures <= id_mask && context <= id_mask && mesh <= id_mask &&
+           "render_queue::make_key id exceeds its field, the frame has too many distinct states or resources");
+    const uint64_t ids = (uint64_t(state) & state_mask) << 40 | (uint64_t(program) & id_mask) << 30 |
+                         (uint64_t(textures) & id_mask) << 20 | (uint64_t(context) & id_mask) << 10 |
+                         (uint64_t(mesh) & id_mask);
+    const uint64_t d = quantise_depth(depth);
+    if(translucent) return uint64_t(1) << 63 | (depth_mask - d) << 47 | ids;
+    else            return ids << 16 | d;
+}
+
+uint32_t render_queue::intern(int field, uint64_t value) {
+    auto& map = ids_[field];
+    return map.emplace(value, uint32_t(map.size())).first->second;
+}
+
+void render_queue::submit(primitive_type type, const mesh_base* mesh_ptr, const render_context* context_ptr,
+                          const render_args* args_ptr, float depth) {
+    assert(mesh_ptr && context_ptr && "render_queue::submit requires a mesh and a context");
+    const auto state = context_ptr->get_state();
+    const bool translucent = state && state->blend() && state->blend()->enabled;
+
+    item itm{type, mesh_ptr, context_ptr, args_ptr, {}};
+    itm.ids[F_STATE] = intern(F_STATE, uint64_t(reinterpret_cast<uintptr_t>(state)));
+    itm.ids[F_PROGRAM] = intern(F_PROGRAM, uint64_t(reinterpret_cast<uintptr_t>(context_ptr->get_program())));
+    itm.ids[F_TEXTURES] = intern(F_TEXTURES, hash_textures(context_ptr->get_textures()));
+    itm.ids[F_CONTEXT] = intern(F_CONTEXT, uint64_t(reinterpret_cast<uintptr_t>(context_ptr)));
+    itm.ids[F_MESH] = intern(F_MESH, uint64_t(reinterpret_cast<uintptr_t>(mesh_ptr)));
+
+    keys_.push_back(make_key(translucent, itm.ids[F_STATE], itm.ids[F_PROGRAM], itm.ids[F_TEXTURES],
+                             itm.ids[F_CONTEXT], itm.ids[F_MESH], depth));
+    items_.push_back(itm);
+}
+
+const std::vector<uint32_t>& render_queue::sort() {
+    const size_t count = items_.size();
+    order_.resize(count);
+    for(size_t i = 0; i != count; ++i) order_[i] = uint32_t(i);
+
+    stats_ = frame_stats{};
+    stats_.draws = uint32_t(count);
+    count_switches(order_.data(), stats_.submitted);
+
+    // LSD radix sort of the keys by byte, skipping the bytes that are the same in every key
+    auto& keys = sorted_keys_;
+    keys.assign(keys_.begin(), keys_.end());
+    scratch_keys_.resize(count);
+    scratch_order_.resize(count);
+    for(int shift = 0; shift != 64 && count > 1; shift += 8) {
+        uint32_t histogram[256] = { };
+        for(auto key : keys) ++histogram[(key >> shift) & 0xFF];
+        if(histogram[(keys[0] >> shift) & 0xFF] == count) continue;
+
+        uint32_t offset = 0;
+        for(auto& h : histogram) {
+            const uint32_t c = h;
+            h = offset;
+            offset += c;
+        }
+        for(size_t i = 0; i != count; ++i) {
+            const uint32_t slot = histogram[(keys[i] >> shift) & 0xFF]++;
+            scratch_keys_[slot] = keys[i];
+            scratch_order_[slot] = order_[i];
+        }
+        keys.swap(scratch_keys_);
+        order_.swap(scratch_order_);
+    }
+
+    count_switches(order_.data(), stats_.sorted);
+    return order_;
+}
+
+void render_queue::flush(renderer* rndr) {
+    sort();
+    for(auto idx : order_) {
+        const auto& itm = items_[idx];
+        if(itm.args) rndr->draw(itm.type, itm.mesh, itm.context, *itm.args);
+        else         rndr->draw(itm.type, itm.mesh, itm.context);
+    }
+    clear();
+}
+
+void render_queue::clear() {
+    items_.clear();
+    keys_.clear();
+    for(auto& map : ids_) map.clear();
+}
+
+void render_queue::count_switches(const uint32_t* order, switch_count& count) const {
+    uint32_t* counters[F_COUNT] = { &count.state, &count.program, &count.textures, &count.context, &count.mesh };
+    const item* prev = nullptr;
+    for(size_t i = 0; i != items_.size(); ++i) {
+        const auto& itm = items_[order[i]];
+        for(int f = 0; f != F_COUNT; ++f) {
+            if(!prev || prev->ids[f] != itm.ids[f]) ++*counters[f];
+        }
+        prev = &itm;
+    }
+}
@@ -0,0 +1,107 @@
+/* Created by Darren Otgaar on 2018/06/24. http://www.github.com/otgaard/zap */
+#ifndef ZAP_RENDER_QUEUE_HPP
+#define ZAP_RENDER_QUEUE_HPP
+
+/* The render_queue collects the draws of a frame and replays them through the renderer in an order that minimises the
+ * state changes between them.  Each draw is given a 64-bit sort key:
+ *
+ *   opaque:       0 | state (7) | program (10) | textures (10) | context (10) | mesh (10) | depth (16, front to back)
+ *   translucent:  1 | depth (16, back to front) | state (7) | program (10) | textures (10) | context (10) | mesh (10)
+ *
+ * where the fields are dense per-frame ids of the render_state, program, texture set, render_context and mesh, so that
+ * draws sharing state are adjacent and translucent (blended) draws follow the opaque draws in depth order.  The keys are
+ * radix sorted (stable, so equal keys keep their submission order).  The queue counts the switches of each kind in the
+ * submitted and in the sorted order, giving the switches saved per frame.
+ *
+ * A frame may use 128 distinct render_states and 1024 of each of the other fields (asserted in make_key).  Beyond that a
+ * release build wraps the ids, which still draws correctly but sorts the aliased draws together with others.
+ *
+ * The meshes, contexts and render_args must remain valid until flush().
+ */
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <renderer/rndr.hpp>
+#include <renderer/renderer.hpp>
+
+namespace zap { namespace renderer {
+
+class ZAPRENDERER_EXPORT render_queue {
+public:
+    using mesh_base = engine::mesh_base;
+    using primitive_type = engine::primitive_type;
+
+    struct switch_count {
+        uint32_t state = 0;
+        uint32_t program = 0;
+        uint32_t textures = 0;
+        uint32_t context = 0;
+        uint32_t mesh = 0;                              // Vertex array bindings
+    };
+
+    struct frame_stats {
+        uint32_t draws = 0;
+        switch_count submitted;                         // The switches in submission order
+        switch_count sorted;                            // The switches replayed
+    };
+
+    render_queue() = default;
+
+    // depth is the distance from the eye, or any key increasing away from the eye (negative values are treated as zero)
+    void submit(primitive_type type, const mesh_base* mesh_ptr, const render_context* context_ptr,
+                const render_args* args_ptr=nullptr, float depth=0.f);
+
+    template <typename SpatialT>
+    void submit(const scene_graph::visual<SpatialT>& v, const render_args& args, float depth=0.f) {
+        submit(v.get_type(), v.get_mesh(), args.get_context(), &args, depth);
+    }
+
+    template <typename SpatialT>
+    void submit(const scene_graph::visual<SpatialT>& v, const render_context* context_ptr, float depth=0.f) {
+        submit(v.get_type(), v.get_mesh(), context_ptr, nullptr, depth);
+    }
+
+    // Submits the visible set of the culler, each visual with its own context and at the depth of its bound
+    template <typename SpatialT>
+    void submit(const scene_graph::culler<SpatialT>& visible) {
+        for(const auto& v : visible.visible()) submit(*v.obj, v.obj->get_context(), v.depth);
+    }
+
+    // Sorts the keys without drawing, returning the submission indices in draw order
+    const std::vector<uint32_t>& sort();
+    // Sorts and draws the submitted draws and clears the queue
+    void flush(renderer* rndr);
+    void clear();
+
+    size_t size() const { return items_.size(); }
+    bool empty() const { return items_.empty(); }
+    // The statistics of the last sort
+    const frame_stats& stats() const { return stats_; }
+
+    static uint64_t make_key(bool translucent, uint32_t state, uint32_t program, uint32_t textures, uint32_t context,
+                             uint32_t mesh, float depth);
+
+protected:
+    struct item {
+        primitive_type type;
+        const mesh_base* mesh;
+        const render_context* context;
+        const render_args* args;
+        uint32_t ids[5];                                // state, program, textures, context, mesh
+    };
+
+    uint32_t intern(int field, uint64_t value);
+    void count_switches(const uint32_t* order, switch_count& count) const;
+
+    std::vector<item> items_;
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> order_, scratch_order_;
+    std::vector<uint64_t> sorted_keys_, scratch_keys_;
+    std::unordered_map<uint64_t, uint32_t> ids_[5];     // The per-frame ids of each field
+    frame_stats stats_;
+};
+
+}}
+
+#endif //ZAP_RENDER_QUEUE_HPP
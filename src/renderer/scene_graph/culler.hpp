@@ -0,0 +1,182 @@
+/* Created by Darren Otgaar on 2018/06/25. http://www.github.com/otgaard/zap */
+#ifndef ZAP_CULLER_HPP
+#define ZAP_CULLER_HPP
+
+/* The culler collects the visuals of a scene graph that intersect the view frustum.  The six planes are extracted from
+ * the camera's proj_view matrix (with the normals pointing into the frustum) and the world bound of each spatial is
+ * tested against the planes that are still active.  A bound on the inner side of a plane deactivates that plane for the
+ * subtree below it, so a subtree fully inside the frustum is collected without any further tests and a subtree fully
+ * outside is skipped at its root.  A spatial with cull_mode::CM_ALWAYS is never drawn and one with CM_NEVER is always
+ * drawn (with everything below it).
+ *
+ * Only 3D spheres and AABBs are tested, other bounds are treated as visible.
+ */
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <renderer/camera.hpp>
+#include "spatial.hpp"
+
+namespace zap { namespace scene_graph {
+    template <typename SpatialT> class visual;
+
+    namespace detail {
+        // -1 if G is outside P, +1 if inside P and 0 if it straddles the plane
+        template <typename GeoT>
+        inline int which_side(const maths::vec4f& P, const GeoT& G) { return 0; }
+
+        inline int which_side(const maths::vec4f& P, const maths::geometry::spheref& S) {
+            const float d = P.x*S.centre.x + P.y*S.centre.y + P.z*S.centre.z + P.w;
+            return d <= -S.radius ? -1 : d >= S.radius ? +1 : 0;
+        }
+
+        inline int which_side(const maths::vec4f& P, const maths::geometry::AABB3f& B) {
+            const float d = P.x*B.centre.x + P.y*B.centre.y + P.z*B.centre.z + P.w;
+            const float r = std::abs(P.x)*B.hextent.x + std::abs(P.y)*B.hextent.y + std::abs(P.z)*B.hextent.z;
+            return d <= -r ? -1 : d >= r ? +1 : 0;
+        }
+
+        template <typename GeoT>
+        inline float view_depth(const maths::vec3f& eye, const maths::vec3f& dir, const GeoT& G) { return 0.f; }
+
+        inline float view_depth(const maths::vec3f& eye, const maths::vec3f& dir, const maths::geometry::spheref& S) {
+            return maths::dot(S.centre - eye, dir);
+        }
+
+        inline float view_depth(const maths::vec3f& eye, const maths::vec3f& dir, const maths::geometry::AABB3f& B) {
+            return maths::dot(B.centre - eye, dir);
+        }
+    }
+
+    template <typename SpatialT>
+    class culler {
+    public:
+        using spatial_t = SpatialT;
+        using visual_t = visual<SpatialT>;
+        using vec3f = maths::vec3f;
+        using vec4f = maths::vec4f;
+        using mat4f = maths::mat4f;
+
+        enum frustum_plane {
+            FP_DMIN = 0,
+            FP_DMAX = 1,
+            FP_UMIN = 2,
+            FP_UMAX = 3,
+            FP_RMIN = 4,
+            FP_RMAX = 5,
+            FP_COUNT = 6
+        };
+
+        constexpr static uint32_t all_planes = (1u << FP_COUNT) - 1;
+
+        struct visible_object {
+            const visual_t* obj;
+            float depth;                                // The distance of the bound's centre along the view direction
+        };
+
+        using visible_set = std::vector<visible_object>;
+
+        struct cull_stats {
+            uint32_t tested = 0;                        // The bounds tested against the frustum
+            uint32_t culled = 0;                        // The subtrees rejected
+            uint32_t contained = 0;                     // The subtrees accepted without testing their children
+        };
+
+        culler() = default;
+        explicit culler(const renderer::camera& cam) { set_frustum(cam); }
+
+        void set_frustum(const renderer::camera& cam) { set_frustum(cam.proj_view(), cam.world_pos(), cam.dir()); }
+        void set_frustum(const mat4f& proj_view, const vec3f& eye, const vec3f& dir);
+
+        // Clears the visible set and collects the visuals of scene
+        const visible_set& compute_visible_set(const spatial_t& scene) {
+            clear();
+            add_visible_set(scene);
+            return visible_;
+        }
+
+        // Appends the visuals of scene to the visible set
+        void add_visible_set(const spatial_t& scene) {
+            plane_state_ = all_planes;
+            scene.get_visible_set(*this, false);
+        }
+
+        void clear() { visible_.clear(); stats_ = cull_stats{}; }
+
+        const visible_set& visible() const { return visible_; }
+        size_t size() const { return visible_.size(); }
+        bool empty() const { return visible_.empty(); }
+        const cull_stats& stats() const { return stats_; }
+        const vec4f& plane(int idx) const { return planes_[idx]; }
+
+        // Used by the scene graph during the traversal
+        bool is_visible(const typename spatial_t::bound_t& bound);
+        void insert(const visual_t& obj) {
+            visible_.push_back({&obj, detail::view_depth(eye_, dir_, obj.world_bound().geometry)});
+        }
+        uint32_t get_plane_state() const { return plane_state_; }
+        void set_plane_state(uint32_t state) { plane_state_ = state; }
+
+    protected:
+        vec4f planes_[FP_COUNT];
+        vec3f eye_ = {0.f, 0.f, 0.f};
+        vec3f dir_ = {0.f, 0.f, 1.f};
+        uint32_t plane_state_ = all_planes;             // The planes still to be tested, one bit per plane
+        visible_set visible_;
+        cull_stats stats_;
+    };
+
+    template <typename SpatialT>
+    void culler<SpatialT>::set_frustum(const mat4f& proj_view, const vec3f& eye, const vec3f& dir) {
+        // Gribb & Hartmann, a point is inside if -w <= x, y, z <= w in clip space
+        const vec4f r0 = proj_view.row4(0), r1 = proj_view.row4(1), r2 = proj_view.row4(2), r3 = proj_view.row4(3);
+        planes_[FP_DMIN] = r3 + r2;
+        planes_[FP_DMAX] = r3 - r2;
+        planes_[FP_UMIN] = r3 + r1;
+        planes_[FP_UMAX] = r3 - r1;
+        planes_[FP_RMIN] = r3 + r0;
+        planes_[FP_RMAX] = r3 - r0;
+        for(auto& P : planes_) {
+            const float len = P.xyz().length();
+            if(len > 0.f) P *= 1.f/len;
+        }
+
+        eye_ = eye;
+        dir_ = dir;
+    }
+
+    template <typename SpatialT>
+    bool culler<SpatialT>::is_visible(const typename spatial_t::bound_t& bound) {
+        if(plane_state_ == 0) return true;
+
+        ++stats_.tested;
+        for(int i = 0; i != FP_COUNT; ++i) {
+            const uint32_t mask = 1u << i;
+            if(!(plane_state_ & mask)) continue;
+
+            const int side = detail::which_side(planes_[i], bound.geometry);
+            if(side < 0) {
+                ++stats_.culled;
+                return false;
+            }
+            if(side > 0) plane_state_ &= ~mask;
+        }
+
+        if(plane_state_ == 0) ++stats_.contained;
+        return true;
+    }
+
+    template <typename TransformT, typename GeoT>
+    void spatial<TransformT,GeoT>::get_visible_set(culler<spatial>& c, bool no_cull) const {
+        if(culling_ == cull_mode::CM_ALWAYS) return;
+        if(culling_ == cull_mode::CM_NEVER) no_cull = true;
+
+        // The planes the bound is inside of are cleared for the subtree and restored for the siblings
+        const auto state = c.get_plane_state();
+        if(no_cull || c.is_visible(world_bound())) on_get_visible_set(c, no_cull || c.get_plane_state() == 0);
+        c.set_plane_state(state);
+    }
+}}
+
+#endif //ZAP_CULLER_HPP
@@ -9,6 +9,8 @@
 #include <memory>
 #include <algorithm>
 #include "spatial.hpp"
+#include "culler.hpp"
+#include <tools/scheduler.hpp>
 
 namespace zap { namespace scene_graph {
     template <typename SpatialT, typename PtrT>
@@ -25,19 +27,32 @@ namespace zap { namespace scene_graph {
         node& operator=(const node& rhs) = delete;
 
         void update(double t, float dt) override;
-
-        size_t child_count() const { return children_.size(); }
+        /* Updates the transforms and bounds of the graph in parallel.  The transforms of the top levels are updated on
+         * the calling thread until there are at least subtrees independent subtrees (by default four per worker).  Each
+         * subtree is updated and its bound computed as a task on the pool, then the bounds of the top levels are
+         * combined.  The update() of a spatial must only modify its own subtree.
+         *
+         * Overrides of update() on the expanded top levels (including this node) are not called, only those within the
+         * subtrees are.  When the top levels do not override update(), the transforms and bounds are identical to those
+         * of update() followed by world_bound().
+         */
+        void update(double t, float dt, scheduler& pool, size_t subtrees=0);
+
+        size_t child_count() const override { return children_.size(); }
         size_t attach_child(spatial_t* ptr);
         spatial_t* detach_child(spatial_t* ptr);
         spatial_t* detach_child(size_t idx);
-        spatial_t* at(size_t idx);
-        const spatial_t* at(size_t idx) const;
+        spatial_t* at(size_t idx) override;
+        const spatial_t* at(size_t idx) const override;
 
     protected:
         using child_array_t = std::vector<ptr_t>;
         void invalidate_transform() const override;
         void update_transform() const override;
         void update_bound() const override;
+        void on_get_visible_set(culler<SpatialT>& c, bool no_cull) const override {
+            for(auto& spatial : children_) spatial->get_visible_set(c, no_cull);
+        }
 
         child_array_t children_;
     };
@@ -47,39 +62,37 @@ namespace zap { namespace scene_graph {
         assert(ptr->parent() == nullptr && "Attempt to attach owned child");
         if(ptr->parent() != nullptr) return INVALID_IDX;
         auto idx = children_.size();
+        ptr->set_parent(this);
         children_.push_back(ptr);
+        SpatialT::invalidate_bound();
         return idx;
     }
 
     template <typename SpatialT, typename PtrT>
     typename node<SpatialT, PtrT>::spatial_t* node<SpatialT, PtrT>::detach_child(typename node<SpatialT, PtrT>::spatial_t* ptr) {
-        auto it = std::find_if(children_.begin(), children_.end(), ptr);
-        if(it != children_.end()) {
-            children_.erase(it);
-            return ptr;
-        }
-        return nullptr;
+        auto it = std::find_if(children_.begin(), children_.end(), [ptr](const ptr_t& child) { return &*child == ptr; });
+        return it != children_.end() ? detach_child(size_t(it - children_.begin())) : nullptr;
     }
 
     template <typename SpatialT, typename PtrT>
     typename node<SpatialT, PtrT>::spatial_t* node<SpatialT, PtrT>::detach_child(size_t idx) {
-        auto it = children_.begin()+idx;
-        if(it != children_.end()) {
-            auto ptr = *it;
-            children_.erase(it);
-            return ptr;
-        }
-        return nullptr;
+        if(idx >= children_.size()) return nullptr;
+        spatial_t* ptr = &*children_[idx];
+        children_.erase(children_.begin()+idx);
+        ptr->set_parent(nullptr);
+        ptr->invalidate_transform();
+        SpatialT::invalidate_bound();
+        return ptr;
     }
 
     template <typename SpatialT, typename PtrT>
     typename node<SpatialT, PtrT>::spatial_t* node<SpatialT, PtrT>::at(size_t idx) {
-        return idx < children_.size() ? children_[idx] : nullptr;
+        return idx < children_.size() ? &*children_[idx] : nullptr;
     }
 
     template <typename SpatialT, typename PtrT>
     const typename node<SpatialT, PtrT>::spatial_t* node<SpatialT, PtrT>::at(size_t idx) const {
-        return idx < children_.size() ? children_[idx] : nullptr;
+        return idx < children_.size() ? &*children_[idx] : nullptr;
     }
 
     template <typename SpatialT, typename PtrT>
@@ -98,6 +111,52 @@ namespace zap { namespace scene_graph {
         }
     }
 
+    template <typename SpatialT, typename PtrT>
+    void node<SpatialT, PtrT>::update(double t, float dt, scheduler& pool, size_t subtrees) {
+        if(subtrees == 0) subtrees = 4*std::max<size_t>(pool.size(), 1);
+
+        // Expand the top levels a level at a time until there are enough subtrees, leaves remain subtrees of their own
+        std::vector<spatial_t*> frontier(1, this), next;
+        bool expanded = true;
+        while(expanded && frontier.size() < subtrees) {
+            expanded = false;
+            next.clear();
+            for(auto ptr : frontier) {
+                const size_t count = ptr->child_count();
+                if(count == 0) {
+                    next.push_back(ptr);
+                    continue;
+                }
+
+                if(ptr->cache_state_.is_set(spatial_state::SS_TRANS_INVALID)) {
+                    ptr->update_transform();
+                    for(size_t i = 0; i != count; ++i) ptr->at(i)->invalidate_transform();
+                }
+                // The tasks read the world transform, so the lazy matrix is computed here
+                ptr->world_transform().affine();
+                ptr->invalidate_bound();
+                for(size_t i = 0; i != count; ++i) next.push_back(ptr->at(i));
+                expanded = true;
+            }
+            frontier.swap(next);
+        }
+
+        if(frontier.size() == 1 && frontier[0] == this) {
+            update(t, dt);
+            SpatialT::world_bound();
+            return;
+        }
+
+        pool.parallel_for(0, int(frontier.size()), 1, [&frontier, t, dt](int first, int last) {
+            for(int i = first; i != last; ++i) {
+                frontier[i]->update(t, dt);
+                frontier[i]->world_bound();
+            }
+        });
+
+        SpatialT::world_bound();
+    }
+
     template <typename SpatialT, typename PtrT>
     void node<SpatialT, PtrT>::update_transform() const {
         if(SpatialT::parent_ && SpatialT::parent_->cache_state_.is_set(spatial_state::SS_TRANS_INVALID)) {
@@ -123,13 +182,13 @@ namespace zap { namespace scene_graph {
         if(SpatialT::cache_state_.is_set(spatial_state::SS_BOUND_INVALID)) {
             bool found_first = false;
             for(auto& spatial : children_) {
-                if(found_first) SpatialT::world_bound_.combine(spatial->world_bound());
+                if(found_first) SpatialT::world_bound_.grow(spatial->world_bound());
                 else {
                     found_first = true;
                     SpatialT::world_bound_ = spatial->world_bound();
                 }
             }
-            SpatialT::model_bound_ = SpatialT::world_bound_.transform(SpatialT::world_transform().inv_affine());
+            SpatialT::model_bound_ = SpatialT::world_bound_.transform_cref(SpatialT::world_transform().inv_affine());
         }
         SpatialT::cache_state_.clear(spatial_state::SS_BOUND_INVALID);
     }
@@ -13,6 +13,7 @@
 
 namespace zap { namespace scene_graph {
     template <typename SpatialT, typename PtrT=std::unique_ptr<SpatialT>> class node;
+    template <typename SpatialT> class culler;
 
     enum class cull_mode : char {
         CM_NEVER,
@@ -62,9 +63,15 @@ namespace zap { namespace scene_graph {
         bool always_cull() const { return culling_ == cull_mode::CM_ALWAYS; }
 
         const spatial* parent() const { return parent_; }
+        virtual size_t child_count() const { return 0; }
+        virtual spatial* at(size_t idx) { return nullptr; }
+        virtual const spatial* at(size_t idx) const { return nullptr; }
 
         virtual void update(double t, float dt) { }
 
+        // Adds the visuals of this subtree that are not culled to the culler (defined in culler.hpp)
+        void get_visible_set(culler<spatial>& c, bool no_cull) const;
+
         bool is_dirty() const { return cache_state_.is_set(spatial_state::SS_TRANS_INVALID); }
 
     protected:
@@ -74,7 +81,14 @@ namespace zap { namespace scene_graph {
 
         spatial() = default;
         void set_parent(spatial* parent) { parent_ = parent; }
-        void invalidate_bound() const { cache_state_.set(spatial_state::SS_BOUND_INVALID); }
+        // Invalidates the bound of this spatial and its ancestors, stopping at the first that is already invalid (whose
+        // ancestors are invalid too).  Only writes valid bounds, so concurrent children of an invalidated parent do not
+        // race.
+        void invalidate_bound() const {
+            for(auto ptr = this; ptr && !ptr->cache_state_.is_set(spatial_state::SS_BOUND_INVALID); ptr = ptr->parent_) {
+                ptr->cache_state_.set(spatial_state::SS_BOUND_INVALID);
+            }
+        }
         virtual void invalidate_transform() const {
             cache_state_.set(spatial_state::SS_TRANS_INVALID, spatial_state::SS_BOUND_INVALID);
             if(parent_) parent_->invalidate_bound();
@@ -82,6 +96,7 @@ namespace zap { namespace scene_graph {
 
         virtual void update_transform() const;
         virtual void update_bound() const;
+        virtual void on_get_visible_set(culler<spatial>& c, bool no_cull) const { }
 
         spatial* parent_ = nullptr;
         transform_t model_transform_;
@@ -0,0 +1,347 @@
+/* Created by Darren Otgaar on 2018/06/26. http://www.github.com/otgaard/zap */
+#ifndef ZAP_TRANSFORM_STORE_HPP
+#define ZAP_TRANSFORM_STORE_HPP
+
+/* A flat, structure of arrays alternative to the node/spatial hierarchy.  The store keeps the parent index, local
+ * transform, world matrix and the model and world bounds of every element in contiguous arrays, ordered so that every
+ * parent precedes its children.  update() then composes the world matrices in one forward pass (a dirty element dirties
+ * the elements after it that reference it) and the world bounds in two backward passes (children are combined into
+ * their parents, as in node::update_bound), without any recursion or virtual calls.
+ *
+ * Elements are referenced by stable handles, the dense index of an element changes when the hierarchy is reordered or
+ * elements are destroyed.  Creating an element under an existing parent keeps the order, reparenting reorders the store
+ * depth first (so that every subtree is contiguous) on the next update().  spatial_handle provides the spatial API over
+ * an element.  World matrices and bounds are those of the last update().
+ */
+
+#include <vector>
+#include <cstdint>
+#include "spatial.hpp"
+
+namespace zap { namespace scene_graph {
+    template <typename TransformT, typename GeoT>
+    class transform_store {
+    public:
+        using transform_t = TransformT;
+        using bound_t = maths::bound<GeoT, TransformT>;
+        using affine_t = typename transform_t::affine_t;
+        using handle_t = uint32_t;
+
+        constexpr static handle_t invalid_handle = ~handle_t(0);
+
+        transform_store() = default;
+        explicit transform_store(size_t reserve) { this->reserve(reserve); }
+
+        void reserve(size_t count);
+
+        handle_t create(handle_t parent=invalid_handle) { return create(bound_t{}, parent); }
+        handle_t create(const bound_t& model_bound, handle_t parent=invalid_handle);
+        // Destroys the element and all of its descendants
+        void destroy(handle_t h);
+        bool set_parent(handle_t h, handle_t parent);
+
+        bool is_valid(handle_t h) const { return h < slots_.size() && slots_[h] != invalid_handle; }
+        size_t size() const { return parent_.size(); }
+        bool empty() const { return parent_.empty(); }
+
+        handle_t parent(handle_t h) const { auto p = parent_[index(h)]; return p < 0 ? invalid_handle : ids_[p]; }
+        size_t child_count(handle_t h) const { return child_count_[index(h)]; }
+
+        const transform_t& local(handle_t h) const { return local_[index(h)]; }
+        void set_local(handle_t h, const transform_t& T) { edit_local(h) = T; }
+        // Marks the element dirty and returns its transform for modification
+        transform_t& edit_local(handle_t h) { auto idx = index(h); flags_[idx] |= F_TRANS_DIRTY; return local_[idx]; }
+
+        const bound_t& model_bound(handle_t h) const { return model_bound_[index(h)]; }
+        void set_model_bound(handle_t h, const bound_t& B) {
+            auto idx = index(h);
+            model_bound_[idx] = B;
+            flags_[idx] |= F_BOUND_DIRTY;
+        }
+
+        const affine_t& world(handle_t h) const { return world_[index(h)]; }
+        const bound_t& world_bound(handle_t h) const { return world_bound_[index(h)]; }
+
+        cull_mode culling(handle_t h) const { return culling_[index(h)]; }
+        void culling(handle_t h, cull_mode c) { culling_[index(h)] = c; }
+
+        // Composes the world matrices and bounds of all dirty elements and their descendants
+        void update();
+
+        // The dense arrays, in topological order (valid after update())
+        uint32_t index(handle_t h) const { assert(is_valid(h) && "Invalid transform_store handle"); return slots_[h]; }
+        handle_t handle(uint32_t idx) const { return ids_[idx]; }
+        const int32_t* parents() const { return parent_.data(); }
+        const affine_t* worlds() const { return world_.data(); }
+        const bound_t* world_bounds() const { return world_bound_.data(); }
+
+    protected:
+        enum flags : uint8_t {
+            F_TRANS_DIRTY = 1 << 0,
+            F_BOUND_DIRTY = 1 << 1,
+            F_GROWN = 1 << 2                            // The world bound holds at least one child's bound
+        };
+
+        void sort();
+        void compact(const std::vector<uint32_t>& order);
+
+        std::vector<int32_t> parent_;                   // Dense index of the parent, -1 for roots
+        std::vector<uint32_t> child_count_;
+        std::vector<transform_t> local_;
+        std::vector<affine_t> world_;
+        std::vector<bound_t> model_bound_;
+        std::vector<bound_t> world_bound_;
+        std::vector<uint8_t> flags_;
+        std::vector<cull_mode> culling_;
+        std::vector<handle_t> ids_;                     // Dense index to handle
+        std::vector<uint32_t> slots_;                   // Handle to dense index
+        std::vector<handle_t> free_;
+        bool order_invalid_ = false;
+    };
+
+    template <typename TransformT, typename GeoT>
+    void transform_store<TransformT,GeoT>::reserve(size_t count) {
+        parent_.reserve(count); child_count_.reserve(count); local_.reserve(count); world_.reserve(count);
+        model_bound_.reserve(count); world_bound_.reserve(count); flags_.reserve(count); culling_.reserve(count);
+        ids_.reserve(count); slots_.reserve(count);
+    }
+
+    template <typename TransformT, typename GeoT>
+    typename transform_store<TransformT,GeoT>::handle_t
+    transform_store<TransformT,GeoT>::create(const bound_t& model_bound, handle_t parent) {
+        assert((parent == invalid_handle || is_valid(parent)) && "Invalid parent handle");
+        handle_t h;
+        if(free_.empty()) {
+            h = handle_t(slots_.size());
+            slots_.push_back(0);
+        } else {
+            h = free_.back();
+            free_.pop_back();
+        }
+
+        // Appending keeps the order as the parent is already in the store
+        const auto idx = uint32_t(parent_.size());
+        slots_[h] = idx;
+        ids_.push_back(h);
+        parent_.push_back(parent == invalid_handle ? -1 : int32_t(slots_[parent]));
+        if(parent != invalid_handle) child_count_[slots_[parent]]++;
+        child_count_.push_back(0);
+        local_.emplace_back();
+        world_.push_back(affine_t::identity());
+        model_bound_.push_back(model_bound);
+        world_bound_.push_back(model_bound);
+        flags_.push_back(F_TRANS_DIRTY | F_BOUND_DIRTY);
+        culling_.push_back(cull_mode::CM_DYNAMIC);
+        return h;
+    }
+
+    template <typename TransformT, typename GeoT>
+    void transform_store<TransformT,GeoT>::destroy(handle_t h) {
+        if(!is_valid(h)) return;
+        if(order_invalid_) sort();
+
+        // Descendants follow their ancestors, so one pass from the element finds the subtree
+        const auto first = slots_[h];
+        const auto count = uint32_t(parent_.size());
+        std::vector<uint8_t> removed(count, 0);
+        removed[first] = 1;
+        for(uint32_t i = first+1; i < count; ++i) removed[i] = parent_[i] >= 0 && removed[parent_[i]];
+
+        if(parent_[first] >= 0) {
+            child_count_[parent_[first]]--;
+            flags_[parent_[first]] |= F_BOUND_DIRTY;
+        }
+
+        std::vector<uint32_t> order;
+        order.reserve(count);
+        for(uint32_t i = 0; i != count; ++i) {
+            if(removed[i]) {
+                free_.push_back(ids_[i]);
+                slots_[ids_[i]] = invalid_handle;
+            } else {
+                order.push_back(i);
+            }
+        }
+        compact(order);
+    }
+
+    template <typename TransformT, typename GeoT>
+    bool transform_store<TransformT,GeoT>::set_parent(handle_t h, handle_t parent) {
+        assert(is_valid(h) && (parent == invalid_handle || is_valid(parent)) && "Invalid handle");
+        const auto idx = slots_[h];
+        const int32_t pidx = parent == invalid_handle ? -1 : int32_t(slots_[parent]);
+        if(parent_[idx] == pidx) return true;
+
+        // Reject cycles
+        for(auto p = pidx; p >= 0; p = parent_[p]) {
+            if(uint32_t(p) == idx) {
+                LOG_ERR("Cannot attach an element to its own descendant");
+                return false;
+            }
+        }
+
+        if(parent_[idx] >= 0) {
+            child_count_[parent_[idx]]--;
+            flags_[parent_[idx]] |= F_BOUND_DIRTY;
+        }
+        if(pidx >= 0) child_count_[pidx]++;
+        parent_[idx] = pidx;
+        flags_[idx] |= F_TRANS_DIRTY;
+        if(pidx > int32_t(idx)) order_invalid_ = true;
+        return true;
+    }
+
+    template <typename TransformT, typename GeoT>
+    void transform_store<TransformT,GeoT>::update() {
+        if(order_invalid_) sort();
+
+        const auto count = parent_.size();
+        const int32_t* parent = parent_.data();
+        const transform_t* local = local_.data();
+        affine_t* world = world_.data();
+        uint8_t* flags = flags_.data();
+
+        // Forward: a parent precedes its children, so its world matrix and dirty state are final when they are reached
+        for(size_t i = 0; i != count; ++i) {
+            const auto p = parent[i];
+            if(p >= 0 && (flags[p] & F_TRANS_DIRTY)) flags[i] |= F_TRANS_DIRTY;
+            if(flags[i] & F_TRANS_DIRTY) {
+                world[i] = p >= 0 ? world[p] * local[i].affine() : local[i].affine();
+                flags[i] |= F_BOUND_DIRTY;
+            }
+        }
+
+        // Backward: dirty the ancestors of dirty bounds and reset the bounds to be recombined
+        for(size_t i = count; i-- != 0;) {
+            if(flags[i] & F_BOUND_DIRTY) {
+                flags[i] &= ~F_GROWN;
+                if(parent[i] >= 0) flags[parent[i]] |= F_BOUND_DIRTY;
+            }
+        }
+
+        // Backward: the children of an element are complete before it is reached and are grown into it
+        bound_t* model_bound = model_bound_.data();
+        bound_t* world_bound = world_bound_.data();
+        const uint32_t* child_count = child_count_.data();
+        for(size_t i = count; i-- != 0;) {
+            const auto p = parent[i];
+            if((flags[i] & F_BOUND_DIRTY) && child_count[i] == 0) world_bound[i] = model_bound[i].transform_cref(world[i]);
+            if(p >= 0 && (flags[p] & F_BOUND_DIRTY)) {
+                if(flags[p] & F_GROWN) world_bound[p].grow(world_bound[i]);
+                else {
+                    world_bound[p] = world_bound[i];
+                    flags[p] |= F_GROWN;
+                }
+            }
+            flags[i] &= ~(F_TRANS_DIRTY | F_BOUND_DIRTY);
+        }
+    }
+
+    template <typename TransformT, typename GeoT>
+    void transform_store<TransformT,GeoT>::sort() {
+        // Depth first, keeping the relative order of siblings and roots
+        const auto count = uint32_t(parent_.size());
+        std::vector<uint32_t> offset(count+1, 0), children(count);
+        for(uint32_t i = 0; i != count; ++i) if(parent_[i] >= 0) offset[parent_[i]+1]++;
+        for(uint32_t i = 0; i != count; ++i) offset[i+1] += offset[i];
+        {
+            std::vector<uint32_t> fill(offset.begin(), offset.end()-1);
+            for(uint32_t i = 0; i != count; ++i) if(parent_[i] >= 0) children[fill[parent_[i]]++] = i;
+        }
+
+        std::vector<uint32_t> order, stack;
+        order.reserve(count);
+        for(uint32_t root = 0; root != count; ++root) {
+            if(parent_[root] >= 0) continue;
+            stack.push_back(root);
+            while(!stack.empty()) {
+                const auto idx = stack.back();
+                stack.pop_back();
+                order.push_back(idx);
+                for(auto c = offset[idx+1]; c != offset[idx]; --c) stack.push_back(children[c-1]);
+            }
+        }
+
+        assert(order.size() == count && "transform_store hierarchy contains a cycle");
+        compact(order);
+        order_invalid_ = false;
+    }
+
+    namespace detail {
+        template <typename T>
+        void gather(std::vector<T>& arr, const std::vector<uint32_t>& order) {
+            std::vector<T> result;
+            result.reserve(order.size());
+            for(auto idx : order) result.push_back(std::move(arr[idx]));
+            arr.swap(result);
+        }
+    }
+
+    template <typename TransformT, typename GeoT>
+    void transform_store<TransformT,GeoT>::compact(const std::vector<uint32_t>& order) {
+        // Keeps the elements in order (old dense indices), remapping the parent indices
+        std::vector<int32_t> remap(parent_.size(), -1);
+        for(uint32_t i = 0; i != order.size(); ++i) remap[order[i]] = int32_t(i);
+
+        detail::gather(parent_, order);
+        for(auto& p : parent_) if(p >= 0) p = remap[p];
+        detail::gather(child_count_, order);
+        detail::gather(local_, order);
+        detail::gather(world_, order);
+        detail::gather(model_bound_, order);
+        detail::gather(world_bound_, order);
+        detail::gather(flags_, order);
+        detail::gather(culling_, order);
+        detail::gather(ids_, order);
+        for(uint32_t i = 0; i != ids_.size(); ++i) slots_[ids_[i]] = i;
+    }
+
+    // The spatial API over an element of a transform_store
+    template <typename TransformT, typename GeoT>
+    class spatial_handle {
+    public:
+        using store_t = transform_store<TransformT, GeoT>;
+        using transform_t = TransformT;
+        using bound_t = typename store_t::bound_t;
+        using handle_t = typename store_t::handle_t;
+        using type = typename transform_t::type;
+        using affine_t = typename transform_t::affine_t;
+        using vec_t = typename transform_t::vec_t;
+        using rot_t = typename transform_t::rot_t;
+
+        spatial_handle() = default;
+        spatial_handle(store_t* store, handle_t h) : store_(store), handle_(h) { }
+
+        bool is_valid() const { return store_ && store_->is_valid(handle_); }
+        handle_t handle() const { return handle_; }
+        store_t* store() const { return store_; }
+
+        void translate(const vec_t& T) { store_->edit_local(handle_).translate(T); }
+        void rotate(const rot_t& R) { store_->edit_local(handle_).rotate(R); }
+        void rotate(const affine_t& R) { store_->edit_local(handle_).rotate(R); }
+        void matrix(const rot_t& M) { store_->edit_local(handle_).matrix(M); }
+        void uniform_scale(type S) { store_->edit_local(handle_).uniform_scale(S); }
+        void scale(const vec_t& S) { store_->edit_local(handle_).scale(S); }
+
+        const transform_t& model_transform() const { return store_->local(handle_); }
+        void set_model_transform(const transform_t& T) { store_->set_local(handle_, T); }
+        const bound_t& model_bound() const { return store_->model_bound(handle_); }
+        void set_model_bound(const bound_t& B) { store_->set_model_bound(handle_, B); }
+        const affine_t& world_matrix() const { return store_->world(handle_); }
+        const bound_t& world_bound() const { return store_->world_bound(handle_); }
+
+        cull_mode culling() const { return store_->culling(handle_); }
+        void culling(cull_mode c) { store_->culling(handle_, c); }
+        bool always_cull() const { return culling() == cull_mode::CM_ALWAYS; }
+
+        spatial_handle parent() const { return spatial_handle(store_, store_->parent(handle_)); }
+        bool attach_child(const spatial_handle& child) { return store_->set_parent(child.handle_, handle_); }
+        bool detach() { return store_->set_parent(handle_, store_t::invalid_handle); }
+
+    protected:
+        store_t* store_ = nullptr;
+        handle_t handle_ = store_t::invalid_handle;
+    };
+}}
+
+#endif //ZAP_TRANSFORM_STORE_HPP
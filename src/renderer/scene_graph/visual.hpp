@@ -6,6 +6,7 @@
 #define ZAP_VISUAL_HPP
 
 #include "spatial.hpp"
+#include "culler.hpp"
 #include <engine/mesh.hpp>
 #include <renderer/render_args.hpp>
 
@@ -58,6 +59,8 @@ namespace zap { namespace scene_graph {
         const render_context* get_context() const { return context_; }
 
     protected:
+        void on_get_visible_set(culler<SpatialT>& c, bool no_cull) const override { c.insert(*this); }
+
         primitive_type type_ = primitive_type::PT_NONE;
         mesh_base* mesh_ = nullptr;
         render_context* context_ = nullptr;
@@ -0,0 +1,55 @@
+/* Created by Darren Otgaar on 2018/06/26. http://www.github.com/otgaard/zap */
+#ifndef ZAP_CPU_HPP
+#define ZAP_CPU_HPP
+
+/* The instruction sets of the host, for the dispatchers that select between kernels compiled once per instruction set.
+ *
+ * Kernels for an instruction set above the baseline are compiled in their own translation unit (flagged with isa_sources
+ * in CMakeUtils.cmake) and only called after checking the host here.  Such a unit must only contain code instantiated
+ * for it: templates instantiated on a type in its anonymous namespace, and the intrinsics.  Any non-template inline
+ * function it includes (from this header, <cmath>, the maths headers and so on) is emitted as a weak symbol compiled for
+ * that instruction set, and the linker may keep that copy for the callers in the baseline units.  The kernel headers
+ * shared with these units are written under this rule.
+ */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace zap {
+    namespace detail {
+        inline int detect_simd_width() {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if(info[0] < 7) return 4;
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+            if(!osxsave || !avx) return 4;
+            const unsigned long long xcr0 = _xgetbv(0);
+            __cpuidex(info, 7, 0);
+            if((info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6) return 16;        // AVX-512F with ZMM state enabled
+            if((info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6) return 8;            // AVX2 with YMM state enabled
+            return 4;
+#elif defined(__GNUC__)
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f")) return 16;
+            if(__builtin_cpu_supports("avx2")) return 8;
+            return 4;
+#else
+            return 4;
+#endif
+        }
+    }
+
+    // The float lanes of the widest vector the host supports: 16 (AVX-512F), 8 (AVX2) or 4 (SSE2)
+    inline int host_simd_width() {
+        static const int width = detail::detect_simd_width();
+        return width;
+    }
+
+    inline bool host_supports_avx2() { return host_simd_width() >= 8; }
+    inline bool host_supports_avx512() { return host_simd_width() >= 16; }
+}
+
+#endif //ZAP_CPU_HPP
@@ -5,10 +5,15 @@
 #include "os.hpp"
 #ifndef WIN32
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #else
 #include <windows.h>
 #endif
 #include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
 #include <GLFW/glfw3.h>
 
 using namespace zap;
@@ -31,6 +36,21 @@ bool zap::is_dir(const std::string& path) {
 #endif
 }
 
+bool zap::get_file_info(const std::string& filename, file_info& info) {
+#ifndef WIN32
+    struct stat buf;
+    if(stat(filename.c_str(), &buf) != 0 || !S_ISREG(buf.st_mode)) return false;
+    info.size = uint64_t(buf.st_size);
+    info.mtime = int64_t(buf.st_mtime);
+#else
+    struct _stat64 buf;
+    if(_stat64(filename.c_str(), &buf) != 0 || (buf.st_mode & _S_IFREG) == 0) return false;
+    info.size = uint64_t(buf.st_size);
+    info.mtime = int64_t(buf.st_mtime);
+#endif
+    return true;
+}
+
 std::vector<std::string> zap::get_files(const std::string& path) {
     std::vector<std::string> out;
 
@@ -62,4 +82,111 @@ std::vector<std::string> zap::get_files(const std::string& path) {
 #endif
 
     return out;
-}
\ No newline at end of file
+}
+zap::mapped_file::mapped_file(mapped_file&& rhs) noexcept : data_(rhs.data_), size_(rhs.size_) {
+#ifdef WIN32
+    file_ = rhs.file_; mapping_ = rhs.mapping_;
+    rhs.file_ = nullptr; rhs.mapping_ = nullptr;
+#endif
+    rhs.data_ = nullptr; rhs.size_ = 0;
+}
+
+zap::mapped_file& zap::mapped_file::operator=(mapped_file&& rhs) noexcept {
+    if(this != &rhs) {
+        close();
+        data_ = rhs.data_; size_ = rhs.size_;
+#ifdef WIN32
+        file_ = rhs.file_; mapping_ = rhs.mapping_;
+        rhs.file_ = nullptr; rhs.mapping_ = nullptr;
+#endif
+        rhs.data_ = nullptr; rhs.size_ = 0;
+    }
+    return *this;
+}
+
+bool zap::write_file_atomic(const std::string& path, const std::function<void(std::ostream&)>& writer) {
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if(file) writer(file);
+        file.close();                                   // Flushes the last of the buffer, failing the stream if it fails
+        if(!file) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+#ifdef WIN32
+    const bool renamed = MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool renamed = std::rename(tmp_path.c_str(), path.c_str()) == 0;   // Replaces path in a single step
+#endif
+    if(!renamed) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool zap::mapped_file::open(const std::string& path) {
+    close();
+
+#ifdef WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0) {
+        close();
+        return false;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mapping_) {
+        close();
+        return false;
+    }
+
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if(!data_) {
+        close();
+        return false;
+    }
+    size_ = size_t(file_size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd == -1) return false;
+
+    struct stat buf;
+    if(fstat(fd, &buf) != 0 || buf.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, size_t(buf.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);                                        // The mapping holds its own reference to the file
+    if(ptr == MAP_FAILED) return false;
+
+    madvise(ptr, size_t(buf.st_size), MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(ptr);
+    size_ = size_t(buf.st_size);
+#endif
+
+    return true;
+}
+
+void zap::mapped_file::close() {
+#ifdef WIN32
+    if(data_) UnmapViewOfFile(data_);
+    if(mapping_) CloseHandle(mapping_);
+    if(file_) CloseHandle(file_);
+    file_ = nullptr; mapping_ = nullptr;
+#else
+    if(data_) munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr; size_ = 0;
+}
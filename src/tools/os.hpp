@@ -7,11 +7,55 @@
 
 #include <string>
 #include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <functional>
 
 namespace zap {
+    struct file_info {
+        uint64_t size;
+        int64_t mtime;                                  // Last modification, seconds since the epoch
+    };
+
     bool is_file(const std::string& filename);
     bool is_dir(const std::string& path);
+    bool get_file_info(const std::string& filename, file_info& info);
     std::vector<std::string> get_files(const std::string& path);
+
+    // Writes path through writer into a temporary alongside it, renamed over path once complete so that a reader never
+    // maps a partial file.  Returns false, removing the temporary, if any write or the rename fails.
+    bool write_file_atomic(const std::string& path, const std::function<void(std::ostream&)>& writer);
+
+    // A read-only memory map of a whole file.  Empty files cannot be mapped and fail to open.
+    class mapped_file {
+    public:
+        mapped_file() = default;
+        explicit mapped_file(const std::string& path) { open(path); }
+        mapped_file(mapped_file&& rhs) noexcept;
+        mapped_file(const mapped_file&) = delete;
+        ~mapped_file() { close(); }
+
+        mapped_file& operator=(mapped_file&& rhs) noexcept;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        bool open(const std::string& path);
+        void close();
+
+        bool is_open() const { return data_ != nullptr; }
+        const char* data() const { return data_; }
+        const char* begin() const { return data_; }
+        const char* end() const { return data_ + size_; }
+        size_t size() const { return size_; }
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+#ifdef WIN32
+        void* file_ = nullptr;
+        void* mapping_ = nullptr;
+#endif
+    };
 };
 
 #endif //ZAP_OS_HPP
@@ -0,0 +1,325 @@
+//
+// Created by Darren Otgaar on 2018/06/13.
+//
+
+#ifndef ZAP_SCHEDULER_HPP
+#define ZAP_SCHEDULER_HPP
+
+/* A work-stealing task scheduler.  Each worker owns a deque of tasks: the owner pushes and pops at the back (LIFO, which
+ * keeps recently spawned work hot in cache) while idle workers steal from the front of the other deques.  Tasks submitted
+ * from outside the pool are distributed round-robin over the worker deques, so no single lock is shared by every
+ * submission.
+ *
+ * Tasks store their callable in a small inline buffer and only fall back to the heap for large captures.  Threads that
+ * wait on the scheduler (parallel_for, wait) execute pending tasks rather than blocking, so nested parallelism from inside
+ * a task cannot deadlock the pool.
+ */
+
+#include <core/core.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace zap {
+
+// A move-only, type-erased void() callable with small-buffer storage
+class task {
+public:
+    constexpr static size_t buffer_size = 48;
+
+    task() = default;
+    template <typename Fnc, typename = typename std::enable_if<!std::is_same<std::decay_t<Fnc>, task>::value>::type>
+    task(Fnc&& fnc) {
+        using F = std::decay_t<Fnc>;
+        using fits = std::integral_constant<bool, sizeof(F) <= buffer_size && alignof(F) <= alignof(storage_t) &&
+                                                  std::is_nothrow_move_constructible<F>::value>;
+        construct<F>(std::forward<Fnc>(fnc), fits{});
+    }
+    task(task&& rhs) noexcept : vtable_(rhs.vtable_) {
+        if(vtable_) vtable_->move(&storage_, &rhs.storage_);
+        rhs.vtable_ = nullptr;
+    }
+    task(const task&) = delete;
+    ~task() { reset(); }
+
+    task& operator=(task&& rhs) noexcept {
+        if(this != &rhs) {
+            reset();
+            vtable_ = rhs.vtable_;
+            if(vtable_) vtable_->move(&storage_, &rhs.storage_);
+            rhs.vtable_ = nullptr;
+        }
+        return *this;
+    }
+    task& operator=(const task&) = delete;
+
+    explicit operator bool() const { return vtable_ != nullptr; }
+    void operator()() { vtable_->invoke(&storage_); }
+
+    void reset() {
+        if(vtable_) vtable_->destroy(&storage_);
+        vtable_ = nullptr;
+    }
+
+private:
+    using storage_t = std::aligned_storage<buffer_size, alignof(std::max_align_t)>::type;
+
+    struct vtable {
+        void (*invoke)(void*);
+        void (*move)(void* trg, void* src);
+        void (*destroy)(void*);
+    };
+
+    template <typename F>
+    struct inline_ops {
+        static void invoke(void* ptr) { (*static_cast<F*>(ptr))(); }
+        static void move(void* trg, void* src) {
+            new (trg) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        }
+        static void destroy(void* ptr) { static_cast<F*>(ptr)->~F(); }
+        static const vtable* table() { static const vtable tbl = { &invoke, &move, &destroy }; return &tbl; }
+    };
+
+    template <typename F>
+    struct heap_ops {
+        static void invoke(void* ptr) { (**static_cast<F**>(ptr))(); }
+        static void move(void* trg, void* src) { *static_cast<F**>(trg) = *static_cast<F**>(src); }
+        static void destroy(void* ptr) { delete *static_cast<F**>(ptr); }
+        static const vtable* table() { static const vtable tbl = { &invoke, &move, &destroy }; return &tbl; }
+    };
+
+    template <typename F, typename Fnc>
+    void construct(Fnc&& fnc, std::true_type) {
+        new (&storage_) F(std::forward<Fnc>(fnc));
+        vtable_ = inline_ops<F>::table();
+    }
+
+    template <typename F, typename Fnc>
+    void construct(Fnc&& fnc, std::false_type) {
+        *reinterpret_cast<F**>(&storage_) = new F(std::forward<Fnc>(fnc));
+        vtable_ = heap_ops<F>::table();
+    }
+
+    storage_t storage_;
+    const vtable* vtable_ = nullptr;
+};
+
+class scheduler {
+public:
+    scheduler() = default;
+    scheduler(const scheduler&) = delete;
+    ~scheduler() { shutdown(); }
+    scheduler& operator=(const scheduler&) = delete;
+
+    bool initialise(int thread_count=2) {
+        if(!threads_.empty() || thread_count < 1) return false;
+
+        stop_ = false;
+        queues_.reset(new worker_queue[thread_count]);
+        queue_count_ = thread_count;
+        threads_.reserve(size_t(thread_count));
+        for(int i = 0; i != thread_count; ++i) threads_.emplace_back([this, i]() { worker(i); });
+        return true;
+    }
+
+    // Stops the workers once the queued tasks have run, so that a parallel_for or wait in flight on another thread still
+    // completes.  Tasks must not be submitted from outside the pool after shutdown has started.
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mtx_);
+            stop_ = true;
+        }
+        sleep_cv_.notify_all();
+        for(auto& thr : threads_) thr.join();
+        while(run_one()) { }                    // Anything submitted as the last worker exited
+        threads_.clear();
+        queues_.reset();
+        queue_count_ = 0;
+        pending_ = 0;
+    }
+
+    size_t size() const { return threads_.size(); }
+
+    // Submits the task to the calling worker's deque, or round-robin if called from outside the pool
+    void submit(task&& tsk) {
+        assert(queue_count_ != 0 && "scheduler::submit() requires an initialised scheduler");
+        auto& id = current();
+        const int idx = id.owner == this ? id.index : int(next_queue_++ % unsigned(queue_count_));
+
+        ++pending_;
+        {
+            std::lock_guard<std::mutex> lock(queues_[idx].mtx);
+            queues_[idx].tasks.emplace_back(std::move(tsk));
+        }
+
+        if(sleeping_ != 0) {
+            std::lock_guard<std::mutex> lock(sleep_mtx_);
+            sleep_cv_.notify_one();
+        }
+    }
+
+    // The arguments to the functions are packed into a copied tuple to prevent temporary destruction.  Remember to
+    // explicitly pass references using std::ref or std::cref.
+
+    template <typename Fnc, typename... Args>
+    void run_task(Fnc&& fnc, Args&&... arguments) {
+        submit(task{[fnc = std::forward<Fnc>(fnc), parms = std::make_tuple(std::forward<Args>(arguments)...)]() mutable {
+            zap::apply(fnc, parms);
+        }});
+    }
+
+    // Wraps a function in a future and executes it in the scheduler
+    template <typename Fnc, typename... Args>
+    auto run_function(Fnc&& fnc, Args&&... arguments) -> std::future<decltype(fnc(arguments...))> {
+        using RetT = decltype(fnc(arguments...));
+        std::packaged_task<RetT()> pkg{
+            [fnc = std::forward<Fnc>(fnc), parms = std::make_tuple(std::forward<Args>(arguments)...)]() mutable {
+                return zap::apply(fnc, parms);
+            }
+        };
+        auto fut = pkg.get_future();
+        submit(task{std::move(pkg)});
+        return fut;
+    }
+
+    // Calls fnc(first, last) over [begin, end) in chunks of grain, the calling thread participates.  fnc must not throw.
+    template <typename Fnc>
+    void parallel_for(int begin, int end, int grain, Fnc&& fnc) {
+        if(end <= begin) return;
+        grain = std::max(grain, 1);
+        const int chunks = (end - begin + grain - 1)/grain;
+        if(chunks == 1 || threads_.empty()) {
+            for(int first = begin; first < end; first += grain) fnc(first, std::min(first + grain, end));
+            return;
+        }
+
+        std::atomic<int> next_chunk{0}, active{0};
+        auto body = [&]() {
+            for(int chunk = next_chunk++; chunk < chunks; chunk = next_chunk++) {
+                const int first = begin + chunk*grain;
+                fnc(first, std::min(first + grain, end));
+            }
+        };
+
+        // Helpers that start after the range is exhausted return immediately, the stack frame outlives all of them
+        const int helpers = std::min(int(size()), chunks - 1);
+        active = helpers;
+        for(int i = 0; i != helpers; ++i) submit(task{[&body, &active]() { body(); --active; }});
+
+        body();
+        while(active != 0) {
+            if(!run_one()) std::this_thread::yield();
+        }
+    }
+
+    // Waits for the future while executing pending tasks
+    template <typename T>
+    T wait(std::future<T>& fut) {
+        while(fut.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if(!run_one()) std::this_thread::yield();
+        }
+        return fut.get();
+    }
+
+    // Executes one pending task on the calling thread, returns false if none was found
+    bool run_one() {
+        auto& id = current();
+        task tsk;
+        if(!take(id.owner == this ? id.index : -1, tsk)) return false;
+        tsk();
+        return true;
+    }
+
+protected:
+    struct worker_queue {
+        std::mutex mtx;
+        std::deque<task> tasks;
+    };
+
+    struct worker_id {
+        const scheduler* owner;
+        int index;
+    };
+
+    static worker_id& current() {
+        static thread_local worker_id id = { nullptr, -1 };
+        return id;
+    }
+
+    // Pops from the back of the own deque, then steals from the front of the others
+    bool take(int index, task& tsk) {
+        if(pending_ <= 0) return false;
+
+        if(index >= 0) {
+            auto& q = queues_[index];
+            std::lock_guard<std::mutex> lock(q.mtx);
+            if(!q.tasks.empty()) {
+                tsk = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                --pending_;
+                return true;
+            }
+        }
+
+        const int start = index >= 0 ? index + 1 : int(next_queue_ % unsigned(queue_count_));
+        for(int i = 0; i != queue_count_; ++i) {
+            auto& q = queues_[(start + i) % queue_count_];
+            std::unique_lock<std::mutex> lock(q.mtx, std::try_to_lock);
+            if(lock.owns_lock() && !q.tasks.empty()) {
+                tsk = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                --pending_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker(int index) {
+        current() = worker_id{this, index};
+
+        task tsk;
+        while(true) {
+            if(take(index, tsk)) {
+                tsk();
+                tsk.reset();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mtx_);
+            ++sleeping_;
+            sleep_cv_.wait(lock, [this]() { return stop_ || pending_ > 0; });
+            --sleeping_;
+            if(stop_ && pending_ <= 0) break;
+        }
+
+        current() = worker_id{nullptr, -1};
+    }
+
+private:
+    std::unique_ptr<worker_queue[]> queues_;
+    int queue_count_ = 0;
+    std::vector<std::thread> threads_;
+
+    std::atomic<int> pending_{0};               // Tasks queued but not yet taken
+    std::atomic<unsigned> next_queue_{0};
+
+    std::mutex sleep_mtx_;
+    std::condition_variable sleep_cv_;
+    std::atomic<int> sleeping_{0};
+    bool stop_ = false;
+};
+
+}
+
+#endif //ZAP_SCHEDULER_HPP